@@ -0,0 +1,206 @@
+#!/usr/bin/env python3
+"""
+Banco de rendimiento de facdes_solver (make bench).
+
+Ejecuta una matriz fija de casos con --timing, reúne el tiempo total, las
+iteraciones, el tiempo por iteración y el desglose por fase (transformadas,
+OZ en el espacio k, cierre, Ng/mezcla, salida) en bench/results.json y lo
+compara con bench/baseline.json:
+
+  - tiempo total: regresión si supera la línea base en más de --tolerance
+    (relativo) y en más de --min-seconds (absoluto, ruido del reloj);
+  - iteraciones: deben coincidir exactamente (el algoritmo es determinista,
+    un cambio indica un cambio numérico, no de rendimiento).
+
+Cada caso se ejecuta --repeat veces (una sola si tarda más de 30 s) en un
+directorio temporal y se toma la ejecución más rápida. Solo usa la
+biblioteca estándar de Python.
+
+Uso:
+  python3 bench/bench.py [--solver build/facdes_solver] [--quick] [--filter texto]
+                         [--repeat 3] [--tolerance 0.15] [--update-baseline]
+"""
+
+import argparse
+import json
+import os
+import platform
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+PHASES = ["transform", "oz", "closure", "mixing", "output", "other"]
+
+LONG_CASE_SECONDS = 30.0
+
+
+def build_cases():
+    """Matriz fija de casos: (nombre, argumentos, quick)."""
+    cases = []
+
+    # Esféricos: HNC y RY sobre Hertz, GCM y hombro suave a varios --nodes
+    spherical = [
+        ("hertz", ["--potential", "13", "--volfactor", "0.3", "--temp", "1.0"]),
+        ("gcm", ["--potential", "10", "--volfactor", "0.3", "--temp", "1.0"]),
+        ("shoulder", ["--potential", "16", "--volfactor", "0.2", "--temp", "1.0",
+                      "--lambda_a", "2.0", "--lambda_r", "5.0"]),
+    ]
+    for label, args in spherical:
+        for closure in ["HNC", "RY"]:
+            for nodes in [1024, 4096, 16384]:
+                cases.append(("%s_%s_n%d" % (label, closure, nodes),
+                              ["--closure", closure] + args + ["--nodes", str(nodes), "--knodes", "256"],
+                              nodes <= 4096))
+
+    # No esféricos: dipolar MSA/LHNC/RHNC y modo 2 (Anderson) de N = 512 a 8192
+    dipolar = ["--potential", "14", "--volfactor", "0.3", "--temp", "1.0", "--dipole", "1.0",
+               "--knodes", "64", "--mixing", "anderson"]
+    for closure in ["MSA", "LHNC", "RHNC"]:
+        for nodes in [512, 2048, 8192]:
+            cases.append(("dipolar_%s_n%d" % (closure, nodes),
+                          ["--closure", closure] + dipolar + ["--nodes", str(nodes)],
+                          nodes <= 2048))
+
+    mode2 = ["--potential", "15", "--volfactor", "0.3", "--temp", "1.0", "--dipole", "1.0",
+             "--knodes", "64", "--mixing", "anderson"]
+    for closure in ["MSA", "LHNC"]:
+        for nodes in [512, 2048, 8192]:
+            cases.append(("mode2_%s_n%d" % (closure, nodes),
+                          ["--closure", closure] + mode2 + ["--nodes", str(nodes)],
+                          nodes <= 512))
+
+    return cases
+
+
+def run_case(solver, args, repeat):
+    """Ejecuta un caso repeat veces y devuelve la ejecución más rápida (o None si falla)."""
+    best = None
+    for _ in range(repeat):
+        work = tempfile.mkdtemp(prefix="oz_bench_")
+        try:
+            os.mkdir(os.path.join(work, "output"))
+            timing = os.path.join(work, "timing.json")
+            proc = subprocess.run([solver] + args + ["--timing", timing], cwd=work,
+                                  stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+            if proc.returncode != 0 or not os.path.exists(timing):
+                sys.stderr.write(proc.stderr)
+                return None
+            with open(timing) as f:
+                result = json.load(f)
+        finally:
+            shutil.rmtree(work, ignore_errors=True)
+
+        if best is None or result["wall"] < best["wall"]:
+            best = result
+        # Long cases barely change between runs: one is enough
+        if result["wall"] > LONG_CASE_SECONDS:
+            break
+    return best
+
+
+def compare(results, baseline, tolerance, min_seconds):
+    """Compara con la línea base; devuelve el número de regresiones."""
+    regressions = 0
+    print("\n%-26s %10s %10s %8s %8s  %s" % ("caso", "base (s)", "ahora (s)", "cambio", "iter", "estado"))
+    for name, res in results.items():
+        base = baseline.get(name)
+        if base is None:
+            print("%-26s %10s %10.4f %8s %8d  sin línea base" % (name, "-", res["wall"], "-", res["iterations"]))
+            continue
+
+        change = res["wall"] / base["wall"] - 1.0 if base["wall"] > 0 else 0.0
+        status = "ok"
+        if res["iterations"] != base["iterations"]:
+            status = "REGRESIÓN: iteraciones %d -> %d" % (base["iterations"], res["iterations"])
+        elif change > tolerance and res["wall"] - base["wall"] > min_seconds:
+            status = "REGRESIÓN: tiempo"
+        elif change < -tolerance and base["wall"] - res["wall"] > min_seconds:
+            status = "mejora"
+        if status.startswith("REGRESIÓN"):
+            regressions += 1
+
+        print("%-26s %10.4f %10.4f %+7.1f%% %8d  %s" % (name, base["wall"], res["wall"], 100.0 * change,
+                                                       res["iterations"], status))
+    return regressions
+
+
+def print_phases(results):
+    print("\n%-26s %8s %10s" % ("caso", "iter", "s/iter") + "".join(" %9s" % p for p in PHASES))
+    for name, res in results.items():
+        print("%-26s %8d %10.2e" % (name, res["iterations"], res["time_per_iteration"]) + \
+              "".join(" %9.4f" % res["phases"].get(p, 0.0) for p in PHASES))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Banco de rendimiento por fases de facdes_solver.")
+    parser.add_argument("--solver", default=os.path.join(HERE, "..", "build", "facdes_solver"))
+    parser.add_argument("--baseline", default=os.path.join(HERE, "baseline.json"))
+    parser.add_argument("--output", default=os.path.join(HERE, "results.json"))
+    parser.add_argument("--quick", action="store_true", help="solo los casos pequeños")
+    parser.add_argument("--filter", default=None, help="solo los casos cuyo nombre contiene el texto")
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("--tolerance", type=float, default=0.15, help="regresión relativa tolerada del tiempo total")
+    parser.add_argument("--min-seconds", type=float, default=0.02, help="diferencia absoluta mínima para contar")
+    parser.add_argument("--update-baseline", action="store_true", help="guardar los resultados como línea base")
+    opts = parser.parse_args()
+
+    solver = os.path.abspath(opts.solver)
+    if not os.path.exists(solver):
+        sys.exit("Error: No se encuentra el ejecutable %s (ejecute make)." % solver)
+
+    cases = [c for c in build_cases() if (c[2] or not opts.quick) and (opts.filter is None or opts.filter in c[0])]
+    if not cases:
+        sys.exit("Error: Ningún caso coincide con la selección.")
+
+    results = {}
+    failed = 0
+    for i, (name, args, _) in enumerate(cases):
+        print("[%2d/%d] %-26s" % (i + 1, len(cases), name), end="", flush=True)
+        res = run_case(solver, args, max(opts.repeat, 1))
+        if res is None:
+            print(" FALLÓ")
+            failed += 1
+            continue
+        res["args"] = " ".join(args)
+        results[name] = res
+        print(" %8.4f s  %6d iter" % (res["wall"], res["iterations"]))
+
+    report = {"solver": os.path.basename(solver), "host": platform.node(), "repeat": opts.repeat, "cases": results}
+    with open(opts.output, "w") as f:
+        json.dump(report, f, indent=1, sort_keys=True)
+    print("\nResultados escritos en %s" % opts.output)
+
+    print_phases(results)
+
+    if opts.update_baseline:
+        baseline = {}
+        if os.path.exists(opts.baseline):
+            with open(opts.baseline) as f:
+                baseline = json.load(f).get("cases", {})
+        baseline.update(results)
+        report["cases"] = baseline
+        with open(opts.baseline, "w") as f:
+            json.dump(report, f, indent=1, sort_keys=True)
+        print("\nLínea base actualizada en %s (%d casos)" % (opts.baseline, len(baseline)))
+        return 1 if failed else 0
+
+    if not os.path.exists(opts.baseline):
+        print("\nSin línea base (%s); genérela con 'make bench-baseline'." % opts.baseline)
+        return 1 if failed else 0
+
+    with open(opts.baseline) as f:
+        baseline = json.load(f).get("cases", {})
+    regressions = compare(results, baseline, opts.tolerance, opts.min_seconds)
+
+    if regressions or failed:
+        print("\n%d regresiones, %d casos fallidos." % (regressions, failed))
+        return 1
+    print("\nSin regresiones (tolerancia %.0f%%)." % (100.0 * opts.tolerance))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
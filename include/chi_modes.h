@@ -0,0 +1,119 @@
+#ifndef CHI_MODES_H
+#define CHI_MODES_H
+
+#include <stddef.h>
+
+/**
+ * @brief Generic k-space OZ solver in the chi representation of linear molecules.
+ *
+ * The projections f^{mnl}(k) (m, n <= mmax, |m-n| <= l <= m+n, m+n+l even)
+ * are converted to Blum's normalisation, f_B = f / y^{mnl}, and combined
+ * into one matrix per chi = 0..mmax,
+ *
+ *   f^chi_{mn} = sum_l (m n l; chi -chi 0) f_B^{mnl},        m, n >= chi,
+ *
+ * on which the OZ equation is diagonal: H^chi = (I - (-1)^chi rho C^chi)^{-1} C^chi.
+ * Back-transform: f_B^{mnl} = (2l+1) sum_{chi=-min(m,n)}^{min(m,n)} (m n l; chi -chi 0) f^chi_{mn},
+ * with f^{-chi} = f^{chi} for m+n+l even.
+ *
+ * Every table (projection set, y^{mnl}, chi coefficients and the block
+ * structure) is built from Wigner 3j symbols when the solver is created.
+ * Each chi matrix is further split into its connected blocks, so decoupled
+ * projections (e.g. h000 of the dipolar fluid) are solved as scalars. The
+ * blocks are solved for CHI_TILE k points at a time by Gaussian
+ * elimination with partial pivoting per k and the k index innermost,
+ * which vectorises across k; the tiles are shared out among the OpenMP
+ * threads.
+ */
+
+/**
+ * @brief Number of k points solved together (length of the vector loops).
+ */
+#ifndef CHI_TILE
+#define CHI_TILE 64
+#endif
+
+/**
+ * @brief Normalisation of the projections f^{mnl} = y f_B^{mnl} handed to the solver.
+ */
+typedef enum {
+    CHI_NORM_Y = 0,         // y^{mnl} = sqrt((2m+1)(2n+1)) (m n l; 0 0 0)  (potential 15)
+    CHI_NORM_Y_LFACT = 1    // y^{mnl} / l!, so that Phi^{112} = D(12)        (potential 14)
+} ChiNormalization;
+
+typedef struct {
+    int chi;                // chi of the block (its -chi twin is identical)
+    int dim;                // Block size
+    int *m_index;           // [dim] m (= n) value of each row
+    double sign;            // (-1)^chi
+    int n_terms;            // Forward terms f^chi_{ab} += coef * f_B^p
+    int *entry;             // [n_terms] a*dim + b
+    int *proj;              // [n_terms] projection index p
+    double *coef;           // [n_terms] (m n l; chi -chi 0)
+} ChiBlock;
+
+typedef struct {
+    int n_projections;
+    int n_points;
+    int mmax;
+    int *m, *n, *l;         // [n_projections] projection indices
+    double *norm;           // [n_projections] y^{mnl}
+    int n_blocks;
+    ChiBlock *blocks;
+    int *inv_start;         // [n_projections+1] inverse terms of projection p
+    int *inv_block;         // Inverse terms, chi = -min(m,n) .. min(m,n)
+    int *inv_entry;
+    double *inv_coef;       // (2l+1) (m n l; chi -chi 0)
+    int n_work;             // Workspaces (one per OpenMP thread)
+    size_t work_size;       // Doubles per workspace
+    double *work;           // [n_work] tiles: per block C/H [dim*dim*CHI_TILE], A [dim*dim*CHI_TILE]
+    double *det;            // [n_work][CHI_TILE]
+} ChiModeSolver;
+
+/**
+ * @brief Wigner 3j symbol (j1 j2 j3; m1 m2 m3) for integer arguments (Racah formula).
+ */
+double wigner_3j(int j1, int j2, int j3, int m1, int m2, int m3);
+
+/**
+ * @brief Lists the projections (m, n, l) with m, n <= mmax and m+n+l even.
+ *
+ * Ordered by m, then n, then l. m, n and l may be NULL to only count them.
+ *
+ * @return Number of projections (14 for mmax = 2).
+ */
+int chi_projection_set(int mmax, int *m, int *n, int *l);
+
+/**
+ * @brief Builds the solver for an explicit projection list.
+ *
+ * Projections outside the list are taken as zero (e.g. 011 and 101 of the
+ * dipolar fluid).
+ *
+ * @return Pointer to the solver, or NULL on allocation failure or if a
+ *         projection has m+n+l odd or violates the triangle rule.
+ */
+ChiModeSolver* create_chi_mode_solver(int n_projections, const int *m, const int *n, const int *l,
+                                      ChiNormalization normalization, int n_points);
+
+/**
+ * @brief Frees a ChiModeSolver.
+ */
+void free_chi_mode_solver(ChiModeSolver *s);
+
+/**
+ * @brief Index of projection (m, n, l), or -1 if it is not in the solver.
+ */
+int chi_projection_index(const ChiModeSolver *s, int m, int n, int l);
+
+/**
+ * @brief Solves H(k) from C(k) at every k point.
+ *
+ * Blocks whose determinant is below 1e-12 in magnitude give H = 0 at that k.
+ *
+ * @param C_k [n_projections][n_points] direct correlation projections.
+ * @param H_k [n_projections][n_points] output total correlation projections.
+ */
+void chi_mode_solve(ChiModeSolver *s, double **C_k, double **H_k, double rho);
+
+#endif /* CHI_MODES_H */
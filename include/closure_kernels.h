@@ -0,0 +1,69 @@
+#ifndef CLOSURE_KERNELS_H
+#define CLOSURE_KERNELS_H
+
+/**
+ * @brief Branch-free loops of the closure relations.
+ *
+ * The callers split the grid at the hard core once, so these kernels only
+ * see the points outside it and have no per-element branch on r. Built
+ * with make SIMD=1 this file alone is compiled with -ffast-math and
+ * 'omp simd', so GCC vectorises exp/log through glibc's libmvec; the
+ * default build gives exactly the scalar results of the branchy loops.
+ *
+ * Output and input arrays must not overlap.
+ */
+
+// Mark a loop for vectorisation (no-op without make SIMD=1)
+#ifdef OZ_USE_SIMD
+#define OZ_SIMD _Pragma("omp simd")
+#else
+#define OZ_SIMD
+#endif
+
+/**
+ * @brief Inside the core: c = -(gamma + 1), i.e. g = 0.
+ */
+void closure_core_kernel(double *restrict c, const double *restrict gamma, int n);
+
+/**
+ * @brief Percus-Yevick factors w = 1 - exp(-beta u); -1 where beta u > 70 (U scaled by T).
+ *
+ * They depend only on U and T, so closrel_ctx keeps them in ctx->closure_tab.
+ */
+void closure_PY_weights(double *restrict w, const double *restrict U, double T, int n);
+
+/**
+ * @brief Percus-Yevick with precomputed factors: c = w (gamma + 1).
+ */
+void closure_PY_table_kernel(double *restrict c, const double *restrict gamma, const double *restrict w, int n);
+
+/**
+ * @brief HNC: c = exp(-beta u + gamma) - gamma - 1; -(gamma + 1) where beta u - gamma > 70.
+ */
+void closure_HNC_kernel(double *restrict c, const double *restrict gamma, const double *restrict U, double T, int n);
+
+/**
+ * @brief Boltzmann factors e = exp(-beta u) (U scaled by T), the r-only part of RY.
+ */
+void closure_boltzmann(double *restrict e, const double *restrict U, double T, int n);
+
+/**
+ * @brief Rogers-Young with precomputed Boltzmann factors: c = e (1 + (exp(gamma f) - 1)/f) - gamma - 1.
+ *
+ * @param e Factors from closure_boltzmann.
+ * @param f Mixing function from closure_RY_mixing (f = 0 gives the r -> 0 limit gamma).
+ */
+void closure_RY_table_kernel(double *restrict c, const double *restrict gamma, const double *restrict e, \
+                             const double *restrict f, int n);
+
+/**
+ * @brief Rogers-Young mixing function f = 1 - exp(-alpha r).
+ */
+void closure_RY_mixing(double *restrict f, const double *restrict r, double alpha, int n);
+
+/**
+ * @brief c = h - log(h + 1), or -1 where h + 1 <= 1e-12 (c000 of the dipolar LHNC/QHNC).
+ */
+void closure_log_kernel(double *restrict c, const double *restrict h, int n);
+
+#endif /* CLOSURE_KERNELS_H */
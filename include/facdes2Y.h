@@ -3,6 +3,8 @@
 
 #include "structures.h"
 #include "math_aux.h"
+#include "oz_output.h"
+#include "oz_cache.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -14,6 +16,72 @@
 #include <gsl/gsl_math.h>
 #include <gsl/gsl_spline.h>
 
+/**
+ * @brief Thermodynamics of a converged solution (from Termo).
+ */
+typedef struct {
+    double rho;                 // Number density
+    double pressure;            // Virial pressure beta*P
+    double chic;                // Inverse compressibility 1 - rho*c(k=0)
+    double energy;              // Excess energy beta*U/N
+    double chiv;                // d(beta*P)/drho from the tangent-linear solve (NAN unless --thermo linear)
+    double alpha;               // Closure alpha (fitted by the RY search)
+} OZThermo;
+
+/**
+ * @brief Scratch-buffer counters of one solve (from the context workspace).
+ */
+typedef struct {
+    size_t arena_allocs;        // Buffers served by the workspace
+    size_t heap_allocs;         // Buffers that had to come from malloc (0 when the workspace is big enough)
+    size_t high_water_bytes;    // Peak workspace use
+} OZAllocStats;
+
+/**
+ * @brief Every observable of one solve on the solver grid.
+ */
+typedef struct {
+    int nodes;
+    double *k;                  // [nodes] wave vectors of S(k), 1/S(k) and c(k)
+    double *Sk;                 // [nodes] S(k)
+    double *invSk;              // [nodes] 1/S(k)
+    double *Ck;                 // [nodes] c(k)
+    double *r;                  // [nodes] distances of g(r)
+    double *Gr;                 // [nodes] g(r)
+    double *Cr;                 // [nodes] c(r) on the g(r) grid
+    OZThermo thermo;
+    OZAllocStats alloc;
+    int ramp_steps;             // Accepted density steps of the ramp
+    int ramp_rejected;          // Adaptive steps retried at half size
+    int iterations;             // Iterations of the final solve (-1: did not converge)
+    double residual;            // Residual norm of the final solve
+    const double *k_out;        // [n_out] optional wave vectors where c(k) and S(k) are evaluated by Filon (NULL: none)
+    int n_out;
+    double *Ck_out;             // [n_out] c(k) on k_out (set by the caller with k_out)
+    double *Sk_out;             // [n_out] S(k) on k_out (set by the caller with k_out)
+} OZResult;
+
+// Density continuation, iteration and output defaults (facdes2Y.c)
+extern int rampMode, predictorOrder, solverMode, thermoMode, multigridLevels, outputFormat;
+extern const char *cacheDir;
+extern const OZPotentialTable *potentialTable;
+extern int filonOutput;
+
+OZResult* create_oz_result(int nodes);
+void free_oz_result(OZResult *result);
+void oz_result_from_context(OZResult *result, const OZContext *ctx, const double *StructFactor, const double *Gr_data);
+
+int write_oz_result_header(OZOutput *out, int potentialID, int closureID, int nodes, \
+                           double Temperature2, double lambda_a, double lambda_r);
+int write_oz_result(OZOutput *out, const OZResult *result, double volumeFactor, double Temperature);
+
+void spherical_cache_key(OZCacheKey *key, const OZContext *ctx, int potentialID, int closureID, \
+                         double Temperature2, double lambda_a, double lambda_r, double volumeFactor, double Temperature);
+double* spherical_cache_seed(const char *dir, const OZCacheKey *key, const OZContext *ctx, double max_distance, \
+                             double *rhoSeed, double *alphaSeed);
+int spherical_cache_usable(const OZContext *ctx);
+int spherical_cache_store(const char *dir, const OZCacheKey *key, const OZContext *ctx);
+
 void interpolationFunc(double *xInput, double *yInput, double *xOutput, double *yOutput, int nrowsInput, int nrowsOutput);
 
 void ck_HNC(double volumeFactor, double Temperature, double Temperature2, double lambda_a, double lambda_r, const gsl_vector *k, \
@@ -34,11 +102,26 @@ void sk_RY(double volumeFactor, double Temperature, double Temperature2, double
 void gr_RY(double volumeFactor, double Temperature, double Temperature2, double lambda_a, double lambda_r, const gsl_vector *r, \
             double *OutputVec, int potentialNumber, int nodesFacdes2Y);
 
+void all_HNC(double volumeFactor, double Temperature, double Temperature2, double lambda_a, double lambda_r, const gsl_vector *k, \
+             const gsl_vector *r, double *ckVec, double *isVec, double *skVec, double *grVec, OZThermo *thermo, \
+             OZAllocStats *alloc, int potentialNumber, int nodesFacdes2Y);
+void all_RY(double volumeFactor, double Temperature, double Temperature2, double lambda_a, double lambda_r, const gsl_vector *k, \
+            const gsl_vector *r, double *ckVec, double *isVec, double *skVec, double *grVec, OZThermo *thermo, \
+            OZAllocStats *alloc, int potentialNumber, int nodesFacdes2Y);
 
 int facdes2YFunc(const int nodes, int nrho, double rmax, int potentialID, int closureID, double sigma1, double sigma2, \
                  double Temperature, double Temperature2, double lambda_a, double lambda_r, double volumeFactor, \
                  double d, double alpha, double EZ, const int OutputFlag, double *ykVec, double *rkVec);
 
+int facdes2YAll(const int nodes, int nrho, double rmax, int potentialID, int closureID, double sigma1, double sigma2, \
+                double Temperature, double Temperature2, double lambda_a, double lambda_r, double volumeFactor, \
+                double d, double alpha, double EZ, OZResult *result);
+
+int facdes2YSolve(OZContext *ctx, int potentialID, int closureID, double sigma1, double sigma2, \
+                  double Temperature, double Temperature2, double lambda_a, double lambda_r, double volumeFactor, \
+                  double alpha, double EZ, int nrho, const double *gammaSeed, double rhoSeed, \
+                  double *StructFactor, double *Gr_data, char *folderName, int *printFlag);
+
 char *getFolderID();
 bool directoryExists(char *path);
 
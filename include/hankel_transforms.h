@@ -0,0 +1,80 @@
+#ifndef HANKEL_TRANSFORMS_H
+#define HANKEL_TRANSFORMS_H
+
+/**
+ * @brief Fast spherical Hankel transforms on the non-spherical solver grid.
+ *
+ * The grid is r_j = (j+1)*dr, k_i = (i+1)*dk with dk = PI/(N*dr), so that
+ * k_i r_j = PI (i+1)(j+1) / N and every j_l kernel reduces to discrete sine
+ * and cosine sums. For N a power of 2 these are evaluated with the
+ * Numerical-Recipes sinft/cosft1 machinery in O(N log N); otherwise the same
+ * sums are evaluated directly in O(N^2).
+ *
+ * Conventions (identical to HT2_Direct / IHT2_Direct for l = 2):
+ *   F(k) = 4 PI (-1)^(l/2) sum_j r_j^2 f(r_j) j_l(k r_j) dr
+ *   f(r) = (-1)^(l/2) / (2 PI^2) sum_i k_i^2 F(k_i) j_l(k_i r) dk
+ *
+ * A plan from create_hankel_plan_log uses instead the log-spaced grid
+ * r_j = r_min e^(j dlnr), k_i = k_min e^(i dlnr) with k_min ~ kr/r_max and
+ * k_max ~ kr/r_min (shifted by less than dlnr/2 against ringing), and
+ * evaluates the same integrals with FFTLog (Hamilton 2000): the integrand
+ * r^3 f(r) is expanded in powers r^(q + i eta_m) of ln r, each of which has
+ * a closed-form j_l transform, so orders 0..HANKEL_LOG_MAX_ORDER cost one
+ * pair of complex FFTs of 2N points. The prefactor is (-1)^(floor(l/2)).
+ */
+#define HANKEL_LOG_MAX_ORDER 4
+#define HANKEL_LOG_BIAS 1.5     // Power-law bias q of FFTLog (needs -l < q < 2)
+
+typedef struct {
+    int n_points;           // Number of grid points N
+    int use_fft;            // 1 if N is a power of 2
+    int log_grid;           // 1: log-spaced grid, FFTLog transforms
+    double dr, dk;          // Grid spacings (uniform grid)
+    double dlnr;            // Spacing of ln r and ln k (log grid)
+    double *r;              // r_j = (j+1)*dr, or r_min e^(j dlnr)
+    double *k;              // k_i = (i+1)*dk, or k_min e^(i dlnr)
+    double *work;           // FFT buffer [N+1], or [4N]: 2N complex values (log grid)
+    double *sum_a;          // Scratch for the three partial sums [N]
+    double *sum_b;
+    double *sum_c;
+    double *kernel;         // Log grid: FFTLog kernel u_m of each order, [HANKEL_LOG_MAX_ORDER+1][4N]
+} HankelPlan;
+
+/**
+ * @brief Allocates a transform plan for N points of spacing dr.
+ *
+ * @return Pointer to the plan, or NULL on allocation failure.
+ */
+HankelPlan* create_hankel_plan(int n_points, double dr);
+
+/**
+ * @brief Allocates an FFTLog plan for N log-spaced points on [r_min, r_max].
+ *
+ * N must be a power of 2 (the grid is zero-padded to 2N points). The k grid
+ * spans the same number of decades, placed by kr = k_min r_max = k_max r_min:
+ * kr > 1 trades reach at small k for resolution of the smallest r.
+ *
+ * @return Pointer to the plan, or NULL on allocation failure or a bad grid.
+ */
+HankelPlan* create_hankel_plan_log(int n_points, double r_min, double r_max, double kr);
+
+/**
+ * @brief Frees a transform plan.
+ */
+void free_hankel_plan(HankelPlan *plan);
+
+/**
+ * @brief Forward transform f(r) -> F(k) of order l (l = 0 or 2; 0..HANKEL_LOG_MAX_ORDER on a log grid).
+ *
+ * @return 0 on success, -1 if the order is not supported.
+ */
+int hankel_forward(HankelPlan *plan, int l, const double *f, double *fk);
+
+/**
+ * @brief Inverse transform F(k) -> f(r) of order l (l = 0 or 2; 0..HANKEL_LOG_MAX_ORDER on a log grid).
+ *
+ * @return 0 on success, -1 if the order is not supported.
+ */
+int hankel_inverse(HankelPlan *plan, int l, const double *fk, double *f);
+
+#endif /* HANKEL_TRANSFORMS_H */
@@ -0,0 +1,63 @@
+#ifndef HS_REFERENCE_H
+#define HS_REFERENCE_H
+
+/**
+ * @brief Hard-sphere reference of the RHNC closure (--closure RHNC).
+ *
+ * Tables on the non-spherical grid r_j = (j+1)*dr (hankel_transforms.h),
+ * built once with the order-0 Hankel transforms and never written again,
+ * so every solve at the same (rho, sigma, grid) shares one reference
+ * read-only, also across threads. The closure only reads the tables: the
+ * Verlet-Weis correction and d ln g/dr cost nothing per iteration.
+ */
+typedef enum {
+    HS_REFERENCE_PY = 0,    // Percus-Yevick (Wertheim-Thiele c(r))
+    HS_REFERENCE_VW = 1     // Verlet-Weis corrected PY g(r)
+} HSReferenceKind;
+
+typedef struct {
+    HSReferenceKind kind;
+    int n_points;
+    double dr;
+    double rho;
+    double sigma;
+    double *c;              // [n_points] c_HS(r)
+    double *h;              // [n_points] h_HS(r)
+    double *eta;            // [n_points] h_HS - c_HS
+    double *dlng;           // [n_points] d ln g_HS/dr for r > sigma (central differences, one-sided at contact; 0 in the core)
+} HSReference;
+
+/**
+ * @brief Computes a reference on n_points points of spacing dr.
+ *
+ * PY: the exact PY c(r) inside sigma, transformed to C(k), OZ for H(k) and
+ * back to h(r). VW: PY at the packing eta_w = eta - eta^2/16 (diameter
+ * sigma*(eta_w/eta)^(1/3)) plus the damped oscillatory tail beyond sigma,
+ * with h = -1 inside the core and c(r) from OZ.
+ *
+ * @return Pointer to the reference, or NULL on allocation failure.
+ */
+HSReference* create_hs_reference(HSReferenceKind kind, int n_points, double dr, double rho, double sigma);
+
+/**
+ * @brief Frees a reference from create_hs_reference (not one from hs_reference_get).
+ */
+void free_hs_reference(HSReference *ref);
+
+/**
+ * @brief Shared reference for (kind, grid, rho, sigma), computed at most once per process.
+ *
+ * Looks in the references of this process, then in cache_dir (NULL: no
+ * on-disk cache), and computes and stores it otherwise. Thread-safe.
+ *
+ * @return Read-only reference owned by the process table, or NULL on failure.
+ */
+const HSReference* hs_reference_get(HSReferenceKind kind, int n_points, double dr, double rho, double sigma, \
+                                    const char *cache_dir);
+
+/**
+ * @brief Frees every reference returned by hs_reference_get (none may be in use).
+ */
+void hs_reference_clear(void);
+
+#endif /* HS_REFERENCE_H */
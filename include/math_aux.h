@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <stdbool.h>
+#include "oz_context.h"
 
 // We define some global parameters
 extern int nrows, ncols;
@@ -26,10 +27,36 @@ void intt(double *h, double dr, double *sft);
 void FT(double *c, double *c1, double *rk, double dr);
 void FFT(double *inputData, double rmax, int isDirect);
 
+// Reentrant variants: the grid and composition come from the context
+extern void closrel_ctx(const OZContext *ctx, double *gamma, int potentialID, int closureID, double *cFuncMatrix, double T, double alpha);
+
+void pp_ctx(const OZContext *ctx, double dr, double *matrix1, double *matrix2, double *prod);
+void ONg_ctx(const OZContext *ctx, double *gammaInput, double *gammaOutput, int potentialID, int closureID, \
+             double *cFuncMatrix, double T, double Tfin, double alpha);
+/*
+   Zero-padding factor of FT_fast_ctx: the sine transform is evaluated on
+   k_m = m*PI/(FT_PAD*rmax), FT_PAD times finer than q, before the spline.
+*/
+#define FT_PAD 4
+
+void Extrap_ctx(const OZContext *ctx, double *gammaOutput, double *gammaInput, double rho, double drho);
+void interp_ctx(const OZContext *ctx, int m, int n, double *r1, double *gammaInput, double *gammaOutput);
+void Pres_ctx(const OZContext *ctx, double *f, double dr, double *eta);
+void FFTM_ctx(const OZContext *ctx, double *inputDataMatrix, int isDirect);
+double calint_ctx(const OZContext *ctx, double *f, double dr);
+void intt_ctx(const OZContext *ctx, double *h, double dr, double *sft);
+void FT_ctx(const OZContext *ctx, double *c, double *c1, double *rk, double dr);
+void FT_fast_ctx(const OZContext *ctx, double *c, double *c1, double *rk, int nk);
+void FT_filon_ctx(const OZContext *ctx, double *c, double *c1, double *rk, int nk);
+void FFT_ctx(const OZContext *ctx, double *inputData, int isDirect);
+
 void HT2_Direct(double *f, double *fk, double *r, double *k_vec, int nodes);
 void IHT2_Direct(double *fk, double *f, double *r, double *k_vec, int nodes);
 void sinft(double *y, int nmax);
+void sinft_double(double *y, int n);
+void cosft1_double(double *y, int n);
 void realft(double *data, int n, int isign, int nmax);
 void four1(double *data, int nn, int isign, int nmax);
+void four1_double(double *data, int nn, int isign);
 
 #endif /* FACDES2Y_MATH_DOT_H */
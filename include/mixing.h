@@ -0,0 +1,128 @@
+#ifndef MIXING_H
+#define MIXING_H
+
+/**
+ * @brief Anderson (DIIS) mixing over all projections of a ProjectionMatrix.
+ *
+ * The fixed-point map of the non-spherical solvers is c -> G(c), where G is
+ * the transform/OZ/closure sequence of one Picard sweep. With residual
+ * f = G(c) - c, the Anderson update over the last m steps is
+ *
+ *   c_{k+1} = c_k + beta f_k - sum_a gamma_a (dc_a + beta df_a),
+ *
+ * with gamma the least-squares solution of min || f_k - sum_a gamma_a df_a ||.
+ * With an empty history this is exactly the damped Picard step.
+ */
+typedef struct {
+    int n_projections;
+    int n_points;
+    int depth;              // Maximum history length m
+    int count;              // Pairs currently stored (<= depth)
+    int head;               // Next slot to overwrite
+    int has_previous;       // 1 once c_prev/f_prev hold a valid step
+    double *dc;             // [depth][n_projections*n_points] differences of c
+    double *df;             // [depth][n_projections*n_points] differences of f
+    double *c_prev;         // Previous iterate
+    double *f_prev;         // Previous residual
+    double *f;              // Current residual
+    double *gram;           // [depth*depth] normal-equation matrix
+    double *gamma;          // [depth] mixing coefficients
+    double *partial;        // Chunk sums of the reductions
+    const double *weight;   // [n_points] weights of the residual norm (NULL: plain RMS), not owned
+} AndersonMixer;
+
+/**
+ * @brief Points per partial sum of the residual and the Gram products.
+ *
+ * Chunks are summed in a fixed order, so the reductions (and hence the
+ * iteration history) do not depend on the number of OpenMP threads.
+ */
+#ifndef MIX_CHUNK
+#define MIX_CHUNK 4096
+#endif
+
+/**
+ * @brief Residual growth between two steps that counts as a failed step.
+ *
+ * Anderson residuals are not monotone, so small increases are tolerated.
+ */
+#ifndef DAMPING_GROWTH_FACTOR
+#define DAMPING_GROWTH_FACTOR 1.5
+#endif
+
+/**
+ * @brief Step-size controller that backs off when the residual grows.
+ */
+typedef struct {
+    int enabled;
+    double beta;            // Current damping
+    double beta_max;        // Requested damping (upper bound)
+    double beta_min;        // Lower bound
+    double prev_error;      // Residual of the previous step (< 0 before the first)
+} DampingControl;
+
+/**
+ * @brief Allocates a mixer for n_projections x n_points with history depth.
+ *
+ * @return Pointer to the mixer, or NULL on allocation failure.
+ */
+AndersonMixer* create_anderson_mixer(int n_projections, int n_points, int depth);
+
+/**
+ * @brief Frees a mixer.
+ */
+void free_anderson_mixer(AndersonMixer *am);
+
+/**
+ * @brief Weights every point of the residual norm and of the least-squares fit.
+ *
+ * The norm becomes sqrt(sum_p sum_i weight[i] f_p[i]^2 / (n_projections*n_points)).
+ * weight has n_points entries and must outlive the mixer; NULL restores the plain RMS.
+ */
+void anderson_set_weights(AndersonMixer *am, const double *weight);
+
+/**
+ * @brief Drops the stored history (the next step is plain Picard).
+ */
+void anderson_reset(AndersonMixer *am);
+
+/**
+ * @brief Computes the RMS residual between c_new and c.
+ *
+ * Stores f = c_new - c inside the mixer for the following anderson_step.
+ */
+double anderson_residual(AndersonMixer *am, double **c, double **c_new);
+
+/**
+ * @brief Updates c in place with the Anderson step for damping beta.
+ *
+ * Must be called after anderson_residual for the same c.
+ */
+void anderson_step(AndersonMixer *am, double **c, double beta);
+
+/**
+ * @brief Solves the m x m system G gamma = b in place (b returns gamma).
+ *
+ * Gaussian elimination with partial pivoting; also used by the device
+ * Anderson step of mode2_gpu.h.
+ *
+ * @return 0 on success, -1 if G is numerically singular.
+ */
+int mixing_solve_small_system(double *G, double *b, int m);
+
+/**
+ * @brief Initializes the damping controller.
+ */
+void damping_init(DampingControl *dc, double beta, int enabled);
+
+/**
+ * @brief Adapts beta to the latest residual.
+ *
+ * Halves beta (down to beta_min) when the residual grew by more than
+ * DAMPING_GROWTH_FACTOR and slowly restores it towards beta_max otherwise.
+ *
+ * @return 1 if the step failed (the caller should reset the history), 0 otherwise.
+ */
+int damping_update(DampingControl *dc, double error);
+
+#endif /* MIXING_H */
@@ -0,0 +1,121 @@
+#ifndef MODE2_GPU_H
+#define MODE2_GPU_H
+
+#include "structures_nonspherical.h"
+#include "chi_modes.h"
+
+/**
+ * @brief Potential-15 iteration on a CUDA device (make CUDA=1, --gpu 1).
+ *
+ * The device keeps c, h, eta, C_k and H_k, the j_l(k_i r_j) tables of every
+ * order and the Anderson history for the whole loop. Each step of
+ * solver_mode2_core maps onto one call: the transforms are cuBLAS dgemm
+ * against the tables (the same products as the CPU path), the chi blocks
+ * are solved by one thread per k with the pivoting of chi_mode_solve, and
+ * the closures are elementwise kernels. Only the residual and the Anderson
+ * Gram products (a few scalars) come back per iteration; the full arrays
+ * only with mode2_device_download, for checkpoints and output.
+ *
+ * Reductions sum fixed blocks in a fixed order, so a run is reproducible,
+ * but it is not bitwise identical to the CPU path (device sin/cos/log).
+ * Every call is synchronous, so --timing charges each phase correctly.
+ *
+ * Without OZ_USE_CUDA the functions below are stubs: no device is
+ * available and create_mode2_device returns NULL.
+ */
+typedef struct Mode2Device Mode2Device;
+
+/**
+ * @brief Largest chi block (m, n <= 7) solved on the device.
+ */
+#define MODE2_GPU_MAX_DIM 8
+
+#ifdef OZ_USE_CUDA
+
+/**
+ * @brief 1 if a CUDA device can be used, 0 otherwise.
+ */
+int mode2_gpu_available(void);
+
+/**
+ * @brief Copies the grids and the chi tables to the device and builds the
+ * Bessel tables there.
+ *
+ * @return Pointer to the device state, or NULL if there is no device, a
+ *         block exceeds MODE2_GPU_MAX_DIM or device memory runs out.
+ */
+Mode2Device* create_mode2_device(const ChiModeSolver *chi, const double *r, const double *k, int nodes, \
+                                 int depth);
+
+/**
+ * @brief Releases the device memory.
+ */
+void free_mode2_device(Mode2Device *dev);
+
+/**
+ * @brief Sets the device c from the host (initial guess or cached solution).
+ */
+void mode2_device_upload(Mode2Device *dev, const ProjectionMatrix *c);
+
+/**
+ * @brief C_k = forward transform of c.
+ */
+void mode2_device_forward(Mode2Device *dev, double prefactor);
+
+/**
+ * @brief H_k from C_k in the chi representation.
+ */
+void mode2_device_oz(Mode2Device *dev, double rho);
+
+/**
+ * @brief h = inverse transform of H_k.
+ */
+void mode2_device_inverse(Mode2Device *dev, double prefactor);
+
+/**
+ * @brief eta = h - c and the closure (0 = MSA, otherwise LHNC) into c_new.
+ */
+void mode2_device_closure(Mode2Device *dev, int closureID, double beta_mu2, double sigma, int i112);
+
+/**
+ * @brief RMS of c_new - c, as anderson_residual; keeps the residual on the device.
+ */
+double mode2_device_residual(Mode2Device *dev);
+
+/**
+ * @brief Anderson step for damping beta, as anderson_step (reset: drop the history first).
+ */
+void mode2_device_step(Mode2Device *dev, double beta, int reset);
+
+/**
+ * @brief Copies the device arrays back; any of the matrices may be NULL.
+ */
+void mode2_device_download(const Mode2Device *dev, ProjectionMatrix *c, ProjectionMatrix *h, \
+                           ProjectionMatrix *C_k, ProjectionMatrix *H_k);
+
+#else
+
+static inline int mode2_gpu_available(void) { return 0; }
+static inline Mode2Device* create_mode2_device(const ChiModeSolver *chi, const double *r, const double *k, \
+                                               int nodes, int depth) {
+    (void) chi; (void) r; (void) k; (void) nodes; (void) depth;
+    return NULL;
+}
+static inline void free_mode2_device(Mode2Device *dev) { (void) dev; }
+static inline void mode2_device_upload(Mode2Device *dev, const ProjectionMatrix *c) { (void) dev; (void) c; }
+static inline void mode2_device_forward(Mode2Device *dev, double prefactor) { (void) dev; (void) prefactor; }
+static inline void mode2_device_oz(Mode2Device *dev, double rho) { (void) dev; (void) rho; }
+static inline void mode2_device_inverse(Mode2Device *dev, double prefactor) { (void) dev; (void) prefactor; }
+static inline void mode2_device_closure(Mode2Device *dev, int closureID, double beta_mu2, double sigma, int i112) {
+    (void) dev; (void) closureID; (void) beta_mu2; (void) sigma; (void) i112;
+}
+static inline double mode2_device_residual(Mode2Device *dev) { (void) dev; return 0.0; }
+static inline void mode2_device_step(Mode2Device *dev, double beta, int reset) { (void) dev; (void) beta; (void) reset; }
+static inline void mode2_device_download(const Mode2Device *dev, ProjectionMatrix *c, ProjectionMatrix *h, \
+                                         ProjectionMatrix *C_k, ProjectionMatrix *H_k) {
+    (void) dev; (void) c; (void) h; (void) C_k; (void) H_k;
+}
+
+#endif /* OZ_USE_CUDA */
+
+#endif /* MODE2_GPU_H */
@@ -0,0 +1,64 @@
+#ifndef NEWTON_H
+#define NEWTON_H
+
+#include "oz_context.h"
+
+// Jacobian-free Newton-Krylov solver for gamma = ONg(gamma) (--solver newton)
+#define NK_MAX_ITER       30        // Newton steps before giving up
+#define NK_KRYLOV_DIM     15        // GMRES basis size (one cycle per Newton step)
+#define NK_FORCING_MAX    0.1       // Largest relative GMRES tolerance (Eisenstat-Walker)
+#define NK_MAX_BACKTRACK  8         // Step halvings of the line search
+
+// Tangent-linear density derivative (TangentPressure_ctx, --thermo linear)
+#define TL_TOL            1.0E-5    // Relative residual of the linear solve (the differences of ONg are noisy near 1e-7)
+#define TL_MAX_CYCLES     4         // GMRES restarts before giving up
+#define TL_DRHO_REL       1.0E-4    // Relative density step of the pressure difference
+
+/**
+ * @brief Solves F(gamma) = ONg(gamma) - gamma = 0 by Newton-GMRES.
+ *
+ * Drop-in replacement for the Ng iteration at one state point: same
+ * arguments, same convergence measure (Pres_ctx of the residual <= EZ)
+ * and, on success, gammaOutput = ONg(gamma) and cFuncMatrix hold the
+ * converged solution exactly as Ng leaves them. Jacobian-vector products
+ * are forward differences of ONg_ctx, so closrel_ctx and the transforms
+ * are used unchanged. Each step is damped by a backtracking line search
+ * on the residual norm.
+ *
+ * @param ctx Solver context.
+ * @param step Step number of the telemetry records (oz_telemetry_next_step).
+ * @param gammaInput Initial guess.
+ * @param gammaOutput Output gamma. On failure, the iterate with the smallest residual.
+ * @param potentialID ID of the potential.
+ * @param closureID ID of the closure relation.
+ * @param cFuncMatrix Direct correlation function matrix (scratch and output).
+ * @param T Coupling factor of the potential.
+ * @param TFlag Passed to the last ONg_ctx call (>= 1 prints S(k) max).
+ * @param alpha Closure parameter.
+ * @param EZ Convergence criterion.
+ * @return Newton steps taken, or -1 if it did not converge. The last
+ *         residual norm is left in ctx->ng_residual.
+ */
+int NewtonKrylov_ctx(OZContext *ctx, int step, double *gammaInput, double *gammaOutput, int potentialID, int closureID, \
+                     double *cFuncMatrix, double T, double TFlag, double alpha, double EZ);
+
+/**
+ * @brief Density derivative of the virial pressure at a converged solution.
+ *
+ * Solves the linearised fixed point (I - dONg/dgamma) dgamma = dONg/drho
+ * with restarted GMRES, using the same forward-difference products of
+ * ONg_ctx as NewtonKrylov_ctx, and differentiates Termo_ctx along
+ * (dgamma, 1). Replaces the two nonlinear solves at rho -+ ddrho of the
+ * RY consistency check by one linear solve.
+ *
+ * @param ctx Solver context at the density of gamma.
+ * @param gamma Converged gamma (as left by Ng_ctx in gammaOutput).
+ * @param potentialID ID of the potential.
+ * @param closureID ID of the closure relation.
+ * @param alpha Closure parameter of the solution.
+ * @param dpdrho Output: d(beta*P)/drho at constant temperature.
+ * @return 0 on success, 1 if the linear solve did not converge or ran out of memory.
+ */
+int TangentPressure_ctx(const OZContext *ctx, double *gamma, int potentialID, int closureID, double alpha, double *dpdrho);
+
+#endif /* NEWTON_H */
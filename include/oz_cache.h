@@ -0,0 +1,104 @@
+#ifndef OZ_CACHE_H
+#define OZ_CACHE_H
+
+/**
+ * @brief On-disk cache of converged solutions and checkpoints (--cache <dir>).
+ *
+ * Every entry is one bin file (see oz_output.h) in the cache directory,
+ * named after its key with the state point rounded to 6 significant
+ * digits, so solving the same point again replaces the entry. Entries are
+ * written to a temporary file and renamed, so a killed run never leaves a
+ * truncated one. A solve looks up the compatible entry (same solver,
+ * potential, closure and fixed parameters) nearest to its state point and
+ * starts from it, interpolating onto its own grid when the grids differ.
+ */
+
+/**
+ * @brief Largest relative state-point distance accepted as a warm start.
+ */
+#ifndef OZ_CACHE_MAX_DISTANCE
+#define OZ_CACHE_MAX_DISTANCE 0.25
+#endif
+
+#define OZ_CACHE_MAX_STATE 3
+
+typedef struct {
+    char solver[16];            // "spherical", "dipolar" or "mode2"
+    char closure[8];            // Closure name (e.g. "HNC", "LHNC")
+    int potential;
+    int mmax;                   // Highest m, n of the projections (0: spherical)
+    int nodes;                  // Grid of the entry (informative: grids may differ)
+    double rmax;
+    double params[3];           // Must match exactly (spherical: temp2, lambda_a, lambda_r)
+    int n_state;
+    double state[OZ_CACHE_MAX_STATE]; // Nearest-neighbour coordinates (e.g. volfactor, temp)
+} OZCacheKey;
+
+typedef struct {
+    OZCacheKey key;
+    int converged;              // 0 for a checkpoint of an unfinished solve
+    int iterations;
+    double residual;
+    double rho;
+    double alpha;               // Closure alpha (RY), 0 otherwise
+    double distance;            // Relative distance to the looked-up key
+    int n_columns;
+    int n_rows;
+    double *r;                  // [n_rows] grid of the stored functions
+    double *data;               // [n_columns*n_rows] one column after another
+} OZCacheEntry;
+
+/**
+ * @brief Allocates an entry for key with n_columns functions on n_rows points.
+ *
+ * @return Pointer to the entry, or NULL on allocation failure.
+ */
+OZCacheEntry* create_oz_cache_entry(const OZCacheKey *key, int n_columns, int n_rows);
+
+/**
+ * @brief Frees an OZCacheEntry.
+ */
+void free_oz_cache_entry(OZCacheEntry *entry);
+
+/**
+ * @brief Writes entry into dir (created if missing), replacing any entry with the same rounded key.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int oz_cache_save(const char *dir, const OZCacheEntry *entry);
+
+/**
+ * @brief Loads the compatible entry nearest to key.
+ *
+ * The distance is the RMS relative difference of the state coordinates. On
+ * ties an entry on the same grid, then a converged one, is preferred.
+ *
+ * @param max_distance Largest accepted distance (OZ_CACHE_MAX_DISTANCE; 0: the same state point only).
+ * @return Pointer to the entry, or NULL if none lies within max_distance.
+ */
+OZCacheEntry* oz_cache_nearest(const char *dir, const OZCacheKey *key, double max_distance);
+
+/**
+ * @brief Maps n_columns columns of n_in values on r_in onto the increasing grid r.
+ *
+ * On the same grid the values are copied. Otherwise they are interpolated
+ * with interpolationFunc inside [r_in[0], r_in[n_in-1]], held at the first
+ * value below it and set to 0 beyond it (correlations vanish at large r).
+ * Also carries the coarse solutions of --multigrid to the next grid.
+ *
+ * @param data [n_columns*n_in] input, one column after another.
+ * @param out [n_columns*n_rows] output, one column after another.
+ * @return 0 on success, 1 on failure.
+ */
+int oz_fit_columns(const double *r_in, const double *data, int n_in, int n_columns, \
+                   const double *r, int n_rows, double *out);
+
+/**
+ * @brief Maps every column of entry onto the increasing grid r (oz_fit_columns).
+ *
+ * @param out [n_columns*n_rows] output, one column after another.
+ * @return 0 on success, 1 on failure.
+ */
+int oz_cache_fit(const OZCacheEntry *entry, const double *r, int n_rows, double *out);
+
+#endif /* OZ_CACHE_H */
@@ -0,0 +1,201 @@
+#ifndef OZ_CONTEXT_H
+#define OZ_CONTEXT_H
+
+#include <stddef.h>
+#include "oz_fft.h"
+#include "oz_potential.h"
+
+/**
+ * @brief Scratch arena borrowed by the solver routines.
+ *
+ * One aligned block sized from nrows*ncols when the context is created.
+ * Routines take buffers with oz_alloc and give them all back with
+ * oz_release(ctx, mark) on return, so the iteration does not touch the heap.
+ */
+typedef struct {
+    double *base;           // Aligned block of capacity doubles
+    size_t capacity;
+    size_t used;            // Doubles currently handed out
+    size_t high_water;      // Largest value of used so far
+    size_t arena_allocs;    // Buffers served from the block
+    size_t heap_allocs;     // Buffers that fell back to malloc (block full or no arena)
+} OZWorkspace;
+
+/**
+ * @brief Rogers-Young mixing function f(r) = 1 - exp(-alpha r) for the last alpha.
+ *
+ * closrel_ctx rebuilds it only when alpha changes, so the Ng iterations at
+ * one alpha do not recompute an r-only factor on every call.
+ */
+typedef struct {
+    double alpha;           // alpha of f (< 0: not built yet)
+    double *f;              // [nrows]
+} OZRYMixing;
+
+/**
+ * @brief Core index and U-only closure factors of closrel_ctx for the last (potential, closure, T).
+ *
+ * Outside the core PY needs 1 - exp(-beta u T) and RY exp(-beta u T); both
+ * depend only on U and the ramp temperature T, so the Ng iterations of one
+ * density step compute them once. input_ctx invalidates the tables
+ * together with U.
+ */
+typedef struct {
+    int potential;          // Potential of the tables (< 0: not built yet)
+    int closure;
+    double T;
+    int lo[3];              // First point outside the core of each column
+    double *w;              // [nrows*ncols] PY: c = w (gamma + 1); RY: exp(-beta u T) (from lo on)
+} OZClosureTables;
+
+// Density continuation used by a cold solve
+#define OZ_RAMP_FIXED    0      // nrho equal steps (OZ2_ctx)
+#define OZ_RAMP_ADAPTIVE 1      // Step-size control (OZ2_adaptive_ctx)
+
+// Iteration used at each density step
+#define OZ_SOLVER_NG     0      // Ng three-iterate acceleration (Ng_ctx)
+#define OZ_SOLVER_NEWTON 1      // Newton-GMRES with Ng as fallback (NewtonKrylov_ctx)
+
+// Density derivative of the virial pressure (RY consistency, ctx->chiv)
+#define OZ_THERMO_FD     0      // Nonlinear re-solves at rho -+ ddrho
+#define OZ_THERMO_LINEAR 1      // Tangent-linear solve at rho (TangentPressure_ctx)
+
+/**
+ * @brief Working state of one spherical OZ solve.
+ *
+ * Holds what used to live in the globals of facdes2Y.c (grids, potential
+ * tables, composition and current density), so independent state points
+ * can be solved at the same time in one process. Matrices are stored by
+ * columns, element (i, k) at [i + k*nrows]: each pair component is one
+ * contiguous vector, so transforms run in place and the closure and
+ * inner-product loops are unit-stride. Columns are 64-byte aligned when
+ * nrows is a multiple of 8 (every power-of-two grid). The legacy globals
+ * use the same layout.
+ */
+typedef struct {
+    int nrows;              // Number of grid points
+    int ncols;              // Number of species pairs (3)
+    double rmax;            // Box length
+    double rho;             // Current density (changed by the OZ2 ramp)
+    double dr;              // Real-space step
+    double x[2];            // Mole fractions
+    double *r;              // [nrows] r_i = i*dr
+    double *q;              // [nrows] q_i = i*PI/rmax
+    double *U;              // [nrows*ncols] beta*u(r)
+    double *Up;             // [nrows*ncols] -r*beta*u'(r)
+    double *sigmaVec;       // [ncols] pair diameters
+    double *gamma;          // [nrows*ncols] converged gamma of the last solve (may be NULL)
+    double *ck;             // [nrows] c_11(k) of the last solve on the S(k) grid (may be NULL)
+    double *cr;             // [nrows] c_11(r) of the last solve on the g(r) grid (may be NULL)
+    const double *k_out;    // [n_out] wave vectors where Escribe_ctx also evaluates c(k) and S(k) by Filon (NULL: none)
+    int n_out;
+    double *ck_out;         // [n_out] c_11(k) on k_out (with k_out)
+    double *sk_out;         // [n_out] S(k) on k_out (with k_out)
+    double pv;              // Virial pressure beta*P of the last solve
+    double chic;            // Inverse compressibility 1 - rho*c(k=0) of the last solve
+    double ener;            // Excess energy beta*U/N of the last solve
+    double chiv;            // d(beta*P)/drho of the last solve (OZ_THERMO_LINEAR only, else NAN)
+    double ry_alpha;        // Closure alpha used by the last solve (fitted for RY)
+    double ry_alpha_seed;   // Starting alpha of the RY search (<= 0: the alpha argument)
+    int ry_evals;           // Consistency evaluations of the last RY search
+    OZWorkspace *ws;        // Scratch arena (NULL: every buffer comes from malloc)
+    int ramp_mode;          // OZ_RAMP_FIXED or OZ_RAMP_ADAPTIVE
+    int predictor_order;    // Adaptive ramp predictor: 1 linear, 2 quadratic
+    int ng_max_iter;        // Ng iteration cap (0: iterate until converged)
+    int multigrid_levels;   // Cold solves start from nrows/2, nrows/4, ... (0: full grid only)
+    int solver;             // OZ_SOLVER_NG or OZ_SOLVER_NEWTON
+    int thermo_mode;        // OZ_THERMO_FD or OZ_THERMO_LINEAR
+    int fft_double;         // 1: FFT_ctx uses sinft_double (0: sinft, float twiddles as always)
+    OZFFTPlan *fft;         // nrows x ncols sine transform of FFTM_ctx (NULL: FFT_ctx per column)
+    OZFFTPlan *fft_pad;     // FT_PAD*nrows sine transform of FT_fast_ctx (NULL: sinft_double)
+    OZRYMixing *ry_mix;     // Cached RY mixing function (NULL: built on every closrel_ctx call)
+    OZClosureTables *closure_tab;   // Cached core index and PY/RY factors (NULL: built on every closrel_ctx call)
+    const OZPotentialTable *potential_table;    // u(r) of potential 17 (NULL: none)
+    int ramp_steps;         // Density steps accepted by the last solve
+    int ramp_rejected;      // Steps the adaptive ramp had to retry
+    int ng_iter;            // Iterations of the last Ng_ctx call (-1: did not converge)
+    double ng_residual;     // Pres_ctx residual norm left by the last Ng_ctx call
+    int verbose;            // 1: progress and thermodynamics on stdout; 0: silent (library solves)
+    int owns_arrays;        // 1 if free_oz_context must release the arrays
+    double ry_dif[2];       // Rogers-Young search state (was static in RY)
+    int ry_ix;
+} OZContext;
+
+/**
+ * @brief Allocates a context with its own grids and potential tables.
+ *
+ * @param nodes Number of grid points.
+ * @param rmax Box length.
+ * @return Pointer to the context, or NULL on allocation failure.
+ */
+OZContext* create_oz_context(int nodes, double rmax);
+
+/**
+ * @brief Frees a context created by create_oz_context.
+ */
+void free_oz_context(OZContext *ctx);
+
+/**
+ * @brief Returns a context that aliases the legacy globals.
+ *
+ * The arrays are shared with the globals, so the old entry points can be
+ * written as thin wrappers around the *_ctx functions.
+ */
+OZContext oz_legacy_context(void);
+
+/**
+ * @brief Copies the scalars a *_ctx function may change back to the globals.
+ */
+void oz_legacy_sync(const OZContext *ctx);
+
+/**
+ * @brief Returns a scratch buffer of n doubles.
+ *
+ * Served from ctx->ws when it has room, otherwise from malloc (and counted
+ * in heap_allocs). Release it with oz_free and close the frame with
+ * oz_release.
+ */
+double* oz_alloc(const OZContext *ctx, size_t n);
+
+/**
+ * @brief Frees a buffer from oz_alloc (no-op for arena buffers).
+ */
+void oz_free(const OZContext *ctx, double *p);
+
+/**
+ * @brief Current arena position, to be passed to oz_release.
+ */
+size_t oz_mark(const OZContext *ctx);
+
+/**
+ * @brief Returns every arena buffer taken since mark.
+ */
+void oz_release(const OZContext *ctx, size_t mark);
+
+/**
+ * @brief Process-wide number of buffers oz_alloc took from the heap.
+ *
+ * Includes contexts without an arena (the legacy entry points). Stays
+ * constant during the iteration when every context has a large enough arena.
+ */
+size_t oz_heap_alloc_count(void);
+
+/**
+ * @brief Copies a row-major matrix [i*ncols + k] into the column layout.
+ */
+void oz_columns_from_rows(const OZContext *ctx, const double *rows, double *cols);
+
+/**
+ * @brief Copies a column-layout matrix into row-major order [i*ncols + k].
+ */
+void oz_columns_to_rows(const OZContext *ctx, const double *cols, double *rows);
+
+/**
+ * @brief printf on stdout when ctx->verbose is set.
+ *
+ * Progress of the ramp, the RY search and the potential banner go through
+ * here; allocation failures are always printed.
+ */
+void oz_log(const OZContext *ctx, const char *fmt, ...);
+
+#endif /* OZ_CONTEXT_H */
@@ -0,0 +1,42 @@
+#ifndef OZ_FFT_H
+#define OZ_FFT_H
+
+/**
+ * @brief Sine-transform backend of the spherical solver.
+ *
+ * A plan transforms howmany contiguous columns of n points, element j of
+ * column c at data[j + c*n] (the layout of the solver matrices), with the
+ * sinft convention
+ *   y[k] = sum_{j=1}^{n-1} y[j] sin(pi j k / n),  k = 0..n-1,  y[0] = 0.
+ *
+ * The default backend runs the Numerical Recipes sinft of math_aux.c on
+ * each column and needs n to be a power of 2. Built with -DOZ_USE_FFTW
+ * (make FFT=fftw) the plan is an FFTW RODFT00 of size n-1 over all
+ * columns at once, for any n >= 2.
+ */
+typedef struct OZFFTPlan OZFFTPlan;
+
+OZFFTPlan* oz_fft_plan_create(int n, int howmany);
+void oz_fft_plan_free(OZFFTPlan *plan);
+
+/**
+ * @brief Runs the plan in place on data[n*howmany].
+ *
+ * @param plan Plan from oz_fft_plan_create.
+ * @param data Contiguous columns.
+ * @param fullPrecision 0 keeps the float-rounded twiddles of sinft (the
+ *        results OZ2 has always produced); FFTW is always full precision.
+ */
+void oz_fft_sine(const OZFFTPlan *plan, double *data, int fullPrecision);
+
+/**
+ * @brief 1 if the backend can transform n points.
+ */
+int oz_fft_size_supported(int n);
+
+/**
+ * @brief Backend name ("nr" or "fftw").
+ */
+const char* oz_fft_backend(void);
+
+#endif /* OZ_FFT_H */
@@ -0,0 +1,157 @@
+#ifndef OZ_OUTPUT_H
+#define OZ_OUTPUT_H
+
+/**
+ * @brief Self-describing result files (--output-format bin|hdf5).
+ *
+ * A file holds file-level metadata and a sequence of points (one per solved
+ * state point). Each point carries numeric metadata and named datasets of
+ * n_columns x n_rows doubles (one column per projection), so every point of
+ * a sweep is appended to the same file.
+ *
+ * bin:  native doubles in tagged records (layout in docs/user_guide.md).
+ * hdf5: root attributes for the file metadata; every dataset is an
+ *       extendable [n_points][n_columns][n_rows] array chunked by column and
+ *       every point attribute a [n_points] array under /points, so a point is
+ *       one more slab along the first axis. Needs make HDF5=1.
+ */
+
+typedef enum {
+    OZ_OUTPUT_TEXT = 0,     // Legacy .dat files (default)
+    OZ_OUTPUT_BIN  = 1,     // Binary record stream (.bin)
+    OZ_OUTPUT_HDF5 = 2      // HDF5 file (.h5)
+} OZOutputFormat;
+
+typedef struct OZOutput OZOutput;
+
+/**
+ * @brief Parses "text", "bin" or "hdf5".
+ *
+ * @return 0 on success, 1 for an unknown name.
+ */
+int oz_output_parse_format(const char *name, OZOutputFormat *format);
+
+/**
+ * @brief 1 if the format was compiled in (hdf5 needs make HDF5=1).
+ */
+int oz_output_format_available(OZOutputFormat format);
+
+/**
+ * @brief File extension of the format (".bin", ".h5"; ".dat" for text).
+ */
+const char* oz_output_extension(OZOutputFormat format);
+
+/**
+ * @brief Creates (or truncates) a bin or hdf5 file.
+ *
+ * @return Pointer to the writer, or NULL if the file cannot be created or
+ *         the format is text or not compiled in.
+ */
+OZOutput* create_oz_output(const char *path, OZOutputFormat format);
+
+/**
+ * @brief Closes the file and frees the writer (an open point is ended first).
+ */
+void free_oz_output(OZOutput *out);
+
+/**
+ * @brief Adds a file-level string attribute (outside a point only).
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int oz_output_attr_string(OZOutput *out, const char *key, const char *value);
+
+/**
+ * @brief Adds an integer attribute to the file, or to the open point.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int oz_output_attr_int(OZOutput *out, const char *key, long value);
+
+/**
+ * @brief Adds a double attribute to the file, or to the open point.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int oz_output_attr_double(OZOutput *out, const char *key, double value);
+
+/**
+ * @brief Opens the next point; attributes and datasets go to it until oz_output_end_point.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int oz_output_begin_point(OZOutput *out);
+
+/**
+ * @brief Writes a dataset of the open point.
+ *
+ * In hdf5 every point must give a dataset the same shape.
+ *
+ * @param name Dataset name (e.g. "h").
+ * @param columns Space-separated column labels (e.g. "h000 h110 h112").
+ * @param data [n_columns] pointers to n_rows contiguous doubles each.
+ * @return 0 on success, 1 on failure.
+ */
+int oz_output_dataset(OZOutput *out, const char *name, const char *columns, const double *const *data, \
+                      int n_columns, int n_rows);
+
+/**
+ * @brief Closes the open point.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int oz_output_end_point(OZOutput *out);
+
+/**
+ * @brief Points written so far.
+ */
+int oz_output_point_count(const OZOutput *out);
+
+/**
+ * @brief Attributes and datasets of one point read back from a bin file.
+ *
+ * The file-level attributes come first, then those of the point.
+ */
+typedef struct {
+    int n_attrs;
+    char **keys;
+    double *values;         // [n_attrs] numeric value (0 for strings)
+    char **strings;         // [n_attrs] string value, NULL for numbers
+    int n_datasets;
+    char **names;
+    int *n_columns;
+    int *n_rows;
+    double **data;          // [n_datasets] columns one after another (NULL when not loaded)
+} OZPointData;
+
+/**
+ * @brief Reads point index of a bin file (of either byte order; the other one is swapped on read).
+ *
+ * @param load_data 0 to only read the attributes and the dataset shapes.
+ * @return Pointer to the point, or NULL if the file cannot be read or has no such point.
+ */
+OZPointData* read_oz_point(const char *path, int index, int load_data);
+
+/**
+ * @brief Frees an OZPointData.
+ */
+void free_oz_point(OZPointData *pd);
+
+/**
+ * @brief Numeric attribute key of the point (the last one if repeated).
+ *
+ * @return 0 if found, 1 otherwise.
+ */
+int oz_point_number(const OZPointData *pd, const char *key, double *value);
+
+/**
+ * @brief String attribute key of the point, or NULL.
+ */
+const char* oz_point_string(const OZPointData *pd, const char *key);
+
+/**
+ * @brief Dataset name of the point, or NULL if absent or not loaded.
+ */
+const double* oz_point_dataset(const OZPointData *pd, const char *name, int *n_columns, int *n_rows);
+
+#endif /* OZ_OUTPUT_H */
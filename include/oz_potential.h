@@ -0,0 +1,110 @@
+#ifndef OZ_POTENTIAL_H
+#define OZ_POTENTIAL_H
+
+#include <stddef.h>
+
+/**
+ * @brief Pair potentials shared between state points, and tabulated u(r) files.
+ *
+ * Every analytic potential of POT_ctx is beta*u = E * shape(r), with E
+ * the inverse temperature of the pair, so the tables of one (potential,
+ * grid, parameters) only change by a factor between state points. The
+ * first POT_ctx call of a potential stores its U and Up here; later calls
+ * with the same key, from any thread, copy them scaled by the ratio of
+ * the energy factors instead of re-evaluating pow/exp/tanh on the grid.
+ * At the temperature that built the entry the copy is exact; at another
+ * one it differs from a fresh evaluation by the rounding of one product.
+ *
+ * A tabulated potential (--potential 17, --potential-file) is a binary
+ * file mapped read-only, resampled onto the solver grid by a Steffen
+ * spline (monotone between nodes, so it does not overshoot near a steep
+ * core):
+ *
+ *   offset 0   char[8]  "OZUTAB\0\0"
+ *   offset 8   uint32   0x01020304 (byte order; files of the other one are rejected)
+ *   offset 12  uint32   columns: 2 (r, u) or 3 (r, u, du/dr)
+ *   offset 16  int64    n_points (>= 4)
+ *   offset 24  double   r[n_points], u[n_points] and, with 3 columns, du/dr[n_points]
+ *
+ * r is strictly increasing and u is in units of the energy scale, so
+ * beta*u = u/T. Without the du/dr column the derivative is that of the
+ * spline of u.
+ */
+typedef struct {
+    int n_points;
+    const double *r;            // [n_points] nodes, strictly increasing (points into the mapping)
+    const double *u;            // [n_points] u(r)
+    const double *du;           // [n_points] du/dr (NULL: derivative of the spline)
+    unsigned int checksum;      // FNV-1a of the data, identifies the table in cache keys
+    void *map;                  // Mapping of the whole file
+    size_t map_size;
+} OZPotentialTable;
+
+/**
+ * @brief Maps a tabulated potential file.
+ *
+ * @return Pointer to the table, or NULL (with a message on stderr) if the
+ *         file cannot be read or is not a valid table.
+ */
+OZPotentialTable* oz_potential_table_open(const char *path);
+
+/**
+ * @brief Unmaps a table from oz_potential_table_open.
+ */
+void oz_potential_table_close(OZPotentialTable *table);
+
+/**
+ * @brief Resamples scale*u(r) onto r[0..n).
+ *
+ * U = scale*u and Up = -r*scale*du/dr inside [r_first, r_last]; both are
+ * 0 below r_first (the closures treat those points as the core) and
+ * beyond r_last (the potential is truncated there).
+ *
+ * @return 0 on success, 1 on allocation failure.
+ */
+int oz_potential_table_sample(const OZPotentialTable *table, const double *r, int n, double scale, \
+                              double *U, double *Up);
+
+/**
+ * @brief What a shared U/Up table depends on besides its energy factors.
+ *
+ * Fields a potential does not use are still compared, so they have to be
+ * filled from the same species data on every call.
+ */
+typedef struct {
+    int potential;
+    int nrows;
+    int ncols;
+    double dr;
+    double sigma[3];            // Pair diameters (sigmaVec)
+    double lambda[2];           // especie.lambda of species 1 and 2
+    double lambda2[2];
+    double temperature2[2];
+    double xnu;
+    unsigned int table;         // Checksum of the potential-17 table (0 otherwise)
+} OZPotentialKey;
+
+/**
+ * @brief Copies the shared tables of key, rescaled to the energy factors scale[ncols].
+ *
+ * @return 1 if the key was found (U and Up written), 0 otherwise.
+ */
+int oz_potential_lookup(const OZPotentialKey *key, const double *scale, double *U, double *Up);
+
+/**
+ * @brief Shares the tables U and Up computed with the energy factors scale[ncols].
+ *
+ * Keeps the last OZ_POTENTIAL_MAX_ENTRIES keys; a key already stored is
+ * left as it is. Allocation failures only skip the store.
+ */
+void oz_potential_store(const OZPotentialKey *key, const double *scale, const double *U, const double *Up);
+
+/**
+ * @brief Frees every shared table.
+ */
+void oz_potential_clear(void);
+
+// Shared tables kept per process (the oldest is dropped beyond this)
+#define OZ_POTENTIAL_MAX_ENTRIES 16
+
+#endif /* OZ_POTENTIAL_H */
@@ -0,0 +1,77 @@
+#ifndef OZ_SOLVER_H
+#define OZ_SOLVER_H
+
+#include "facdes2Y.h"
+
+/**
+ * @brief Embeddable spherical solver (liboz.a / liboz.so).
+ *
+ * A handle owns one solver context (grids, workspace, FFT plans) and the
+ * last converged gamma, so repeated solves reuse every allocation and start
+ * from the previous state point. Nothing is written to disk and nothing is
+ * printed unless OZSolveParams.verbose is set; the results come back in an
+ * OZResult, which write_oz_result can still save if the caller wants files.
+ * A handle must not be used by two threads at once; separate handles are
+ * independent.
+ */
+
+typedef struct OZSolver OZSolver;
+
+/**
+ * @brief One state point and the iteration controls of a solve.
+ */
+typedef struct {
+    int potential;              // Potential ID (as --potential)
+    int closure;                // 1 PY, 2 HNC, 3 RY
+    double volume_factor;       // Volume fraction
+    double temperature;
+    double temperature2;        // Second temperature of the two-scale potentials
+    double lambda_a;            // Attraction range
+    double lambda_r;            // Repulsion range
+    double sigma;               // Particle diameter
+    double alpha;               // Closure parameter (starting alpha of the RY search)
+    double tolerance;           // Convergence tolerance (EZ)
+    int nrho;                   // Density steps of a cold ramp
+    int ramp_mode;              // OZ_RAMP_FIXED or OZ_RAMP_ADAPTIVE
+    int predictor_order;        // Adaptive ramp predictor: 1 linear, 2 quadratic
+    int solver;                 // OZ_SOLVER_NG or OZ_SOLVER_NEWTON
+    int thermo_mode;            // OZ_THERMO_FD or OZ_THERMO_LINEAR (RY consistency and OZThermo.chiv)
+    int multigrid_levels;       // Cold solves start from nodes/2, nodes/4, ... (0: full grid only)
+    int warm_start;             // 1: continue from the previous solve of the handle (same potential and closure)
+    const OZPotentialTable *potential_table;    // u(r) of potential 17 (oz_potential_table_open; NULL: none)
+    int verbose;                // 1: print the progress of the CLI on stdout
+} OZSolveParams;
+
+/**
+ * @brief Fills params with the CLI defaults (HNC, adaptive ramp, Ng, warm start, silent).
+ *
+ * potential, volume_factor and temperature still have to be set.
+ */
+void oz_solve_params_default(OZSolveParams *params);
+
+/**
+ * @brief Allocates a solver for grids of nodes points on a box of length rmax.
+ *
+ * @return Pointer to the solver, or NULL on allocation failure.
+ */
+OZSolver* create_oz_solver(int nodes, double rmax);
+
+/**
+ * @brief Frees a solver created by create_oz_solver.
+ */
+void free_oz_solver(OZSolver *solver);
+
+/**
+ * @brief Solves one state point into result.
+ *
+ * A warm start that does not converge is redone with the full ramp.
+ *
+ * @param solver Handle from create_oz_solver.
+ * @param params State point and controls.
+ * @param result Output, created with create_oz_result(nodes); k_out/Ck_out/Sk_out are honoured.
+ * @return 0 on success, 1 on failure (including potential 17 without potential_table)
+ *         or if the solve did not converge.
+ */
+int oz_solver_solve(OZSolver *solver, const OZSolveParams *params, OZResult *result);
+
+#endif /* OZ_SOLVER_H */
@@ -0,0 +1,84 @@
+#ifndef OZ_TELEMETRY_H
+#define OZ_TELEMETRY_H
+
+#include <stddef.h>
+#include "oz_timing.h"
+
+/**
+ * @brief Per-iteration solver records (--telemetry, or a callback from the library).
+ *
+ * Ng_ctx, NewtonKrylov_ctx and the dipolar and mode-2 loops emit one record
+ * per iteration: residual, whether the Ng extrapolation was accepted, the
+ * cumulative phase times of the calling thread (oz_timings) and the
+ * workspace allocation counters. Every call site is guarded by
+ * oz_telemetry_active, so with no sink installed the cost is one branch
+ * per iteration. Records of concurrent sweep workers reach the sink one at
+ * a time (a mutex), tagged with the sweep point of the worker.
+ */
+
+typedef struct {
+    const char *solver;         // "ng", "newton", "dipolar" or "mode2"
+    int point;                  // Sweep point of the emitting thread (-1: not in a sweep)
+    int step;                   // Solve of the thread, from 1: every Ng/Newton call of the ramp, RY search and final
+                                // solve is one (1 for the non-spherical solvers)
+    double rho;                 // Density of the step
+    int iteration;              // Iteration within the step, from 1
+    double residual;            // Pres_ctx ETA (ng), ||F|| (newton) or L2 error of the mixing (dipolar, mode2)
+    int accepted;               // Ng: 1 extrapolation accepted, 0 plain iteration; -1 for the other solvers
+    int precision;              // Bits of the transforms: 32 while a --mixed-precision solve is in float, else 64
+    double seconds[OZ_N_PHASES];    // Cumulative phase times of the thread (Ng books its mixing time on return)
+    size_t arena_allocs;        // Buffers served by the context workspace (0 without one)
+    size_t heap_allocs;         // Buffers that fell back to malloc (workspace, or process-wide without one)
+} OZTelemetryRecord;
+
+/**
+ * @brief Receives every record; calls are serialised, rec is only valid during the call.
+ */
+typedef void (*OZTelemetryCallback)(const OZTelemetryRecord *rec, void *user);
+
+/**
+ * @brief Non-zero while a callback or file is installed (checked before building a record).
+ */
+extern int oz_telemetry_active;
+
+/**
+ * @brief Installs cb (NULL removes it and closes any --telemetry file).
+ */
+void oz_telemetry_set_callback(OZTelemetryCallback cb, void *user);
+
+/**
+ * @brief Writes every record to path: CSV if it ends in ".csv", JSON Lines otherwise.
+ *
+ * @return 0 on success, 1 if the file cannot be created.
+ */
+int oz_telemetry_open(const char *path);
+
+/**
+ * @brief Removes the sink and closes the file of oz_telemetry_open.
+ *
+ * @return 0 on success, 1 if the file could not be written.
+ */
+int oz_telemetry_close(void);
+
+/**
+ * @brief Sweep point of the calling thread in its records (-1: none); restarts the step count.
+ */
+void oz_telemetry_set_point(int point);
+
+/**
+ * @brief Precision (32 or 64 bits) reported in the records of the calling thread from now on.
+ */
+void oz_telemetry_set_precision(int bits);
+
+/**
+ * @brief Number of the next step of the calling thread (one per Ng_ctx call).
+ */
+int oz_telemetry_next_step(void);
+
+/**
+ * @brief Builds a record with the phase times of the calling thread and hands it to the sink.
+ */
+void oz_telemetry_emit(const char *solver, int step, double rho, int iteration, double residual, int accepted, \
+                       size_t arena_allocs, size_t heap_allocs);
+
+#endif /* OZ_TELEMETRY_H */
@@ -0,0 +1,86 @@
+#ifndef OZ_TIMING_H
+#define OZ_TIMING_H
+
+/**
+ * @brief Per-phase wall-clock counters of a solve (--timing, make bench).
+ *
+ * The solver loops bracket each phase with oz_time_now / oz_timing_stop.
+ * The counters are thread-local: every sweep worker accumulates its own
+ * and hands them to the calling thread when it finishes (so the phases of a
+ * parallel sweep add up the time of all workers), and an OpenMP region is timed once by the thread that enters it, so the
+ * parallel phases count wall time, not CPU time. A clock_gettime pair per
+ * phase and iteration is far below the cost of any phase.
+ */
+
+typedef enum {
+    OZ_PHASE_TRANSFORM = 0,     // r <-> k transforms (sine/FFT, Hankel)
+    OZ_PHASE_OZ,                // k-space OZ solve
+    OZ_PHASE_CLOSURE,           // Closure relation
+    OZ_PHASE_MIXING,            // Ng acceleration / Newton / Picard-Anderson update
+    OZ_PHASE_OUTPUT,            // Observables and result files
+    OZ_N_PHASES
+} OZPhase;
+
+typedef struct {
+    double seconds[OZ_N_PHASES];
+    long iterations;            // Ng / Newton iterations, or mixing steps
+} OZTimings;
+
+/**
+ * @brief Monotonic wall clock in seconds.
+ */
+double oz_time_now(void);
+
+/**
+ * @brief Adds the time elapsed since t0 (from oz_time_now) to phase.
+ */
+void oz_timing_stop(OZPhase phase, double t0);
+
+/**
+ * @brief Adds seconds to phase (for a phase measured as a difference).
+ */
+void oz_timing_add(OZPhase phase, double seconds);
+
+/**
+ * @brief Adds n iterations to the counter of the calling thread.
+ */
+void oz_timing_count(long n);
+
+/**
+ * @brief Counters of the calling thread.
+ */
+const OZTimings* oz_timings(void);
+
+/**
+ * @brief Adds the counters t (e.g. of a finished worker thread) to those of the calling thread.
+ */
+void oz_timing_merge(const OZTimings *t);
+
+/**
+ * @brief Sum of every phase of the calling thread so far.
+ */
+double oz_timing_total(void);
+
+/**
+ * @brief Clears the counters of the calling thread.
+ */
+void oz_timing_reset(void);
+
+/**
+ * @brief Name of a phase in the JSON report ("transform", "oz", ...).
+ */
+const char* oz_phase_name(OZPhase phase);
+
+/**
+ * @brief Writes the counters of the calling thread and the wall time as JSON.
+ *
+ * {"wall": s, "iterations": n, "time_per_iteration": s,
+ *  "phases": {"transform": s, "oz": s, "closure": s, "mixing": s, "output": s, "other": s}}
+ *
+ * "other" is the wall time not covered by a phase (setup, potentials, ramp bookkeeping).
+ *
+ * @return 0 on success, 1 if the file cannot be written.
+ */
+int oz_timing_write_json(const char *path, double wall);
+
+#endif /* OZ_TIMING_H */
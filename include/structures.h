@@ -14,6 +14,28 @@ extern double rho, dr;
 extern double *r, *q, x[2];
 extern double *U, *Up, *sigmaVec;
 
+// Adaptive density continuation (OZ2_adaptive_ctx)
+#define NG_DIVERGENCE_FACTOR 1.0E3  // Ng gives up when the residual grows this much over its first value
+#define OZ_ADAPT_H0        0.1      // First step in rho/rho_final
+#define OZ_ADAPT_HMAX      0.5      // Largest step
+#define OZ_ADAPT_FAST      10       // Ng iterations at or below which the step doubles
+#define OZ_ADAPT_SLOW      40       // Ng iterations above which the step halves
+#define OZ_ADAPT_MAX_ITER  200      // Ng iteration cap during the ramp
+
+// Coarse-to-fine initial guess (facdes2YSolve with ctx->multigrid_levels)
+#define OZ_MULTIGRID_MIN_NODES 256  // No level is solved on fewer grid points
+#define OZ_MULTIGRID_MIN_PER_SIGMA 4.0  // ... nor with fewer points per diameter sigmaVec[0] (coarser seeds do not re-converge)
+
+// Rogers-Young alpha search (OZ2_finish_ctx)
+#define RY_ALPHA_TOL       1.0E-4   // Bracket width at which the search stops
+#define RY_RESIDUAL_TOL    1.0E-5   // ... or |chic - chiv|/chic drops to the noise left by EZ
+#define RY_ALPHA_MIN       1.0E-3   // Search range of alpha
+#define RY_ALPHA_MAX       1.0E2
+#define RY_BRACKET_GROWTH  4.0      // Largest growth of the bracketing step
+#define RY_OVERSHOOT       2.0      // Bracketing steps go this far past the secant root
+#define RY_MAX_EVAL        40       // Consistency evaluations before giving up
+#define RY_NG_MAX_ITER     1000     // Ng iteration cap during the search
+
 typedef struct species{
 
     double diameter;
@@ -35,6 +57,23 @@ void Ng(int kj, double *gammaInput, double *gammaOutput, int potentialID, int cl
         double T, double Tfin, double alpha, double EZ, double rmax, int nrho, int *printFlag); 
 void closrel(double *gamma, int potentialID, int closureID, double *cFuncMatrix, double T, double alpha);
 
+// Reentrant variants: all solver state lives in the context
+int input_ctx(OZContext *ctx, double fv, double xnu, species especie1, species especie2, int potentialID);
+int POT_ctx(OZContext *ctx, species especie1, species especie2, int potentialID, double xnu);
+void OZ2_ctx(OZContext *ctx, double *Sk, double *Gr, int potentialID, int closureID, double alpha, double EZ, \
+             int nrho, char folderName[20], int *printFlag);
+int OZ2_warm_ctx(OZContext *ctx, const double *gammaSeed, double rhoSeed, double *Sk, double *Gr, \
+                 int potentialID, int closureID, double alpha, double EZ, int nrho, \
+                 char folderName[20], int *printFlag);
+int OZ2_adaptive_ctx(OZContext *ctx, double *Sk, double *Gr, int potentialID, int closureID, double alpha, double EZ, \
+                     int nrho, char folderName[20], int *printFlag);
+void Termo_ctx(const OZContext *ctx, double *gamma, double *cFuncMatrix, double *pv1, double *chic, double *ener);
+void RY_ctx(OZContext *ctx, double pv1, double pv2, double chic, double ddrho, double *alpha, double dalpha, int *IRY);
+void Escribe_ctx(const OZContext *ctx, double *gamma, double *cFuncMatrix, double *Sk, double *Gr, int potentialID, int closureID, char folderName[20]);
+int Ng_ctx(OZContext *ctx, int kj, double *gammaInput, double *gammaOutput, int potentialID, int closureID, \
+           double *cFuncMatrix, double T, double TFlag, double alpha, double EZ, int nrho, int *printFlag);
+void closrel_ctx(const OZContext *ctx, double *gamma, int potentialID, int closureID, double *cFuncMatrix, double T, double alpha);
+
 void appendclosureID(char *inputString, int closureID);
 void appendPotentialID(char *inputString, int potentialID);
 void PotentialName(int potentialID, double xnu);
@@ -2,6 +2,15 @@
 #define STRUCTURES_NONSPHERICAL_H
 
 #include <gsl/gsl_vector.h>
+#include "oz_output.h"
+#include "oz_cache.h"
+#include "hs_reference.h"
+#include "chi_modes.h"
+
+/**
+ * @brief Row alignment of a ProjectionMatrix, in doubles (64 bytes).
+ */
+#define PROJECTION_ALIGN 8
 
 /**
  * @brief Structure to hold Rotational Invariant Projections.
@@ -10,14 +19,58 @@
  * Index 0: h000 (Spherical/Density part)
  * Index 1: h110 (Angle dependent part 1)
  * Index 2: h112 (Angle dependent part 2 - Dipolar interaction)
+ *
+ * All projections live in one aligned block; row p starts at
+ * block + p*stride, with stride = n_points rounded up to PROJECTION_ALIGN,
+ * and data[p] points at it, so data[p][i] indexing is unchanged.
  */
 typedef struct {
     int n_projections;      // Number of projections (e.g., 3 for DHS)
     int n_points;           // Number of spatial points (r or k)
-    double **data;          // 2D array [n_projections][n_points]
+    int stride;             // Distance between rows in doubles (>= n_points)
+    double *block;          // [n_projections*stride] storage, 64-byte aligned
+    double **data;          // Row views [n_projections] into block
     char **labels;          // Labels for projections (e.g., "000", "110", "112")
 } ProjectionMatrix;
 
+/**
+ * @brief Iteration controls shared by the non-spherical solvers.
+ */
+typedef enum {
+    MIXING_PICARD = 0,      // c += alpha * (c_new - c)
+    MIXING_ANDERSON = 1     // Anderson / DIIS over all projections
+} MixingScheme;
+
+typedef enum {
+    RADIAL_GRID_UNIFORM = 0, // r_j = (j+1)*rmax/N, sine/cosine transforms
+    RADIAL_GRID_LOG = 1      // r_j log-spaced on [r_min, rmax], FFTLog transforms (potential 14)
+} RadialGrid;
+
+typedef struct {
+    MixingScheme mixing;    // Update scheme
+    int anderson_depth;     // History length for Anderson mixing
+    double alpha;           // Damping / Picard mixing parameter (0 < alpha <= 1)
+    int adaptive_damping;   // 1 = halve alpha when the residual grows
+    int max_iter;           // Maximum number of iterations
+    double tolerance;       // Convergence threshold on the RMS residual
+    int mmax;               // Highest m, n of the potential-15 projections
+    OZOutputFormat output_format; // text: output_*.dat; bin/hdf5: one file with every projection
+    const char *cache_dir;  // Solution cache (NULL: start from MSA, store nothing)
+    int checkpoint_interval; // Iterations between checkpoints into cache_dir (0: only the final c)
+    HSReferenceKind hs_reference; // Hard-sphere reference of RHNC (PY or Verlet-Weis)
+    RadialGrid grid;        // Radial grid of the dipolar solver
+    double r_min;           // First point of the log grid
+    int dipole_split;       // 1 = transform the 1/r^3 tails of c112 and h112 analytically (DipoleTail)
+    int gpu;                // 1 = iterate potential 15 on a CUDA device (mode2_gpu.h)
+    double mixed_precision; // Potential 15: float transforms until the residual drops below this (0: always double)
+} NonSphericalOptions;
+
+/**
+ * @brief Returns the default iteration controls (plain Picard, alpha = 0.3, mmax = 2, text output, no cache,
+ * PY reference, uniform grid; r_min = 0.01 for the log grid; no dipole split, no GPU, all double).
+ */
+NonSphericalOptions default_nonspherical_options(void);
+
 /**
  * @brief Allocates memory for a ProjectionMatrix.
  * 
@@ -39,4 +92,128 @@ void free_projection_matrix(ProjectionMatrix *pm);
  */
 void set_projection_label(ProjectionMatrix *pm, int index, const char *label);
 
+/**
+ * @brief Copies the values of src into dst (same shape) with one memcpy.
+ */
+void projection_matrix_copy(ProjectionMatrix *dst, const ProjectionMatrix *src);
+
+/**
+ * @brief Exchanges the storage of two matrices of the same shape in O(1).
+ *
+ * Only the block and its row views move; labels stay with their matrix.
+ * Used to double-buffer an iterate and its update without copying.
+ */
+void projection_matrix_swap(ProjectionMatrix *a, ProjectionMatrix *b);
+
+/**
+ * @brief Writes every row of pm as one dataset of the open point of out.
+ *
+ * Column p is labelled name followed by m[p] n[p] l[p] (e.g. "h112").
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int write_projection_matrix(OZOutput *out, const char *name, const ProjectionMatrix *pm, \
+                            const int *m, const int *n, const int *l);
+
+/**
+ * @brief Cache key of a non-spherical state point; the state is (rho, temp, dipole).
+ */
+void nonspherical_cache_key(OZCacheKey *key, const char *solver, const char *closure, int potential, int mmax, \
+                            int nodes, double rmax, double rho, double temp, double dipole);
+
+/**
+ * @brief Replaces c(r) by the cached c nearest to key, mapped onto the grid r.
+ *
+ * @return 0 if c was loaded, 1 if there is no usable entry (c is unchanged).
+ */
+int nonspherical_cache_load(const char *dir, const OZCacheKey *key, const double *r, ProjectionMatrix *c);
+
+/**
+ * @brief Stores c(r) under key, as a converged solution or as a checkpoint.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int nonspherical_cache_save(const char *dir, const OZCacheKey *key, const double *r, const ProjectionMatrix *c, \
+                            int converged, int iterations, double residual, double rho);
+
+/**
+ * @brief r-only factors of the dipolar closures, computed once per solve.
+ *
+ * The grid is split at the hard core (r <= sigma) once, so the closure
+ * loops have no per-point branch on r, and the 1/r^3 dipole tail is not
+ * re-evaluated with pow() on every iteration.
+ */
+typedef struct {
+    int n_points;
+    int i_core;             // First point outside the core (r > sigma)
+    double *u_dip;          // [n_points] beta*mu^2 / r^3 (the 112 tail)
+} DipolarClosureGrid;
+
+/**
+ * @brief Builds the closure factors for an increasing grid r.
+ *
+ * @return Pointer to the grid, or NULL on allocation failure.
+ */
+DipolarClosureGrid* create_dipolar_closure_grid(const double *r, int n_points, double beta_mu2, double sigma);
+
+/**
+ * @brief Frees a DipolarClosureGrid.
+ */
+void free_dipolar_closure_grid(DipolarClosureGrid *grid);
+
+/**
+ * @brief Long-range parts of c112 and h112 and their exact transform (--dipole-split).
+ *
+ * Outside the core c112 = beta*mu^2 t(r) and h112 = A t(r) plus short-ranged
+ * terms, with t(r) = 1/r^3 (0 inside the core). The order-2 transform of t,
+ *   T(k) = 4 PI integral_sigma^inf r^2 t(r) j_2(kr) dr = 4 PI j_1(k sigma) / (k sigma),
+ * includes the part beyond rmax and the jump at sigma, which the numerical
+ * transforms truncate, so these only see c112 - beta*mu^2 t and H112 - A T.
+ * A follows from the dielectric (k -> 0) limit of OZ: dipole_tail_amplitude.
+ */
+typedef struct {
+    int n_points;
+    double *t_r;            // [n_points] 1/r^3 for r > sigma, 0 inside
+    double *t_k;            // [n_points] sign * 4 PI j_1(k sigma) / (k sigma)
+    double t_0;             // T(k -> 0) = sign * 4 PI / 3
+    double *w_r;            // [n_points] 4 PI r^2 dr, the k = 0 transform of order 0
+    double *work;           // [n_points] remainder handed to the transforms
+} DipoleTail;
+
+/**
+ * @brief Tabulates t(r) and T(k); sign is the sign convention of the order-2
+ * transforms (-1 for hankel_transforms.h).
+ *
+ * @return Pointer to the tables, or NULL on allocation failure.
+ */
+DipoleTail* create_dipole_tail(const double *r, const double *k, int n_points, double dr, double sigma, double sign);
+
+/**
+ * @brief Frees a DipoleTail.
+ */
+void free_dipole_tail(DipoleTail *tail);
+
+/**
+ * @brief tail->work = f - amplitude * table (t_r before a forward transform, t_k before an inverse one).
+ */
+void dipole_tail_remove(DipoleTail *tail, const double *f, const double *table, double amplitude);
+
+/**
+ * @brief Amplitude A of h112 -> A t(r), from OZ at k -> 0.
+ *
+ * There the transforms of the short-ranged parts vanish for l > 0, so
+ * C112(0+) = beta*mu^2 T(0) and H112(0+) = A T(0), and the l = 0 projections
+ * give their integrals (w_r). chi0 is the solver's projection set on one k
+ * point; its OZ solve is the dielectric constant of the current c.
+ *
+ * @param c [n_projections][n_points] direct correlation projections.
+ * @param i112 Index of the 112 projection.
+ */
+double dipole_tail_amplitude(DipoleTail *tail, ChiModeSolver *chi0, double **c, int i112, double beta_mu2, double rho);
+
+/**
+ * @brief f += amplitude * table (t_k after a forward transform, t_r after an inverse one).
+ */
+void dipole_tail_restore(const DipoleTail *tail, double *f, const double *table, double amplitude);
+
 #endif /* STRUCTURES_NONSPHERICAL_H */
@@ -0,0 +1,64 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "oz_output.h"
+
+/**
+ * @brief One (volume fraction, temperature) state point of a sweep.
+ */
+typedef struct {
+    double volumeFactor;
+    double temperature;
+} StatePoint;
+
+/**
+ * @brief Parameters shared by every point of a sweep.
+ */
+typedef struct {
+    int potentialID;
+    int closureID;              // 2=HNC, 3=RY
+    double Temperature2;
+    double lambda_a;
+    double lambda_r;
+    int nodes;                  // Solver grid points
+    int n_threads;              // Worker threads (<= 0: one per online CPU)
+    const double *k_out;        // [n_out] wave vectors of the S(k) output
+    const double *r_out;        // [n_out] distances of the g(r) output
+    int n_out;
+    const char *output_path;    // Consolidated output file
+    OZOutputFormat output_format; // text: S(k), g(r) on k_out, r_out; bin/hdf5: every point on the solver grid
+    const char *cache_dir;      // Solution cache (NULL: none); seeds the cold points and stores every point
+} SweepConfig;
+
+/**
+ * @brief Reads the state points of a sweep file.
+ *
+ * Each non-empty line that does not start with '#' is either
+ *   <volfactor> <temp>
+ * or a grid
+ *   grid <vf_min> <vf_max> <n_vf> <T_min> <T_max> <n_T>
+ *
+ * @param path Sweep file.
+ * @param points Output array (allocated here, free with free()).
+ * @param n_points Number of points read.
+ * @return 0 on success, 1 on failure.
+ */
+int read_sweep_file(const char *path, StatePoint **points, int *n_points);
+
+/**
+ * @brief Solves all state points on a thread pool and writes one output file.
+ *
+ * Points are scheduled sorted by temperature and volume fraction. Each point
+ * is seeded from the converged gamma of the nearest already-solved point and
+ * only ramps from gamma = 0 when no point has been solved yet (or, with a
+ * cache, when no cached solution lies near it either). A seeded solve that
+ * does not converge is redone with the full ramp; a point that still does
+ * not converge is written as nan and makes the sweep fail. The seed depends
+ * on which points finished first, so with n_threads > 1 the results are
+ * reproducible only to within EZ.
+ *
+ * @return 0 on success, 1 on failure (including points that did not converge).
+ */
+int run_sweep(const StatePoint *points, int n_points, const SweepConfig *cfg);
+
+#endif /* SWEEP_H */
@@ -0,0 +1,435 @@
+/**
+ * @file chi_modes.c
+ * @brief Chi-representation OZ solver for arbitrary m, n <= mmax.
+ *
+ * See chi_modes.h for the transforms. The tables are built once from 3j
+ * symbols; chi_mode_solve then only runs tiled loops over k.
+ */
+
+#include "chi_modes.h"
+#include "closure_kernels.h"    // OZ_SIMD
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static double factorial(int n) {
+    double f = 1.0;
+    for (int i = 2; i <= n; i++) f *= i;
+    return f;
+}
+
+double wigner_3j(int j1, int j2, int j3, int m1, int m2, int m3) {
+    if (m1 + m2 + m3 != 0) return 0.0;
+    if (j3 < abs(j1 - j2) || j3 > j1 + j2) return 0.0;
+    if (abs(m1) > j1 || abs(m2) > j2 || abs(m3) > j3) return 0.0;
+
+    double delta = factorial(j1 + j2 - j3) * factorial(j1 - j2 + j3) * factorial(-j1 + j2 + j3) \
+                   / factorial(j1 + j2 + j3 + 1);
+    double pref = sqrt(delta * factorial(j1 + m1) * factorial(j1 - m1) * factorial(j2 + m2) \
+                       * factorial(j2 - m2) * factorial(j3 + m3) * factorial(j3 - m3));
+
+    int kmin = 0;
+    if (j2 - j3 - m1 > kmin) kmin = j2 - j3 - m1;
+    if (j1 - j3 + m2 > kmin) kmin = j1 - j3 + m2;
+    int kmax = j1 + j2 - j3;
+    if (j1 - m1 < kmax) kmax = j1 - m1;
+    if (j2 + m2 < kmax) kmax = j2 + m2;
+
+    double sum = 0.0;
+    for (int k = kmin; k <= kmax; k++) {
+        double term = 1.0 / (factorial(k) * factorial(j3 - j2 + k + m1) * factorial(j3 - j1 + k - m2) \
+                             * factorial(j1 + j2 - j3 - k) * factorial(j1 - k - m1) * factorial(j2 - k + m2));
+        sum += (k % 2) ? -term : term;
+    }
+
+    int phase = j1 - j2 - m3;
+    return ((phase % 2) ? -1.0 : 1.0) * pref * sum;
+}
+
+int chi_projection_set(int mmax, int *m, int *n, int *l) {
+    int count = 0;
+    for (int mi = 0; mi <= mmax; mi++) {
+        for (int ni = 0; ni <= mmax; ni++) {
+            for (int li = abs(mi - ni); li <= mi + ni; li++) {
+                if ((mi + ni + li) % 2) continue;
+                if (m) m[count] = mi;
+                if (n) n[count] = ni;
+                if (l) l[count] = li;
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+int chi_projection_index(const ChiModeSolver *s, int m, int n, int l) {
+    for (int p = 0; p < s->n_projections; p++) {
+        if (s->m[p] == m && s->n[p] == n && s->l[p] == l) return p;
+    }
+    return -1;
+}
+
+// Root of the union-find forest over the m values of one chi
+static int find_root(int *parent, int a) {
+    while (parent[a] != a) a = parent[a];
+    return a;
+}
+
+// Position of m among the rows of a block, or -1
+static int block_row(const ChiBlock *b, int m) {
+    for (int a = 0; a < b->dim; a++) {
+        if (b->m_index[a] == m) return a;
+    }
+    return -1;
+}
+
+// Block of the given chi that contains row m, or -1
+static int find_block(const ChiModeSolver *s, int chi, int m) {
+    for (int b = 0; b < s->n_blocks; b++) {
+        if (s->blocks[b].chi == chi && block_row(&s->blocks[b], m) >= 0) return b;
+    }
+    return -1;
+}
+
+/*
+ * Splits the chi matrix into connected blocks: rows m and n are linked when
+ * some projection (m, n, l) has a non-zero (m n l; chi -chi 0).
+ */
+static int build_blocks(ChiModeSolver *s) {
+    int np = s->n_projections;
+    int mmax = s->mmax;
+    int parent[mmax + 1], used[mmax + 1];
+
+    s->blocks = calloc((size_t) (mmax + 1) * (mmax + 1), sizeof(ChiBlock));
+    if (!s->blocks) return -1;
+    s->n_blocks = 0;
+
+    for (int chi = 0; chi <= mmax; chi++) {
+        for (int a = 0; a <= mmax; a++) {
+            parent[a] = a;
+            used[a] = 0;
+        }
+        for (int p = 0; p < np; p++) {
+            if (s->m[p] < chi || s->n[p] < chi) continue;
+            if (fabs(wigner_3j(s->m[p], s->n[p], s->l[p], chi, -chi, 0)) < 1e-14) continue;
+            used[s->m[p]] = used[s->n[p]] = 1;
+            int ra = find_root(parent, s->m[p]), rb = find_root(parent, s->n[p]);
+            if (ra != rb) parent[rb] = ra;
+        }
+
+        for (int root = chi; root <= mmax; root++) {
+            if (!used[root] || find_root(parent, root) != root) continue;
+
+            ChiBlock *b = &s->blocks[s->n_blocks++];
+            b->chi = chi;
+            b->sign = (chi % 2) ? -1.0 : 1.0;
+            b->dim = 0;
+            b->m_index = malloc((mmax + 1) * sizeof(int));
+            b->entry = malloc(np * sizeof(int));
+            b->proj = malloc(np * sizeof(int));
+            b->coef = malloc(np * sizeof(double));
+            if (!b->m_index || !b->entry || !b->proj || !b->coef) return -1;
+
+            for (int a = chi; a <= mmax; a++) {
+                if (used[a] && find_root(parent, a) == root) b->m_index[b->dim++] = a;
+            }
+
+            b->n_terms = 0;
+            for (int p = 0; p < np; p++) {
+                if (s->m[p] < chi || s->n[p] < chi) continue;
+                int row = block_row(b, s->m[p]), col = block_row(b, s->n[p]);
+                if (row < 0 || col < 0) continue;
+                double w = wigner_3j(s->m[p], s->n[p], s->l[p], chi, -chi, 0);
+                if (fabs(w) < 1e-14) continue;
+                b->entry[b->n_terms] = row * b->dim + col;
+                b->proj[b->n_terms] = p;
+                b->coef[b->n_terms] = w;
+                b->n_terms++;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int build_inverse(ChiModeSolver *s) {
+    int np = s->n_projections;
+    int cap = np * (2 * s->mmax + 1);
+
+    s->inv_start = malloc((np + 1) * sizeof(int));
+    s->inv_block = malloc(cap * sizeof(int));
+    s->inv_entry = malloc(cap * sizeof(int));
+    s->inv_coef = malloc(cap * sizeof(double));
+    if (!s->inv_start || !s->inv_block || !s->inv_entry || !s->inv_coef) return -1;
+
+    int t = 0;
+    for (int p = 0; p < np; p++) {
+        int m = s->m[p], n = s->n[p], l = s->l[p];
+        int cmax = (m < n) ? m : n;
+        s->inv_start[p] = t;
+        for (int chi = -cmax; chi <= cmax; chi++) {
+            double w = (2 * l + 1) * wigner_3j(m, n, l, chi, -chi, 0);
+            if (fabs(w) < 1e-14) continue;
+            int b = find_block(s, abs(chi), m);
+            if (b < 0) continue;
+            const ChiBlock *blk = &s->blocks[b];
+            s->inv_block[t] = b;
+            s->inv_entry[t] = block_row(blk, m) * blk->dim + block_row(blk, n);
+            s->inv_coef[t] = w;
+            t++;
+        }
+    }
+    s->inv_start[np] = t;
+
+    return 0;
+}
+
+ChiModeSolver* create_chi_mode_solver(int n_projections, const int *m, const int *n, const int *l,
+                                      ChiNormalization normalization, int n_points) {
+    for (int p = 0; p < n_projections; p++) {
+        if ((m[p] + n[p] + l[p]) % 2 || l[p] < abs(m[p] - n[p]) || l[p] > m[p] + n[p]) return NULL;
+    }
+
+    ChiModeSolver *s = calloc(1, sizeof(ChiModeSolver));
+    if (!s) return NULL;
+
+    s->n_projections = n_projections;
+    s->n_points = n_points;
+    s->mmax = 0;
+    s->m = malloc(n_projections * sizeof(int));
+    s->n = malloc(n_projections * sizeof(int));
+    s->l = malloc(n_projections * sizeof(int));
+    s->norm = malloc(n_projections * sizeof(double));
+    if (!s->m || !s->n || !s->l || !s->norm) {
+        free_chi_mode_solver(s);
+        return NULL;
+    }
+
+    for (int p = 0; p < n_projections; p++) {
+        s->m[p] = m[p];
+        s->n[p] = n[p];
+        s->l[p] = l[p];
+        if (m[p] > s->mmax) s->mmax = m[p];
+        if (n[p] > s->mmax) s->mmax = n[p];
+
+        s->norm[p] = sqrt((2.0 * m[p] + 1.0) * (2.0 * n[p] + 1.0)) * wigner_3j(m[p], n[p], l[p], 0, 0, 0);
+        if (normalization == CHI_NORM_Y_LFACT) s->norm[p] /= factorial(l[p]);
+    }
+
+    if (build_blocks(s) != 0 || build_inverse(s) != 0) {
+        free_chi_mode_solver(s);
+        return NULL;
+    }
+
+    s->work_size = 0;
+    for (int b = 0; b < s->n_blocks; b++) s->work_size += 2 * (size_t) s->blocks[b].dim * s->blocks[b].dim * CHI_TILE;
+#ifdef _OPENMP
+    s->n_work = omp_get_max_threads();
+#else
+    s->n_work = 1;
+#endif
+    s->work = malloc(s->n_work * s->work_size * sizeof(double));
+    s->det = malloc((size_t) s->n_work * CHI_TILE * sizeof(double));
+    if (!s->work || !s->det) {
+        free_chi_mode_solver(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+void free_chi_mode_solver(ChiModeSolver *s) {
+    if (!s) return;
+
+    if (s->blocks) {
+        for (int b = 0; b < s->n_blocks; b++) {
+            free(s->blocks[b].m_index);
+            free(s->blocks[b].entry);
+            free(s->blocks[b].proj);
+            free(s->blocks[b].coef);
+        }
+        free(s->blocks);
+    }
+    free(s->m);
+    free(s->n);
+    free(s->l);
+    free(s->norm);
+    free(s->inv_start);
+    free(s->inv_block);
+    free(s->inv_entry);
+    free(s->inv_coef);
+    free(s->work);
+    free(s->det);
+    free(s);
+}
+
+/*
+ * Solves (I - sign rho C) H = C for one block on nk points. X holds C on
+ * entry and H on return, A is scratch; both are [dim*dim][CHI_TILE].
+ * Gaussian elimination with partial pivoting chosen separately at every k
+ * (rows are swapped by select, so the loops still vectorise): the signed
+ * pivots multiply to the determinant, which decides (as in the hand-written
+ * inversions) whether the point is singular.
+ */
+static void solve_block_tile(const ChiBlock *b, double *X, double *A, double *det, double rho, int nk) {
+    int d = b->dim;
+    double srho = b->sign * rho;
+
+    for (int a = 0; a < d; a++) {
+        for (int c = 0; c < d; c++) {
+            double *restrict Ae = A + (size_t) (a*d + c) * CHI_TILE;
+            const double *restrict Xe = X + (size_t) (a*d + c) * CHI_TILE;
+            double diag = (a == c) ? 1.0 : 0.0;
+            OZ_SIMD
+            for (int t = 0; t < nk; t++) Ae[t] = diag - srho * Xe[t];
+        }
+    }
+
+    for (int t = 0; t < nk; t++) det[t] = 1.0;
+
+    // Forward elimination
+    for (int j = 0; j < d; j++) {
+        // Partial pivoting: bring the largest |A_ij|, i >= j, of each k into row j
+        for (int i = j + 1; i < d; i++) {
+            const double *restrict Aij = A + (size_t) (i*d + j) * CHI_TILE;
+            const double *restrict Ajj = A + (size_t) (j*d + j) * CHI_TILE;
+            unsigned char swap[CHI_TILE];
+            int any = 0;
+
+            for (int t = 0; t < nk; t++) {
+                swap[t] = fabs(Aij[t]) > fabs(Ajj[t]);
+                any |= swap[t];
+            }
+            if (!any) continue;
+
+            for (int c = j; c < d; c++) {
+                double *restrict Ajc = A + (size_t) (j*d + c) * CHI_TILE;
+                double *restrict Aic = A + (size_t) (i*d + c) * CHI_TILE;
+                OZ_SIMD
+                for (int t = 0; t < nk; t++) {
+                    double u = Ajc[t], v = Aic[t];
+                    Ajc[t] = swap[t] ? v : u;
+                    Aic[t] = swap[t] ? u : v;
+                }
+            }
+            for (int c = 0; c < d; c++) {
+                double *restrict Xjc = X + (size_t) (j*d + c) * CHI_TILE;
+                double *restrict Xic = X + (size_t) (i*d + c) * CHI_TILE;
+                OZ_SIMD
+                for (int t = 0; t < nk; t++) {
+                    double u = Xjc[t], v = Xic[t];
+                    Xjc[t] = swap[t] ? v : u;
+                    Xic[t] = swap[t] ? u : v;
+                }
+            }
+            OZ_SIMD
+            for (int t = 0; t < nk; t++) det[t] = swap[t] ? -det[t] : det[t];
+        }
+
+        const double *restrict piv = A + (size_t) (j*d + j) * CHI_TILE;
+        OZ_SIMD
+        for (int t = 0; t < nk; t++) det[t] *= piv[t];
+
+        for (int i = j + 1; i < d; i++) {
+            double *restrict Aij = A + (size_t) (i*d + j) * CHI_TILE;
+            // Aij becomes the multiplier
+            OZ_SIMD
+            for (int t = 0; t < nk; t++) Aij[t] /= piv[t];
+
+            for (int c = j + 1; c < d; c++) {
+                double *restrict Aic = A + (size_t) (i*d + c) * CHI_TILE;
+                const double *restrict Ajc = A + (size_t) (j*d + c) * CHI_TILE;
+                OZ_SIMD
+                for (int t = 0; t < nk; t++) Aic[t] -= Aij[t] * Ajc[t];
+            }
+            for (int c = 0; c < d; c++) {
+                double *restrict Xic = X + (size_t) (i*d + c) * CHI_TILE;
+                const double *restrict Xjc = X + (size_t) (j*d + c) * CHI_TILE;
+                OZ_SIMD
+                for (int t = 0; t < nk; t++) Xic[t] -= Aij[t] * Xjc[t];
+            }
+        }
+    }
+
+    // Back substitution
+    for (int i = d - 1; i >= 0; i--) {
+        const double *restrict Aii = A + (size_t) (i*d + i) * CHI_TILE;
+        for (int c = 0; c < d; c++) {
+            double *restrict Xic = X + (size_t) (i*d + c) * CHI_TILE;
+            for (int q = i + 1; q < d; q++) {
+                const double *restrict Aiq = A + (size_t) (i*d + q) * CHI_TILE;
+                const double *restrict Xqc = X + (size_t) (q*d + c) * CHI_TILE;
+                OZ_SIMD
+                for (int t = 0; t < nk; t++) Xic[t] -= Aiq[t] * Xqc[t];
+            }
+            OZ_SIMD
+            for (int t = 0; t < nk; t++) Xic[t] /= Aii[t];
+        }
+    }
+
+    // Singular points give H = 0 (also clears the inf/nan of a zero pivot)
+    for (int e = 0; e < d*d; e++) {
+        double *restrict Xe = X + (size_t) e * CHI_TILE;
+        OZ_SIMD
+        for (int t = 0; t < nk; t++) Xe[t] = (fabs(det[t]) > 1e-12) ? Xe[t] : 0.0;
+    }
+}
+
+void chi_mode_solve(ChiModeSolver *s, double **C_k, double **H_k, double rho) {
+    int np = s->n_projections;
+    int n_tiles = (s->n_points + CHI_TILE - 1) / CHI_TILE;
+
+    // Tiles are independent: no reduction, so the result is the same for any thread count
+    #pragma omp parallel for schedule(static) num_threads(s->n_work)
+    for (int tile = 0; tile < n_tiles; tile++) {
+        int k0 = tile * CHI_TILE;
+        int nk = (s->n_points - k0 < CHI_TILE) ? s->n_points - k0 : CHI_TILE;
+        double *X[s->n_blocks];
+#ifdef _OPENMP
+        int tid = omp_get_thread_num();
+#else
+        int tid = 0;
+#endif
+        double *w = s->work + (size_t) tid * s->work_size;
+        double *det = s->det + (size_t) tid * CHI_TILE;
+
+        for (int b = 0; b < s->n_blocks; b++) {
+            const ChiBlock *blk = &s->blocks[b];
+            size_t size = (size_t) blk->dim * blk->dim * CHI_TILE;
+            X[b] = w;
+            double *A = w + size;
+            w += 2 * size;
+
+            // Blum projections -> chi matrix
+            memset(X[b], 0, size * sizeof(double));
+            for (int q = 0; q < blk->n_terms; q++) {
+                double *restrict Xe = X[b] + (size_t) blk->entry[q] * CHI_TILE;
+                const double *restrict Cp = C_k[blk->proj[q]] + k0;
+                double coef = blk->coef[q], norm = s->norm[blk->proj[q]];
+                OZ_SIMD
+                for (int t = 0; t < nk; t++) Xe[t] += coef * (Cp[t] / norm);
+            }
+
+            solve_block_tile(blk, X[b], A, det, rho, nk);
+        }
+
+        // Chi matrices -> projections
+        for (int p = 0; p < np; p++) {
+            double *restrict Hp = H_k[p] + k0;
+            for (int t = 0; t < nk; t++) Hp[t] = 0.0;
+            for (int q = s->inv_start[p]; q < s->inv_start[p + 1]; q++) {
+                const double *restrict Xe = X[s->inv_block[q]] + (size_t) s->inv_entry[q] * CHI_TILE;
+                double coef = s->inv_coef[q];
+                OZ_SIMD
+                for (int t = 0; t < nk; t++) Hp[t] += coef * Xe[t];
+            }
+            double norm = s->norm[p];
+            OZ_SIMD
+            for (int t = 0; t < nk; t++) Hp[t] *= norm;
+        }
+    }
+}
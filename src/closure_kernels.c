@@ -0,0 +1,81 @@
+/**
+ * @file closure_kernels.c
+ * @brief Closure loops outside the hard core, written for vectorisation.
+ *
+ * Every kernel evaluates both sides of its cutoff and selects, so the loop
+ * body has no branch. The expressions are those of the original closrel
+ * loops term by term, which keeps the default build bit-identical; the
+ * PY and RY factors of U alone are split off into their own loops, whose
+ * results closrel_ctx keeps between calls.
+ */
+
+#include "closure_kernels.h"
+#include <math.h>
+
+void closure_core_kernel(double *restrict c, const double *restrict gamma, int n) {
+    OZ_SIMD
+    for (int i = 0; i < n; i++) {
+        c[i] = -(gamma[i] + 1.0);
+    }
+}
+
+void closure_PY_weights(double *restrict w, const double *restrict U, double T, int n) {
+    OZ_SIMD
+    for (int i = 0; i < n; i++) {
+        double arg = U[i] * T;
+        double e = exp(-arg);
+        w[i] = (arg > 70.0) ? -1.0 : -(e - 1.0);
+    }
+}
+
+void closure_PY_table_kernel(double *restrict c, const double *restrict gamma, const double *restrict w, int n) {
+    OZ_SIMD
+    for (int i = 0; i < n; i++) {
+        c[i] = w[i] * (gamma[i] + 1.0);
+    }
+}
+
+void closure_HNC_kernel(double *restrict c, const double *restrict gamma, const double *restrict U, double T, int n) {
+    OZ_SIMD
+    for (int i = 0; i < n; i++) {
+        double g = gamma[i] + 1.0;
+        double arg = U[i] * T - gamma[i];
+        double e = exp(-arg);
+        c[i] = (arg > 70.0) ? -g : e - g;
+    }
+}
+
+void closure_boltzmann(double *restrict e, const double *restrict U, double T, int n) {
+    OZ_SIMD
+    for (int i = 0; i < n; i++) {
+        e[i] = exp(-U[i] * T);
+    }
+}
+
+void closure_RY_table_kernel(double *restrict c, const double *restrict gamma, const double *restrict e, \
+                             const double *restrict f, int n) {
+    OZ_SIMD
+    for (int i = 0; i < n; i++) {
+        double g = gamma[i] + 1.0;
+        // (exp(gamma*f) - 1)/f -> gamma at r = 0 (no core, e.g. GCM)
+        double arg = (f[i] > 0.0) ? (exp(gamma[i] * f[i]) - 1.0) / f[i] : gamma[i];
+        c[i] = e[i] * (1.0 + arg) - g;
+    }
+}
+
+void closure_RY_mixing(double *restrict f, const double *restrict r, double alpha, int n) {
+    OZ_SIMD
+    for (int i = 0; i < n; i++) {
+        f[i] = 1.0 - exp(-alpha * r[i]);
+    }
+}
+
+void closure_log_kernel(double *restrict c, const double *restrict h, int n) {
+    OZ_SIMD
+    for (int i = 0; i < n; i++) {
+        double g = h[i] + 1.0;
+        // log of a non-positive g is only evaluated to be discarded
+        double l = log((g > 1e-12) ? g : 1.0);
+        c[i] = (g > 1e-12) ? h[i] - l : -1.0;
+    }
+}
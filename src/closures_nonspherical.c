@@ -1,109 +1,201 @@
 #include "structures_nonspherical.h"
+#include "closure_kernels.h"
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+// Points per OpenMP task of the vector kernels (they stay serial inside)
+#define DIPOLAR_CLOSURE_CHUNK 1024
+
+// c000 = h000 - ln(g000) on [i0, n), split across threads
+static void closure_log_parallel(double *c, const double *h, int i0, int n) {
+    #pragma omp parallel for schedule(static)
+    for (int b = i0; b < n; b += DIPOLAR_CLOSURE_CHUNK) {
+        int len = (n - b < DIPOLAR_CLOSURE_CHUNK) ? n - b : DIPOLAR_CLOSURE_CHUNK;
+        closure_log_kernel(c + b, h + b, len);
+    }
+}
+
+DipolarClosureGrid* create_dipolar_closure_grid(const double *r, int n_points, double beta_mu2, double sigma) {
+    DipolarClosureGrid *grid = malloc(sizeof(DipolarClosureGrid));
+    if (!grid) return NULL;
+
+    grid->n_points = n_points;
+    grid->u_dip = malloc(n_points * sizeof(double));
+    if (!grid->u_dip) {
+        free(grid);
+        return NULL;
+    }
+
+    grid->i_core = n_points;
+    for (int i = n_points - 1; i >= 0 && r[i] > sigma; i--) grid->i_core = i;
+
+    for (int i = 0; i < n_points; i++) {
+        grid->u_dip[i] = beta_mu2 / pow(r[i], 3.0);
+    }
+
+    return grid;
+}
+
+void free_dipolar_closure_grid(DipolarClosureGrid *grid) {
+    if (!grid) return;
+    free(grid->u_dip);
+    free(grid);
+}
+
+DipoleTail* create_dipole_tail(const double *r, const double *k, int n_points, double dr, double sigma, double sign) {
+    DipoleTail *tail = malloc(sizeof(DipoleTail));
+    if (!tail) return NULL;
+
+    tail->n_points = n_points;
+    tail->t_0 = sign * 4.0 * M_PI / 3.0;
+    tail->t_r = malloc(n_points * sizeof(double));
+    tail->t_k = malloc(n_points * sizeof(double));
+    tail->w_r = malloc(n_points * sizeof(double));
+    tail->work = malloc(n_points * sizeof(double));
+    if (!tail->t_r || !tail->t_k || !tail->w_r || !tail->work) {
+        free_dipole_tail(tail);
+        return NULL;
+    }
+
+    for (int i = 0; i < n_points; i++) {
+        tail->t_r[i] = (r[i] > sigma) ? 1.0 / (r[i] * r[i] * r[i]) : 0.0;
+        tail->w_r[i] = 4.0 * M_PI * r[i] * r[i] * dr;
+
+        // j_1(x)/x, by its series where the closed form cancels
+        double x = k[i] * sigma;
+        double j1x = (x < 1e-3) ? 1.0 / 3.0 - x * x / 30.0 : (sin(x) - x * cos(x)) / (x * x * x);
+        tail->t_k[i] = sign * 4.0 * M_PI * j1x;
+    }
+
+    return tail;
+}
+
+void free_dipole_tail(DipoleTail *tail) {
+    if (!tail) return;
+    free(tail->t_r);
+    free(tail->t_k);
+    free(tail->w_r);
+    free(tail->work);
+    free(tail);
+}
+
+void dipole_tail_remove(DipoleTail *tail, const double *f, const double *table, double amplitude) {
+    for (int i = 0; i < tail->n_points; i++) tail->work[i] = f[i] - amplitude * table[i];
+}
+
+double dipole_tail_amplitude(DipoleTail *tail, ChiModeSolver *chi0, double **c, int i112, double beta_mu2, double rho) {
+    int np = chi0->n_projections;
+    double C0[np], H0[np];
+    double *C0_rows[np], *H0_rows[np];
+
+    for (int p = 0; p < np; p++) {
+        C0[p] = 0.0;
+        if (chi0->l[p] == 0)
+            for (int i = 0; i < tail->n_points; i++) C0[p] += tail->w_r[i] * c[p][i];
+        C0_rows[p] = &C0[p];
+        H0_rows[p] = &H0[p];
+    }
+    C0[i112] = beta_mu2 * tail->t_0;
+
+    chi_mode_solve(chi0, C0_rows, H0_rows, rho);
+    return H0[i112] / tail->t_0;
+}
+
+void dipole_tail_restore(const DipoleTail *tail, double *f, const double *table, double amplitude) {
+    for (int i = 0; i < tail->n_points; i++) f[i] += amplitude * table[i];
+}
+
+/*
+ * Inside Hard Core: h(r) = -1 => c(r) = -1 - eta(r).
+ * For projections: g000 = h000 + 1. g110 = h110. g112 = h112.
+ * Condition g(r, omega) = 0 for all omega inside core
+ * => h000 = -1, h110 = 0, h112 = 0.
+ */
+static void closure_core_dipolar(double **c, double **eta, int n) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; i++) {
+        c[0][i] = -1.0 - eta[0][i];
+        c[1][i] = -eta[1][i];
+        c[2][i] = -eta[2][i];
+    }
+}
 
 /**
  * @brief Applies the Mean Spherical Approximation (MSA) closure.
  */
 // Updated MSA to accept eta and enforce Core condition
-void closure_MSA_dipolar(double **c, double **eta, double *r, int n_points, double beta_mu2, double sigma) {
-    for (int i = 0; i < n_points; i++) {
-        double ri = r[i];
-        if (ri > sigma) {
-            c[0][i] = 0.0; 
-            c[1][i] = 0.0;
-            c[2][i] = beta_mu2 / pow(ri, 3.0);
-        } else {
-            // Inside Hard Core: h(r) = -1 => c(r) = -1 - eta(r)
-            // Ideally we need eta here.
-            c[0][i] = -1.0 - eta[0][i];
-            c[1][i] = -eta[1][i]; // h110 = 0 inside? usually h(r) = -1 refers to g(r)=0. 
-                                  // g = h + 1. So g=0 => h=-1.
-                                  // For projections: g000 = h000 + 1. g110 = h110. g112 = h112.
-                                  // Condition g(r, omega) = 0 for all omega inside core.
-                                  // => h000 = -1, h110 = 0, h112 = 0.
-            c[2][i] = -eta[2][i];
-        }
+void closure_MSA_dipolar(double **c, double **eta, const DipolarClosureGrid *grid) {
+    closure_core_dipolar(c, eta, grid->i_core);
+
+    #pragma omp parallel for schedule(static)
+    for (int i = grid->i_core; i < grid->n_points; i++) {
+        c[0][i] = 0.0; 
+        c[1][i] = 0.0;
+        c[2][i] = grid->u_dip[i];
     }
 }
 
 /**
  * @brief Applies the Linearized HNC (LHNC) closure.
  */
-void closure_LHNC_dipolar(double **c, double **h, double **eta, double *r, int n_points, double beta_mu2, double sigma) {
-    for (int i = 0; i < n_points; i++) {
-        double ri = r[i];
-        if (ri > sigma) {
-            double h000 = h[0][i];
-            double g000 = h000 + 1.0;
-            double dipole = beta_mu2 / pow(ri, 3.0);
-
-            // c000
-            if (g000 > 1e-12) {
-                c[0][i] = h000 - log(g000); 
-            } else {
-                c[0][i] = -1.0; // Fallback
-            }
+void closure_LHNC_dipolar(double **c, double **h, double **eta, const DipolarClosureGrid *grid) {
+    int ic = grid->i_core;
 
-            // c110
-            c[1][i] = h000 * eta[1][i];
+    // Inside Core: Exact relation for HNC is g=0 => c = -1 - eta (same as MSA/PercusYevick approximation inside)
+    // If we just use the HNC expression c = h - ln(g) + ... it diverges if g->0,
+    // so for r < sigma we enforce h = -1 and use the HNC expression outside.
+    closure_core_dipolar(c, eta, ic);
 
-            // c112
-            c[2][i] = dipole + h000 * (eta[2][i] + dipole);
-        } else {
-             // Inside Core: Exact relation for HNC is g=0 => c = -1 - eta (same as MSA/PercusYevick approximation inside)
-             // or solves for c such that g=0.
-             // "In the mean spherical approximation (MSA) the closure relation is ... h(r) = -1 for r < sigma"
-             // For HNC, we also enforce h = -1.
-             // If we just use the HNC expression c = h - ln(g) + ... it diverges if g->0.
-             // So for numerical solvers one usually switches to:
-             // if r < sigma: c = -1 - eta (enforces h=-1)
-             // else: c = HNC_expression
-             
-            c[0][i] = -1.0 - eta[0][i];
-            c[1][i] = -eta[1][i]; 
-            c[2][i] = -eta[2][i];
-        }
+    // c000 = h000 - ln(g000), -1 as fallback where g000 vanishes
+    closure_log_parallel(c[0], h[0], ic, grid->n_points);
+
+    #pragma omp parallel for schedule(static)
+    for (int i = ic; i < grid->n_points; i++) {
+        double h000 = h[0][i];
+        double dipole = grid->u_dip[i];
+
+        // c110
+        c[1][i] = h000 * eta[1][i];
+
+        // c112
+        c[2][i] = dipole + h000 * (eta[2][i] + dipole);
     }
 }
 
 /**
  * @brief Applies the Quadratic HNC (QHNC) closure.
  */
-void closure_QHNC_dipolar(double **c, double **h, double **eta, double *r, int n_points, double beta_mu2, double sigma) {
-     for (int i = 0; i < n_points; i++) {
-        double ri = r[i];
-        if (ri > sigma) {
-            double h000 = h[0][i];
-            double g000 = h000 + 1.0;
-            double dipole = beta_mu2 / pow(ri, 3.0);
-            
-            double term112 = eta[2][i] + dipole;
-            double term110 = eta[1][i];
-            double quad_term = (term112*term112 + term110*term110) / 6.0;
-
-            if (g000 > 1e-12) {
-                c[0][i] = h000 - log(g000) + quad_term;
-            } else {
-                c[0][i] = -1.0;
-            }
+void closure_QHNC_dipolar(double **c, double **h, double **eta, const DipolarClosureGrid *grid) {
+    int ic = grid->i_core;
 
-            c[1][i] = h000 * eta[1][i];
-            c[2][i] = dipole + h000 * (term112);
-        } else {
-            // Inside Core
-            c[0][i] = -1.0 - eta[0][i];
-            c[1][i] = -eta[1][i]; 
-            c[2][i] = -eta[2][i];
-        }
+    closure_core_dipolar(c, eta, ic);
+    closure_log_parallel(c[0], h[0], ic, grid->n_points);
+
+    #pragma omp parallel for schedule(static)
+    for (int i = ic; i < grid->n_points; i++) {
+        double h000 = h[0][i];
+        double g000 = h000 + 1.0;
+        double dipole = grid->u_dip[i];
+        
+        double term112 = eta[2][i] + dipole;
+        double term110 = eta[1][i];
+        double quad_term = (term112*term112 + term110*term110) / 6.0;
+
+        if (g000 > 1e-12) c[0][i] += quad_term;
+
+        c[1][i] = h000 * eta[1][i];
+        c[2][i] = dipole + h000 * (term112);
     }
 }
 
 /**
  * @brief Applies the exact Reference Hypernetted-Chain (RHNC) closure for Dipolar Hard Spheres.
  * Evaluates the integro-differential formulation using the exact (000, 110, 112) algebraic reduction.
+ * The reference tables (eta_HS, d ln g_HS/dr) are read, never recomputed.
  */
-void closure_RHNC_dipolar(double **c, double **h, double **eta, double *r, int n_points, double beta_mu2, double sigma, double *c_HS, double *h_HS) {
+void closure_RHNC_dipolar(double **c, double **h, double **eta, double *r, const DipolarClosureGrid *grid, const HSReference *ref) {
+    int n_points = grid->n_points;
     double dr = r[1] - r[0]; // Assume uniform grid
 
     // Allocate arrays for the integrand I_k(r)
@@ -111,12 +203,13 @@ void closure_RHNC_dipolar(double **c, double **h, double **eta, double *r, int n
     double *I1 = malloc(n_points * sizeof(double));
     double *I2 = malloc(n_points * sizeof(double));
 
-    for (int i = 0; i < n_points; i++) {
-        double ri = r[i];
-        if (ri <= sigma) {
-            I0[i] = 0.0; I1[i] = 0.0; I2[i] = 0.0;
-            continue; // Inside core handled centrally later
-        }
+    // Inside core handled centrally later
+    for (int i = 0; i < grid->i_core; i++) {
+        I0[i] = 0.0; I1[i] = 0.0; I2[i] = 0.0;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int i = grid->i_core; i < n_points; i++) {
 
         // Compute derivatives using central differences
         int i_prev = (i > 0) ? i - 1 : 0;
@@ -127,33 +220,27 @@ void closure_RHNC_dipolar(double **c, double **h, double **eta, double *r, int n
 
         // Delta W = -Delta eta + beta Delta u
         // Delta eta_0 = eta0 - (h_HS - c_HS)
-        double eta_HS_prev = h_HS[i_prev] - c_HS[i_prev];
-        double eta_HS_next = h_HS[i_next] - c_HS[i_next];
-        double dW0_prev = -(eta[0][i_prev] - eta_HS_prev);
-        double dW0_next = -(eta[0][i_next] - eta_HS_next);
+        double dW0_prev = -(eta[0][i_prev] - ref->eta[i_prev]);
+        double dW0_next = -(eta[0][i_next] - ref->eta[i_next]);
         double dW0 = (dW0_next - dW0_prev) / den;
 
         double dW1 = -(eta[1][i_next] - eta[1][i_prev]) / den;
 
         // u_D = - beta_mu2 / r^3 => beta Delta u_2 = beta_mu2 / r^3
-        double u2_prev = beta_mu2 / pow(r_prev, 3.0);
-        double u2_next = beta_mu2 / pow(r_next, 3.0);
+        double u2_prev = grid->u_dip[i_prev];
+        double u2_next = grid->u_dip[i_next];
         double dW2_prev = -eta[2][i_prev] + u2_prev;
         double dW2_next = -eta[2][i_next] + u2_next;
         double dW2 = (dW2_next - dW2_prev) / den;
 
         // dW_HS = d(ln(g_HS))/dr
-        double g_HS_prev = h_HS[i_prev] + 1.0;
-        double g_HS_next = h_HS[i_next] + 1.0;
-        if (g_HS_prev < 1e-12) g_HS_prev = 1e-12;
-        if (g_HS_next < 1e-12) g_HS_next = 1e-12;
-        double dW_HS = (log(g_HS_next) - log(g_HS_prev)) / den;
+        double dW_HS = ref->dlng[i];
 
         // Values at current i
         double h0 = h[0][i];
         double h1 = h[1][i];
         double h2 = h[2][i];
-        double dh0 = h0 - h_HS[i];
+        double dh0 = h0 - ref->h[i];
 
         // Exact RHNC Tensor multiplication rules for l<=2
         I0[i] = dW0 * h0 + 3.0 * dW1 * h1 + (2.0/3.0) * dW2 * h2 - dh0 * dW_HS;
@@ -161,10 +248,10 @@ void closure_RHNC_dipolar(double **c, double **h, double **eta, double *r, int n
         I2[i] = dW0 * h2 + dW2 * h0 - h2 * dW_HS;
     }
 
-    // Integrate backward: Delta c_k(r) = Integral_r^infty I_k(r') dr'
+    // Integrate backward: Delta c_k(r) = Integral_r^infty I_k(r') dr' (a serial prefix sum)
     double sum0 = 0.0, sum1 = 0.0, sum2 = 0.0;
     for (int i = n_points - 1; i >= 0; i--) {
-        if (r[i] > sigma) {
+        if (i >= grid->i_core) {
             if (i < n_points - 1) {
                 // Trapezoidal rule
                 sum0 += 0.5 * (I0[i] + I0[i+1]) * dr;
@@ -177,9 +264,9 @@ void closure_RHNC_dipolar(double **c, double **h, double **eta, double *r, int n
             }
 
             // c = Delta c + c_HS - beta Delta u
-            c[0][i] = sum0 + c_HS[i];
+            c[0][i] = sum0 + ref->c[i];
             c[1][i] = sum1;
-            c[2][i] = sum2 + (beta_mu2 / pow(r[i], 3.0));
+            c[2][i] = sum2 + grid->u_dip[i];
         } else {
             // Inside Hard Core exact relation: c = -1 - eta
             c[0][i] = -1.0 - eta[0][i];
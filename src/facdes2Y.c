@@ -8,12 +8,13 @@
  */
 
 #include "facdes2Y.h"
+#include "oz_timing.h"
 #include <sys/stat.h> // For mkdir
 
 /**
  * @brief Maximum range for the radial distribution function.
  */
-double rmax;
+double rmax = 160;
 
 /**
  * @brief Number of rows and columns for data structures.
@@ -45,6 +46,46 @@ double alpha = 1.0;
  */
 double EZ = 1.0E-4;
 
+/**
+ * @brief Density continuation (OZ_RAMP_FIXED or OZ_RAMP_ADAPTIVE).
+ */
+int rampMode = OZ_RAMP_ADAPTIVE;
+
+/**
+ * @brief Order of the adaptive ramp predictor (1 = linear, 2 = quadratic).
+ */
+int predictorOrder = 2;
+
+/**
+ * @brief Iteration at each density step (OZ_SOLVER_NG or OZ_SOLVER_NEWTON).
+ */
+int solverMode = OZ_SOLVER_NG;
+
+/**
+ * @brief Density derivative of the pressure (OZ_THERMO_FD or OZ_THERMO_LINEAR, --thermo).
+ */
+int thermoMode = OZ_THERMO_FD;
+
+/**
+ * @brief Coarse grids solved before a cold solve, at nodes/2, nodes/4, ... (--multigrid; 0: none).
+ */
+int multigridLevels = 0;
+
+/**
+ * @brief Format of the results (OZOutputFormat; text writes the .dat observables).
+ */
+int outputFormat = OZ_OUTPUT_TEXT;
+
+/**
+ * @brief Solution cache directory (--cache; NULL: no cache).
+ */
+const char *cacheDir = NULL;
+
+/**
+ * @brief u(r) of potential 17 (--potential-file; NULL: none).
+ */
+const OZPotentialTable *potentialTable = NULL;
+
 /**
  * @brief Diameter of species 1.
  */
@@ -70,19 +111,25 @@ double *r, *q, x[2];
  */
 double *U, *Up, *sigmaVec;
 
-// Helper function prototype
-static void solve_and_process(double volumeFactor, double Temperature, double Temperature2, 
-                            double lambda_a, double lambda_r, const gsl_vector *input_vec, 
-                            double *OutputVec, int potentialNumber, int nodesFacdes2Y,
-                            int closureID, int outputFlag, const char *filename);
+/**
+ * @brief 1: C(k) and S(k) of the output k grid by Filon quadrature instead of interpolation (--sk-filon).
+ */
+int filonOutput = 0;
+
+// Helper function prototypes
+static void solve_all_and_process(double volumeFactor, double Temperature, double Temperature2, 
+                            double lambda_a, double lambda_r, const gsl_vector *k_vec, const gsl_vector *r_vec,
+                            double *ckVec, double *isVec, double *skVec, double *grVec, OZThermo *thermo,
+                            OZAllocStats *alloc, int potentialNumber, int nodesFacdes2Y, int closureID);
+static void write_observable(const char *filename, const double *xVec, const double *yVec, int nodes);
 
 /**
  * @brief Calculates the Direct Correlation Function using the HNC closure.
  */
 void ck_HNC(double volumeFactor, double Temperature, double Temperature2, double lambda_a, double lambda_r, const gsl_vector *k, \
             double *OutputVec, int potentialNumber, int nodesFacdes2Y){
-    solve_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, k, OutputVec, 
-                     potentialNumber, nodesFacdes2Y, 2, 1, "HNC_CdeK.dat");
+    solve_all_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, k, NULL, 
+                          OutputVec, NULL, NULL, NULL, NULL, NULL, potentialNumber, nodesFacdes2Y, 2);
 }
 
 /**
@@ -90,8 +137,8 @@ void ck_HNC(double volumeFactor, double Temperature, double Temperature2, double
  */
 void is_HNC(double volumeFactor, double Temperature, double Temperature2, double lambda_a, double lambda_r, const gsl_vector *k, \
             double *OutputVec, int potentialNumber, int nodesFacdes2Y){
-    solve_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, k, OutputVec, 
-                     potentialNumber, nodesFacdes2Y, 2, 2, "HNC_FT_CdeK.dat");
+    solve_all_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, k, NULL, 
+                          NULL, OutputVec, NULL, NULL, NULL, NULL, potentialNumber, nodesFacdes2Y, 2);
 }
 
 /**
@@ -99,8 +146,8 @@ void is_HNC(double volumeFactor, double Temperature, double Temperature2, double
  */
 void sk_HNC(double volumeFactor, double Temperature, double Temperature2, double lambda_a, double lambda_r, const gsl_vector *k, \
             double *OutputVec, int potentialNumber, int nodesFacdes2Y){
-    solve_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, k, OutputVec, 
-                     potentialNumber, nodesFacdes2Y, 2, 0, "HNC_SdeK.dat");
+    solve_all_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, k, NULL, 
+                          NULL, NULL, OutputVec, NULL, NULL, NULL, potentialNumber, nodesFacdes2Y, 2);
 }
 
 /**
@@ -108,8 +155,8 @@ void sk_HNC(double volumeFactor, double Temperature, double Temperature2, double
  */
 void ck_RY(double volumeFactor, double Temperature, double Temperature2, double lambda_a, double lambda_r, const gsl_vector *k, \
             double *OutputVec, int potentialNumber, int nodesFacdes2Y){
-    solve_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, k, OutputVec, 
-                     potentialNumber, nodesFacdes2Y, 3, 1, "RY_CdeK.dat");
+    solve_all_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, k, NULL, 
+                          OutputVec, NULL, NULL, NULL, NULL, NULL, potentialNumber, nodesFacdes2Y, 3);
 }
 
 /**
@@ -117,8 +164,8 @@ void ck_RY(double volumeFactor, double Temperature, double Temperature2, double
  */
 void is_RY(double volumeFactor, double Temperature, double Temperature2, double lambda_a, double lambda_r, const gsl_vector *k, \
             double *OutputVec, int potentialNumber, int nodesFacdes2Y){
-    solve_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, k, OutputVec, 
-                     potentialNumber, nodesFacdes2Y, 3, 2, "RY_FT_CdeK.dat");
+    solve_all_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, k, NULL, 
+                          NULL, OutputVec, NULL, NULL, NULL, NULL, potentialNumber, nodesFacdes2Y, 3);
 }
 
 /**
@@ -126,8 +173,8 @@ void is_RY(double volumeFactor, double Temperature, double Temperature2, double
  */
 void sk_RY(double volumeFactor, double Temperature, double Temperature2, double lambda_a, double lambda_r, const gsl_vector *k, \
             double *OutputVec, int potentialNumber, int nodesFacdes2Y){
-    solve_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, k, OutputVec, 
-                     potentialNumber, nodesFacdes2Y, 3, 0, "RY_SdeK.dat");
+    solve_all_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, k, NULL, 
+                          NULL, NULL, OutputVec, NULL, NULL, NULL, potentialNumber, nodesFacdes2Y, 3);
 }
 
 /**
@@ -135,8 +182,8 @@ void sk_RY(double volumeFactor, double Temperature, double Temperature2, double
  */
 void gr_HNC(double volumeFactor, double Temperature, double Temperature2, double lambda_a, double lambda_r, const gsl_vector *r_vec, \
             double *OutputVec, int potentialNumber, int nodesFacdes2Y){
-    solve_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, r_vec, OutputVec, 
-                     potentialNumber, nodesFacdes2Y, 2, 3, "HNC_GdeR.dat");
+    solve_all_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, NULL, r_vec, 
+                          NULL, NULL, NULL, OutputVec, NULL, NULL, potentialNumber, nodesFacdes2Y, 2);
 }
 
 /**
@@ -144,58 +191,41 @@ void gr_HNC(double volumeFactor, double Temperature, double Temperature2, double
  */
 void gr_RY(double volumeFactor, double Temperature, double Temperature2, double lambda_a, double lambda_r, const gsl_vector *r_vec, \
             double *OutputVec, int potentialNumber, int nodesFacdes2Y){
-    solve_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, r_vec, OutputVec, 
-                     potentialNumber, nodesFacdes2Y, 3, 3, "RY_GdeR.dat");
+    solve_all_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, NULL, r_vec, 
+                          NULL, NULL, NULL, OutputVec, NULL, NULL, potentialNumber, nodesFacdes2Y, 3);
 }
 
 /**
- * @brief Generic helper function to solve OZ equation and process results.
- * 
- * This function encapsulates the common logic for all solver variants:
- * 1. Memory allocation
- * 2. Solving the OZ equation via facdes2YFunc
- * 3. Interpolating results to the input grid
- * 4. Writing results to file in the output/ directory
- * 5. Cleaning up memory
- */
-static void solve_and_process(double volumeFactor, double Temperature, double Temperature2, 
-                            double lambda_a, double lambda_r, const gsl_vector *input_vec, 
-                            double *OutputVec, int potentialNumber, int nodesFacdes2Y,
-                            int closureID, int outputFlag, const char *filename) {
-    
-    int potentialID = potentialNumber;
-    const int nodesInput = input_vec->size;
-    
-    double *rkVec, *ykVec, *xOutputVec;
-    
-    rmax = 160;
-    
-    // Allocate memory for solver arrays and output
-    rkVec = malloc(nodesFacdes2Y * sizeof(double));
-    ykVec = malloc(nodesFacdes2Y * sizeof(double));
-    xOutputVec = malloc(nodesInput * sizeof(double));
-    
-    if (rkVec == NULL || ykVec == NULL || xOutputVec == NULL) {
-        printf("Memory allocation failed in solve_and_process for %s.\n", filename);
-        if (rkVec) free(rkVec);
-        if (ykVec) free(ykVec);
-        if (xOutputVec) free(xOutputVec);
-        return;
-    }
-    
-    for(int i=0; i < nodesInput; i++){
-        xOutputVec[i] = (double)(input_vec->data[i]);
-        OutputVec[i] = 0.0;
-    }
-    
-    // Solve OZ equation
-    facdes2YFunc(nodesFacdes2Y, nrho, rmax, potentialID, closureID, sigma1, sigma2, Temperature, Temperature2, lambda_a, lambda_r, \
-                 volumeFactor, d, alpha, EZ, outputFlag, ykVec, rkVec);
-    
-    // Interpolate results to input grid
-    interpolationFunc(rkVec, ykVec, xOutputVec, OutputVec, nodesFacdes2Y, (int)nodesInput);
-    
-    // Write to file in output/ directory
+ * @brief Calculates every observable with a single HNC solve.
+ *
+ * c(k), 1/S(k) and S(k) are interpolated to k and g(r) to r. Any output
+ * pointer (and the grid it needs) may be NULL to skip that quantity.
+ */
+void all_HNC(double volumeFactor, double Temperature, double Temperature2, double lambda_a, double lambda_r, const gsl_vector *k, \
+             const gsl_vector *r, double *ckVec, double *isVec, double *skVec, double *grVec, OZThermo *thermo, \
+             OZAllocStats *alloc, int potentialNumber, int nodesFacdes2Y){
+    solve_all_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, k, r, 
+                          ckVec, isVec, skVec, grVec, thermo, alloc, potentialNumber, nodesFacdes2Y, 2);
+}
+
+/**
+ * @brief Calculates every observable with a single Rogers-Young solve.
+ *
+ * c(k), 1/S(k) and S(k) are interpolated to k and g(r) to r. Any output
+ * pointer (and the grid it needs) may be NULL to skip that quantity.
+ */
+void all_RY(double volumeFactor, double Temperature, double Temperature2, double lambda_a, double lambda_r, const gsl_vector *k, \
+            const gsl_vector *r, double *ckVec, double *isVec, double *skVec, double *grVec, OZThermo *thermo, \
+            OZAllocStats *alloc, int potentialNumber, int nodesFacdes2Y){
+    solve_all_and_process(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, k, r, 
+                          ckVec, isVec, skVec, grVec, thermo, alloc, potentialNumber, nodesFacdes2Y, 3);
+}
+
+/**
+ * @brief Writes one (x, y) observable to output/ (local directory as fallback).
+ */
+static void write_observable(const char *filename, const double *xVec, const double *yVec, int nodes) {
+
     char filepath[256];
     snprintf(filepath, sizeof(filepath), "output/%s", filename);
     
@@ -208,28 +238,214 @@ static void solve_and_process(double volumeFactor, double Temperature, double Te
     }
     
     if (outputFile != NULL) {
-        for (int i=0; i < nodesFacdes2Y; i++) {
-            fprintf(outputFile, "%.17lf\t%.17lf\n", rkVec[i], ykVec[i]);
-            // For S(k) HNC, the original code also printed to stdout. Preserving that behavior if needed, 
-            // but usually libraries shouldn't print to stdout. Removed for consistency unless requested.
-            // if (outputFlag == 0 && closureID == 2) printf("%.17lf\t%.17lf\n", rkVec[i], ykVec[i]);
+        for (int i=0; i < nodes; i++) {
+            fprintf(outputFile, "%.17lf\t%.17lf\n", xVec[i], yVec[i]);
         }
         fclose(outputFile);
     } else {
         fprintf(stderr, "Error: Could not open file %s for writing.\n", filename);
     }
+}
+
+/**
+ * @brief Generic helper function to solve OZ equation and process results.
+ * 
+ * This function encapsulates the common logic for all solver variants:
+ * 1. Solving the OZ equation once via facdes2YAll
+ * 2. Interpolating each requested observable to its input grid
+ * 3. Writing each requested observable to file in the output/ directory
+ * 4. Cleaning up memory
+ */
+static void solve_all_and_process(double volumeFactor, double Temperature, double Temperature2, 
+                            double lambda_a, double lambda_r, const gsl_vector *k_vec, const gsl_vector *r_vec,
+                            double *ckVec, double *isVec, double *skVec, double *grVec, OZThermo *thermo,
+                            OZAllocStats *alloc, int potentialNumber, int nodesFacdes2Y, int closureID) {
+    
+    const char *prefix = (closureID == 3) ? "RY" : "HNC";
+    char filename[64];
+    // bin and hdf5 keep every quantity on the solver grid in one file instead
+    int text = (outputFormat == OZ_OUTPUT_TEXT);
+
+    OZResult *result = create_oz_result(nodesFacdes2Y);
+    if (result == NULL) {
+        printf("Memory allocation failed in solve_all_and_process.\n");
+        return;
+    }
+
+    // --sk-filon: c(k) and S(k) straight on the output k by Filon quadrature
+    double *ckFilon = NULL, *skFilon = NULL;
+    if (filonOutput && k_vec != NULL) {
+        ckFilon = malloc(k_vec->size * sizeof(double));
+        skFilon = malloc(k_vec->size * sizeof(double));
+        if (ckFilon == NULL || skFilon == NULL) {
+            printf("Memory allocation failed in solve_all_and_process.\n");
+            free(ckFilon);
+            free(skFilon);
+            free_oz_result(result);
+            return;
+        }
+        result->k_out = k_vec->data;
+        result->n_out = (int) k_vec->size;
+        result->Ck_out = ckFilon;
+        result->Sk_out = skFilon;
+    }
+    
+    // Solve OZ equation
+    if (facdes2YAll(nodesFacdes2Y, nrho, rmax, potentialNumber, closureID, sigma1, sigma2, Temperature, Temperature2, \
+                    lambda_a, lambda_r, volumeFactor, d, alpha, EZ, result) != 0) {
+        free(ckFilon);
+        free(skFilon);
+        free_oz_result(result);
+        return;
+    }
+
+    // Interpolate results to input grids and write them
+    double t_output = oz_time_now();
+    if (ckVec != NULL && k_vec != NULL) {
+        if (ckFilon != NULL) {
+            memcpy(ckVec, ckFilon, k_vec->size * sizeof(double));
+        } else {
+            interpolationFunc(result->k, result->Ck, k_vec->data, ckVec, nodesFacdes2Y, (int) k_vec->size);
+        }
+        snprintf(filename, sizeof(filename), "%s_CdeK.dat", prefix);
+        if (text) write_observable(filename, result->k, result->Ck, nodesFacdes2Y);
+    }
+    if (isVec != NULL && k_vec != NULL) {
+        if (skFilon != NULL) {
+            for (size_t i = 0; i < k_vec->size; i++) isVec[i] = 1.0 / skFilon[i];
+        } else {
+            interpolationFunc(result->k, result->invSk, k_vec->data, isVec, nodesFacdes2Y, (int) k_vec->size);
+        }
+        snprintf(filename, sizeof(filename), "%s_FT_CdeK.dat", prefix);
+        if (text) write_observable(filename, result->k, result->invSk, nodesFacdes2Y);
+    }
+    if (skVec != NULL && k_vec != NULL) {
+        if (skFilon != NULL) {
+            memcpy(skVec, skFilon, k_vec->size * sizeof(double));
+        } else {
+            interpolationFunc(result->k, result->Sk, k_vec->data, skVec, nodesFacdes2Y, (int) k_vec->size);
+        }
+        snprintf(filename, sizeof(filename), "%s_SdeK.dat", prefix);
+        if (text) write_observable(filename, result->k, result->Sk, nodesFacdes2Y);
+    }
+    if (grVec != NULL && r_vec != NULL) {
+        interpolationFunc(result->r, result->Gr, r_vec->data, grVec, nodesFacdes2Y, (int) r_vec->size);
+        snprintf(filename, sizeof(filename), "%s_GdeR.dat", prefix);
+        if (text) write_observable(filename, result->r, result->Gr, nodesFacdes2Y);
+    }
+    if (thermo != NULL) {
+        *thermo = result->thermo;
+    }
+    if (alloc != NULL) {
+        *alloc = result->alloc;
+    }
+
+    if (!text) {
+        char filepath[256];
+        snprintf(filepath, sizeof(filepath), "output/%s%s", prefix, oz_output_extension(outputFormat));
+
+        OZOutput *out = create_oz_output(filepath, outputFormat);
+        if (out == NULL || write_oz_result_header(out, potentialNumber, closureID, nodesFacdes2Y, \
+                                                  Temperature2, lambda_a, lambda_r) != 0 || \
+            oz_output_begin_point(out) != 0 || write_oz_result(out, result, volumeFactor, Temperature) != 0 || \
+            oz_output_end_point(out) != 0) {
+            fprintf(stderr, "Error: Could not write file %s.\n", filepath);
+        } else {
+            printf("Resultados escritos en %s\n", filepath);
+        }
+        free_oz_output(out);
+    }
+    oz_timing_stop(OZ_PHASE_OUTPUT, t_output);
     
-    free(xOutputVec);
-    free(rkVec);
-    free(ykVec);
+    free(ckFilon);
+    free(skFilon);
+    free_oz_result(result);
 }
 
 /**
- * @brief Main solver function for the Ornstein-Zernike equation.
+ * @brief Coarse-to-fine seed of a cold solve (ctx->multigrid_levels > 0).
  *
- * @param nodes Number of spatial nodes.
- * @param nrho Number of density points.
- * @param rmax Maximum range.
+ * Solves the same state point on nrows/2 points with the same rmax (which
+ * takes its own seed from nrows/4 while levels remain) and maps the
+ * converged gamma onto ctx->r, so the full grid only re-converges at the
+ * final density. ctx->r and ctx->sigmaVec must be set (input_ctx).
+ *
+ * @param rhoSeed Output: density of the seed.
+ * @return [nrows*ncols] seed, or NULL if the grid cannot be halved (too
+ *         few points, or fewer than OZ_MULTIGRID_MIN_PER_SIGMA per diameter)
+ *         or the coarse solve did not converge.
+ */
+static double* multigrid_seed(OZContext *ctx, int potentialID, int closureID, double sigma1, double sigma2, \
+                              double Temperature, double Temperature2, double lambda_a, double lambda_r, \
+                              double volumeFactor, double alpha, double EZ, int nrho, char *folderName, \
+                              double *rhoSeed) {
+    int nodes = ctx->nrows / 2;
+    if (ctx->nrows % 2 != 0 || nodes < OZ_MULTIGRID_MIN_NODES || !oz_fft_size_supported(nodes)) return NULL;
+    if (ctx->rmax / nodes > ctx->sigmaVec[0] / OZ_MULTIGRID_MIN_PER_SIGMA) {
+        oz_log(ctx, "Multimalla: N = %d dejaría dr = %.3g > sigma/%g; sin mallas más gruesas\n", nodes, \
+               ctx->rmax / nodes, OZ_MULTIGRID_MIN_PER_SIGMA);
+        return NULL;
+    }
+
+    OZContext *coarse   = create_oz_context(nodes, ctx->rmax);
+    double *StructFactor = malloc(nodes*2 * sizeof(double));
+    double *Gr_data      = malloc(nodes*2 * sizeof(double));
+    double *seed         = malloc((size_t) ctx->nrows*ctx->ncols * sizeof(double));
+
+    if (coarse == NULL || StructFactor == NULL || Gr_data == NULL || seed == NULL) {
+        printf("Memory allocation failed in multigrid_seed.\n");
+        free_oz_context(coarse);
+        free(StructFactor);
+        free(Gr_data);
+        free(seed);
+        return NULL;
+    }
+
+    coarse->ramp_mode = ctx->ramp_mode;
+    coarse->predictor_order = ctx->predictor_order;
+    coarse->solver = ctx->solver;
+    coarse->thermo_mode = ctx->thermo_mode;
+    coarse->ry_alpha_seed = ctx->ry_alpha_seed;
+    coarse->multigrid_levels = ctx->multigrid_levels - 1;
+    coarse->potential_table = ctx->potential_table;
+    // A coarse level only reports its summary line
+    coarse->verbose = 0;
+    int printFlag = 1;
+
+    int steps = facdes2YSolve(coarse, potentialID, closureID, sigma1, sigma2, Temperature, Temperature2, lambda_a, \
+                              lambda_r, volumeFactor, alpha, EZ, nrho, NULL, 0.0, StructFactor, Gr_data, \
+                              folderName, &printFlag);
+    int converged = spherical_cache_usable(coarse);
+    oz_log(ctx, "Multimalla: N = %d %s (%d pasos)\n", nodes, converged ? "convergida" : "no convergió; rampa completa", steps);
+
+    if (converged) {
+        oz_fit_columns(coarse->r, coarse->gamma, nodes, ctx->ncols, ctx->r, ctx->nrows, seed);
+        *rhoSeed = coarse->rho;
+        // The RY search on the full grid starts from the coarse alpha
+        if (closureID == 3) ctx->ry_alpha_seed = coarse->ry_alpha;
+    } else {
+        free(seed);
+        seed = NULL;
+    }
+
+    free_oz_context(coarse);
+    free(StructFactor);
+    free(Gr_data);
+    return seed;
+}
+
+/**
+ * @brief Solves one state point on a caller-provided context.
+ *
+ * Sets up the species and the potential on ctx and solves the OZ equation,
+ * either with the full density ramp (gammaSeed == NULL; fixed or adaptive
+ * after ctx->ramp_mode) or by continuation from the converged gamma of a
+ * neighbouring state. With ctx->multigrid_levels a cold solve first runs
+ * on the coarser grids (multigrid_seed) and falls back to the ramp if the
+ * full grid does not re-converge from there. The converged gamma is
+ * left in ctx->gamma.
+ *
+ * @param ctx Solver context created with create_oz_context.
  * @param potentialID Interaction potential ID.
  * @param closureID Closure relation ID.
  * @param sigma1 Diameter of species 1.
@@ -239,44 +455,34 @@ static void solve_and_process(double volumeFactor, double Temperature, double Te
  * @param lambda_a Attraction range.
  * @param lambda_r Repulsion range.
  * @param volumeFactor Volume fraction.
- * @param d Diameter scaling.
  * @param alpha Closure parameter.
  * @param EZ EZ parameter.
- * @param OutputFlag Flag to determine output type.
- * @param ykVec Output array for function values.
- * @param rkVec Output array for radial/wave vector values.
- * @return 0 on success, 1 on failure.
+ * @param nrho Number of density points of the ramp.
+ * @param gammaSeed Converged gamma of a neighbouring state, or NULL.
+ * @param rhoSeed Density of the neighbouring state (ignored without seed).
+ * @param StructFactor Output [nodes*2] (k, S(k)) pairs.
+ * @param Gr_data Output [nodes*2] (r, g(r)) pairs.
+ * @param folderName Output folder name.
+ * @param printFlag Flag to control printing.
+ * @return Number of density steps used (nrho for the fixed ramp); 0 if U could not be
+ *         built (potential 17 without ctx->potential_table), with ctx marked as failed.
  */
-int facdes2YFunc(const int nodes, int nrho, double rmax, int potentialID, int closureID, double sigma1, double sigma2, \
-                 double Temperature, double Temperature2, double lambda_a, double lambda_r, double volumeFactor, \
-                 double d, double alpha, double EZ, const int OutputFlag, double *ykVec, double *rkVec) {
-    
-    nrows = nodes;
-    ncols = 3;
+int facdes2YSolve(OZContext *ctx, int potentialID, int closureID, double sigma1, double sigma2, \
+                  double Temperature, double Temperature2, double lambda_a, double lambda_r, double volumeFactor, \
+                  double alpha, double EZ, int nrho, const double *gammaSeed, double rhoSeed, \
+                  double *StructFactor, double *Gr_data, char *folderName, int *printFlag) {
 
-    int i;
-    int printFlag = 0;
-    double *StructFactor, *FT_Cr, *Gr_data;
+    int nsteps = nrho;
     bool IsPolidispersed;
     species especie1, especie2;
-    
-    // Allocate memory for global arrays
-    r               = malloc(nrows * sizeof(double));
-    q               = malloc(nrows * sizeof(double));
-    U               = malloc(nrows*ncols * sizeof(double));
-    Up              = malloc(nrows*ncols *sizeof(double));
-    sigmaVec        = malloc(ncols * sizeof(double));
-    StructFactor    = malloc(nrows*2 * sizeof(double));
-    FT_Cr           = malloc(nrows*2 * sizeof(double));
-    Gr_data         = malloc(nrows*2 * sizeof(double));
-
-    if (r == NULL || q == NULL || U == NULL || Up == NULL || sigmaVec == NULL || StructFactor == NULL || FT_Cr == NULL || Gr_data == NULL) {
-        printf("Memory allocation failed in facdes2YFunc.\n");
-        return 1;
-    }
-    
-    x[0] = 1.0;
-    x[1] = 1.0 - x[0];
+
+    ctx->x[0] = 1.0;
+    ctx->x[1] = 1.0 - ctx->x[0];
+
+    // Every point starts its own Rogers-Young alpha search
+    ctx->ry_ix = 1;
+    ctx->ry_dif[0] = 0.0;
+    ctx->ry_dif[1] = 0.0;
 
     IsPolidispersed = false;
 
@@ -300,56 +506,455 @@ int facdes2YFunc(const int nodes, int nrho, double rmax, int potentialID, int cl
         especie2. lambda2 = especie1. lambda2;
     }
 
-    char *folderName = getFolderID();
+    // Read input data; without U (potential 17 with no table) the point is marked as failed
+    if (input_ctx(ctx, volumeFactor, xnu, especie1, especie2, potentialID) != 0) {
+        ctx->ng_iter = -1;
+        ctx->pv = ctx->chic = ctx->ener = ctx->chiv = NAN;
+        return 0;
+    }
 
-    // Read input data
-    input(volumeFactor, xnu, especie1, especie2, rmax, potentialID);
+    // Cold solves with multigrid levels start from the coarser grids
+    double *multigridSeed = NULL;
+    double ryAlphaSeed = ctx->ry_alpha_seed;
+    if (gammaSeed == NULL && ctx->multigrid_levels > 0) {
+        multigridSeed = multigrid_seed(ctx, potentialID, closureID, sigma1, sigma2, Temperature, Temperature2, \
+                                       lambda_a, lambda_r, volumeFactor, alpha, EZ, nrho, folderName, &rhoSeed);
+        gammaSeed = multigridSeed;
+    }
 
     // Perform calculations
-    OZ2(StructFactor, Gr_data, potentialID, closureID, alpha, EZ, rmax, nrho, folderName, &printFlag);
+    if (gammaSeed != NULL) {
+        nsteps = OZ2_warm_ctx(ctx, gammaSeed, rhoSeed, StructFactor, Gr_data, potentialID, closureID, \
+                              alpha, EZ, nrho, folderName, printFlag);
+        if (multigridSeed != NULL && !spherical_cache_usable(ctx)) {
+            oz_log(ctx, "\nMultimalla: la malla completa no convergió desde la semilla; rampa completa\n");
+            ctx->ry_alpha_seed = ryAlphaSeed;
+            gammaSeed = NULL;
+        }
+        free(multigridSeed);
+    }
+
+    if (gammaSeed == NULL && ctx->ramp_mode == OZ_RAMP_ADAPTIVE) {
+        nsteps = OZ2_adaptive_ctx(ctx, StructFactor, Gr_data, potentialID, closureID, alpha, EZ, nrho, folderName, printFlag);
+    } else if (gammaSeed == NULL) {
+        OZ2_ctx(ctx, StructFactor, Gr_data, potentialID, closureID, alpha, EZ, nrho, folderName, printFlag);
+        nsteps = nrho;
+    }
+
+    return nsteps;
+}
+
+/**
+ * @brief Allocates a result for a solve on nodes grid points.
+ *
+ * @param nodes Number of spatial nodes.
+ * @return Pointer to the result, or NULL on allocation failure.
+ */
+OZResult* create_oz_result(int nodes) {
+    OZResult *result = malloc(sizeof(OZResult));
+    if (!result) return NULL;
+
+    result->nodes = nodes;
+    result->k     = malloc(nodes * sizeof(double));
+    result->Sk    = malloc(nodes * sizeof(double));
+    result->invSk = malloc(nodes * sizeof(double));
+    result->Ck    = malloc(nodes * sizeof(double));
+    result->r     = malloc(nodes * sizeof(double));
+    result->Gr    = malloc(nodes * sizeof(double));
+    result->Cr    = malloc(nodes * sizeof(double));
+    memset(&result->thermo, 0, sizeof(OZThermo));
+    result->thermo.chiv = NAN;
+    memset(&result->alloc, 0, sizeof(OZAllocStats));
+    result->ramp_steps = 0;
+    result->ramp_rejected = 0;
+    result->iterations = 0;
+    result->residual = 0.0;
+    result->k_out = NULL;
+    result->n_out = 0;
+    result->Ck_out = NULL;
+    result->Sk_out = NULL;
 
-    printf("\n\n");
+    if (!result->k || !result->Sk || !result->invSk || !result->Ck || !result->r || !result->Gr || !result->Cr) {
+        free_oz_result(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Frees a result created by create_oz_result.
+ */
+void free_oz_result(OZResult *result) {
+    if (!result) return;
+
+    free(result->k);
+    free(result->Sk);
+    free(result->invSk);
+    free(result->Ck);
+    free(result->r);
+    free(result->Gr);
+    free(result->Cr);
+    free(result);
+}
+
+/**
+ * @brief Fills a result from a solved context and the (x, y) pairs of Escribe_ctx.
+ *
+ * @param result Output, created with create_oz_result(ctx->nrows).
+ * @param ctx Context of the solve (ck, cr, thermodynamics and counters).
+ * @param StructFactor [nodes*2] (k, S(k)) pairs.
+ * @param Gr_data [nodes*2] (r, g(r)) pairs.
+ */
+void oz_result_from_context(OZResult *result, const OZContext *ctx, const double *StructFactor, const double *Gr_data) {
+    for (int i = 0; i < result->nodes; i++) {
+        result->k[i]     = StructFactor[i*2 + 0];
+        result->Sk[i]    = StructFactor[i*2 + 1];
+        result->invSk[i] = 1.0 / StructFactor[i*2 + 1];
+        result->Ck[i]    = ctx->ck[i];
+        result->r[i]     = Gr_data[i*2 + 0];
+        result->Gr[i]    = Gr_data[i*2 + 1];
+        result->Cr[i]    = ctx->cr[i];
+    }
+
+    result->thermo.rho      = ctx->rho;
+    result->thermo.pressure = ctx->pv;
+    result->thermo.chic     = ctx->chic;
+    result->thermo.energy   = ctx->ener;
+    result->thermo.chiv     = ctx->chiv;
+    result->thermo.alpha    = ctx->ry_alpha;
+
+    result->alloc.arena_allocs     = ctx->ws->arena_allocs;
+    result->alloc.heap_allocs      = ctx->ws->heap_allocs;
+    result->alloc.high_water_bytes = ctx->ws->high_water * sizeof(double);
+
+    result->ramp_steps    = ctx->ramp_steps;
+    result->ramp_rejected = ctx->ramp_rejected;
+    result->iterations    = ctx->ng_iter;
+    result->residual      = ctx->ng_residual;
+}
+
+/**
+ * @brief Writes the file-level metadata shared by every spherical point.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int write_oz_result_header(OZOutput *out, int potentialID, int closureID, int nodes, \
+                           double Temperature2, double lambda_a, double lambda_r) {
+    return oz_output_attr_string(out, "solver", "spherical") | \
+           oz_output_attr_string(out, "closure", (closureID == 3) ? "RY" : "HNC") | \
+           oz_output_attr_int(out, "potential", potentialID) | \
+           oz_output_attr_int(out, "nodes", nodes) | \
+           oz_output_attr_double(out, "rmax", rmax) | \
+           oz_output_attr_double(out, "temp2", Temperature2) | \
+           oz_output_attr_double(out, "lambda_a", lambda_a) | \
+           oz_output_attr_double(out, "lambda_r", lambda_r);
+}
+
+/**
+ * @brief Writes a state point into the open point of out: its metadata and
+ *        r, h, c, k, S, H and C on the solver grid.
+ *
+ * H(k) = (S(k) - 1)/rho and h(r) = g(r) - 1.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int write_oz_result(OZOutput *out, const OZResult *result, double volumeFactor, double Temperature) {
+    int nodes = result->nodes;
+    double *h = malloc(nodes * sizeof(double));
+    double *H = malloc(nodes * sizeof(double));
+
+    if (h == NULL || H == NULL) {
+        printf("Memory allocation failed in write_oz_result.\n");
+        free(h);
+        free(H);
+        return 1;
+    }
+
+    for (int i = 0; i < nodes; i++) {
+        h[i] = result->Gr[i] - 1.0;
+        H[i] = (result->Sk[i] - 1.0) / result->thermo.rho;
+    }
+
+    int status = oz_output_attr_double(out, "volfactor", volumeFactor) | \
+                 oz_output_attr_double(out, "temp", Temperature) | \
+                 oz_output_attr_double(out, "rho", result->thermo.rho) | \
+                 oz_output_attr_int(out, "iterations", result->iterations) | \
+                 oz_output_attr_double(out, "residual", result->residual) | \
+                 oz_output_attr_int(out, "ramp_steps", result->ramp_steps) | \
+                 oz_output_attr_double(out, "pressure", result->thermo.pressure) | \
+                 oz_output_attr_double(out, "chic", result->thermo.chic) | \
+                 oz_output_attr_double(out, "energy", result->thermo.energy) | \
+                 oz_output_attr_double(out, "alpha", result->thermo.alpha) | \
+                 oz_output_attr_double(out, "chiv", result->thermo.chiv);
+
+    const double *col[1];
+    col[0] = result->r;  status |= oz_output_dataset(out, "r", "r", col, 1, nodes);
+    col[0] = h;          status |= oz_output_dataset(out, "h", "h000", col, 1, nodes);
+    col[0] = result->Cr; status |= oz_output_dataset(out, "c", "c000", col, 1, nodes);
+    col[0] = result->k;  status |= oz_output_dataset(out, "k", "k", col, 1, nodes);
+    col[0] = result->Sk; status |= oz_output_dataset(out, "S", "S000", col, 1, nodes);
+    col[0] = H;          status |= oz_output_dataset(out, "H", "H000", col, 1, nodes);
+    col[0] = result->Ck; status |= oz_output_dataset(out, "C", "C000", col, 1, nodes);
+
+    free(h);
+    free(H);
+    return status;
+}
+
+/**
+ * @brief Solves one state point and returns every observable.
+ *
+ * One density ramp (and, for RY, one alpha search) gives S(k), 1/S(k),
+ * c(k) and g(r) on the solver grid together with the Termo thermodynamics.
+ *
+ * @param nodes Number of spatial nodes.
+ * @param nrho Number of density points.
+ * @param rmax Maximum range.
+ * @param potentialID Interaction potential ID.
+ * @param closureID Closure relation ID.
+ * @param sigma1 Diameter of species 1.
+ * @param sigma2 Diameter of species 2.
+ * @param Temperature Temperature of species 1.
+ * @param Temperature2 Temperature of species 2.
+ * @param lambda_a Attraction range.
+ * @param lambda_r Repulsion range.
+ * @param volumeFactor Volume fraction.
+ * @param d Diameter scaling.
+ * @param alpha Closure parameter.
+ * @param EZ EZ parameter.
+ * @param result Output, created with create_oz_result(nodes).
+ * @return 0 on success, 1 on failure.
+ */
+int facdes2YAll(const int nodes, int nrho, double rmax, int potentialID, int closureID, double sigma1, double sigma2, \
+                double Temperature, double Temperature2, double lambda_a, double lambda_r, double volumeFactor, \
+                double d, double alpha, double EZ, OZResult *result) {
+    
+    int printFlag = 0;
+    double *StructFactor, *Gr_data;
+    
+    // Each call owns its grids and potential tables, so concurrent calls
+    // do not share any state
+    OZContext *ctx  = create_oz_context(nodes, rmax);
+    StructFactor    = malloc(nodes*2 * sizeof(double));
+    Gr_data         = malloc(nodes*2 * sizeof(double));
+
+    if (ctx == NULL || StructFactor == NULL || Gr_data == NULL) {
+        printf("Memory allocation failed in facdes2YAll.\n");
+        free_oz_context(ctx);
+        free(StructFactor);
+        free(Gr_data);
+        return 1;
+    }
+
+    ctx->k_out = result->k_out;
+    ctx->n_out = result->n_out;
+    ctx->ck_out = result->Ck_out;
+    ctx->sk_out = result->Sk_out;
+
+    char *folderName = getFolderID();
+
+    ctx->ramp_mode = rampMode;
+    ctx->predictor_order = predictorOrder;
+    ctx->solver = solverMode;
+    ctx->thermo_mode = thermoMode;
+    ctx->multigrid_levels = multigridLevels;
+    ctx->potential_table = potentialTable;
+
+    // Warm start from the nearest cached solution, if any
+    OZCacheKey key;
+    double *gammaSeed = NULL, rhoSeed = 0.0;
+    if (cacheDir != NULL) {
+        spherical_cache_key(&key, ctx, potentialID, closureID, Temperature2, lambda_a, lambda_r, volumeFactor, Temperature);
+        gammaSeed = spherical_cache_seed(cacheDir, &key, ctx, OZ_CACHE_MAX_DISTANCE, &rhoSeed, &ctx->ry_alpha_seed);
+    }
+
+    facdes2YSolve(ctx, potentialID, closureID, sigma1, sigma2, Temperature, Temperature2, lambda_a, lambda_r, \
+                  volumeFactor, alpha, EZ, nrho, gammaSeed, rhoSeed, StructFactor, Gr_data, folderName, &printFlag);
+
+    if (gammaSeed != NULL && !spherical_cache_usable(ctx)) {
+        oz_log(ctx, "\n[caché] la continuación desde la semilla no convergió; rampa completa\n");
+        ctx->ry_alpha_seed = 0.0;
+        facdes2YSolve(ctx, potentialID, closureID, sigma1, sigma2, Temperature, Temperature2, lambda_a, lambda_r, \
+                      volumeFactor, alpha, EZ, nrho, NULL, 0.0, StructFactor, Gr_data, folderName, &printFlag);
+    }
+
+    oz_log(ctx, "\n\n");
+
+    if (cacheDir != NULL) spherical_cache_store(cacheDir, &key, ctx);
+    free(gammaSeed);
+
+    oz_result_from_context(result, ctx, StructFactor, Gr_data);
+
+    free_oz_context(ctx);
+    free(StructFactor);
+    free(Gr_data);
+    free(folderName);
+
+    return 0;
+}
+
+/**
+ * @brief Cache key of a spherical state point solved on the grid of ctx.
+ */
+void spherical_cache_key(OZCacheKey *key, const OZContext *ctx, int potentialID, int closureID, \
+                         double Temperature2, double lambda_a, double lambda_r, double volumeFactor, double Temperature) {
+    static const char *closure_names[4] = {"", "PY", "HNC", "RY"};
+
+    memset(key, 0, sizeof(OZCacheKey));
+    snprintf(key->solver, sizeof(key->solver), "spherical");
+    snprintf(key->closure, sizeof(key->closure), "%s", (closureID >= 1 && closureID <= 3) ? closure_names[closureID] : "?");
+    key->potential = potentialID;
+    key->nodes = ctx->nrows;
+    key->rmax = ctx->rmax;
+    key->params[0] = Temperature2;
+    key->params[1] = lambda_a;
+    key->params[2] = lambda_r;
+    // Potential 17 does not use temp2: the table data identify it instead
+    if (potentialID == 17 && ctx->potential_table != NULL) key->params[0] = ctx->potential_table->checksum;
+    key->n_state = 2;
+    key->state[0] = volumeFactor;
+    key->state[1] = Temperature;
+}
+
+/**
+ * @brief Seed gamma for OZ2_warm_ctx from the cached solution nearest to key.
+ *
+ * @param max_distance Largest accepted state distance (see oz_cache_nearest).
+ * @param rhoSeed Output density of the cached solution.
+ * @param alphaSeed Output closure alpha of the cached solution (starts the RY search).
+ * @return [nrows*ncols] gamma on the grid of ctx (free with free()), or NULL without a usable entry.
+ */
+double* spherical_cache_seed(const char *dir, const OZCacheKey *key, const OZContext *ctx, double max_distance, \
+                             double *rhoSeed, double *alphaSeed) {
+    OZCacheEntry *entry = oz_cache_nearest(dir, key, max_distance);
+    if (entry == NULL) return NULL;
+
+    double *gamma = NULL;
+    if (entry->n_columns == ctx->ncols && entry->rho > 0.0) {
+        gamma = malloc((size_t) ctx->nrows * ctx->ncols * sizeof(double));
+    }
+    if (gamma != NULL && oz_cache_fit(entry, ctx->r, ctx->nrows, gamma) == 0) {
+        *rhoSeed = entry->rho;
+        *alphaSeed = entry->alpha;
+        oz_log(ctx, "[caché] semilla: phi = %.4f  T = %.4f  (distancia %.3g%s)\n", entry->key.state[0], entry->key.state[1], \
+               entry->distance, entry->converged ? "" : ", punto de control");
+    } else {
+        free(gamma);
+        gamma = NULL;
+    }
+
+    free_oz_cache_entry(entry);
+    return gamma;
+}
+
+/**
+ * @brief 1 if the last solve on ctx converged to a finite solution.
+ */
+int spherical_cache_usable(const OZContext *ctx) {
+    return ctx->ng_iter >= 0 && isfinite(ctx->chic) && isfinite(ctx->pv);
+}
+
+/**
+ * @brief Stores the converged gamma of ctx under key (failed solves are not stored).
+ *
+ * @return 0 on success, 1 on failure.
+ */
+int spherical_cache_store(const char *dir, const OZCacheKey *key, const OZContext *ctx) {
+    if (ctx->gamma == NULL || !spherical_cache_usable(ctx)) return 1;
+
+    OZCacheEntry *entry = create_oz_cache_entry(key, ctx->ncols, ctx->nrows);
+    if (entry == NULL) {
+        printf("Memory allocation failed in spherical_cache_store.\n");
+        return 1;
+    }
+
+    memcpy(entry->r, ctx->r, (size_t) ctx->nrows * sizeof(double));
+    memcpy(entry->data, ctx->gamma, (size_t) ctx->nrows * ctx->ncols * sizeof(double));
+    entry->converged = 1;
+    entry->iterations = ctx->ng_iter;
+    entry->residual = ctx->ng_residual;
+    entry->rho = ctx->rho;
+    entry->alpha = ctx->ry_alpha;
+
+    int status = oz_cache_save(dir, entry);
+    free_oz_cache_entry(entry);
+    return status;
+}
+
+/**
+ * @brief Main solver function for the Ornstein-Zernike equation.
+ *
+ * Returns a single observable; use facdes2YAll to get all of them from one solve.
+ *
+ * @param nodes Number of spatial nodes.
+ * @param nrho Number of density points.
+ * @param rmax Maximum range.
+ * @param potentialID Interaction potential ID.
+ * @param closureID Closure relation ID.
+ * @param sigma1 Diameter of species 1.
+ * @param sigma2 Diameter of species 2.
+ * @param Temperature Temperature of species 1.
+ * @param Temperature2 Temperature of species 2.
+ * @param lambda_a Attraction range.
+ * @param lambda_r Repulsion range.
+ * @param volumeFactor Volume fraction.
+ * @param d Diameter scaling.
+ * @param alpha Closure parameter.
+ * @param EZ EZ parameter.
+ * @param OutputFlag Flag to determine output type.
+ * @param ykVec Output array for function values.
+ * @param rkVec Output array for radial/wave vector values.
+ * @return 0 on success, 1 on failure.
+ */
+int facdes2YFunc(const int nodes, int nrho, double rmax, int potentialID, int closureID, double sigma1, double sigma2, \
+                 double Temperature, double Temperature2, double lambda_a, double lambda_r, double volumeFactor, \
+                 double d, double alpha, double EZ, const int OutputFlag, double *ykVec, double *rkVec) {
+    
+    int i;
+    const double *xVec, *yVec;
+
+    OZResult *result = create_oz_result(nodes);
+    if (result == NULL) {
+        printf("Memory allocation failed in facdes2YFunc.\n");
+        return 1;
+    }
+
+    if (facdes2YAll(nodes, nrho, rmax, potentialID, closureID, sigma1, sigma2, Temperature, Temperature2, \
+                    lambda_a, lambda_r, volumeFactor, d, alpha, EZ, result) != 0) {
+        free_oz_result(result);
+        return 1;
+    }
 
     switch(OutputFlag){
         
-        case 1: // Fourier transform HNC closure
-            for (i=0; i<nrows; i++){
-                rkVec[i] = FT_Cr[i*2 + 0];
-                ykVec[i] = FT_Cr[i*2 + 1];
-            }            
+        case 1: // Fourier transform of the direct correlation function
+            xVec = result->k;
+            yVec = result->Ck;
             break;
         
         case 2: // Inverse of Structure factor
-            for (i=0; i<nrows; i++){
-                rkVec[i] = StructFactor[i*2 + 0];
-                ykVec[i] = 1.0 / StructFactor[i*2 + 1];
-            }
+            xVec = result->k;
+            yVec = result->invSk;
             break;
         
         case 3: // Radial distribution function g(r)
-            for (i=0; i<nrows; i++){
-                rkVec[i] = Gr_data[i*2 + 0];
-                ykVec[i] = Gr_data[i*2 + 1];
-            }
+            xVec = result->r;
+            yVec = result->Gr;
             break;
         
         default : // Structure factor
-            for (i=0; i<nrows; i++){
-                rkVec[i] = StructFactor[i*2 + 0];
-                ykVec[i] = StructFactor[i*2 + 1];
-            }
+            xVec = result->k;
+            yVec = result->Sk;
             break;
     }
 
-    free(r);
-    free(q);
-    free(U);
-    free(Up);
-    free(sigmaVec);
-    free(StructFactor);
-    free(FT_Cr);
-    free(Gr_data);
-    free(folderName);
+    for (i=0; i<nodes; i++){
+        rkVec[i] = xVec[i];
+        ykVec[i] = yVec[i];
+    }
+
+    free_oz_result(result);
 
     return 0;
 }
@@ -390,20 +995,21 @@ void interpolationFunc(double *xInput, double *yInput, double *xOutput, double *
  * @return A string containing the formatted timestamp.
  */
 char *getFolderID() {
-    char *fullTime, *day, *month, *year, *hour, *min, *sec;
+    char fullTime[32], *save, *day, *month, *year, *hour, *min, *sec;
 
     time_t currentTime;
     currentTime = time(NULL);
 
-    fullTime = ctime(&currentTime);
+    // Reentrant versions: several solves may ask for a folder ID at once
+    ctime_r(&currentTime, fullTime);
 
-    month = strtok(fullTime, " ");
-    month = strtok(NULL, " ");
-    day = strtok(NULL, " ");
-    hour = strtok(NULL, ":");
-    min = strtok(NULL, ":");
-    sec = strtok(NULL, " ");
-    year = strtok(NULL, "\n");
+    month = strtok_r(fullTime, " ", &save);
+    month = strtok_r(NULL, " ", &save);
+    day = strtok_r(NULL, " ", &save);
+    hour = strtok_r(NULL, ":", &save);
+    min = strtok_r(NULL, ":", &save);
+    sec = strtok_r(NULL, " ", &save);
+    year = strtok_r(NULL, "\n", &save);
 
     int resultLength = strlen(day) + strlen(month) + strlen(year) +
                        strlen(hour) + strlen(min) + strlen(sec) + 6;
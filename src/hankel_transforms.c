@@ -0,0 +1,292 @@
+#include "hankel_transforms.h"
+#include "math_aux.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <complex.h>
+
+static int is_power_of_two(int n) {
+    return (n > 1) && ((n & (n - 1)) == 0);
+}
+
+HankelPlan* create_hankel_plan(int n_points, double dr) {
+    HankelPlan *plan = malloc(sizeof(HankelPlan));
+    if (!plan) return NULL;
+
+    plan->n_points = n_points;
+    plan->use_fft = is_power_of_two(n_points);
+    plan->log_grid = 0;
+    plan->dr = dr;
+    plan->dk = M_PI / (n_points * dr);
+    plan->dlnr = 0.0;
+    plan->kernel = NULL;
+
+    plan->r = malloc(n_points * sizeof(double));
+    plan->k = malloc(n_points * sizeof(double));
+    plan->work = malloc((n_points + 1) * sizeof(double));
+    plan->sum_a = malloc(n_points * sizeof(double));
+    plan->sum_b = malloc(n_points * sizeof(double));
+    plan->sum_c = malloc(n_points * sizeof(double));
+
+    if (!plan->r || !plan->k || !plan->work || !plan->sum_a || !plan->sum_b || !plan->sum_c) {
+        free_hankel_plan(plan);
+        return NULL;
+    }
+
+    for (int i = 0; i < n_points; i++) {
+        plan->r[i] = (i + 1) * plan->dr;
+        plan->k[i] = (i + 1) * plan->dk;
+    }
+
+    return plan;
+}
+
+/*
+ * ln Gamma(z) for Re z >= 1/2 (Lanczos, g = 7). Only exp() of the result is
+ * used, so the branch of the imaginary part does not matter.
+ */
+static double complex log_gamma(double complex z) {
+    static const double p[9] = {0.99999999999980993, 676.5203681218851, -1259.1392167224028,
+                                771.32342877765313, -176.61502916214059, 12.507343278686905,
+                                -0.13857109526572012, 9.9843695780195716e-6, 1.5056327351493116e-7};
+    z -= 1.0;
+    double complex x = p[0];
+    for (int i = 1; i < 9; i++) x += p[i] / (z + i);
+    double complex t = z + 7.5;
+    return 0.5 * log(2.0 * M_PI) + (z + 0.5) * clog(t) - t + clog(x);
+}
+
+/*
+ * u_m = (x_0 y_0)^(-i eta_m) U(q + i eta_m) on the padded grid, with the
+ * Mellin transform of j_l
+ *   U(z) = integral t^(z-1) j_l(t) dt = sqrt(PI) 2^(z-2) Gamma((l+z)/2) / Gamma((3+l-z)/2).
+ * The Nyquist term is kept real so that real input gives real output.
+ */
+static void fftlog_kernel(int l, int m2, double dlnr, double ln_xy, double *u) {
+    double q = HANKEL_LOG_BIAS;
+
+    for (int m = 0; m < m2; m++) {
+        int ms = (m <= m2 / 2) ? m : m - m2;
+        double eta = 2.0 * M_PI * ms / (m2 * dlnr);
+        double complex z = q + I * eta;
+        double complex ln_u = 0.5 * log(M_PI) + (z - 2.0) * M_LN2 + log_gamma(0.5 * (l + z)) - \
+                              log_gamma(0.5 * (3.0 + l - z)) - I * eta * ln_xy;
+        double complex um = cexp(ln_u);
+        u[2*m] = creal(um);
+        u[2*m+1] = (2 * m == m2) ? 0.0 : cimag(um);
+    }
+}
+
+HankelPlan* create_hankel_plan_log(int n_points, double r_min, double r_max, double kr) {
+    if (!is_power_of_two(n_points) || r_min <= 0.0 || r_max <= r_min || kr <= 0.0) {
+        fprintf(stderr, "Error: Log grid needs N = %d a power of 2, 0 < r_min < r_max and kr > 0.\n", n_points);
+        return NULL;
+    }
+
+    HankelPlan *plan = calloc(1, sizeof(HankelPlan));
+    if (!plan) return NULL;
+
+    int m2 = 2 * n_points;
+    plan->n_points = n_points;
+    plan->use_fft = 1;
+    plan->log_grid = 1;
+    plan->dlnr = log(r_max / r_min) / (n_points - 1);
+
+    plan->r = malloc(n_points * sizeof(double));
+    plan->k = malloc(n_points * sizeof(double));
+    plan->work = malloc(2 * m2 * sizeof(double));
+    plan->kernel = malloc((size_t) (HANKEL_LOG_MAX_ORDER + 1) * 2 * m2 * sizeof(double));
+
+    if (!plan->r || !plan->k || !plan->work || !plan->kernel) {
+        free_hankel_plan(plan);
+        return NULL;
+    }
+
+    // x_0 y_0 of the padded grids, which start N/2 points below r_0 and k_0:
+    // nominally kr r_min / r_max, moved by less than dlnr/2 so that the l = 0
+    // kernel is real at the Nyquist frequency (low-ringing choice)
+    double ln_xy = log(kr * r_min / r_max) - n_points * plan->dlnr;
+    double eta_nyquist = M_PI / plan->dlnr;
+    double complex z = HANKEL_LOG_BIAS + I * eta_nyquist;
+    double phase = cimag(log_gamma(0.5 * z) - log_gamma(0.5 * (3.0 - z)) + z * M_LN2) - eta_nyquist * ln_xy;
+    ln_xy += (phase - M_PI * round(phase / M_PI)) / eta_nyquist;
+
+    double k_min = exp(ln_xy + n_points * plan->dlnr) / r_min;
+    for (int i = 0; i < n_points; i++) {
+        plan->r[i] = r_min * exp(i * plan->dlnr);
+        plan->k[i] = k_min * exp(i * plan->dlnr);
+    }
+    for (int l = 0; l <= HANKEL_LOG_MAX_ORDER; l++)
+        fftlog_kernel(l, m2, plan->dlnr, ln_xy, plan->kernel + (size_t) l * 2 * m2);
+
+    return plan;
+}
+
+void free_hankel_plan(HankelPlan *plan) {
+    if (!plan) return;
+
+    free(plan->r);
+    free(plan->k);
+    free(plan->work);
+    free(plan->sum_a);
+    free(plan->sum_b);
+    free(plan->sum_c);
+    free(plan->kernel);
+    free(plan);
+}
+
+/*
+ * out[i] = sum_{j=0}^{N-1} g[j] sin(PI (i+1)(j+1) / N)
+ *
+ * The j = N-1 term (r = rmax) and the i = N-1 output vanish identically,
+ * which is what lets the sum map onto sinft over indices 1..N-1.
+ */
+static void sine_sum(HankelPlan *plan, const double *g, double *out) {
+    int n = plan->n_points;
+
+    if (plan->use_fft) {
+        double *w = plan->work;
+        w[0] = 0.0;
+        for (int m = 1; m < n; m++) w[m] = g[m-1];
+        sinft_double(w, n);
+        for (int i = 0; i < n - 1; i++) out[i] = w[i+1];
+        out[n-1] = 0.0;
+        return;
+    }
+
+    for (int i = 0; i < n; i++) {
+        double sum = 0.0;
+        for (int j = 0; j < n; j++) {
+            sum += g[j] * sin(M_PI * (i + 1) * (double)(j + 1) / n);
+        }
+        out[i] = sum;
+    }
+}
+
+/*
+ * out[i] = sum_{j=0}^{N-1} g[j] cos(PI (i+1)(j+1) / N)
+ *
+ * cosft1 weights the end point by 1/2, so the r = rmax term is added back.
+ */
+static void cosine_sum(HankelPlan *plan, const double *g, double *out) {
+    int n = plan->n_points;
+
+    if (plan->use_fft) {
+        double *w = plan->work;
+        w[0] = 0.0;
+        for (int m = 1; m <= n; m++) w[m] = g[m-1];
+        cosft1_double(w, n);
+        for (int i = 0; i < n; i++) {
+            double sign = ((i + 1) % 2 == 0) ? 1.0 : -1.0;
+            out[i] = w[i+1] + 0.5 * sign * g[n-1];
+        }
+        return;
+    }
+
+    for (int i = 0; i < n; i++) {
+        double sum = 0.0;
+        for (int j = 0; j < n; j++) {
+            sum += g[j] * cos(M_PI * (i + 1) * (double)(j + 1) / n);
+        }
+        out[i] = sum;
+    }
+}
+
+/*
+ * Shared body of the forward and inverse transforms. The kernel is symmetric
+ * in (i, j), so both directions only differ in which grid is integrated over
+ * (x_j) and which is evaluated (y_i), and in the prefactor.
+ *
+ *   l = 0:  sum_j x_j^2 g_j j0(y x_j) = (1/y) S[x g]
+ *   l = 2:  sum_j x_j^2 g_j j2(y x_j) = (3/y^3) S[g/x] - (1/y) S[x g] - (3/y^2) C[g]
+ */
+static int hankel_sum(HankelPlan *plan, int l, const double *x, const double *y,
+                      const double *g, double *out, double prefactor) {
+    int n = plan->n_points;
+    double *a = plan->sum_a;
+    double *b = plan->sum_b;
+    double *c = plan->sum_c;
+
+    if (l == 0) {
+        for (int j = 0; j < n; j++) a[j] = x[j] * g[j];
+        sine_sum(plan, a, b);
+        for (int i = 0; i < n; i++) out[i] = prefactor * b[i] / y[i];
+        return 0;
+    }
+
+    if (l == 2) {
+        // The three partial sums are formed one at a time because sum_a is
+        // reused as the input buffer.
+        for (int j = 0; j < n; j++) a[j] = g[j] / x[j];
+        sine_sum(plan, a, b);
+        for (int i = 0; i < n; i++) out[i] = 3.0 * b[i] / (y[i] * y[i] * y[i]);
+
+        for (int j = 0; j < n; j++) a[j] = x[j] * g[j];
+        sine_sum(plan, a, b);
+        cosine_sum(plan, g, c);
+        for (int i = 0; i < n; i++) {
+            out[i] -= b[i] / y[i] + 3.0 * c[i] / (y[i] * y[i]);
+            out[i] *= -prefactor;
+        }
+        return 0;
+    }
+
+    fprintf(stderr, "Error: Hankel transform of order l=%d not supported.\n", l);
+    return -1;
+}
+
+/*
+ * FFTLog body of both directions: out_i = prefactor * integral x^2 g(x) j_l(y_i x) dx.
+ *
+ * a = x^(3-q) g is zero-padded to 2N points (N/2 on each side, so the
+ * periodic extension in ln x does not fold one tail onto the other),
+ * c_m = FFT[a] / 2N, and out = y^(-q) FFT[c u], read back from the middle.
+ * The sign of the prefactor is (-1)^(floor(l/2)).
+ */
+static int fftlog_sum(HankelPlan *plan, int l, const double *x, const double *y,
+                      const double *g, double *out, double prefactor) {
+    if (l < 0 || l > HANKEL_LOG_MAX_ORDER) {
+        fprintf(stderr, "Error: Hankel transform of order l=%d not supported.\n", l);
+        return -1;
+    }
+
+    int n = plan->n_points, m2 = 2 * n, pad = n / 2;
+    double q = HANKEL_LOG_BIAS;
+    double *w = plan->work;
+    const double *u = plan->kernel + (size_t) l * 2 * m2;
+
+    for (int m = 0; m < 2 * m2; m++) w[m] = 0.0;
+    for (int j = 0; j < n; j++) w[2*(j+pad)] = g[j] * pow(x[j], 3.0 - q);
+
+    four1_double(w, m2, -1);
+    for (int m = 0; m < m2; m++) {
+        double re = w[2*m], im = w[2*m+1];
+        w[2*m]   = (re * u[2*m] - im * u[2*m+1]) / m2;
+        w[2*m+1] = (re * u[2*m+1] + im * u[2*m]) / m2;
+    }
+    four1_double(w, m2, -1);
+
+    if ((l / 2) % 2) prefactor = -prefactor;
+    for (int i = 0; i < n; i++) out[i] = prefactor * w[2*(i+pad)] * pow(y[i], -q);
+
+    // l = 0: the ball x < x_0, with g = g_0, which the log grid does not reach
+    if (l == 0) {
+        double x0 = x[0];
+        for (int i = 0; i < n; i++) {
+            double t = y[i] * x0;
+            double j1t = (t < 1e-3) ? 1.0 / 3.0 - t * t / 30.0 : (sin(t) - t * cos(t)) / (t * t * t);
+            out[i] += prefactor * g[0] * x0 * x0 * x0 * j1t;
+        }
+    }
+    return 0;
+}
+
+int hankel_forward(HankelPlan *plan, int l, const double *f, double *fk) {
+    if (plan->log_grid) return fftlog_sum(plan, l, plan->r, plan->k, f, fk, 4.0 * M_PI);
+    return hankel_sum(plan, l, plan->r, plan->k, f, fk, 4.0 * M_PI * plan->dr);
+}
+
+int hankel_inverse(HankelPlan *plan, int l, const double *fk, double *f) {
+    if (plan->log_grid) return fftlog_sum(plan, l, plan->k, plan->r, fk, f, 1.0 / (2.0 * M_PI * M_PI));
+    return hankel_sum(plan, l, plan->k, plan->r, fk, f, plan->dk / (2.0 * M_PI * M_PI));
+}
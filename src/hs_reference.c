@@ -0,0 +1,258 @@
+/**
+ * @file hs_reference.c
+ * @brief Hard-sphere reference of the RHNC closure, memoised per process and in --cache.
+ *
+ * The sine sums of the reference are the order-0 Hankel transforms of the
+ * dipolar solver, so they run in O(N log N) on power-of-two grids. A
+ * reference is immutable once built; hs_reference_get hands out one copy
+ * per (kind, grid, rho, sigma) for the lifetime of the process.
+ */
+
+#include "hs_reference.h"
+#include "hankel_transforms.h"
+#include "oz_cache.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static const char *kind_names[2] = {"PY", "VW"};
+
+typedef struct HSReferenceNode {
+    HSReference *ref;
+    struct HSReferenceNode *next;
+} HSReferenceNode;
+
+static HSReferenceNode *references = NULL;
+static pthread_mutex_t references_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static HSReference* alloc_hs_reference(HSReferenceKind kind, int n_points, double dr, double rho, double sigma) {
+    HSReference *ref = calloc(1, sizeof(HSReference));
+    if (!ref) return NULL;
+
+    ref->kind = kind;
+    ref->n_points = n_points;
+    ref->dr = dr;
+    ref->rho = rho;
+    ref->sigma = sigma;
+    ref->c    = malloc(n_points * sizeof(double));
+    ref->h    = malloc(n_points * sizeof(double));
+    ref->eta  = malloc(n_points * sizeof(double));
+    ref->dlng = malloc(n_points * sizeof(double));
+
+    if (!ref->c || !ref->h || !ref->eta || !ref->dlng) {
+        free_hs_reference(ref);
+        return NULL;
+    }
+    return ref;
+}
+
+void free_hs_reference(HSReference *ref) {
+    if (!ref) return;
+
+    free(ref->c);
+    free(ref->h);
+    free(ref->eta);
+    free(ref->dlng);
+    free(ref);
+}
+
+// eta and d ln g/dr from c and h; ln g jumps at sigma, so the differences stay outside the core
+static void finish_hs_reference(HSReference *ref) {
+    int n = ref->n_points;
+
+    for (int i = 0; i < n; i++) ref->eta[i] = ref->h[i] - ref->c[i];
+
+    // First node outside the core (r > sigma), as grid->i_core of the closures
+    int i_core = 0;
+    while (i_core < n && (i_core + 1) * ref->dr <= ref->sigma) i_core++;
+
+    // The closure never reads d ln g inside the core
+    for (int i = 0; i < i_core; i++) ref->dlng[i] = 0.0;
+
+    for (int i = i_core; i < n; i++) {
+        int i_prev = (i > i_core) ? i - 1 : i_core;
+        int i_next = (i < n - 1) ? i + 1 : n - 1;
+        double g_prev = ref->h[i_prev] + 1.0;
+        double g_next = ref->h[i_next] + 1.0;
+        if (g_prev < 1e-12) g_prev = 1e-12;
+        if (g_next < 1e-12) g_next = 1e-12;
+        ref->dlng[i] = (i_next > i_prev) ? (log(g_next) - log(g_prev)) / ((i_next - i_prev) * ref->dr) : 0.0;
+    }
+}
+
+// Exact PY c(r) of diameter sigma at density rho and h(r) from OZ; Ck is scratch
+static void percus_yevick(HankelPlan *plan, double rho, double sigma, double *c, double *h, double *Ck) {
+    int n = plan->n_points;
+    double eta_vol = rho * M_PI * pow(sigma, 3) / 6.0;
+    double lambda1 = pow(1.0 + 2.0*eta_vol, 2) / pow(1.0 - eta_vol, 4);
+    double lambda2 = -pow(1.0 + 0.5*eta_vol, 2) / pow(1.0 - eta_vol, 4);
+
+    for (int i = 0; i < n; i++) {
+        double x = plan->r[i] / sigma;
+        if (x < 1.0) {
+            c[i] = -lambda1 - 6.0*eta_vol*lambda2*x - 0.5*eta_vol*lambda1*pow(x, 3);
+        } else {
+            c[i] = 0.0;
+        }
+    }
+
+    hankel_forward(plan, 0, c, Ck);
+    for (int i = 0; i < n; i++) {
+        double denom = 1.0 - rho * Ck[i];
+        Ck[i] = (fabs(denom) > 1e-12) ? Ck[i] / denom : 0.0;
+    }
+    hankel_inverse(plan, 0, Ck, h);
+}
+
+HSReference* create_hs_reference(HSReferenceKind kind, int n_points, double dr, double rho, double sigma) {
+    HSReference *ref = alloc_hs_reference(kind, n_points, dr, rho, sigma);
+    HankelPlan *plan = create_hankel_plan(n_points, dr);
+    double *Fk = malloc(n_points * sizeof(double));
+
+    if (!ref || !plan || !Fk) {
+        printf("Memory allocation failed in create_hs_reference.\n");
+        free_hs_reference(ref);
+        free_hankel_plan(plan);
+        free(Fk);
+        return NULL;
+    }
+
+    if (kind == HS_REFERENCE_PY) {
+        percus_yevick(plan, rho, sigma, ref->c, ref->h, Fk);
+    } else {
+        // Verlet-Weis: PY at the reduced packing, same density, plus the tail
+        double eta_vol = rho * M_PI * pow(sigma, 3) / 6.0;
+        double eta_w = eta_vol * (1.0 - eta_vol / 16.0);
+        double sigma_w = sigma * cbrt(eta_w / eta_vol);
+        double A = 0.75 * eta_w * eta_w * (1.0 - 0.7117*eta_w - 0.114*eta_w*eta_w) / pow(1.0 - eta_w, 4);
+        double g_contact = (1.0 + 0.5*eta_w) / pow(1.0 - eta_w, 2);
+        double mu = 24.0 * A / (eta_w * g_contact * sigma);
+
+        percus_yevick(plan, rho, sigma_w, ref->c, ref->h, Fk);
+
+        for (int i = 0; i < n_points; i++) {
+            double x = plan->r[i] - sigma;
+            if (x < 0.0) {
+                ref->h[i] = -1.0;
+            } else {
+                ref->h[i] += A * sigma / plan->r[i] * exp(-mu * x) * cos(mu * x);
+            }
+        }
+
+        // c(r) from OZ: C = H / (1 + rho H)
+        hankel_forward(plan, 0, ref->h, Fk);
+        for (int i = 0; i < n_points; i++) {
+            double denom = 1.0 + rho * Fk[i];
+            Fk[i] = (fabs(denom) > 1e-12) ? Fk[i] / denom : 0.0;
+        }
+        hankel_inverse(plan, 0, Fk, ref->c);
+    }
+
+    finish_hs_reference(ref);
+
+    free_hankel_plan(plan);
+    free(Fk);
+    return ref;
+}
+
+static void hs_cache_key(OZCacheKey *key, HSReferenceKind kind, int n_points, double dr, double rho, double sigma) {
+    memset(key, 0, sizeof(OZCacheKey));
+    snprintf(key->solver, sizeof(key->solver), "hsref");
+    snprintf(key->closure, sizeof(key->closure), "%s", kind_names[kind]);
+    key->nodes = n_points;
+    key->rmax = n_points * dr;
+    key->params[0] = sigma;
+    key->n_state = 1;
+    key->state[0] = rho;
+}
+
+// Reference stored in dir for exactly this point and grid, or NULL
+static HSReference* hs_cache_load(const char *dir, const OZCacheKey *key, HSReferenceKind kind, int n_points, \
+                                  double dr, double rho, double sigma) {
+    OZCacheEntry *entry = oz_cache_nearest(dir, key, 0.0);
+    if (!entry) return NULL;
+
+    HSReference *ref = NULL;
+    if (entry->n_columns == 2 && entry->n_rows == n_points && fabs(entry->r[0] - dr) <= 1e-12 * dr && \
+        fabs(entry->key.rmax - key->rmax) <= 1e-9 * key->rmax) {
+        ref = alloc_hs_reference(kind, n_points, dr, rho, sigma);
+    }
+    if (ref) {
+        memcpy(ref->c, entry->data, n_points * sizeof(double));
+        memcpy(ref->h, entry->data + n_points, n_points * sizeof(double));
+        finish_hs_reference(ref);
+    }
+
+    free_oz_cache_entry(entry);
+    return ref;
+}
+
+static void hs_cache_store(const char *dir, const OZCacheKey *key, const HSReference *ref) {
+    OZCacheEntry *entry = create_oz_cache_entry(key, 2, ref->n_points);
+    if (!entry) return;
+
+    for (int i = 0; i < ref->n_points; i++) entry->r[i] = (i + 1) * ref->dr;
+    memcpy(entry->data, ref->c, ref->n_points * sizeof(double));
+    memcpy(entry->data + ref->n_points, ref->h, ref->n_points * sizeof(double));
+    entry->converged = 1;
+    entry->rho = ref->rho;
+
+    oz_cache_save(dir, entry);
+    free_oz_cache_entry(entry);
+}
+
+const HSReference* hs_reference_get(HSReferenceKind kind, int n_points, double dr, double rho, double sigma, \
+                                    const char *cache_dir) {
+    HSReference *ref = NULL;
+
+    // Held while computing, so concurrent solves at one point build it once
+    pthread_mutex_lock(&references_lock);
+
+    for (HSReferenceNode *node = references; node; node = node->next) {
+        HSReference *r = node->ref;
+        if (r->kind == kind && r->n_points == n_points && r->dr == dr && r->rho == rho && r->sigma == sigma) {
+            ref = r;
+            break;
+        }
+    }
+
+    if (!ref) {
+        OZCacheKey key;
+        hs_cache_key(&key, kind, n_points, dr, rho, sigma);
+
+        if (cache_dir) ref = hs_cache_load(cache_dir, &key, kind, n_points, dr, rho, sigma);
+        if (ref) {
+            printf("Hard-sphere reference (%s) from cache\n", kind_names[kind]);
+        } else {
+            ref = create_hs_reference(kind, n_points, dr, rho, sigma);
+            if (ref && cache_dir) hs_cache_store(cache_dir, &key, ref);
+        }
+
+        HSReferenceNode *node = ref ? malloc(sizeof(HSReferenceNode)) : NULL;
+        if (node) {
+            node->ref = ref;
+            node->next = references;
+            references = node;
+        } else if (ref) {
+            printf("Memory allocation failed in hs_reference_get.\n");
+            free_hs_reference(ref);
+            ref = NULL;
+        }
+    }
+
+    pthread_mutex_unlock(&references_lock);
+    return ref;
+}
+
+void hs_reference_clear(void) {
+    pthread_mutex_lock(&references_lock);
+    while (references) {
+        HSReferenceNode *node = references;
+        references = node->next;
+        free_hs_reference(node->ref);
+        free(node);
+    }
+    pthread_mutex_unlock(&references_lock);
+}
@@ -1,14 +1,40 @@
 #include "facdes2Y.h"
+#include "structures_nonspherical.h"
+#include "sweep.h"
+#include "oz_fft.h"
+#include "oz_timing.h"
+#include "oz_telemetry.h"
+#include "mode2_gpu.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <gsl/gsl_vector.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 // Forward declaration of the new solver
-void solver_dipolar(int closureID, double temp, double rho, double dipole_moment, 
-                   int nodes, double rmax, const char *output_dir);
+int solver_dipolar(int closureID, double temp, double rho, double dipole_moment, 
+                   int nodes, double rmax, const char *output_dir,
+                   const NonSphericalOptions *opts);
 void solver_mode2_core(int closureID, double temp, double rho, double dipole_moment, 
-                   int nodes, double rmax, const char *output_dir);
+                   int nodes, double rmax, const char *output_dir,
+                   const NonSphericalOptions *opts);
+
+// Escribe los tiempos por fase (--timing); no hace nada sin --timing
+static void write_timing(const char *timing_path, double t_start) {
+    if (timing_path == NULL) return;
+    if (oz_timing_write_json(timing_path, oz_time_now() - t_start) != 0) {
+        fprintf(stderr, "Error: No se pudo escribir el archivo de tiempos %s.\n", timing_path);
+    }
+}
+
+// Cierra el archivo de --telemetry al salir, por cualquier camino
+static void close_telemetry(void) {
+    if (oz_telemetry_close() != 0) {
+        fprintf(stderr, "Error: No se pudo escribir el archivo de telemetría.\n");
+    }
+}
 
 // =========================================================
 // Función para Desplegar las Opciones de Potencial
@@ -36,6 +62,7 @@ void display_potential_options() {
     printf("  13  | HERTZIAN POTENTIAL (n=2.5)| U = E * (1 - r/sigma)^2.5 (r < sigma)\n");
     printf("  14  | DIPOLAR HARD SPHERES      | Hard Spheres + Point Dipole (Non-Spherical)\n");
     printf("  16  | SOFT SHOULDER POTENTIAL   | U = 0.5 * E * (1 - tanh(alpha * (r - lambda)))\n");
+    printf("  17  | TABULATED u(r)            | U = u(r)/T leído de --potential-file\n");
     printf("-------------------------------------------------------------------------\n");
     printf("\n");
     printf("Ejemplo de uso: ./facdes_solver --closure HNC --potential 13 ...\n\n");
@@ -57,6 +84,52 @@ void print_usage(const char *prog_name) {
     fprintf(stderr, "  --lambda_a  <double>       Parámetro lambda_a (e.g., 0.1, por defecto 0.0).\n");
     printf("  --lambda_r  <double>       Parámetro lambda_r (e.g., 0.1, por defecto 0.0).\n");
     printf("  --dipole    <double>       Momento dipolar mu (para potencial 14).\n");
+    fprintf(stderr, "  --output-format <text|bin|hdf5> Formato de salida (por defecto text). bin y hdf5 escriben\n");
+    fprintf(stderr, "                             todas las proyecciones y los metadatos en un solo archivo\n");
+    fprintf(stderr, "                             (hdf5 requiere make HDF5=1).\n");
+    fprintf(stderr, "  --potential-file <archivo> Tabla binaria de u(r) del potencial 17 (docs/user_guide.md).\n");
+    fprintf(stderr, "  --cache     <directorio>   Caché de soluciones: cada resolución arranca de la solución guardada\n");
+    fprintf(stderr, "                             más cercana y guarda la suya (por defecto desactivada).\n");
+    fprintf(stderr, "  --checkpoint <int>         Iteraciones entre puntos de control en la caché (potenciales 14 y 15;\n");
+    fprintf(stderr, "                             por defecto 100, 0 = solo al final).\n");
+    fprintf(stderr, "  --sk-filon                 Evalúa C(k) y S(k) directamente en los k de salida por cuadratura\n");
+    fprintf(stderr, "                             de Filon en lugar de interpolarlos (cierres HNC y RY).\n");
+    fprintf(stderr, "  --timing    <archivo.json> Escribe el tiempo total, las iteraciones y el desglose por fase\n");
+    fprintf(stderr, "                             (transformadas, OZ, cierre, mezcla, salida) en JSON (make bench).\n");
+    fprintf(stderr, "  --telemetry <archivo>      Un registro por iteración (residuo, Ng aceptado, tiempos acumulados\n");
+    fprintf(stderr, "                             por fase, reservas): CSV si termina en .csv, si no JSON Lines.\n");
+    fprintf(stderr, "\nOpciones de iteración (potenciales 14 y 15):\n");
+    fprintf(stderr, "  --mixing    <picard|anderson> Esquema de mezcla (por defecto picard; anderson con --grid log).\n");
+    fprintf(stderr, "  --anderson-depth <int>     Historia de Anderson m (por defecto 5).\n");
+    fprintf(stderr, "  --mix-alpha <double>       Factor de amortiguamiento (por defecto 0.3).\n");
+    fprintf(stderr, "  --adaptive  <0|1>          Amortiguamiento adaptativo (por defecto 1 con anderson).\n");
+    fprintf(stderr, "  --max-iter  <int>          Máximo de iteraciones (por defecto 2000).\n");
+    fprintf(stderr, "  --tol       <double>       Tolerancia del residuo RMS (por defecto 1e-6).\n");
+    fprintf(stderr, "  --mmax      <int>          m, n máximos de las proyecciones del potencial 15 (por defecto 2).\n");
+    fprintf(stderr, "  --hs-ref    <py|vw>        Referencia de esferas duras de RHNC: Percus-Yevick o Verlet-Weis\n");
+    fprintf(stderr, "                             (por defecto py).\n");
+    fprintf(stderr, "  --rmax      <double>       Radio máximo de la malla en unidades de sigma (por defecto 10).\n");
+    fprintf(stderr, "  --grid      <uniform|log>  Malla radial del potencial 14: uniforme o logarítmica con\n");
+    fprintf(stderr, "                             transformadas FFTLog (por defecto uniform).\n");
+    fprintf(stderr, "  --rmin      <double>       Primer punto de la malla logarítmica (por defecto 0.01).\n");
+    fprintf(stderr, "  --dipole-split <0|1>       Transforma analíticamente las colas 1/r^3 de c112 y h112\n");
+    fprintf(stderr, "                             (malla uniforme, por defecto 0).\n");
+    fprintf(stderr, "  --gpu       <0|1>          Itera el potencial 15 en un dispositivo CUDA (make CUDA=1,\n");
+    fprintf(stderr, "                             por defecto 0).\n");
+    fprintf(stderr, "  --mixed-precision <double> Potencial 15: transformadas en float hasta que el residuo baja\n");
+    fprintf(stderr, "                             de este valor, después en double (por defecto 0: siempre double).\n");
+    fprintf(stderr, "\nRampa de densidad (cierres HNC y RY):\n");
+    fprintf(stderr, "  --ramp      <fixed|adaptive> Rampa fija de nrho pasos o paso adaptativo (por defecto adaptive).\n");
+    fprintf(stderr, "  --predictor <1|2>          Orden del predictor de la rampa adaptativa (por defecto 2).\n");
+    fprintf(stderr, "  --solver    <ng|newton>    Iteración en cada paso: Ng o Newton-GMRES (por defecto ng).\n");
+    fprintf(stderr, "  --thermo    <fd|linear>    d(betaP)/drho del cierre RY: re-soluciones en rho -+ drho o\n");
+    fprintf(stderr, "                             una solución lineal en rho (por defecto fd).\n");
+    fprintf(stderr, "  --multigrid <int>          Resuelve antes en nodes/2, nodes/4, ... (tantos niveles) y parte de esa\n");
+    fprintf(stderr, "                             solución (por defecto 0). Cada malla gruesa necesita dr <= sigma/4.\n");
+    fprintf(stderr, "\nBarrido de puntos de estado (cierres HNC y RY):\n");
+    fprintf(stderr, "  --sweep     <archivo>      Resuelve todos los puntos (volfactor temp) del archivo.\n");
+    fprintf(stderr, "                             Sustituye a --volfactor y --temp.\n");
+    fprintf(stderr, "  --threads   <int>          Hilos del barrido o de los potenciales 14 y 15 (por defecto uno por CPU).\n");
     fprintf(stderr, "\nEjemplo:\n");
     fprintf(stderr, "  %s--closure HNC --potential 7 --volfactor 0.2 --temp 1.0 --nodes 2048 --knodes 1024\n\n", prog_name);
 }
@@ -250,6 +323,19 @@ void print_potential_help(int potentialID) {
             printf("./facdes_solver --closure HNC --potential 16 --volfactor 0.2 --temp 1.0 --lambda_a 2.0 --lambda_r 5.0 --nodes 2048 --knodes 1024\n");
             break;
 
+        case 17: // TABULATED u(r)
+            printf("Potencial: TABULATED u(r)\n");
+            printf("Ecuación: U = u(r)/T, u(r) interpolado (Steffen) sobre la malla; 0 fuera de la tabla\n");
+            printf("Parámetros REQUERIDOS:\n");
+            printf("  --potential-file <archivo> : Tabla binaria de r, u(r) [y du/dr]\n");
+            printf("  --volfactor <double> : Factor de volumen\n");
+            printf("  --temp      <double> : Temperatura T*\n");
+            printf("  --nodes     <int>    : Nodos espaciales\n");
+            printf("  --knodes    <int>    : Nodos en espacio k\n");
+            printf("Ejemplo: \n");
+            printf("./facdes_solver --closure HNC --potential 17 --potential-file u.tab --volfactor 0.2 --temp 1.0 --nodes 4096 --knodes 1024\n");
+            break;
+
         default:
             printf("Potencial ID %d no tiene ayuda específica detallada aún.\n", potentialID);
             printf("Revise la lista general de potenciales.\n");
@@ -280,6 +366,15 @@ int main(int argc, char *argv[]) {
     double lambda_a = 0.0;
     double lambda_r = 0.0;
     double dipole_moment = 0.0;
+    double rmax_nonspherical = 10.0;
+    NonSphericalOptions ns_opts = default_nonspherical_options();
+    int adaptive_set = 0;
+    int mixing_set = 0;
+    const char *sweep_path = NULL;
+    const char *timing_path = NULL;
+    const char *telemetry_path = NULL;
+    const char *potential_file = NULL;
+    int n_threads = 0;
     
     // Parseo de argumentos de línea de comandos
     for (int i = 1; i < argc; i++) {
@@ -303,6 +398,124 @@ int main(int argc, char *argv[]) {
             nodesFacdes2Y = atoi(argv[++i]);
         } else if (strcmp(argv[i], "--knodes") == 0 && i + 1 < argc) {
             k_nodes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mixing") == 0 && i + 1 < argc) {
+            const char *scheme = argv[++i];
+            mixing_set = 1;
+            if (strcmp(scheme, "picard") == 0) ns_opts.mixing = MIXING_PICARD;
+            else if (strcmp(scheme, "anderson") == 0) ns_opts.mixing = MIXING_ANDERSON;
+            else {
+                fprintf(stderr, "Error: Esquema de mezcla no válido: %s\n", scheme);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--anderson-depth") == 0 && i + 1 < argc) {
+            ns_opts.anderson_depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mix-alpha") == 0 && i + 1 < argc) {
+            ns_opts.alpha = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--adaptive") == 0 && i + 1 < argc) {
+            ns_opts.adaptive_damping = atoi(argv[++i]);
+            adaptive_set = 1;
+        } else if (strcmp(argv[i], "--max-iter") == 0 && i + 1 < argc) {
+            ns_opts.max_iter = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tol") == 0 && i + 1 < argc) {
+            ns_opts.tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--mmax") == 0 && i + 1 < argc) {
+            ns_opts.mmax = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output-format") == 0 && i + 1 < argc) {
+            const char *format = argv[++i];
+            OZOutputFormat parsed;
+            if (oz_output_parse_format(format, &parsed) != 0) {
+                fprintf(stderr, "Error: Formato de salida no válido: %s\n", format);
+                return EXIT_FAILURE;
+            }
+            if (!oz_output_format_available(parsed)) {
+                fprintf(stderr, "Error: --output-format %s requiere compilar con 'make HDF5=1'.\n", format);
+                return EXIT_FAILURE;
+            }
+            outputFormat = parsed;
+            ns_opts.output_format = parsed;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cacheDir = argv[++i];
+            ns_opts.cache_dir = cacheDir;
+        } else if (strcmp(argv[i], "--potential-file") == 0 && i + 1 < argc) {
+            potential_file = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            ns_opts.checkpoint_interval = atoi(argv[++i]);
+            if (ns_opts.checkpoint_interval < 0) {
+                fprintf(stderr, "Error: El intervalo de --checkpoint no puede ser negativo.\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--hs-ref") == 0 && i + 1 < argc) {
+            const char *kind = argv[++i];
+            if (strcmp(kind, "py") == 0) ns_opts.hs_reference = HS_REFERENCE_PY;
+            else if (strcmp(kind, "vw") == 0) ns_opts.hs_reference = HS_REFERENCE_VW;
+            else {
+                fprintf(stderr, "Error: Referencia de esferas duras no válida: %s\n", kind);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--rmax") == 0 && i + 1 < argc) {
+            rmax_nonspherical = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--gpu") == 0 && i + 1 < argc) {
+            ns_opts.gpu = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mixed-precision") == 0 && i + 1 < argc) {
+            ns_opts.mixed_precision = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--dipole-split") == 0 && i + 1 < argc) {
+            ns_opts.dipole_split = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rmin") == 0 && i + 1 < argc) {
+            ns_opts.r_min = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--grid") == 0 && i + 1 < argc) {
+            const char *grid = argv[++i];
+            if (strcmp(grid, "uniform") == 0) ns_opts.grid = RADIAL_GRID_UNIFORM;
+            else if (strcmp(grid, "log") == 0) ns_opts.grid = RADIAL_GRID_LOG;
+            else {
+                fprintf(stderr, "Error: Malla radial no válida: %s\n", grid);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--sk-filon") == 0) {
+            filonOutput = 1;
+        } else if (strcmp(argv[i], "--timing") == 0 && i + 1 < argc) {
+            timing_path = argv[++i];
+        } else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            telemetry_path = argv[++i];
+        } else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) {
+            sweep_path = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            n_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ramp") == 0 && i + 1 < argc) {
+            const char *mode = argv[++i];
+            if (strcmp(mode, "fixed") == 0) rampMode = OZ_RAMP_FIXED;
+            else if (strcmp(mode, "adaptive") == 0) rampMode = OZ_RAMP_ADAPTIVE;
+            else {
+                fprintf(stderr, "Error: Rampa de densidad no válida: %s\n", mode);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--solver") == 0 && i + 1 < argc) {
+            const char *method = argv[++i];
+            if (strcmp(method, "ng") == 0) solverMode = OZ_SOLVER_NG;
+            else if (strcmp(method, "newton") == 0) solverMode = OZ_SOLVER_NEWTON;
+            else {
+                fprintf(stderr, "Error: Solver no válido: %s\n", method);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--thermo") == 0 && i + 1 < argc) {
+            const char *mode = argv[++i];
+            if (strcmp(mode, "fd") == 0) thermoMode = OZ_THERMO_FD;
+            else if (strcmp(mode, "linear") == 0) thermoMode = OZ_THERMO_LINEAR;
+            else {
+                fprintf(stderr, "Error: Derivada termodinámica no válida: %s\n", mode);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--multigrid") == 0 && i + 1 < argc) {
+            multigridLevels = atoi(argv[++i]);
+            if (multigridLevels < 0) {
+                fprintf(stderr, "Error: --multigrid requiere un número de niveles >= 0.\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--predictor") == 0 && i + 1 < argc) {
+            predictorOrder = atoi(argv[++i]);
+            if (predictorOrder != 1 && predictorOrder != 2) {
+                fprintf(stderr, "Error: El orden del predictor debe ser 1 o 2.\n");
+                return EXIT_FAILURE;
+            }
         } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
             print_usage(argv[0]);
             return EXIT_SUCCESS;
@@ -313,7 +526,11 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    // Validación de argumentos requeridos
+    // Validación de argumentos requeridos (en un barrido phi y T vienen del archivo)
+    if (sweep_path != NULL) {
+        if (volumeFactor == -1.0) volumeFactor = 0.0;
+        if (Temperature == -1.0) Temperature = 0.0;
+    }
     if (closure_str == NULL || potentialNumber == -1 || volumeFactor == -1.0 || 
         Temperature == -1.0 || nodesFacdes2Y == -1 || k_nodes == -1) {
         
@@ -329,6 +546,95 @@ int main(int argc, char *argv[]) {
     }
     
     
+    // Wall time of --timing: from here to the results on disk
+    double t_start = oz_time_now();
+
+    // Picard stalls on the log grid (residual ~5e-6 at max_iter): Anderson unless asked otherwise
+    if (!mixing_set && ns_opts.grid == RADIAL_GRID_LOG) ns_opts.mixing = MIXING_ANDERSON;
+    // Anderson is run with adaptive damping unless asked otherwise
+    if (!adaptive_set) ns_opts.adaptive_damping = (ns_opts.mixing == MIXING_ANDERSON);
+    if (ns_opts.anderson_depth < 0 || ns_opts.alpha <= 0.0 || ns_opts.max_iter <= 0 || ns_opts.tolerance <= 0.0 || \
+        ns_opts.mmax < 1) {
+        fprintf(stderr, "Error: Parámetros de iteración no válidos.\n");
+        return EXIT_FAILURE;
+    }
+    if (rmax_nonspherical <= 0.0) {
+        fprintf(stderr, "Error: --rmax debe ser > 0.\n");
+        return EXIT_FAILURE;
+    }
+    if (ns_opts.grid == RADIAL_GRID_LOG) {
+        if (potentialNumber != 14 || strcmp(closure_str, "RHNC") == 0) {
+            fprintf(stderr, "Error: --grid log solo está disponible para el potencial 14 (cierres MSA, LHNC y QHNC).\n");
+            return EXIT_FAILURE;
+        }
+        if (nodesFacdes2Y < 2 || (nodesFacdes2Y & (nodesFacdes2Y - 1)) != 0 || ns_opts.r_min <= 0.0 || \
+            ns_opts.r_min >= rmax_nonspherical) {
+            fprintf(stderr, "Error: --grid log requiere --nodes potencia de 2 y 0 < --rmin < --rmax.\n");
+            return EXIT_FAILURE;
+        }
+        if (ns_opts.dipole_split) {
+            fprintf(stderr, "Error: --dipole-split requiere la malla uniforme (--grid uniform).\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (ns_opts.gpu) {
+        if (potentialNumber != 15) {
+            fprintf(stderr, "Error: --gpu solo está disponible para el potencial 15.\n");
+            return EXIT_FAILURE;
+        }
+        if (!mode2_gpu_available()) {
+            fprintf(stderr, "Error: --gpu requiere compilar con make CUDA=1 y un dispositivo CUDA.\n");
+            return EXIT_FAILURE;
+        }
+        if (ns_opts.dipole_split) {
+            fprintf(stderr, "Error: --dipole-split no está disponible con --gpu.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (ns_opts.mixed_precision < 0.0 || (ns_opts.mixed_precision > 0.0 && potentialNumber != 15)) {
+        fprintf(stderr, "Error: --mixed-precision debe ser >= 0 y solo está disponible para el potencial 15.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (potentialNumber == 17 && potential_file == NULL) {
+        fprintf(stderr, "Error: El potencial 17 requiere --potential-file.\n");
+        return EXIT_FAILURE;
+    }
+    if (potential_file != NULL) {
+        if (potentialNumber != 17) {
+            fprintf(stderr, "Error: --potential-file solo está disponible para el potencial 17.\n");
+            return EXIT_FAILURE;
+        }
+        // Stays mapped until the process exits
+        potentialTable = oz_potential_table_open(potential_file);
+        if (potentialTable == NULL) return EXIT_FAILURE;
+    }
+
+    if (sweep_path != NULL && (potentialNumber == 14 || potentialNumber == 15)) {
+        fprintf(stderr, "Error: --sweep solo está disponible para potenciales esféricos.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (telemetry_path != NULL) {
+        if (oz_telemetry_open(telemetry_path) != 0) {
+            fprintf(stderr, "Error: No se pudo crear el archivo de telemetría %s.\n", telemetry_path);
+            return EXIT_FAILURE;
+        }
+        atexit(close_telemetry);
+    }
+
+    // The non-spherical solvers split projections and grid points among OpenMP threads
+    if (potentialNumber == 14 || potentialNumber == 15) {
+#ifdef _OPENMP
+        if (n_threads > 0) omp_set_num_threads(n_threads);
+        printf("Hilos OpenMP: %d\n", omp_get_max_threads());
+#else
+        if (n_threads > 1) fprintf(stderr, "Aviso: compilado sin OpenMP (make OPENMP=0); --threads se ignora.\n");
+#endif
+    }
+
     // Check for Dipolar Solver
     if (potentialNumber == 14) {
         if (dipole_moment <= 0.0) {
@@ -352,7 +658,14 @@ int main(int argc, char *argv[]) {
         double rho = 6.0 * volumeFactor / M_PI;
 
         // Call the new solver
-        solver_dipolar(closure_id_int, Temperature, rho, dipole_moment, nodesFacdes2Y, 10.0, "output"); // hardcoded rmax for now
+        int status = solver_dipolar(closure_id_int, Temperature, rho, dipole_moment, nodesFacdes2Y, rmax_nonspherical, \
+                                    "output", &ns_opts);
+        write_timing(timing_path, t_start);
+        if (status != 0) {
+            fprintf(stderr, "Error: El solver dipolar no convergió (--tol %g, --max-iter %d; pruebe --mixing anderson).\n", \
+                    ns_opts.tolerance, ns_opts.max_iter);
+            return EXIT_FAILURE;
+        }
         return EXIT_SUCCESS;
     }
 
@@ -370,7 +683,8 @@ int main(int argc, char *argv[]) {
         else if (strcmp(closure_str, "MSA") == 0) closure_id_int = 0;
         
         double rho = 6.0 * volumeFactor / M_PI;
-        solver_mode2_core(closure_id_int, Temperature, rho, dipole_moment, nodesFacdes2Y, 10.0, "output");
+        solver_mode2_core(closure_id_int, Temperature, rho, dipole_moment, nodesFacdes2Y, rmax_nonspherical, "output", &ns_opts);
+        write_timing(timing_path, t_start);
         return EXIT_SUCCESS;
     }
 
@@ -379,6 +693,12 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    if (!oz_fft_size_supported(nodesFacdes2Y)) {
+        fprintf(stderr, "Error: --nodes %d no es potencia de 2; compile con 'make FFT=fftw' para usar cualquier número de nodos.\n",
+                nodesFacdes2Y);
+        return EXIT_FAILURE;
+    }
+
     // Preparación del vector k (espacio de Fourier)
     gsl_vector *k_vec = gsl_vector_alloc(k_nodes);
     if (k_vec == NULL) {
@@ -413,6 +733,40 @@ int main(int argc, char *argv[]) {
         gsl_vector_set(r_vec, i, r_min + i * dr);
     }
     
+    if (sweep_path != NULL) {
+        StatePoint *points = NULL;
+        int n_points = 0;
+        int status = read_sweep_file(sweep_path, &points, &n_points);
+
+        if (status == 0) {
+            char output_path[256];
+            snprintf(output_path, sizeof(output_path), "output/sweep_%s%s", closure_str, oz_output_extension(outputFormat));
+
+            SweepConfig cfg;
+            cfg.potentialID = potentialNumber;
+            cfg.closureID = (strcmp(closure_str, "HNC") == 0) ? 2 : 3;
+            cfg.Temperature2 = Temperature2;
+            cfg.lambda_a = lambda_a;
+            cfg.lambda_r = lambda_r;
+            cfg.nodes = nodesFacdes2Y;
+            cfg.n_threads = n_threads;
+            cfg.k_out = k_vec->data;
+            cfg.r_out = r_vec->data;
+            cfg.n_out = k_nodes;
+            cfg.output_path = output_path;
+            cfg.output_format = outputFormat;
+            cfg.cache_dir = cacheDir;
+
+            status = run_sweep(points, n_points, &cfg);
+            free(points);
+            if (status == 0) write_timing(timing_path, t_start);
+        }
+
+        gsl_vector_free(k_vec);
+        gsl_vector_free(r_vec);
+        return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     // Vector de salida para S(k)
     double *sk_output = malloc(k_nodes * sizeof(double));
     if (sk_output == NULL) {
@@ -436,26 +790,27 @@ int main(int argc, char *argv[]) {
     printf("Cierre: %s, Potencial: %d, phi: %.4f, T: %.4f, N_calc: %d, N_k: %d\n", 
            closure_str, potentialNumber, volumeFactor, Temperature, nodesFacdes2Y, k_nodes);
 
-    // Llamada a las funciones correspondientes
+    // Una sola resolución da S(k), g(r) y la termodinámica
+    OZThermo thermo;
+    OZAllocStats alloc;
+    printf("\n# Calculando S(k) y g(r)...\n");
     if (strcmp(closure_str, "HNC") == 0) {
-        printf("\n# Calculando S(k)...\n");
-        sk_HNC(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, 
-               k_vec, sk_output, potentialNumber, nodesFacdes2Y);
-        
-        printf("\n# Calculando g(r)...\n");
-        gr_HNC(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, 
-               r_vec, gr_output, potentialNumber, nodesFacdes2Y);
+        all_HNC(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, 
+                k_vec, r_vec, NULL, NULL, sk_output, gr_output, &thermo, &alloc, potentialNumber, nodesFacdes2Y);
     } else { // Cierre "RY"
-        printf("\n# Calculando S(k)...\n");
-        sk_RY(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, 
-              k_vec, sk_output, potentialNumber, nodesFacdes2Y);
-        
-        printf("\n# Calculando g(r)...\n");
-        gr_RY(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, 
-              r_vec, gr_output, potentialNumber, nodesFacdes2Y);
+        all_RY(volumeFactor, Temperature, Temperature2, lambda_a, lambda_r, 
+               k_vec, r_vec, NULL, NULL, sk_output, gr_output, &thermo, &alloc, potentialNumber, nodesFacdes2Y);
     }
 
-    
+    printf("Termodinámica: rho = %.6f  betaP (virial) = %.6f  1 - rho c(0) = %.6f  betaU/N = %.6f  alpha = %.6f\n",
+           thermo.rho, thermo.pressure, thermo.chic, thermo.energy, thermo.alpha);
+    if (isfinite(thermo.chiv)) {
+        printf("Respuesta lineal: d(betaP)/drho = %.6f\n", thermo.chiv);
+    }
+    printf("Memoria de trabajo: %.1f KiB, %zu buffers del arena, %zu reservas en el heap\n",
+           alloc.high_water_bytes / 1024.0, alloc.arena_allocs, alloc.heap_allocs);
+    write_timing(timing_path, t_start);
+
     // Liberar memoria
     free(sk_output);
     free(gr_output);
@@ -1,201 +1,239 @@
 #include "math_aux.h"
+#include "oz_timing.h"
+#include <gsl/gsl_spline.h>
+#include <string.h>
 
-void pp(double dr, double *matrix1, double *matrix2, double *prod) {
+void pp_ctx(const OZContext *ctx, double dr, double *matrix1, double *matrix2, double *prod) {
 
     int k, i;
     double average;
 
-    for (k = 0; k < ncols; k++) {
+    for (k = 0; k < ctx->ncols; k++) {
 
         prod[k] = 0.0;
         
-        for (i = 1; i < (nrows-1); i++) {
+        for (i = 1; i < (ctx->nrows-1); i++) {
         
-            prod[k] += matrix1[i*ncols + k] * matrix2[i*ncols + k];
+            prod[k] += matrix1[i + k*ctx->nrows] * matrix2[i + k*ctx->nrows];
         
         }
         
-        average = (matrix1[0*ncols + k] * matrix2[0*ncols + k]);
-        average += (matrix1[(nrows-1)*ncols + k] * matrix2[(nrows-1)*ncols + k]);
+        average = (matrix1[k*ctx->nrows] * matrix2[k*ctx->nrows]);
+        average += (matrix1[ctx->nrows-1 + k*ctx->nrows] * matrix2[ctx->nrows-1 + k*ctx->nrows]);
         average *= 0.5;
 
         prod[k] = (prod[k] + average) * dr;
     }
 }
 
-void ONg(double *gammaInput, double *gammaOutput, int potentialID, int closureID, double *cFuncMatrix, \
-         double T, double Tfin, double alpha, double rmax) {
+void pp(double dr, double *matrix1, double *matrix2, double *prod) {
+    OZContext ctx = oz_legacy_context();
+    pp_ctx(&ctx, dr, matrix1, matrix2, prod);
+}
+
+void ONg_ctx(const OZContext *ctx, double *gammaInput, double *gammaOutput, int potentialID, int closureID, \
+             double *cFuncMatrix, double T, double Tfin, double alpha) {
     
-    int i, k;
+    int i;
     double sqmax, delta;
     double *S, *Ck;
 
-    Ck = malloc(nrows*ncols * sizeof(double));
-    S  = malloc(nrows*ncols * sizeof(double));
+    size_t mark = oz_mark(ctx);
+    Ck = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    S  = oz_alloc(ctx, ctx->nrows*ctx->ncols);
 
     if (S == NULL || Ck == NULL) {
         printf("Memory allocation failed 6.\n");
+        oz_free(ctx, Ck);
+        oz_free(ctx, S);
+        oz_release(ctx, mark);
         return; // Exit with an error code
     }
 
     // closrel modifica la matriz cFuncMatrix que se declara en OZ2
-    closrel(gammaInput, potentialID, closureID, cFuncMatrix, T, alpha);
+    double t0 = oz_time_now();
+    closrel_ctx(ctx, gammaInput, potentialID, closureID, cFuncMatrix, T, alpha);
+    oz_timing_stop(OZ_PHASE_CLOSURE, t0);
     //printf("%1.9e\n", cFuncMatrix[0]);
     // Se calcula la transformada seno de cada columna de cFuncMatrix
     // El 1 como último argumento en FFTM indica que es la transformada normal (no inversa)
     // NOTA: se sobreescriben los datos de la matriz cFuncMatrix
-    FFTM(cFuncMatrix, rmax, 1);
+    t0 = oz_time_now();
+    FFTM_ctx(ctx, cFuncMatrix, 1);
+    oz_timing_stop(OZ_PHASE_TRANSFORM, t0);
 
     // Almacenamos los resultados de cFuncMatrix en Ck, ya que volveremos a sobreescribir las
     // entradas de cFuncMatrix más adelante.
-    for (i = 0; i < nrows; i++) {
-        for (k = 0; k < ncols; k++) {
-            Ck[i*ncols + k] = cFuncMatrix[i*ncols + k];
-        }
-    }
+    memcpy(Ck, cFuncMatrix, (size_t) ctx->nrows*ctx->ncols * sizeof(double));
 /*
-    for (i=0; i<nrows; i++){
-        printf("%d\t%.15e\t%.15e\t%.15e\n", i, Ck[i*ncols + 0], Ck[i*ncols + 1], Ck[i*ncols + 2]);
+    for (i=0; i<ctx->nrows; i++){
+        printf("%d\t%.15e\t%.15e\t%.15e\n", i, Ck[i + 0*ctx->nrows], Ck[i + 1*ctx->nrows], Ck[i + 2*ctx->nrows]);
     }
 */
     // NOTA: Aunque hallamos puesto la variable ncols como global
     // la siguiente estructura sólo contempla el valor de ncols = 3
-    for (i = 0; i < nrows; i++) {
-        delta = (1.0 - rho*x[0]*Ck[i*ncols + 0]) * \
-                (1.0 - rho*x[1]*Ck[i*ncols + 2]);
-        delta -= pow(rho, 2.0)*x[0]*x[1] * \
-                 pow(Ck[i*ncols + 1], 2.0);
-
-        gammaOutput[i*ncols + 0] = (1.0 - rho*x[1] * Ck[i*ncols + 2]) * Ck[i*ncols + 0];
-        gammaOutput[i*ncols + 0] = (gammaOutput[i*ncols + 0] + \
-                                    rho*x[1] * pow(Ck[i*ncols + 1], 2.0)) / \
+    t0 = oz_time_now();
+    for (i = 0; i < ctx->nrows; i++) {
+        delta = (1.0 - ctx->rho*ctx->x[0]*Ck[i + 0*ctx->nrows]) * \
+                (1.0 - ctx->rho*ctx->x[1]*Ck[i + 2*ctx->nrows]);
+        delta -= pow(ctx->rho, 2.0)*ctx->x[0]*ctx->x[1] * \
+                 pow(Ck[i + 1*ctx->nrows], 2.0);
+
+        gammaOutput[i + 0*ctx->nrows] = (1.0 - ctx->rho*ctx->x[1] * Ck[i + 2*ctx->nrows]) * Ck[i + 0*ctx->nrows];
+        gammaOutput[i + 0*ctx->nrows] = (gammaOutput[i + 0*ctx->nrows] + \
+                                    ctx->rho*ctx->x[1] * pow(Ck[i + 1*ctx->nrows], 2.0)) / \
                                     delta;
-        gammaOutput[i*ncols + 0] = gammaOutput[i*ncols + 0] - Ck[i*ncols + 0];
-        gammaOutput[i*ncols + 1] = Ck[i*ncols + 1] / delta - Ck[i*ncols + 1];
-        gammaOutput[i*ncols + 2] = (1.0 - rho*x[0] * Ck[i*ncols + 0]) * Ck[i*ncols + 2];
-        gammaOutput[i*ncols + 2] = (gammaOutput[i*ncols + 2] + rho*x[0] * pow(Ck[i*ncols + 1], 2.0)) / delta;
-        gammaOutput[i*ncols + 2] = gammaOutput[i*ncols + 2] - Ck[i*ncols + 2];
+        gammaOutput[i + 0*ctx->nrows] = gammaOutput[i + 0*ctx->nrows] - Ck[i + 0*ctx->nrows];
+        gammaOutput[i + 1*ctx->nrows] = Ck[i + 1*ctx->nrows] / delta - Ck[i + 1*ctx->nrows];
+        gammaOutput[i + 2*ctx->nrows] = (1.0 - ctx->rho*ctx->x[0] * Ck[i + 0*ctx->nrows]) * Ck[i + 2*ctx->nrows];
+        gammaOutput[i + 2*ctx->nrows] = (gammaOutput[i + 2*ctx->nrows] + ctx->rho*ctx->x[0] * pow(Ck[i + 1*ctx->nrows], 2.0)) / delta;
+        gammaOutput[i + 2*ctx->nrows] = gammaOutput[i + 2*ctx->nrows] - Ck[i + 2*ctx->nrows];
     }
+    oz_timing_stop(OZ_PHASE_OZ, t0);
 
     // Se calcula la transformada seno INVERSA de cada columna de gammaOutput
     // El -1 como último argumento en FFTM indica que es la transformada inversa
     // NOTA: se sobreescriben los datos de la matriz cFuncMatrix
 
-    FFTM(gammaOutput, rmax, -1);
+    t0 = oz_time_now();
+    FFTM_ctx(ctx, gammaOutput, -1);
+    oz_timing_stop(OZ_PHASE_TRANSFORM, t0);
 /*
-    for (i=0; i<nrows; i++){
-        printf("%d\t%.15e\n", i, gammaOutput[i*ncols + 0]);
+    for (i=0; i<ctx->nrows; i++){
+        printf("%d\t%.15e\n", i, gammaOutput[i + 0*ctx->nrows]);
     }
 */
-    closrel(gammaOutput, potentialID, closureID, cFuncMatrix, T, alpha);
+    t0 = oz_time_now();
+    closrel_ctx(ctx, gammaOutput, potentialID, closureID, cFuncMatrix, T, alpha);
+    oz_timing_stop(OZ_PHASE_CLOSURE, t0);
 /*
-    for (i=0; i<nrows; i++){
-        printf("%d\t%.15e\t%.15e\t%.15e\n", i, cFuncMatrix[i*ncols + 0], cFuncMatrix[i*ncols + 1], cFuncMatrix[i*ncols + 2]);
+    for (i=0; i<ctx->nrows; i++){
+        printf("%d\t%.15e\t%.15e\t%.15e\n", i, cFuncMatrix[i + 0*ctx->nrows], cFuncMatrix[i + 1*ctx->nrows], cFuncMatrix[i + 2*ctx->nrows]);
     }
 */
 /*
-    for (i=0; i<nrows; i++){
-        printf("%d\t%.15e\t%.15e\t%.15e\n", i, gammaOutput[i*ncols + 0], gammaOutput[i*ncols + 1], gammaOutput[i*ncols + 2]);
+    for (i=0; i<ctx->nrows; i++){
+        printf("%d\t%.15e\t%.15e\t%.15e\n", i, gammaOutput[i + 0*ctx->nrows], gammaOutput[i + 1*ctx->nrows], gammaOutput[i + 2*ctx->nrows]);
     }
 */
 
     if (Tfin < 1.0) {
-        free(Ck);
-        free(S);
+        oz_free(ctx, Ck);
+        oz_free(ctx, S);
+        oz_release(ctx, mark);
 
         return;
     }
 
-    for (i = 0; i < nrows; i++) {
-        delta = (1.0 - rho*x[0] * Ck[i*ncols + 0]) * (1.0 - rho*x[1] * Ck[i*ncols + 2]);
-        delta -= pow(rho, 2.0) * x[0]*x[1] * pow(Ck[i*ncols + 1], 2.0);
+    for (i = 0; i < ctx->nrows; i++) {
+        delta = (1.0 - ctx->rho*ctx->x[0] * Ck[i + 0*ctx->nrows]) * (1.0 - ctx->rho*ctx->x[1] * Ck[i + 2*ctx->nrows]);
+        delta -= pow(ctx->rho, 2.0) * ctx->x[0]*ctx->x[1] * pow(Ck[i + 1*ctx->nrows], 2.0);
 
-        S[i*ncols + 0] = (1.0 - rho*x[1] * Ck[i*ncols + 2]) * Ck[i*ncols + 0];
-        S[i*ncols + 0] = (S[i*ncols + 0] + rho*x[1] * pow(Ck[i*ncols + 1], 2.0)) / delta;
-        S[i*ncols + 1] = Ck[i*ncols + 1] / delta;
-        S[i*ncols + 2] = (1.0 - rho*x[0] * Ck[i*ncols + 0]) * Ck[i*ncols + 2];
-        S[i*ncols + 2] = (S[i*ncols + 2] + rho*x[0] * pow(Ck[i*ncols + 1], 2.0)) / delta;
-        S[i*ncols + 0] = x[0] + rho*pow(x[0], 2.0) * S[i*ncols + 0];
-        S[i*ncols + 1] = rho * x[0]*x[1] * S[i*ncols + 1];
-        S[i*ncols + 2] = x[1] + rho*pow(x[1], 2.0) * S[i*ncols + 2];
+        S[i + 0*ctx->nrows] = (1.0 - ctx->rho*ctx->x[1] * Ck[i + 2*ctx->nrows]) * Ck[i + 0*ctx->nrows];
+        S[i + 0*ctx->nrows] = (S[i + 0*ctx->nrows] + ctx->rho*ctx->x[1] * pow(Ck[i + 1*ctx->nrows], 2.0)) / delta;
+        S[i + 1*ctx->nrows] = Ck[i + 1*ctx->nrows] / delta;
+        S[i + 2*ctx->nrows] = (1.0 - ctx->rho*ctx->x[0] * Ck[i + 0*ctx->nrows]) * Ck[i + 2*ctx->nrows];
+        S[i + 2*ctx->nrows] = (S[i + 2*ctx->nrows] + ctx->rho*ctx->x[0] * pow(Ck[i + 1*ctx->nrows], 2.0)) / delta;
+        S[i + 0*ctx->nrows] = ctx->x[0] + ctx->rho*pow(ctx->x[0], 2.0) * S[i + 0*ctx->nrows];
+        S[i + 1*ctx->nrows] = ctx->rho * ctx->x[0]*ctx->x[1] * S[i + 1*ctx->nrows];
+        S[i + 2*ctx->nrows] = ctx->x[1] + ctx->rho*pow(ctx->x[1], 2.0) * S[i + 2*ctx->nrows];
     }
 
     sqmax = 0.0;
 
 //    FILE *outFile = fopen("Sq2.out", "w");
-    for (i = 0; i < nrows; i++) {
+    for (i = 0; i < ctx->nrows; i++) {
 
-//        fprintf(outFile, "%.17e \t %.17e \t %.17e \t %.17e \n", q[i], S[i*ncols + 0], S[i*ncols + 1], S[i*ncols + 2]);
+//        fprintf(outFile, "%.17e \t %.17e \t %.17e \t %.17e \n", q[i], S[i + 0*ctx->nrows], S[i + 1*ctx->nrows], S[i + 2*ctx->nrows]);
         
-        if (S[i*ncols + 0] > sqmax) {
-            sqmax = S[i*ncols + 0];
+        if (S[i + 0*ctx->nrows] > sqmax) {
+            sqmax = S[i + 0*ctx->nrows];
         }
     }
 //    fclose(outFile);
 
-    printf(" sqmax = %.17lf \r", sqmax);
-    fflush(stdout);
+    oz_log(ctx, " sqmax = %.17lf \r", sqmax);
+    if (ctx->verbose) fflush(stdout);
 
-    free(Ck);
-    free(S);
+    oz_free(ctx, Ck);
+    oz_free(ctx, S);
+    oz_release(ctx, mark);
+}
+
+void ONg(double *gammaInput, double *gammaOutput, int potentialID, int closureID, double *cFuncMatrix, \
+         double T, double Tfin, double alpha, double rmax) {
+    OZContext ctx = oz_legacy_context();
+    ctx.rmax = rmax;
+    ONg_ctx(&ctx, gammaInput, gammaOutput, potentialID, closureID, cFuncMatrix, T, Tfin, alpha);
 }
 
 // ##############################################################################################################
 
-void Extrap(double *gammaOut, double *gammaIn, double rho, double drho) {
+void Extrap_ctx(const OZContext *ctx, double *gammaOut, double *gammaIn, double rho, double drho) {
 
     int i, k;
     double a, b;
 
-    for (k = 0; k < ncols; k++) {
-        for (i = 0; i < nrows; i++) {
-            a = (gammaIn[i*ncols + k] - gammaOut[i*ncols + k]) / drho;
-            b = gammaIn[i*ncols + k] - a*rho;
-            gammaOut[i*ncols + k] = a*(rho + drho) + b;
+    for (k = 0; k < ctx->ncols; k++) {
+        for (i = 0; i < ctx->nrows; i++) {
+            a = (gammaIn[i + k*ctx->nrows] - gammaOut[i + k*ctx->nrows]) / drho;
+            b = gammaIn[i + k*ctx->nrows] - a*rho;
+            gammaOut[i + k*ctx->nrows] = a*(rho + drho) + b;
         }
     }
 }
 
-void interp(int m, int n, double *r1, double *gammaInput, double *gammaOutput) {
+void Extrap(double *gammaOut, double *gammaIn, double rho, double drho) {
+    OZContext ctx = oz_legacy_context();
+    Extrap_ctx(&ctx, gammaOut, gammaIn, rho, drho);
+}
+
+// gammaInput has m rows and gammaOutput n rows, each column contiguous
+void interp_ctx(const OZContext *ctx, int m, int n, double *r1, double *gammaInput, double *gammaOutput) {
     
     int i, j, k;
-    double a[nrows], b[nrows];
+    double a[ctx->nrows], b[ctx->nrows];
 
-    for (k = 0; k < ncols; k++) {
+    for (k = 0; k < ctx->ncols; k++) {
         for (i = 0; i < (m-1); i++) {
-            a[i] = (gammaInput[(i+1)*ncols + k] - gammaInput[i*ncols + k]) / (r1[i+1] - r1[i]);
-            b[i] = gammaInput[(i+1)*ncols + k] - a[i] * r1[i+1];
+            a[i] = (gammaInput[i+1 + k*m] - gammaInput[i + k*m]) / (r1[i+1] - r1[i]);
+            b[i] = gammaInput[i+1 + k*m] - a[i] * r1[i+1];
         }
         for (j = 0; j < (m-1); j++) {
             for (i = ((j*n)/m); i < (((j+1)*n) / m); i++) {
-                gammaOutput[i*ncols + k] = a[j] * r[i] + b[j];
+                gammaOutput[i + k*n] = a[j] * ctx->r[i] + b[j];
             }
         }
         for (i = n-(n/m); i < n; i++) {
-            gammaOutput[i*ncols + k] = gammaOutput[(n-(n/m))*ncols + k];
+            gammaOutput[i + k*n] = gammaOutput[(n-(n/m)) + k*n];
         }
     }
 }
 
+void interp(int m, int n, double *r1, double *gammaInput, double *gammaOutput) {
+    OZContext ctx = oz_legacy_context();
+    interp_ctx(&ctx, m, n, r1, gammaInput, gammaOutput);
+}
 
-void Pres(double *f, double dr, double *eta) {
+
+void Pres_ctx(const OZContext *ctx, double *f, double dr, double *eta) {
 
     int i, k;
     double sum, average;
 
     *eta = 0.0;
 
-    for (k = 0; k < ncols; k++) {
+    for (k = 0; k < ctx->ncols; k++) {
         
         sum = 0.0;
         
-        for (i = 1; i < (nrows-1); i++) {
+        for (i = 1; i < (ctx->nrows-1); i++) {
 
-            sum += pow(f[i*ncols + k], 2.0);
+            sum += pow(f[i + k*ctx->nrows], 2.0);
 
         }
-        average = pow(f[0*ncols + k], 2.0) + \
-                  pow(f[(nrows-1)*ncols + k], 2.0);
+        average = pow(f[k*ctx->nrows], 2.0) + \
+                  pow(f[ctx->nrows-1 + k*ctx->nrows], 2.0);
         average *= 0.5;
 
         sum += average;
@@ -206,8 +244,13 @@ void Pres(double *f, double dr, double *eta) {
     *eta = sqrt(*eta);
 }
 
+void Pres(double *f, double dr, double *eta) {
+    OZContext ctx = oz_legacy_context();
+    Pres_ctx(&ctx, f, dr, eta);
+}
 
-void FFTM(double *inputDataMatrix, double rmax, int isDirect) {
+
+void FFTM_ctx(const OZContext *ctx, double *inputDataMatrix, int isDirect) {
 
     /* Este función se llama FFTM por Fast Fourier Transfor Matrix
        y calcula la transformada de fourier de una matriz, pero lo hace
@@ -221,123 +264,321 @@ void FFTM(double *inputDataMatrix, double rmax, int isDirect) {
 
        OJO: Esta función YA es aplicable a cualquier matriz aunque
             manualmente se introduce el número de columnas, que es ncols.
+            Las columnas son contiguas: el elemento (i, k) está en [i + k*nrows].
     */
 
     int i, k;
-    double *tempVector;  //JJ:Este es un vector temporal para realizar la FFT
-
-    // Allocate memory for an array of nrows doubles
-    tempVector = malloc(nrows * sizeof(double));
+    double a;
+    double *col;
 
-    // Check if memory allocation was successful
-    if (tempVector == NULL) {
-        printf("Memory allocation failed 8.\n");
-        return; // Exit with an error code
+    // Each column is contiguous, so the transforms run in place.
+    // Sin plan (envoltorios antiguos) se transforma columna por columna
+    if (ctx->fft == NULL) {
+        for (i = 0; i < ctx->ncols; i++) {
+            FFT_ctx(ctx, inputDataMatrix + (size_t) i*ctx->nrows, isDirect);
+        }
+        return;
     }
 
-    for (i = 0; i < ncols; i++) {
-        //JJ:Guarda cada columna de inputDataMatrix en tempVector
-        for (k = 0; k < nrows; k++) {
-            tempVector[k] = inputDataMatrix[k*ncols + i];
+    // With a plan all columns go through the backend at once; the scaling
+    // is the one of FFT_ctx
+    for (i = 0; i < ctx->ncols; i++) {
+        col = inputDataMatrix + (size_t) i*ctx->nrows;
+        for (k = 0; k < ctx->nrows; k++) {
+            col[k] *= k;
         }
+    }
 
-        //JJ:Le calcula la transformada de FFT a tempVector
-        FFT(tempVector, rmax, isDirect);
+    oz_fft_sine(ctx->fft, inputDataMatrix, ctx->fft_double);
 
-/*
-        for (k=0; k<nrows; k++){
-            printf("%d\t%.15e\n", k, tempVector[k]);
-        }
-*/
+    if (isDirect == 1) {
+        a = 4.0 * pow(ctx->rmax, 3.0) / (1.0 * ctx->nrows*ctx->nrows);
+    } else {
+        a = ctx->nrows * (1.0 / (2.0 * pow(ctx->rmax, 3.0)));
+    }
 
-        //JJ:El resultado lo guarda en inputDataMatrix de regreso
-        for (k = 0; k < nrows; k++) {
-            inputDataMatrix[k*ncols + i] = tempVector[k];
+    for (i = 0; i < ctx->ncols; i++) {
+        col = inputDataMatrix + (size_t) i*ctx->nrows;
+        if (isDirect == 1) col[0] = 0.0;
+        for (k = 1; k < ctx->nrows; k++) {
+            col[k] = a * col[k] / (1.0 * k);
         }
     }
+}
 
-    free(tempVector);
+void FFTM(double *inputDataMatrix, double rmax, int isDirect) {
+    OZContext ctx = oz_legacy_context();
+    ctx.rmax = rmax;
+    FFTM_ctx(&ctx, inputDataMatrix, isDirect);
 }
 
 
-double calint(double *f, double dr) {
+double calint_ctx(const OZContext *ctx, double *f, double dr) {
     
     double rint = 0.0;
     
-    for (int i = 1; i < (nrows-1); i++) {
+    for (int i = 1; i < (ctx->nrows-1); i++) {
         rint += f[i];
     }
 
-    rint = dr * (rint + (f[0] + f[nrows-1]) / 2.0);
+    rint = dr * (rint + (f[0] + f[ctx->nrows-1]) / 2.0);
     
     return rint;
 }
 
+double calint(double *f, double dr) {
+    OZContext ctx = oz_legacy_context();
+    return calint_ctx(&ctx, f, dr);
+}
 
-void intt(double *h, double dr, double *sft) {
-    
-    double *f;
-
-    // Allocate memory for an array of nrows doubles
-    f = malloc(nrows * sizeof(double));
-
-    // Check if memory allocation was successful
-    if (f == NULL) {
-        printf("Memory allocation failed 9.\n");
-        return; // Exit with an error code
-    }
-    
-    for (int k = 0; k < ncols; k++) {
-        for (int i = 0; i < nrows; i++) {
 
-            f[i] = h[i*ncols + k];
-        }
+void intt_ctx(const OZContext *ctx, double *h, double dr, double *sft) {
 
-        sft[k] = calint(f, dr);
+    // Each column of h is contiguous, so calint_ctx reads it in place
+    for (int k = 0; k < ctx->ncols; k++) {
+        sft[k] = calint_ctx(ctx, h + (size_t) k*ctx->nrows, dr);
     }
+}
 
-    free(f);
+void intt(double *h, double dr, double *sft) {
+    OZContext ctx = oz_legacy_context();
+    intt_ctx(&ctx, h, dr, sft);
 }
 
 
-void FT(double *c, double *c1, double *rk, double dr) {
+void FT_ctx(const OZContext *ctx, double *c, double *c1, double *rk, double dr) {
 
     int i, j, k;
     double *ca, *sft;
 
+    size_t mark = oz_mark(ctx);
     // Allocate memory for an array of nrows doubles
-    ca = malloc(nrows*ncols * sizeof(double));
-    sft = malloc(ncols * sizeof(double));
+    ca = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    sft = oz_alloc(ctx, ctx->ncols);
 
     // Check if memory allocation was successful
     if (ca == NULL || sft == NULL) {
         printf("Memory allocation failed 10.\n");
+        oz_free(ctx, ca);
+        oz_free(ctx, sft);
+        oz_release(ctx, mark);
         return; // Exit with an error code
     }
     
-    for (i = 0; i < nrows; i++) {
+    for (i = 0; i < ctx->nrows; i++) {
         
-        for (k = 0; k < ncols; k++) {
-            for (j = 0; j < nrows; j++) {
+        for (k = 0; k < ctx->ncols; k++) {
+            for (j = 0; j < ctx->nrows; j++) {
 
-                ca[j*ncols + k] = r[j] * c[j*ncols + k] * sin(rk[i] * r[j]);
+                ca[j + k*ctx->nrows] = ctx->r[j] * c[j + k*ctx->nrows] * sin(rk[i] * ctx->r[j]);
             
             }
         }
 
-        intt(ca, dr, sft);
+        intt_ctx(ctx, ca, dr, sft);
 
-        for (int k = 0; k < ncols; k++) {
-            c1[i*ncols + k] = 4.0 * M_PI * sft[k] / rk[i];
+        for (int k = 0; k < ctx->ncols; k++) {
+            c1[i + k*ctx->nrows] = 4.0 * M_PI * sft[k] / rk[i];
         }
     }
 
-    free(ca);
-    free(sft);
+    oz_free(ctx, ca);
+    oz_free(ctx, sft);
+    oz_release(ctx, mark);
 }
 
+void FT(double *c, double *c1, double *rk, double dr) {
+    OZContext ctx = oz_legacy_context();
+    FT_ctx(&ctx, c, c1, rk, dr);
+}
 
-void FFT(double *inputData, double rmax, int isDirect) {
+
+/**
+ * @brief Fast version of FT_ctx for monotonic k grids.
+ *
+ * Same trapezoid rule as FT_ctx, 4*PI/k * int r c(r) sin(kr) dr, but the
+ * sine sums are evaluated for all k at once with one zero-padded sinft
+ * per column and then spline-interpolated onto rk. Cost O(N log N + nk)
+ * instead of O(N * nk). The padded transform runs on ctx->fft_pad (any
+ * nrows the backend supports; a power of 2 without a plan).
+ *
+ * @param ctx Solver context (grids, potential tables, density).
+ * @param c Input matrix [nrows*ncols] in r, columns contiguous.
+ * @param c1 Output matrix [nk*ncols] on rk, column k at c1 + k*nk.
+ * @param rk Increasing wave vectors, 0 <= rk <= PI/dr.
+ * @param nk Number of wave vectors.
+ */
+void FT_fast_ctx(const OZContext *ctx, double *c, double *c1, double *rk, int nk) {
+
+    int i, j, k, m;
+    int M = FT_PAD * ctx->nrows;
+    double dkPad = M_PI / (M * ctx->dr);
+    double *y, *kPad, *fPad;
+
+    // Only the part of the padded grid that covers rk goes into the spline
+    m = (int) ceil(rk[nk-1] / dkPad) + 4;
+    if (m > M) m = M;
+    if (m < 4) m = 4;
+
+    size_t mark = oz_mark(ctx);
+    y    = oz_alloc(ctx, M);
+    kPad = oz_alloc(ctx, m);
+    fPad = oz_alloc(ctx, m);
+
+    if (y == NULL || kPad == NULL || fPad == NULL) {
+        printf("Memory allocation failed in FT_fast.\n");
+        oz_free(ctx, y);
+        oz_free(ctx, kPad);
+        oz_free(ctx, fPad);
+        oz_release(ctx, mark);
+        return;
+    }
+
+    gsl_interp_accel *acc = gsl_interp_accel_alloc();
+    gsl_spline *spline = gsl_spline_alloc(gsl_interp_cspline, m);
+
+    for (j = 0; j < m; j++) {
+        kPad[j] = j * dkPad;
+    }
+
+    for (k = 0; k < ctx->ncols; k++) {
+        double s0 = 0.0;
+
+        for (j = 0; j < ctx->nrows; j++) {
+            y[j] = ctx->r[j] * c[j + k*ctx->nrows];
+            s0 += ctx->r[j] * y[j];
+        }
+        // Trapezoid end weights (r[0] = 0 already drops the first point)
+        s0 -= 0.5 * ctx->r[ctx->nrows-1] * y[ctx->nrows-1];
+        y[ctx->nrows-1] *= 0.5;
+        for (j = ctx->nrows; j < M; j++) {
+            y[j] = 0.0;
+        }
+
+        if (ctx->fft_pad) {
+            oz_fft_sine(ctx->fft_pad, y, 1);
+        } else {
+            sinft_double(y, M);
+        }
+
+        // k -> 0 limit: 4*PI * int r^2 c(r) dr
+        fPad[0] = 4.0 * M_PI * ctx->dr * s0;
+        for (j = 1; j < m; j++) {
+            fPad[j] = 4.0 * M_PI * ctx->dr * y[j] / kPad[j];
+        }
+
+        gsl_spline_init(spline, kPad, fPad, m);
+
+        for (i = 0; i < nk; i++) {
+            c1[i + k*nk] = gsl_spline_eval(spline, rk[i], acc);
+        }
+    }
+
+    gsl_spline_free(spline);
+    gsl_interp_accel_free(acc);
+
+    oz_free(ctx, y);
+    oz_free(ctx, kPad);
+    oz_free(ctx, fPad);
+    oz_release(ctx, mark);
+}
+
+/**
+ * @brief Filon sine quadrature of 4*PI/k * int r c(r) sin(kr) dr.
+ *
+ * For arbitrary (non-uniform) k. Integrates r*c(r) exactly on each pair of
+ * intervals as a parabola, so it stays accurate when k*dr is not small.
+ * sin(k r_j) is advanced by rotation, so there is no sin() per element.
+ * Cost O(N * nk). The last point is dropped when nrows-1 is odd.
+ *
+ * @param ctx Solver context (grids, potential tables, density).
+ * @param c Input matrix [nrows*ncols] in r, columns contiguous.
+ * @param c1 Output matrix [nk*ncols] on rk, column k at c1 + k*nk.
+ * @param rk Wave vectors (any order, rk >= 0).
+ * @param nk Number of wave vectors.
+ */
+void FT_filon_ctx(const OZContext *ctx, double *c, double *c1, double *rk, int nk) {
+
+    int i, j, k;
+    int n = ((ctx->nrows - 1) / 2) * 2;     // Even number of intervals
+    double h = ctx->dr;
+    double b = ctx->r[n];
+    double *f;
+
+    size_t mark = oz_mark(ctx);
+    f = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+
+    if (f == NULL) {
+        printf("Memory allocation failed in FT_filon.\n");
+        oz_free(ctx, f);
+        oz_release(ctx, mark);
+        return;
+    }
+
+    for (j = 0; j <= n; j++) {
+        for (k = 0; k < ctx->ncols; k++) {
+            f[j + k*ctx->nrows] = ctx->r[j] * c[j + k*ctx->nrows];
+        }
+    }
+
+    for (i = 0; i < nk; i++) {
+        double kk = rk[i];
+        double theta = kk * h;
+        double al, be, ga;
+
+        if (kk == 0.0) {
+            // Simpson's rule for 4*PI * int r^2 c(r) dr
+            for (k = 0; k < ctx->ncols; k++) {
+                double sum = 0.0;
+                for (j = 1; j < n; j++) {
+                    sum += ((j % 2) ? 4.0 : 2.0) * ctx->r[j] * f[j + k*ctx->nrows];
+                }
+                sum += b * f[n + k*ctx->nrows];
+                c1[i + k*nk] = 4.0 * M_PI * h * sum / 3.0;
+            }
+            continue;
+        }
+
+        if (theta < 1.0/6.0) {
+            double t2 = theta*theta;
+            al = 2.0*theta*t2/45.0 - 2.0*theta*t2*t2/315.0 + 2.0*theta*t2*t2*t2/4725.0;
+            be = 2.0/3.0 + 2.0*t2/15.0 - 4.0*t2*t2/105.0 + 2.0*t2*t2*t2/567.0;
+            ga = 4.0/3.0 - 2.0*t2/15.0 + t2*t2/210.0 - t2*t2*t2/11340.0;
+        } else {
+            double st = sin(theta), ct = cos(theta), t3 = theta*theta*theta;
+            al = (theta*theta + theta*st*ct - 2.0*st*st) / t3;
+            be = 2.0 * (theta*(1.0 + ct*ct) - 2.0*st*ct) / t3;
+            ga = 4.0 * (st - theta*ct) / t3;
+        }
+
+        double sh = sin(theta), ch = cos(theta);
+        double sb = sin(kk*b), cb = cos(kk*b);
+
+        for (k = 0; k < ctx->ncols; k++) {
+            double sEven = 0.0, sOdd = 0.0;
+            double sj = 0.0, cj = 1.0;      // sin, cos of k*r_j with r_0 = 0
+
+            for (j = 0; j <= n; j++) {
+                if (j % 2) sOdd += f[j + k*ctx->nrows] * sj;
+                else sEven += f[j + k*ctx->nrows] * sj;
+
+                double tmp = sj*ch + cj*sh;
+                cj = cj*ch - sj*sh;
+                sj = tmp;
+            }
+            sEven -= 0.5 * f[n + k*ctx->nrows] * sb;
+
+            double integral = h * (al * (f[k*ctx->nrows] - f[n + k*ctx->nrows] * cb) + be * sEven + ga * sOdd);
+            c1[i + k*nk] = 4.0 * M_PI * integral / kk;
+        }
+    }
+
+    oz_free(ctx, f);
+    oz_release(ctx, mark);
+}
+
+
+void FFT_ctx(const OZContext *ctx, double *inputData, int isDirect) {
     
     /*
     Si isDirect =  1 se realiza la transformada seno de inputData
@@ -347,78 +588,158 @@ void FFT(double *inputData, double rmax, int isDirect) {
     int i;
     double a;
 
-    for (i = 0; i < nrows; i++) {
+    for (i = 0; i < ctx->nrows; i++) {
         inputData[i] = (i * inputData[i]);
     }
 
     // Se ejecuta la transformada seno
     // Note que aquí no es necesario usar isDirect
     // porque la transformada seno es su propia inversa
-    sinft(inputData, nrows); 
+    // (Newton-GMRES necesita la versión en doble precisión: diferencia ONg)
+    if (ctx->fft_double) {
+        sinft_double(inputData, ctx->nrows);
+    } else {
+        sinft(inputData, ctx->nrows);
+    }
 
     if (isDirect == 1) {
 //        printf("Se calcula la transformada seno directa");
-        a = 4.0 * pow(rmax, 3.0) / (1.0 * nrows*nrows);
+        a = 4.0 * pow(ctx->rmax, 3.0) / (1.0 * ctx->nrows*ctx->nrows);
         inputData[0] = 0.0;
     }else{
 //        printf("Se calcula la transformada seno inversa");
-        a = nrows * (1.0 / (2.0 * pow(rmax, 3.0)));
+        a = ctx->nrows * (1.0 / (2.0 * pow(ctx->rmax, 3.0)));
     }
     
-    for (i = 1; i < nrows; i++) {
+    for (i = 1; i < ctx->nrows; i++) {
         inputData[i] = a * inputData[i] / (1.0 * i);
 //        printf("%d\t%.15e\n", i, inputData[i]);
     }
 }
 
+void FFT(double *inputData, double rmax, int isDirect) {
+    OZContext ctx = oz_legacy_context();
+    ctx.rmax = rmax;
+    FFT_ctx(&ctx, inputData, isDirect);
+}
+
 
-void sinft(double *y, int nmax) {
-    
-    int m, j, i;
+/*
+   Las rutinas sinft/realft/four1 son la traducción de Numerical Recipes que
+   usa la rampa esférica. El original redondea los factores de giro y las
+   mariposas a float; ese comportamiento se conserva en las versiones
+   públicas (sinft, realft, four1) para no alterar los resultados de OZ2.
+   Las variantes *_double hacen exactamente el mismo algoritmo en doble
+   precisión completa y son las que usan los solvers no esféricos.
+*/
+static inline double nrRound(double value, int fullPrecision) {
+    return fullPrecision ? value : (double) ((float) value);
+}
+
+static void four1_impl(double *data, int nn, int isign, int fullPrecision);
+static void realft_impl(double *data, int n, int isign, int fullPrecision);
+
+static void sinft_impl(double *y, int n, int fullPrecision) {
+
+    int m, j;
     double wr, wi, wpr, wpi, wtemp, theta;
     double y1, y2, sum;
 
-    theta = M_PI / nrows;
+    theta = M_PI / n;
     wr = 1.0;
     wi = 0.0;
     wpr = -2.0 * pow(sin(theta/2.0), 2.0);
     wpi = sin(theta);
     y[0] = 0.0;
-    m = nrows / 2;
+    m = n / 2;
 
     for (j = 1; j <= m; j++) {
         wtemp = wr;
         wr = wr*wpr - wi*wpi + wr;
         wi = wi * wpr + wtemp * wpi + wi;
-        y1 = wi * (y[j] + y[nrows-j]);
-        y2 = (y[j] - y[nrows-j]) / 2.0;
-//        printf("%d\t%.15E\t%.15E\t%.15E\t%.15E\n", j, wi, (y[j] + y[nrows-j]), wi * (y[j] + y[nrows-j]), y1);
+        y1 = wi * (y[j] + y[n-j]);
+        y2 = (y[j] - y[n-j]) / 2.0;
         y[j] = y1 + y2;
-        y[nrows-j] = y1 - y2;
+        y[n-j] = y1 - y2;
     }
 
-    realft(y, m, 1, nmax);
-/*
-    for (i=0; i<nrows; i++){
-        printf("%d\t%.15e\n", i, y[i]);
-    }
-*/
+    realft_impl(y, m, 1, fullPrecision);
+
     sum = 0.0;
     y[0] = y[0] / 2.0;
     y[1] = 0.0;
     
-    for (j = 0; j < (nrows-1); j+=2) {
+    for (j = 0; j < (n-1); j+=2) {
         sum += y[j];
         y[j] = y[j+1];
         y[j+1] = sum;
-//        printf("%.15E\n", sum);
     }
+}
 
-    return;
+
+void sinft(double *y, int nmax) {
+    sinft_impl(y, nmax, 0);
 }
 
 
-void realft(double *data, int n, int isign, int nmax) {
+/**
+ * @brief Sine transform in full double precision.
+ *
+ * Same convention as sinft: on exit y[k] = sum_{j=1}^{n-1} y[j] sin(pi j k / n),
+ * with y[0] = 0. n must be a power of 2.
+ */
+void sinft_double(double *y, int n) {
+    sinft_impl(y, n, 1);
+}
+
+
+/**
+ * @brief Cosine transform (NR cosft1) in full double precision.
+ *
+ * y has n+1 entries. On exit
+ *   y[k] = (y[0] + (-1)^k y[n]) / 2 + sum_{j=1}^{n-1} y[j] cos(pi j k / n),  k = 0..n.
+ * n must be a power of 2.
+ */
+void cosft1_double(double *y, int n) {
+
+    int j;
+    double wr, wi, wpr, wpi, wtemp, theta;
+    double y1, y2, sum;
+
+    theta = M_PI / n;
+    wtemp = sin(0.5 * theta);
+    wpr = -2.0 * wtemp * wtemp;
+    wpi = sin(theta);
+    wr = 1.0;
+    wi = 0.0;
+
+    sum = 0.5 * (y[0] - y[n]);
+    y[0] = 0.5 * (y[0] + y[n]);
+
+    for (j = 1; j < n / 2; j++) {
+        wtemp = wr;
+        wr = wr*wpr - wi*wpi + wr;
+        wi = wi*wpr + wtemp*wpi + wi;
+        y1 = 0.5 * (y[j] + y[n-j]);
+        y2 = (y[j] - y[n-j]);
+        y[j] = y1 - wi*y2;
+        y[n-j] = y1 + wi*y2;
+        sum += wr*y2;
+    }
+
+    realft_impl(y, n / 2, 1, 1);
+
+    y[n] = y[1];
+    y[1] = sum;
+
+    for (j = 3; j < n; j += 2) {
+        sum += y[j];
+        y[j] = sum;
+    }
+}
+
+
+static void realft_impl(double *data, int n, int isign, int fullPrecision) {
     
     int i, n2p3, i1, i2, i3, i4;
     double wr, wi, wpr, wpi, wtemp, theta;
@@ -431,14 +752,7 @@ void realft(double *data, int n, int isign, int nmax) {
     if (isign == 1) {
         c2 = -0.5;
 
-        four1(data, n, +1, nmax); 
-
-/*
-        for (i=0; i<n; i++){
-            printf("%d\t%.15e\n", i, data[i]);
-        }
-*/
-
+        four1_impl(data, n, +1, fullPrecision); 
 
     } else {
         c2 = 0.5;
@@ -456,8 +770,8 @@ void realft(double *data, int n, int isign, int nmax) {
         i2 = i1 + 1;
         i3 = n2p3 - i2;
         i4 = i3 + 1;
-        wrs = ((float) wr);
-        wis = ((float) wi);
+        wrs = nrRound(wr, fullPrecision);
+        wis = nrRound(wi, fullPrecision);
         h1r = c1 * (data[i1-1] + data[i3-1]);
         h1i = c1 * (data[i2-1] - data[i4-1]);
         h2r = -c2 * (data[i2-1] + data[i4-1]);
@@ -479,22 +793,22 @@ void realft(double *data, int n, int isign, int nmax) {
         h1r = data[0];
         data[0] = c1 * (h1r + data[1]);
         data[1] = c1 * (h1r - data[1]);
-        four1(data, n, -1, nmax);
+        four1_impl(data, n, -1, fullPrecision);
     }
 }
 
 
-void four1(double *data, int nn, int isign, int nmax) {
+void realft(double *data, int n, int isign, int nmax) {
+    realft_impl(data, n, isign, 0);
+}
+
+
+static void four1_impl(double *data, int nn, int isign, int fullPrecision) {
 
     int i, j, istep;
     int m, n, mmax;
     double wr, wi, wpr, wpi, wtemp, theta;
-    float tempr, tempi;
-/*
-    for (i=0; i<nn; i++){
-        printf("A %d\t%.15e\n", i, data[i]);
-    }
-*/
+    double tempr, tempi;
 
     n = 2 * nn;
     j = 1;
@@ -502,8 +816,8 @@ void four1(double *data, int nn, int isign, int nmax) {
     for (i = 1; i <= n; i += 2) {
 
         if (j > i) {
-            tempr = data[j-1];
-            tempi = data[j];
+            tempr = nrRound(data[j-1], fullPrecision);
+            tempi = nrRound(data[j], fullPrecision);
             data[j-1] = data[i-1];
             data[j] = data[i];
             data[i-1] = tempr;
@@ -520,10 +834,6 @@ void four1(double *data, int nn, int isign, int nmax) {
         j += m;
     }
 
-/*    for (i=0; i<nn; i++){
-        printf("A %d\t%.15e\n", i, data[i]);
-    }
-*/
     mmax = 2;
 
     while (n > mmax) {
@@ -536,20 +846,17 @@ void four1(double *data, int nn, int isign, int nmax) {
         wi = 0.0;
 
         for (m = 1; m <= mmax; m += 2) {
+            double wrs = nrRound(wr, fullPrecision);
+            double wis = nrRound(wi, fullPrecision);
             for (i = m; i <= n; i += istep) {
                 j = i + mmax;
-                tempr = ((float) wr) * data[j-1] - ((float) wi) * data[j];
-                tempi = ((float) wr) * data[j] + ((float) wi) * data[j-1];
-
-//                printf("%d %d\t%.15lf\t%.15lf\n", m, i, (float) wr, (float) wi);
-//                printf("%d %d\t%.15lf\t%.15lf\n", m, i, tempr, tempi);
-//                printf("%d %d\t%.15lf\t%.15lf\n", m, i, data[i-1], data[i]);
-
-                data[j-1] = data[i-1] - ((float) tempr);
-                data[j] = data[i] - ((float) tempi);
-                data[i-1] += ((float) tempr);
-                data[i] += ((float) tempi);
-//                printf("%d %d\t%.15lf\t%.15lf\n", m, i, data[i-1], data[i]);
+                tempr = nrRound(wrs * data[j-1] - wis * data[j], fullPrecision);
+                tempi = nrRound(wrs * data[j] + wis * data[j-1], fullPrecision);
+
+                data[j-1] = data[i-1] - tempr;
+                data[j] = data[i] - tempi;
+                data[i-1] += tempr;
+                data[i] += tempi;
             }
             wtemp = wr;
             wr = wr * wpr - wi * wpi + wr;
@@ -559,12 +866,22 @@ void four1(double *data, int nn, int isign, int nmax) {
         mmax = istep;
 
     }
-/*
-    for (i=0; i<nn; i++){
-        printf("A %d\t%.15e\n", i, data[i]);
-    }
-*/
-    return;
+}
+
+
+void four1(double *data, int nn, int isign, int nmax) {
+    four1_impl(data, nn, isign, 0);
+}
+
+/**
+ * @brief Complex FFT (NR four1) in full double precision.
+ *
+ * data holds nn complex values as (re, im) pairs. On exit
+ *   data[k] = sum_{j=0}^{nn-1} data[j] exp(isign * 2 pi i j k / nn).
+ * nn must be a power of 2.
+ */
+void four1_double(double *data, int nn, int isign) {
+    four1_impl(data, nn, isign, 1);
 }
 
 /**
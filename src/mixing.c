@@ -0,0 +1,230 @@
+#include "mixing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+AndersonMixer* create_anderson_mixer(int n_projections, int n_points, int depth) {
+    AndersonMixer *am = malloc(sizeof(AndersonMixer));
+    if (!am) return NULL;
+
+    size_t size = (size_t) n_projections * n_points;
+    if (depth < 0) depth = 0;
+
+    am->n_projections = n_projections;
+    am->n_points = n_points;
+    am->depth = depth;
+    am->count = 0;
+    am->head = 0;
+    am->has_previous = 0;
+    am->weight = NULL;
+
+    am->dc = malloc((depth > 0 ? depth : 1) * size * sizeof(double));
+    am->df = malloc((depth > 0 ? depth : 1) * size * sizeof(double));
+    am->c_prev = malloc(size * sizeof(double));
+    am->f_prev = malloc(size * sizeof(double));
+    am->f = malloc(size * sizeof(double));
+    am->gram = malloc((depth > 0 ? depth*depth : 1) * sizeof(double));
+    am->gamma = malloc((depth > 0 ? depth : 1) * sizeof(double));
+    am->partial = malloc((size_t) n_projections * ((n_points + MIX_CHUNK - 1) / MIX_CHUNK) * sizeof(double));
+
+    if (!am->dc || !am->df || !am->c_prev || !am->f_prev || !am->f || !am->gram || !am->gamma || !am->partial) {
+        free_anderson_mixer(am);
+        return NULL;
+    }
+
+    return am;
+}
+
+void free_anderson_mixer(AndersonMixer *am) {
+    if (!am) return;
+
+    free(am->dc);
+    free(am->df);
+    free(am->c_prev);
+    free(am->f_prev);
+    free(am->f);
+    free(am->gram);
+    free(am->gamma);
+    free(am->partial);
+    free(am);
+}
+
+void anderson_set_weights(AndersonMixer *am, const double *weight) {
+    am->weight = weight;
+}
+
+void anderson_reset(AndersonMixer *am) {
+    am->count = 0;
+    am->head = 0;
+    am->has_previous = 0;
+}
+
+double anderson_residual(AndersonMixer *am, double **c, double **c_new) {
+    int n = am->n_points;
+    int n_chunks = (n + MIX_CHUNK - 1) / MIX_CHUNK;
+    int total = am->n_projections * n_chunks;
+
+    #pragma omp parallel for schedule(static)
+    for (int q = 0; q < total; q++) {
+        int p = q / n_chunks;
+        int i0 = (q % n_chunks) * MIX_CHUNK;
+        int i1 = (i0 + MIX_CHUNK < n) ? i0 + MIX_CHUNK : n;
+        double *f = am->f + (size_t) p * n;
+        double sum = 0.0;
+        for (int i = i0; i < i1; i++) {
+            f[i] = c_new[p][i] - c[p][i];
+            sum += f[i] * f[i] * (am->weight ? am->weight[i] : 1.0);
+        }
+        am->partial[q] = sum;
+    }
+
+    double error = 0.0;
+    for (int q = 0; q < total; q++) error += am->partial[q];
+
+    return sqrt(error / (am->n_projections * n));
+}
+
+// Chunked dot product, summed in chunk order whatever the thread count
+static double dot(AndersonMixer *am, const double *a, const double *b, size_t n) {
+    long n_chunks = (long) ((n + MIX_CHUNK - 1) / MIX_CHUNK);
+
+    #pragma omp parallel for schedule(static)
+    for (long q = 0; q < n_chunks; q++) {
+        size_t i0 = (size_t) q * MIX_CHUNK;
+        size_t i1 = (i0 + MIX_CHUNK < n) ? i0 + MIX_CHUNK : n;
+        double sum = 0.0;
+        if (am->weight) {
+            for (size_t i = i0; i < i1; i++) sum += a[i] * b[i] * am->weight[i % am->n_points];
+        } else {
+            for (size_t i = i0; i < i1; i++) sum += a[i] * b[i];
+        }
+        am->partial[q] = sum;
+    }
+
+    double sum = 0.0;
+    for (long q = 0; q < n_chunks; q++) sum += am->partial[q];
+    return sum;
+}
+
+int mixing_solve_small_system(double *G, double *b, int m) {
+    for (int col = 0; col < m; col++) {
+        int piv = col;
+        for (int row = col + 1; row < m; row++) {
+            if (fabs(G[row*m + col]) > fabs(G[piv*m + col])) piv = row;
+        }
+        if (fabs(G[piv*m + col]) < 1e-300) return -1;
+
+        if (piv != col) {
+            for (int j = 0; j < m; j++) {
+                double t = G[col*m + j]; G[col*m + j] = G[piv*m + j]; G[piv*m + j] = t;
+            }
+            double t = b[col]; b[col] = b[piv]; b[piv] = t;
+        }
+
+        for (int row = col + 1; row < m; row++) {
+            double factor = G[row*m + col] / G[col*m + col];
+            for (int j = col; j < m; j++) G[row*m + j] -= factor * G[col*m + j];
+            b[row] -= factor * b[col];
+        }
+    }
+
+    for (int row = m - 1; row >= 0; row--) {
+        double sum = b[row];
+        for (int j = row + 1; j < m; j++) sum -= G[row*m + j] * b[j];
+        b[row] = sum / G[row*m + row];
+    }
+
+    return 0;
+}
+
+void anderson_step(AndersonMixer *am, double **c, double beta) {
+    int n = am->n_points;
+    size_t size = (size_t) am->n_projections * n;
+
+    // Record (dc, df) against the previous step
+    if (am->depth > 0 && am->has_previous) {
+        double *dc = am->dc + (size_t) am->head * size;
+        double *df = am->df + (size_t) am->head * size;
+        #pragma omp parallel for collapse(2) schedule(static)
+        for (int p = 0; p < am->n_projections; p++) {
+            for (int i = 0; i < n; i++) {
+                size_t idx = (size_t) p * n + i;
+                dc[idx] = c[p][i] - am->c_prev[idx];
+                df[idx] = am->f[idx] - am->f_prev[idx];
+            }
+        }
+        am->head = (am->head + 1) % am->depth;
+        if (am->count < am->depth) am->count++;
+    }
+
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int p = 0; p < am->n_projections; p++) {
+        for (int i = 0; i < n; i++) {
+            size_t idx = (size_t) p * n + i;
+            am->c_prev[idx] = c[p][i];
+            am->f_prev[idx] = am->f[idx];
+        }
+    }
+    am->has_previous = 1;
+
+    int m = am->count;
+    int use_history = 0;
+
+    if (m > 0) {
+        double trace = 0.0;
+        for (int a = 0; a < m; a++) {
+            const double *dfa = am->df + (size_t) a * size;
+            for (int b = a; b < m; b++) {
+                double g = dot(am, dfa, am->df + (size_t) b * size, size);
+                am->gram[a*m + b] = g;
+                am->gram[b*m + a] = g;
+            }
+            am->gamma[a] = dot(am, dfa, am->f, size);
+            trace += am->gram[a*m + a];
+        }
+
+        // Tikhonov regularization keeps nearly collinear histories solvable
+        for (int a = 0; a < m; a++) am->gram[a*m + a] += 1e-10 * trace / m + 1e-300;
+
+        use_history = (mixing_solve_small_system(am->gram, am->gamma, m) == 0);
+    }
+
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int p = 0; p < am->n_projections; p++) {
+        for (int i = 0; i < n; i++) {
+            size_t idx = (size_t) p * n + i;
+            double update = beta * am->f[idx];
+            if (use_history) {
+                for (int a = 0; a < m; a++) {
+                    size_t off = (size_t) a * size + idx;
+                    update -= am->gamma[a] * (am->dc[off] + beta * am->df[off]);
+                }
+            }
+            c[p][i] += update;
+        }
+    }
+}
+
+void damping_init(DampingControl *dc, double beta, int enabled) {
+    dc->enabled = enabled;
+    dc->beta = beta;
+    dc->beta_max = beta;
+    dc->beta_min = 1e-3 * beta;
+    dc->prev_error = -1.0;
+}
+
+int damping_update(DampingControl *dc, double error) {
+    int grew = 0;
+
+    if (dc->enabled && dc->prev_error > 0.0) {
+        if (error > DAMPING_GROWTH_FACTOR * dc->prev_error) {
+            dc->beta = fmax(0.5 * dc->beta, dc->beta_min);
+            grew = 1;
+        } else {
+            dc->beta = fmin(1.1 * dc->beta, dc->beta_max);
+        }
+    }
+
+    dc->prev_error = error;
+    return grew;
+}
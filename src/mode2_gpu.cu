@@ -0,0 +1,602 @@
+/**
+ * @file mode2_gpu.cu
+ * @brief CUDA backend of the potential-15 iteration (make CUDA=1, see mode2_gpu.h).
+ *
+ * Device arrays hold one projection per row of n points, without the
+ * padding of ProjectionMatrix; upload and download convert with
+ * cudaMemcpy2D. The kernels reproduce the CPU loops of solver_mode2.c,
+ * chi_modes.c and mixing.c one to one.
+ */
+
+extern "C" {
+#include "mode2_gpu.h"
+#include "mixing.h"
+}
+#include <cuda_runtime.h>
+#include <cublas_v2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+// Threads per block of the elementwise kernels and the reductions
+#define MODE2_GPU_THREADS 256
+
+// Partial sums of a reduction (fixed, so the summation order is too)
+#define MODE2_GPU_PARTIALS 1024
+
+// Doubles of the chi matrices of one k point: sum of dim^2 over the blocks
+#define MODE2_GPU_MAX_X (MODE2_GPU_MAX_DIM * (MODE2_GPU_MAX_DIM + 1) * (2 * MODE2_GPU_MAX_DIM + 1) / 6)
+
+// Chi tables of ChiModeSolver, flattened into device arrays
+typedef struct {
+    int n_blocks;
+    int *dim;               // [n_blocks]
+    int *x_offset;          // [n_blocks] first element of the block in X
+    int *term_start;        // [n_blocks+1]
+    double *sign;           // [n_blocks] (-1)^chi
+    int *entry;             // Forward terms, as ChiBlock
+    int *proj;
+    double *coef;
+    double *norm;           // [n_projections] y^{mnl}
+    int *inv_start;         // [n_projections+1]
+    int *inv_block;
+    int *inv_entry;
+    double *inv_coef;
+} Mode2ChiTables;
+
+struct Mode2Device {
+    int n_projections;
+    int n;
+    int lmax;
+    cublasHandle_t blas;
+
+    double *r, *k;          // [n]
+    double *c, *c_new, *h, *eta, *C_k, *H_k, *f;   // [n_projections*n]
+    double **table;         // [lmax+1] j_l(k_i r_j), [n*n] each (NULL if no projection has that l)
+    double *pack_in, *pack_out;                     // [n_projections*n]
+    int *group;             // Projections sorted by l
+    int *group_start;       // Host: [lmax+2] offsets into group
+    Mode2ChiTables chi;
+
+    int depth, count, head, has_previous;
+    double *dc, *df;        // [depth][n_projections*n]
+    double *c_prev, *f_prev;
+    double *gram, *gamma;   // Host
+    double *gamma_dev;      // [depth]
+
+    double *partial;        // [MODE2_GPU_PARTIALS]
+    double *scalar;         // [1]
+};
+
+static int cuda_ok(cudaError_t status, const char *what) {
+    if (status == cudaSuccess) return 1;
+    fprintf(stderr, "Error: CUDA %s: %s\n", what, cudaGetErrorString(status));
+    return 0;
+}
+
+static int blocks_for(size_t n) {
+    return (int) ((n + MODE2_GPU_THREADS - 1) / MODE2_GPU_THREADS);
+}
+
+// ----------------------------------------------------
+// Kernels
+// ----------------------------------------------------
+
+// j_l(x) as get_jl_kr of solver_mode2.c
+static __device__ double device_jl(int l, double kr) {
+    if (kr < 1e-12) return (l == 0) ? 1.0 : 0.0;
+
+    double kr2 = kr * kr, kr3 = kr2 * kr, kr4 = kr3 * kr, kr5 = kr4 * kr;
+    double sk = sin(kr), ck = cos(kr);
+
+    switch (l) {
+        case 0: return sk / kr;
+        case 1: return (sk / kr2) - (ck / kr);
+        case 2: return ((3.0 / kr3) - (1.0 / kr)) * sk - (3.0 / kr2) * ck;
+        case 3: return ((15.0 / kr4) - (6.0 / kr2)) * sk + ((1.0 / kr) - (15.0 / kr3)) * ck;
+        case 4: return ((105.0 / kr5) - (45.0 / kr3) + (1.0 / kr)) * sk + ((10.0 / kr2) - (105.0 / kr4)) * ck;
+        default: break;
+    }
+
+    if (kr > l) {
+        double jm = ((15.0 / kr4) - (6.0 / kr2)) * sk + ((1.0 / kr) - (15.0 / kr3)) * ck;
+        double j = ((105.0 / kr5) - (45.0 / kr3) + (1.0 / kr)) * sk + ((10.0 / kr2) - (105.0 / kr4)) * ck;
+        for (int q = 4; q < l; q++) {
+            double jp = (2.0 * q + 1.0) / kr * j - jm;
+            jm = j;
+            j = jp;
+        }
+        return j;
+    }
+
+    double lead = 1.0;
+    for (int q = 1; q <= l; q++) lead *= kr / (2.0 * q + 1.0);
+    double term = 1.0, sum = 1.0;
+    for (int q = 1; q < 60 && fabs(term) > 1e-17 * fabs(sum); q++) {
+        term *= -0.5 * kr2 / (q * (2.0 * l + 2.0 * q + 1.0));
+        sum += term;
+    }
+    return lead * sum;
+}
+
+static __global__ void bessel_table_kernel(double *K, int l, const double *r, const double *k, int n) {
+    size_t idx = (size_t) blockIdx.x * blockDim.x + threadIdx.x;
+    if (idx >= (size_t) n * n) return;
+    int i = (int) (idx / n), j = (int) (idx % n);
+    double arg = k[i] * r[j];
+    K[idx] = (arg < 1e-6) ? ((l == 0) ? 1.0 : 0.0) : device_jl(l, arg);
+}
+
+// pack[g][j] = x_j^2 in[group[g]][j]
+static __global__ void pack_kernel(const double *in, double *pack, const int *group, int m, const double *x, int n) {
+    int idx = blockIdx.x * blockDim.x + threadIdx.x;
+    if (idx >= m * n) return;
+    int g = idx / n, j = idx % n;
+    pack[idx] = x[j] * x[j] * in[(size_t) group[g] * n + j];
+}
+
+static __global__ void unpack_kernel(const double *pack, double *out, const int *group, int m, int n) {
+    int idx = blockIdx.x * blockDim.x + threadIdx.x;
+    if (idx >= m * n) return;
+    int g = idx / n, i = idx % n;
+    out[(size_t) group[g] * n + i] = pack[idx];
+}
+
+// y = a + s b
+static __global__ void axpy_kernel(double *y, const double *a, double s, const double *b, size_t n) {
+    size_t i = (size_t) blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < n) y[i] = a[i] + s * b[i];
+}
+
+// One k point per thread: Blum projections -> chi blocks -> solve -> projections
+static __global__ void chi_solve_kernel(Mode2ChiTables t, const double *C, double *H, int n, int np, double rho) {
+    int kk = blockIdx.x * blockDim.x + threadIdx.x;
+    if (kk >= n) return;
+
+    double X[MODE2_GPU_MAX_X];
+    double A[MODE2_GPU_MAX_DIM * MODE2_GPU_MAX_DIM];
+
+    for (int b = 0; b < t.n_blocks; b++) {
+        int d = t.dim[b];
+        double *Xb = X + t.x_offset[b];
+        double srho = t.sign[b] * rho;
+
+        for (int e = 0; e < d*d; e++) Xb[e] = 0.0;
+        for (int q = t.term_start[b]; q < t.term_start[b + 1]; q++) {
+            int p = t.proj[q];
+            Xb[t.entry[q]] += t.coef[q] * (C[(size_t) p * n + kk] / t.norm[p]);
+        }
+
+        for (int a = 0; a < d; a++)
+            for (int c = 0; c < d; c++) A[a*d + c] = ((a == c) ? 1.0 : 0.0) - srho * Xb[a*d + c];
+
+        // Same elimination and pivot sequence as solve_block_tile
+        double det = 1.0;
+        for (int j = 0; j < d; j++) {
+            for (int i = j + 1; i < d; i++) {
+                if (!(fabs(A[i*d + j]) > fabs(A[j*d + j]))) continue;
+                for (int c = j; c < d; c++) {
+                    double u = A[j*d + c]; A[j*d + c] = A[i*d + c]; A[i*d + c] = u;
+                }
+                for (int c = 0; c < d; c++) {
+                    double u = Xb[j*d + c]; Xb[j*d + c] = Xb[i*d + c]; Xb[i*d + c] = u;
+                }
+                det = -det;
+            }
+
+            double piv = A[j*d + j];
+            det *= piv;
+            for (int i = j + 1; i < d; i++) {
+                A[i*d + j] /= piv;
+                for (int c = j + 1; c < d; c++) A[i*d + c] -= A[i*d + j] * A[j*d + c];
+                for (int c = 0; c < d; c++) Xb[i*d + c] -= A[i*d + j] * Xb[j*d + c];
+            }
+        }
+        for (int i = d - 1; i >= 0; i--) {
+            for (int c = 0; c < d; c++) {
+                for (int q = i + 1; q < d; q++) Xb[i*d + c] -= A[i*d + q] * Xb[q*d + c];
+                Xb[i*d + c] /= A[i*d + i];
+            }
+        }
+
+        if (!(fabs(det) > 1e-12))
+            for (int e = 0; e < d*d; e++) Xb[e] = 0.0;
+    }
+
+    for (int p = 0; p < np; p++) {
+        double sum = 0.0;
+        for (int q = t.inv_start[p]; q < t.inv_start[p + 1]; q++)
+            sum += t.inv_coef[q] * X[t.x_offset[t.inv_block[q]] + t.inv_entry[q]];
+        H[(size_t) p * n + kk] = sum * t.norm[p];
+    }
+}
+
+// eta = h - c and closure_MSA_mode2 / closure_LHNC_mode2 into c_new, one r point per thread
+static __global__ void closure_kernel(double *c_new, const double *c, const double *h, double *eta, const double *r,
+                                      int n, int np, int closureID, double beta_mu2, double sigma, int i112) {
+    int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= n) return;
+
+    for (int p = 0; p < np; p++) eta[(size_t) p * n + i] = h[(size_t) p * n + i] - c[(size_t) p * n + i];
+
+    if (r[i] <= sigma) {
+        c_new[i] = -1.0 - eta[i];
+        for (int p = 1; p < np; p++) c_new[(size_t) p * n + i] = -eta[(size_t) p * n + i];
+        return;
+    }
+
+    double u = beta_mu2 / (r[i] * r[i] * r[i]);
+    if (closureID == 0) {
+        for (int p = 0; p < np; p++) c_new[(size_t) p * n + i] = 0.0;
+        c_new[(size_t) i112 * n + i] = u;
+    } else {
+        double h000 = h[i];
+        double g000 = h000 + 1.0;
+        if (g000 < 1e-12) g000 = 1e-12;
+        c_new[i] = h000 - log(g000);
+        for (int p = 1; p < np; p++) c_new[(size_t) p * n + i] = h000 * eta[(size_t) p * n + i];
+        c_new[(size_t) i112 * n + i] += u + h000 * u;
+    }
+}
+
+// partial[b] = sum over the strided points of block b of a*b, tree-reduced in shared memory
+static __global__ void dot_partial_kernel(const double *a, const double *b, size_t n, double *partial) {
+    __shared__ double s[MODE2_GPU_THREADS];
+    double sum = 0.0;
+    for (size_t i = (size_t) blockIdx.x * blockDim.x + threadIdx.x; i < n; i += (size_t) gridDim.x * blockDim.x)
+        sum += a[i] * b[i];
+    s[threadIdx.x] = sum;
+    __syncthreads();
+    for (unsigned w = blockDim.x / 2; w > 0; w /= 2) {
+        if (threadIdx.x < w) s[threadIdx.x] += s[threadIdx.x + w];
+        __syncthreads();
+    }
+    if (threadIdx.x == 0) partial[blockIdx.x] = s[0];
+}
+
+static __global__ void sum_kernel(const double *partial, int m, double *out) {
+    __shared__ double s[MODE2_GPU_THREADS];
+    double sum = 0.0;
+    for (int i = threadIdx.x; i < m; i += blockDim.x) sum += partial[i];
+    s[threadIdx.x] = sum;
+    __syncthreads();
+    for (unsigned w = blockDim.x / 2; w > 0; w /= 2) {
+        if (threadIdx.x < w) s[threadIdx.x] += s[threadIdx.x + w];
+        __syncthreads();
+    }
+    if (threadIdx.x == 0) out[0] = s[0];
+}
+
+// dc[head] = c - c_prev, df[head] = f - f_prev
+static __global__ void record_kernel(double *dc, double *df, const double *c, const double *c_prev,
+                                     const double *f, const double *f_prev, size_t n) {
+    size_t i = (size_t) blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= n) return;
+    dc[i] = c[i] - c_prev[i];
+    df[i] = f[i] - f_prev[i];
+}
+
+static __global__ void anderson_update_kernel(double *c, const double *f, const double *dc, const double *df,
+                                              const double *gamma, int m, double beta, size_t n) {
+    size_t i = (size_t) blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= n) return;
+    double update = beta * f[i];
+    for (int a = 0; a < m; a++) {
+        size_t off = (size_t) a * n + i;
+        update -= gamma[a] * (dc[off] + beta * df[off]);
+    }
+    c[i] += update;
+}
+
+// ----------------------------------------------------
+// Host side
+// ----------------------------------------------------
+
+static double device_dot(Mode2Device *dev, const double *a, const double *b, size_t n) {
+    int blocks = blocks_for(n);
+    if (blocks > MODE2_GPU_PARTIALS) blocks = MODE2_GPU_PARTIALS;
+    double result = 0.0;
+
+    dot_partial_kernel<<<blocks, MODE2_GPU_THREADS>>>(a, b, n, dev->partial);
+    sum_kernel<<<1, MODE2_GPU_THREADS>>>(dev->partial, blocks, dev->scalar);
+    cuda_ok(cudaMemcpy(&result, dev->scalar, sizeof(double), cudaMemcpyDeviceToHost), "dot");
+    return result;
+}
+
+// Device copy of bytes bytes of host; clears *ok (and returns NULL) on failure
+static void* to_device(const void *host, size_t bytes, int *ok) {
+    void *ptr = NULL;
+    if (!*ok || bytes == 0) return NULL;
+    if (!cuda_ok(cudaMalloc(&ptr, bytes), "cudaMalloc") || !cuda_ok(cudaMemcpy(ptr, host, bytes, cudaMemcpyHostToDevice), "cudaMemcpy")) {
+        cudaFree(ptr);
+        *ok = 0;
+        return NULL;
+    }
+    return ptr;
+}
+
+static void* device_alloc(size_t bytes, int *ok) {
+    void *ptr = NULL;
+    if (!*ok) return NULL;
+    if (!cuda_ok(cudaMalloc(&ptr, bytes), "cudaMalloc")) {
+        *ok = 0;
+        return NULL;
+    }
+    return ptr;
+}
+
+static int upload_chi_tables(Mode2Device *dev, const ChiModeSolver *s) {
+    int nb = s->n_blocks, np = s->n_projections;
+    int n_terms = 0, x_size = 0, ok = 1;
+    int *dim = (int *) malloc(nb * sizeof(int));
+    int *x_offset = (int *) malloc(nb * sizeof(int));
+    int *term_start = (int *) malloc((nb + 1) * sizeof(int));
+    double *sign = (double *) malloc(nb * sizeof(double));
+
+    for (int b = 0; b < nb; b++) n_terms += s->blocks[b].n_terms;
+    int *entry = (int *) malloc((n_terms + 1) * sizeof(int));
+    int *proj = (int *) malloc((n_terms + 1) * sizeof(int));
+    double *coef = (double *) malloc((n_terms + 1) * sizeof(double));
+    if (!dim || !x_offset || !term_start || !sign || !entry || !proj || !coef) ok = 0;
+
+    for (int b = 0, t = 0; ok && b < nb; b++) {
+        const ChiBlock *blk = &s->blocks[b];
+        if (blk->dim > MODE2_GPU_MAX_DIM) {
+            fprintf(stderr, "Error: chi block of dimension %d exceeds MODE2_GPU_MAX_DIM.\n", blk->dim);
+            ok = 0;
+            break;
+        }
+        dim[b] = blk->dim;
+        x_offset[b] = x_size;
+        x_size += blk->dim * blk->dim;
+        sign[b] = blk->sign;
+        term_start[b] = t;
+        for (int q = 0; q < blk->n_terms; q++, t++) {
+            entry[t] = blk->entry[q];
+            proj[t] = blk->proj[q];
+            coef[t] = blk->coef[q];
+        }
+        term_start[b + 1] = t;
+    }
+    if (x_size > MODE2_GPU_MAX_X) ok = 0;
+
+    int n_inv = s->inv_start[np];
+    dev->chi.n_blocks = nb;
+    dev->chi.dim = (int *) to_device(dim, nb * sizeof(int), &ok);
+    dev->chi.x_offset = (int *) to_device(x_offset, nb * sizeof(int), &ok);
+    dev->chi.term_start = (int *) to_device(term_start, (nb + 1) * sizeof(int), &ok);
+    dev->chi.sign = (double *) to_device(sign, nb * sizeof(double), &ok);
+    dev->chi.entry = (int *) to_device(entry, (n_terms + 1) * sizeof(int), &ok);
+    dev->chi.proj = (int *) to_device(proj, (n_terms + 1) * sizeof(int), &ok);
+    dev->chi.coef = (double *) to_device(coef, (n_terms + 1) * sizeof(double), &ok);
+    dev->chi.norm = (double *) to_device(s->norm, np * sizeof(double), &ok);
+    dev->chi.inv_start = (int *) to_device(s->inv_start, (np + 1) * sizeof(int), &ok);
+    dev->chi.inv_block = (int *) to_device(s->inv_block, (n_inv + 1) * sizeof(int), &ok);
+    dev->chi.inv_entry = (int *) to_device(s->inv_entry, (n_inv + 1) * sizeof(int), &ok);
+    dev->chi.inv_coef = (double *) to_device(s->inv_coef, (n_inv + 1) * sizeof(double), &ok);
+
+    free(dim); free(x_offset); free(term_start); free(sign);
+    free(entry); free(proj); free(coef);
+    return ok;
+}
+
+int mode2_gpu_available(void) {
+    int count = 0;
+    return cudaGetDeviceCount(&count) == cudaSuccess && count > 0;
+}
+
+Mode2Device* create_mode2_device(const ChiModeSolver *chi, const double *r, const double *k, int nodes, \
+                                 int depth) {
+    if (!mode2_gpu_available()) return NULL;
+
+    Mode2Device *dev = (Mode2Device *) calloc(1, sizeof(Mode2Device));
+    if (!dev) return NULL;
+
+    int np = chi->n_projections, ok = 1;
+    size_t size = (size_t) np * nodes;
+    dev->n_projections = np;
+    dev->n = nodes;
+    dev->depth = (depth > 0) ? depth : 0;
+
+    dev->lmax = 0;
+    for (int p = 0; p < np; p++) if (chi->l[p] > dev->lmax) dev->lmax = chi->l[p];
+
+    if (cublasCreate(&dev->blas) != CUBLAS_STATUS_SUCCESS) {
+        fprintf(stderr, "Error: cuBLAS could not be initialised.\n");
+        free(dev);
+        return NULL;
+    }
+
+    dev->r = (double *) to_device(r, nodes * sizeof(double), &ok);
+    dev->k = (double *) to_device(k, nodes * sizeof(double), &ok);
+    dev->c = (double *) device_alloc(size * sizeof(double), &ok);
+    dev->c_new = (double *) device_alloc(size * sizeof(double), &ok);
+    dev->h = (double *) device_alloc(size * sizeof(double), &ok);
+    dev->eta = (double *) device_alloc(size * sizeof(double), &ok);
+    dev->C_k = (double *) device_alloc(size * sizeof(double), &ok);
+    dev->H_k = (double *) device_alloc(size * sizeof(double), &ok);
+    dev->f = (double *) device_alloc(size * sizeof(double), &ok);
+    dev->pack_in = (double *) device_alloc(size * sizeof(double), &ok);
+    dev->pack_out = (double *) device_alloc(size * sizeof(double), &ok);
+    dev->c_prev = (double *) device_alloc(size * sizeof(double), &ok);
+    dev->f_prev = (double *) device_alloc(size * sizeof(double), &ok);
+    dev->partial = (double *) device_alloc(MODE2_GPU_PARTIALS * sizeof(double), &ok);
+    dev->scalar = (double *) device_alloc(sizeof(double), &ok);
+    if (dev->depth > 0) {
+        dev->dc = (double *) device_alloc(dev->depth * size * sizeof(double), &ok);
+        dev->df = (double *) device_alloc(dev->depth * size * sizeof(double), &ok);
+        dev->gamma_dev = (double *) device_alloc(dev->depth * sizeof(double), &ok);
+    }
+    dev->gram = (double *) malloc((dev->depth > 0 ? dev->depth * dev->depth : 1) * sizeof(double));
+    dev->gamma = (double *) malloc((dev->depth > 0 ? dev->depth : 1) * sizeof(double));
+    if (!dev->gram || !dev->gamma) ok = 0;
+
+    // Projections grouped by l, and one Bessel table per l in use
+    int *group = (int *) malloc(np * sizeof(int));
+    dev->group_start = (int *) malloc((dev->lmax + 2) * sizeof(int));
+    dev->table = (double **) calloc(dev->lmax + 1, sizeof(double *));
+    if (!group || !dev->group_start || !dev->table) ok = 0;
+    for (int l = 0, g = 0; ok && l <= dev->lmax; l++) {
+        dev->group_start[l] = g;
+        for (int p = 0; p < np; p++) if (chi->l[p] == l) group[g++] = p;
+        dev->group_start[l + 1] = g;
+        if (dev->group_start[l + 1] == dev->group_start[l]) continue;
+
+        dev->table[l] = (double *) device_alloc((size_t) nodes * nodes * sizeof(double), &ok);
+        if (ok) bessel_table_kernel<<<blocks_for((size_t) nodes * nodes), MODE2_GPU_THREADS>>>(dev->table[l], l, dev->r, dev->k, nodes);
+    }
+    dev->group = (int *) to_device(group, np * sizeof(int), &ok);
+    free(group);
+
+    if (ok) ok = upload_chi_tables(dev, chi);
+    if (ok) ok = cuda_ok(cudaDeviceSynchronize(), "setup");
+
+    if (!ok) {
+        free_mode2_device(dev);
+        return NULL;
+    }
+
+    size_t free_bytes = 0, total_bytes = 0;
+    cudaMemGetInfo(&free_bytes, &total_bytes);
+    printf("GPU: %.1f MB of Bessel tables and arrays on the device (%.1f MB free)\n", \
+           (double) (total_bytes - free_bytes) / (1024.0 * 1024.0), (double) free_bytes / (1024.0 * 1024.0));
+    return dev;
+}
+
+void free_mode2_device(Mode2Device *dev) {
+    if (!dev) return;
+
+    double *arrays[] = {dev->r, dev->k, dev->c, dev->c_new, dev->h, dev->eta, dev->C_k, dev->H_k, dev->f,
+                        dev->pack_in, dev->pack_out, dev->dc, dev->df,
+                        dev->c_prev, dev->f_prev, dev->gamma_dev, dev->partial, dev->scalar,
+                        dev->chi.sign, dev->chi.coef, dev->chi.norm, dev->chi.inv_coef};
+    for (size_t a = 0; a < sizeof(arrays) / sizeof(arrays[0]); a++) cudaFree(arrays[a]);
+
+    int *indices[] = {dev->group, dev->chi.dim, dev->chi.x_offset, dev->chi.term_start, dev->chi.entry,
+                      dev->chi.proj, dev->chi.inv_start, dev->chi.inv_block, dev->chi.inv_entry};
+    for (size_t a = 0; a < sizeof(indices) / sizeof(indices[0]); a++) cudaFree(indices[a]);
+
+    if (dev->table) {
+        for (int l = 0; l <= dev->lmax; l++) cudaFree(dev->table[l]);
+        free(dev->table);
+    }
+    free(dev->group_start);
+    free(dev->gram);
+    free(dev->gamma);
+    if (dev->blas) cublasDestroy(dev->blas);
+    free(dev);
+}
+
+void mode2_device_upload(Mode2Device *dev, const ProjectionMatrix *c) {
+    cuda_ok(cudaMemcpy2D(dev->c, dev->n * sizeof(double), c->block, c->stride * sizeof(double),
+                         dev->n * sizeof(double), dev->n_projections, cudaMemcpyHostToDevice), "upload");
+}
+
+static void download(const Mode2Device *dev, const double *src, ProjectionMatrix *dst) {
+    if (!dst) return;
+    cuda_ok(cudaMemcpy2D(dst->block, dst->stride * sizeof(double), src, dev->n * sizeof(double),
+                         dev->n * sizeof(double), dev->n_projections, cudaMemcpyDeviceToHost), "download");
+}
+
+void mode2_device_download(const Mode2Device *dev, ProjectionMatrix *c, ProjectionMatrix *h, \
+                           ProjectionMatrix *C_k, ProjectionMatrix *H_k) {
+    download(dev, dev->c, c);
+    download(dev, dev->h, h);
+    download(dev, dev->C_k, C_k);
+    download(dev, dev->H_k, H_k);
+}
+
+/*
+ * out[p][i] = prefactor sum_j x_j^2 in[p][j] j_l(y_i x_j), as transform_mode2:
+ * Y (m x N) = prefactor X (m x N) K^T in row-major terms, i.e. one column-major
+ * dgemm per l.
+ */
+static void device_transform(Mode2Device *dev, const double *in, double *out, const double *x, double prefactor) {
+    int n = dev->n;
+    const double zero = 0.0;
+
+    for (int l = 0; l <= dev->lmax; l++) {
+        int g0 = dev->group_start[l], m = dev->group_start[l + 1] - g0;
+        if (m == 0) continue;
+
+        pack_kernel<<<blocks_for((size_t) m * n), MODE2_GPU_THREADS>>>(in, dev->pack_in, dev->group + g0, m, x, n);
+        cublasDgemm(dev->blas, CUBLAS_OP_T, CUBLAS_OP_N, n, m, n, &prefactor, dev->table[l], n,
+                    dev->pack_in, n, &zero, dev->pack_out, n);
+        unpack_kernel<<<blocks_for((size_t) m * n), MODE2_GPU_THREADS>>>(dev->pack_out, out, dev->group + g0, m, n);
+    }
+}
+
+void mode2_device_forward(Mode2Device *dev, double prefactor) {
+    device_transform(dev, dev->c, dev->C_k, dev->r, prefactor);
+    cuda_ok(cudaDeviceSynchronize(), "forward transform");
+}
+
+void mode2_device_oz(Mode2Device *dev, double rho) {
+    chi_solve_kernel<<<blocks_for(dev->n), MODE2_GPU_THREADS>>>(dev->chi, dev->C_k, dev->H_k, dev->n,
+                                                               dev->n_projections, rho);
+    cuda_ok(cudaDeviceSynchronize(), "chi solve");
+}
+
+void mode2_device_inverse(Mode2Device *dev, double prefactor) {
+    device_transform(dev, dev->H_k, dev->h, dev->k, prefactor);
+    cuda_ok(cudaDeviceSynchronize(), "inverse transform");
+}
+
+void mode2_device_closure(Mode2Device *dev, int closureID, double beta_mu2, double sigma, int i112) {
+    closure_kernel<<<blocks_for(dev->n), MODE2_GPU_THREADS>>>(dev->c_new, dev->c, dev->h, dev->eta, dev->r, dev->n,
+                                                             dev->n_projections, closureID, beta_mu2, sigma, i112);
+    cuda_ok(cudaDeviceSynchronize(), "closure");
+}
+
+double mode2_device_residual(Mode2Device *dev) {
+    size_t size = (size_t) dev->n_projections * dev->n;
+    axpy_kernel<<<blocks_for(size), MODE2_GPU_THREADS>>>(dev->f, dev->c_new, -1.0, dev->c, size);
+    return sqrt(device_dot(dev, dev->f, dev->f, size) / size);
+}
+
+void mode2_device_step(Mode2Device *dev, double beta, int reset) {
+    size_t size = (size_t) dev->n_projections * dev->n;
+
+    if (reset) {
+        dev->count = 0;
+        dev->head = 0;
+        dev->has_previous = 0;
+    }
+
+    // Record (dc, df) against the previous step
+    if (dev->depth > 0 && dev->has_previous) {
+        record_kernel<<<blocks_for(size), MODE2_GPU_THREADS>>>(dev->dc + (size_t) dev->head * size,
+                                                              dev->df + (size_t) dev->head * size,
+                                                              dev->c, dev->c_prev, dev->f, dev->f_prev, size);
+        dev->head = (dev->head + 1) % dev->depth;
+        if (dev->count < dev->depth) dev->count++;
+    }
+    cudaMemcpy(dev->c_prev, dev->c, size * sizeof(double), cudaMemcpyDeviceToDevice);
+    cudaMemcpy(dev->f_prev, dev->f, size * sizeof(double), cudaMemcpyDeviceToDevice);
+    dev->has_previous = 1;
+
+    int m = dev->count, use_history = 0;
+    if (m > 0) {
+        double trace = 0.0;
+        for (int a = 0; a < m; a++) {
+            const double *dfa = dev->df + (size_t) a * size;
+            for (int b = a; b < m; b++) {
+                double g = device_dot(dev, dfa, dev->df + (size_t) b * size, size);
+                dev->gram[a*m + b] = g;
+                dev->gram[b*m + a] = g;
+            }
+            dev->gamma[a] = device_dot(dev, dfa, dev->f, size);
+            trace += dev->gram[a*m + a];
+        }
+
+        // Tikhonov regularization, as anderson_step
+        for (int a = 0; a < m; a++) dev->gram[a*m + a] += 1e-10 * trace / m + 1e-300;
+
+        use_history = (mixing_solve_small_system(dev->gram, dev->gamma, m) == 0);
+        if (use_history) cudaMemcpy(dev->gamma_dev, dev->gamma, m * sizeof(double), cudaMemcpyHostToDevice);
+    }
+
+    anderson_update_kernel<<<blocks_for(size), MODE2_GPU_THREADS>>>(dev->c, dev->f, dev->dc, dev->df, dev->gamma_dev,
+                                                                   use_history ? m : 0, beta, size);
+    cuda_ok(cudaDeviceSynchronize(), "mixing");
+}
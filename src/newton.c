@@ -0,0 +1,368 @@
+/**
+ * @file newton.c
+ * @brief Jacobian-free Newton-Krylov solver for the spherical OZ equation.
+ *
+ * The fixed point gamma = ONg(gamma) that the Ng iteration converges to is
+ * found as the root of F(gamma) = ONg(gamma) - gamma. Each Newton step
+ * solves J s = -F with one cycle of GMRES, where J v is a forward
+ * difference of ONg, and is then damped by a backtracking line search.
+ * The same products give the tangent dgamma/drho of a converged solution
+ * (TangentPressure_ctx).
+ */
+
+#include "newton.h"
+#include "math_aux.h"
+#include "structures.h"
+#include "oz_telemetry.h"
+#include <float.h>
+#include <string.h>
+
+static double nk_dot(const double *a, const double *b, int n) {
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+/*
+ * F(g) = ONg(g) - g. og receives ONg(g). Returns Pres_ctx of F, the
+ * measure the Ng iteration compares with EZ.
+ */
+static double nk_residual(const OZContext *ctx, double *g, double *og, double *F, int potentialID, int closureID, \
+                          double *cFuncMatrix, double T, double alpha) {
+    int n = ctx->nrows*ctx->ncols;
+    double eta;
+
+    ONg_ctx(ctx, g, og, potentialID, closureID, cFuncMatrix, T, 0.0, alpha);
+    for (int i = 0; i < n; i++) F[i] = og[i] - g[i];
+
+    Pres_ctx(ctx, F, ctx->dr, &eta);
+    return eta;
+}
+
+/*
+ * w = J v = dONg/dgamma v - v at g (og = ONg(g)) by a forward difference
+ * of size eps along v/|v|. gp and ogp are scratch.
+ */
+static void nk_jv(const OZContext *ctx, double *g, double *og, const double *v, double *w, double eps, \
+                  double *gp, double *ogp, int potentialID, int closureID, double *cFuncMatrix, double T, double alpha) {
+    int n = ctx->nrows*ctx->ncols;
+    double vnorm = sqrt(nk_dot(v, v, n));
+
+    if (vnorm == 0.0) {
+        for (int i = 0; i < n; i++) w[i] = 0.0;
+        return;
+    }
+
+    double h = eps / vnorm;
+    for (int i = 0; i < n; i++) gp[i] = g[i] + h * v[i];
+    ONg_ctx(ctx, gp, ogp, potentialID, closureID, cFuncMatrix, T, 0.0, alpha);
+    for (int i = 0; i < n; i++) w[i] = (ogp[i] - og[i]) / h - v[i];
+}
+
+/*
+ * One GMRES cycle for J s = -F at g (og = ONg(g)), stopping when the
+ * linear residual drops by the factor forcing.
+ */
+static void nk_gmres(const OZContext *ctx, double *g, double *og, double *F, double *s, double forcing, \
+                     double *V, double *w, double *gp, double *ogp, int potentialID, int closureID, \
+                     double *cFuncMatrix, double T, double alpha) {
+
+    const int m = NK_KRYLOV_DIM;
+    int n = ctx->nrows*ctx->ncols;
+    int i, j, k;
+    double H[(NK_KRYLOV_DIM + 1) * NK_KRYLOV_DIM];
+    double cs[NK_KRYLOV_DIM], sn[NK_KRYLOV_DIM], e[NK_KRYLOV_DIM + 1], y[NK_KRYLOV_DIM];
+    double beta, gnorm, eps, tmp;
+
+    memset(H, 0, sizeof(H));
+    for (i = 0; i < n; i++) s[i] = 0.0;
+
+    beta = sqrt(nk_dot(F, F, n));
+    if (beta == 0.0) return;
+
+    gnorm = sqrt(nk_dot(g, g, n));
+    eps = sqrt(DBL_EPSILON) * (1.0 + gnorm);
+
+    for (i = 0; i < n; i++) V[i] = -F[i] / beta;
+    e[0] = beta;
+
+    k = 0;
+    for (j = 0; j < m; j++) {
+        double *vj = V + (size_t) j*n;
+
+        // w = J vj by a forward difference of ONg
+        nk_jv(ctx, g, og, vj, w, eps, gp, ogp, potentialID, closureID, cFuncMatrix, T, alpha);
+
+        // Modified Gram-Schmidt
+        for (i = 0; i <= j; i++) {
+            double *vi = V + (size_t) i*n;
+            H[i*m + j] = nk_dot(w, vi, n);
+            for (int l = 0; l < n; l++) w[l] -= H[i*m + j] * vi[l];
+        }
+        H[(j+1)*m + j] = sqrt(nk_dot(w, w, n));
+
+        if (j + 1 < m && H[(j+1)*m + j] > 0.0) {
+            double *vn = V + (size_t) (j+1)*n;
+            for (i = 0; i < n; i++) vn[i] = w[i] / H[(j+1)*m + j];
+        }
+
+        // Apply the previous Givens rotations to the new column
+        for (i = 0; i < j; i++) {
+            tmp = cs[i]*H[i*m + j] + sn[i]*H[(i+1)*m + j];
+            H[(i+1)*m + j] = -sn[i]*H[i*m + j] + cs[i]*H[(i+1)*m + j];
+            H[i*m + j] = tmp;
+        }
+
+        tmp = hypot(H[j*m + j], H[(j+1)*m + j]);
+        if (tmp == 0.0) break;
+        cs[j] = H[j*m + j] / tmp;
+        sn[j] = H[(j+1)*m + j] / tmp;
+        H[j*m + j] = tmp;
+        H[(j+1)*m + j] = 0.0;
+
+        e[j+1] = -sn[j] * e[j];
+        e[j] = cs[j] * e[j];
+        k = j + 1;
+
+        if (fabs(e[j+1]) <= forcing * beta) break;
+    }
+
+    // Back substitution and s = V y
+    for (i = k - 1; i >= 0; i--) {
+        y[i] = e[i];
+        for (j = i + 1; j < k; j++) y[i] -= H[i*m + j] * y[j];
+        y[i] /= H[i*m + i];
+    }
+    for (j = 0; j < k; j++) {
+        double *vj = V + (size_t) j*n;
+        for (i = 0; i < n; i++) s[i] += y[j] * vj[i];
+    }
+}
+
+int NewtonKrylov_ctx(OZContext *ctxIn, int step, double *gammaInput, double *gammaOutput, int potentialID, int closureID, \
+                     double *cFuncMatrix, double T, double TFlag, double alpha, double EZ) {
+
+    int i, it, bt;
+    int n = ctxIn->nrows*ctxIn->ncols;
+    int converged = 0;
+    double eta, etaOld, etaTrial, lambda, forcing;
+    double *g, *og, *F, *s, *gt, *ogt, *Ft, *w, *V, *tmp;
+    double *bufs[9];
+
+    // The float-rounded sinft makes ONg noisy at the 1e-7 level, far above
+    // the finite-difference step; the copy shares the arrays and the arena
+    OZContext local = *ctxIn;
+    const OZContext *ctx = &local;
+    local.fft_double = 1;
+
+    size_t mark = oz_mark(ctx);
+    g   = oz_alloc(ctx, n);
+    og  = oz_alloc(ctx, n);
+    F   = oz_alloc(ctx, n);
+    s   = oz_alloc(ctx, n);
+    gt  = oz_alloc(ctx, n);
+    ogt = oz_alloc(ctx, n);
+    Ft  = oz_alloc(ctx, n);
+    w   = oz_alloc(ctx, n);
+    V   = oz_alloc(ctx, (size_t) NK_KRYLOV_DIM * n);
+
+    if (g == NULL || og == NULL || F == NULL || s == NULL || gt == NULL || ogt == NULL || Ft == NULL || w == NULL || V == NULL) {
+        printf("Memory allocation failed in NewtonKrylov.\n");
+        // Leave the input as the result so the caller's Ng fallback starts from it
+        for (i = 0; i < n; i++) {
+            gammaOutput[i] = gammaInput[i];
+        }
+        oz_free(ctx, g);
+        oz_free(ctx, og);
+        oz_free(ctx, F);
+        oz_free(ctx, s);
+        oz_free(ctx, gt);
+        oz_free(ctx, ogt);
+        oz_free(ctx, Ft);
+        oz_free(ctx, w);
+        oz_free(ctx, V);
+        oz_release(ctx, mark);
+        return -1;
+    }
+
+    // The iterate buffers are swapped below; keep the originals to free them
+    bufs[0] = g;  bufs[1] = og;  bufs[2] = F;  bufs[3] = s;  bufs[4] = gt;
+    bufs[5] = ogt; bufs[6] = Ft; bufs[7] = w;  bufs[8] = V;
+
+    for (i = 0; i < n; i++) {
+        g[i] = gammaInput[i];
+        gammaOutput[i] = gammaInput[i];
+    }
+
+    eta = nk_residual(ctx, g, og, F, potentialID, closureID, cFuncMatrix, T, alpha);
+    etaOld = eta;
+    forcing = NK_FORCING_MAX;
+
+    for (it = 0; it < NK_MAX_ITER && isfinite(eta); it++) {
+
+        if (eta <= EZ) {
+            converged = 1;
+            break;
+        }
+
+        // Eisenstat-Walker choice 2: tighten the linear solve as F drops
+        if (it > 0) {
+            forcing = 0.9 * (eta / etaOld) * (eta / etaOld);
+            if (forcing > NK_FORCING_MAX) forcing = NK_FORCING_MAX;
+        }
+
+        // gt and ogt double as the perturbed state inside GMRES
+        nk_gmres(ctx, g, og, F, s, forcing, V, w, gt, ogt, potentialID, closureID, cFuncMatrix, T, alpha);
+
+        // Backtracking on the residual norm
+        lambda = 1.0;
+        for (bt = 0; bt <= NK_MAX_BACKTRACK; bt++) {
+            for (i = 0; i < n; i++) gt[i] = g[i] + lambda * s[i];
+            etaTrial = nk_residual(ctx, gt, ogt, Ft, potentialID, closureID, cFuncMatrix, T, alpha);
+            if (isfinite(etaTrial) && etaTrial <= (1.0 - 1.0E-4 * lambda) * eta) break;
+            lambda *= 0.5;
+        }
+        if (bt > NK_MAX_BACKTRACK) break;
+
+        tmp = g;  g  = gt;  gt  = tmp;
+        tmp = og; og = ogt; ogt = tmp;
+        tmp = F;  F  = Ft;  Ft  = tmp;
+        etaOld = eta;
+        eta = etaTrial;
+
+        for (i = 0; i < n; i++) gammaOutput[i] = g[i];
+
+        if (oz_telemetry_active) {
+            oz_telemetry_emit("newton", step, ctx->rho, it + 1, eta, -1, ctx->ws ? ctx->ws->arena_allocs : 0, \
+                              ctx->ws ? ctx->ws->heap_allocs : oz_heap_alloc_count());
+        }
+    }
+
+    if (!converged && eta <= EZ) converged = 1;
+
+    if (converged) {
+        // Leave gamma and c(r) as the Ng iteration does: gammaOutput = ONg(gamma)
+        ONg_ctx(ctx, g, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha);
+    }
+
+    for (i = 0; i < 9; i++) oz_free(ctx, bufs[i]);
+    oz_release(ctx, mark);
+
+    ctxIn->ng_residual = eta;
+
+    return converged ? it : -1;
+}
+
+/*
+ * beta*P of gamma + h*dgamma at density rho + h, with c from the closure
+ * as Ng leaves it. gp and c are scratch.
+ */
+static double tl_pressure(const OZContext *ctx, const double *gamma, const double *dgamma, double h, double *gp, double *c, \
+                          int potentialID, int closureID, double alpha) {
+    int n = ctx->nrows*ctx->ncols;
+    double pv, chic, ener;
+    OZContext shifted = *ctx;
+    shifted.rho = ctx->rho + h;
+
+    for (int i = 0; i < n; i++) gp[i] = gamma[i] + h * dgamma[i];
+    closrel_ctx(&shifted, gp, potentialID, closureID, c, 1.0, alpha);
+    Termo_ctx(&shifted, gp, c, &pv, &chic, &ener);
+    return pv;
+}
+
+int TangentPressure_ctx(const OZContext *ctxIn, double *gamma, int potentialID, int closureID, double alpha, double *dpdrho) {
+
+    int i, cycle;
+    int n = ctxIn->nrows*ctxIn->ncols;
+    int converged = 0;
+    double h, eps, bnorm, rnorm, p1, p2;
+    double *og, *b, *x, *R, *s, *w, *gp, *ogp, *c, *V;
+
+    // Forward differences need the full-precision transform (see NewtonKrylov_ctx)
+    OZContext local = *ctxIn;
+    const OZContext *ctx = &local;
+    local.fft_double = 1;
+
+    size_t mark = oz_mark(ctx);
+    og  = oz_alloc(ctx, n);
+    b   = oz_alloc(ctx, n);
+    x   = oz_alloc(ctx, n);
+    R   = oz_alloc(ctx, n);
+    s   = oz_alloc(ctx, n);
+    w   = oz_alloc(ctx, n);
+    gp  = oz_alloc(ctx, n);
+    ogp = oz_alloc(ctx, n);
+    c   = oz_alloc(ctx, n);
+    V   = oz_alloc(ctx, (size_t) NK_KRYLOV_DIM * n);
+
+    if (og == NULL || b == NULL || x == NULL || R == NULL || s == NULL || w == NULL || gp == NULL || ogp == NULL || \
+        c == NULL || V == NULL) {
+        printf("Memory allocation failed in TangentPressure.\n");
+        oz_free(ctx, og);
+        oz_free(ctx, b);
+        oz_free(ctx, x);
+        oz_free(ctx, R);
+        oz_free(ctx, s);
+        oz_free(ctx, w);
+        oz_free(ctx, gp);
+        oz_free(ctx, ogp);
+        oz_free(ctx, c);
+        oz_free(ctx, V);
+        oz_release(ctx, mark);
+        return 1;
+    }
+
+    // b = dONg/drho at fixed gamma
+    ONg_ctx(ctx, gamma, og, potentialID, closureID, c, 1.0, 0.0, alpha);
+    h = sqrt(DBL_EPSILON) * local.rho;
+    local.rho = ctxIn->rho + h;
+    ONg_ctx(ctx, gamma, ogp, potentialID, closureID, c, 1.0, 0.0, alpha);
+    local.rho = ctxIn->rho;
+    for (i = 0; i < n; i++) b[i] = (ogp[i] - og[i]) / h;
+
+    // J x = -b with J = dONg/dgamma - I; each cycle solves for the correction of the residual R = J x + b
+    eps = sqrt(DBL_EPSILON) * (1.0 + sqrt(nk_dot(gamma, gamma, n)));
+    bnorm = sqrt(nk_dot(b, b, n));
+    for (i = 0; i < n; i++) {
+        x[i] = 0.0;
+        R[i] = b[i];
+    }
+    rnorm = bnorm;
+
+    for (cycle = 0; cycle < TL_MAX_CYCLES && isfinite(rnorm); cycle++) {
+        if (rnorm <= TL_TOL * bnorm) {
+            converged = 1;
+            break;
+        }
+        nk_gmres(ctx, gamma, og, R, s, TL_TOL * bnorm / rnorm, V, w, gp, ogp, potentialID, closureID, c, 1.0, alpha);
+        for (i = 0; i < n; i++) x[i] += s[i];
+
+        nk_jv(ctx, gamma, og, x, w, eps, gp, ogp, potentialID, closureID, c, 1.0, alpha);
+        for (i = 0; i < n; i++) R[i] = w[i] + b[i];
+        rnorm = sqrt(nk_dot(R, R, n));
+    }
+    if (!converged && rnorm <= TL_TOL * bnorm) converged = 1;
+
+    // Central difference of beta*P along (dgamma/drho, 1): closures and quadratures only
+    if (converged) {
+        h = TL_DRHO_REL * ctxIn->rho;
+        p2 = tl_pressure(ctx, gamma, x, h, gp, c, potentialID, closureID, alpha);
+        p1 = tl_pressure(ctx, gamma, x, -h, gp, c, potentialID, closureID, alpha);
+        *dpdrho = (p2 - p1) / (2.0 * h);
+        if (!isfinite(*dpdrho)) converged = 0;
+    }
+
+    oz_free(ctx, og);
+    oz_free(ctx, b);
+    oz_free(ctx, x);
+    oz_free(ctx, R);
+    oz_free(ctx, s);
+    oz_free(ctx, w);
+    oz_free(ctx, gp);
+    oz_free(ctx, ogp);
+    oz_free(ctx, c);
+    oz_free(ctx, V);
+    oz_release(ctx, mark);
+
+    return converged ? 0 : 1;
+}
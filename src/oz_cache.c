@@ -0,0 +1,295 @@
+/**
+ * @file oz_cache.c
+ * @brief Solution cache behind --cache: bin snapshots keyed by state point.
+ *
+ * An entry file holds the key as file-level attributes and one point with
+ * converged, iterations, residual, rho and alpha and the datasets "r" and
+ * "data". The lookup reads only the attributes of every file in the
+ * directory and loads the datasets of the nearest one.
+ */
+
+#include "oz_cache.h"
+#include "oz_output.h"
+#include "facdes2Y.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define OZ_CACHE_EXTENSION ".ozc"
+#define OZ_CACHE_PATH      1024
+
+OZCacheEntry* create_oz_cache_entry(const OZCacheKey *key, int n_columns, int n_rows) {
+    OZCacheEntry *entry = calloc(1, sizeof(OZCacheEntry));
+    if (!entry) return NULL;
+
+    entry->key = *key;
+    entry->n_columns = n_columns;
+    entry->n_rows = n_rows;
+    entry->r = malloc((size_t) n_rows * sizeof(double));
+    entry->data = malloc((size_t) n_columns * n_rows * sizeof(double));
+
+    if (!entry->r || !entry->data) {
+        free_oz_cache_entry(entry);
+        return NULL;
+    }
+    return entry;
+}
+
+void free_oz_cache_entry(OZCacheEntry *entry) {
+    if (!entry) return;
+
+    free(entry->r);
+    free(entry->data);
+    free(entry);
+}
+
+// <dir>/<solver>_<closure>_p<potential>_m<mmax>_n<nodes>_r<rmax>_<params>_<state>.ozc
+static void cache_file_name(char *path, size_t size, const char *dir, const OZCacheKey *key) {
+    int used = snprintf(path, size, "%s/%s_%s_p%d_m%d_n%d_r%.6g_%.6g_%.6g_%.6g", dir, key->solver, key->closure, \
+                        key->potential, key->mmax, key->nodes, key->rmax, key->params[0], key->params[1], key->params[2]);
+    for (int s = 0; s < key->n_state && used < (int) size; s++) {
+        used += snprintf(path + used, size - used, "_%.6g", key->state[s]);
+    }
+    if (used < (int) size) snprintf(path + used, size - used, "%s", OZ_CACHE_EXTENSION);
+}
+
+int oz_cache_save(const char *dir, const OZCacheEntry *entry) {
+    const OZCacheKey *key = &entry->key;
+    char path[OZ_CACHE_PATH], tmp[OZ_CACHE_PATH + 32], name[16];
+
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: No se pudo crear el directorio de caché %s.\n", dir);
+        return 1;
+    }
+
+    cache_file_name(path, sizeof(path), dir, key);
+    // mkstemp gives every writer (process or sweep thread) its own temporary file
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+    int fd = mkstemp(tmp);
+    if (fd < 0) {
+        fprintf(stderr, "Error: No se pudo escribir la entrada de caché %s.\n", path);
+        return 1;
+    }
+    fchmod(fd, 0644);       // mkstemp creates it 0600
+    close(fd);
+
+    OZOutput *out = create_oz_output(tmp, OZ_OUTPUT_BIN);
+    if (!out) {
+        remove(tmp);
+        return 1;
+    }
+
+    int status = oz_output_attr_string(out, "format", "oz-cache") | \
+                 oz_output_attr_string(out, "solver", key->solver) | \
+                 oz_output_attr_string(out, "closure", key->closure) | \
+                 oz_output_attr_int(out, "potential", key->potential) | \
+                 oz_output_attr_int(out, "mmax", key->mmax) | \
+                 oz_output_attr_int(out, "nodes", key->nodes) | \
+                 oz_output_attr_double(out, "rmax", key->rmax) | \
+                 oz_output_attr_int(out, "n_state", key->n_state);
+    for (int i = 0; i < 3; i++) {
+        snprintf(name, sizeof(name), "param%d", i);
+        status |= oz_output_attr_double(out, name, key->params[i]);
+    }
+    for (int s = 0; s < key->n_state; s++) {
+        snprintf(name, sizeof(name), "state%d", s);
+        status |= oz_output_attr_double(out, name, key->state[s]);
+    }
+
+    const double *col[1] = {entry->r};
+    const double **columns = malloc(entry->n_columns * sizeof(double*));
+    if (!columns) {
+        printf("Memory allocation failed in oz_cache_save.\n");
+        free_oz_output(out);
+        remove(tmp);
+        return 1;
+    }
+    for (int c = 0; c < entry->n_columns; c++) columns[c] = entry->data + (size_t) c * entry->n_rows;
+
+    status |= oz_output_begin_point(out) | \
+              oz_output_attr_int(out, "converged", entry->converged) | \
+              oz_output_attr_int(out, "iterations", entry->iterations) | \
+              oz_output_attr_double(out, "residual", entry->residual) | \
+              oz_output_attr_double(out, "rho", entry->rho) | \
+              oz_output_attr_double(out, "alpha", entry->alpha) | \
+              oz_output_dataset(out, "r", "r", col, 1, entry->n_rows) | \
+              oz_output_dataset(out, "data", "data", (const double *const *) columns, entry->n_columns, entry->n_rows) | \
+              oz_output_end_point(out);
+    free(columns);
+    free_oz_output(out);
+
+    if (status || rename(tmp, path) != 0) {
+        fprintf(stderr, "Error: No se pudo escribir la entrada de caché %s.\n", path);
+        remove(tmp);
+        return 1;
+    }
+    return 0;
+}
+
+// Reads the key of an entry file; 0 on success
+static int read_cache_key(const OZPointData *pd, OZCacheKey *key) {
+    const char *format = oz_point_string(pd, "format");
+    const char *solver = oz_point_string(pd, "solver");
+    const char *closure = oz_point_string(pd, "closure");
+    double value;
+    char name[16];
+
+    if (!format || strcmp(format, "oz-cache") != 0 || !solver || !closure) return 1;
+
+    memset(key, 0, sizeof(OZCacheKey));
+    snprintf(key->solver, sizeof(key->solver), "%s", solver);
+    snprintf(key->closure, sizeof(key->closure), "%s", closure);
+
+    if (oz_point_number(pd, "potential", &value)) return 1;
+    key->potential = (int) value;
+    if (oz_point_number(pd, "mmax", &value)) return 1;
+    key->mmax = (int) value;
+    if (oz_point_number(pd, "nodes", &value)) return 1;
+    key->nodes = (int) value;
+    if (oz_point_number(pd, "rmax", &key->rmax)) return 1;
+    if (oz_point_number(pd, "n_state", &value) || value < 0 || value > OZ_CACHE_MAX_STATE) return 1;
+    key->n_state = (int) value;
+
+    for (int i = 0; i < 3; i++) {
+        snprintf(name, sizeof(name), "param%d", i);
+        if (oz_point_number(pd, name, &key->params[i])) return 1;
+    }
+    for (int s = 0; s < key->n_state; s++) {
+        snprintf(name, sizeof(name), "state%d", s);
+        if (oz_point_number(pd, name, &key->state[s])) return 1;
+    }
+    return 0;
+}
+
+static int same_value(double a, double b) {
+    return fabs(a - b) <= 1e-9 * fmax(1.0, fmax(fabs(a), fabs(b)));
+}
+
+// RMS relative state distance, or -1 if the entry cannot seed key
+static double cache_distance(const OZCacheKey *entry, const OZCacheKey *key) {
+    if (strcmp(entry->solver, key->solver) != 0 || strcmp(entry->closure, key->closure) != 0 || \
+        entry->potential != key->potential || entry->mmax != key->mmax || entry->n_state != key->n_state) {
+        return -1.0;
+    }
+    for (int i = 0; i < 3; i++) {
+        if (!same_value(entry->params[i], key->params[i])) return -1.0;
+    }
+
+    double sum = 0.0;
+    for (int s = 0; s < key->n_state; s++) {
+        double scale = fmax(fabs(key->state[s]), 1e-12);
+        double d = (entry->state[s] - key->state[s]) / scale;
+        sum += d * d;
+    }
+    return (key->n_state > 0) ? sqrt(sum / key->n_state) : 0.0;
+}
+
+// 1 if candidate a (same grid sa, converged ca) beats b at equal distance
+static int cache_better(double da, int sa, int ca, double db, int sb, int cb) {
+    if (da != db) return da < db;
+    if (sa != sb) return sa > sb;
+    return ca > cb;
+}
+
+OZCacheEntry* oz_cache_nearest(const char *dir, const OZCacheKey *key, double max_distance) {
+    DIR *d = opendir(dir);
+    if (!d) return NULL;
+
+    char path[OZ_CACHE_PATH], best_path[OZ_CACHE_PATH] = "";
+    double best_distance = -1.0;
+    int best_grid = 0, best_converged = 0;
+    size_t ext = strlen(OZ_CACHE_EXTENSION);
+    struct dirent *item;
+
+    while ((item = readdir(d)) != NULL) {
+        size_t len = strlen(item->d_name);
+        if (len <= ext || strcmp(item->d_name + len - ext, OZ_CACHE_EXTENSION) != 0) continue;
+
+        snprintf(path, sizeof(path), "%s/%s", dir, item->d_name);
+        OZPointData *pd = read_oz_point(path, 0, 0);
+        if (!pd) continue;
+
+        OZCacheKey stored;
+        double converged = 0.0;
+        if (read_cache_key(pd, &stored) == 0) {
+            double distance = cache_distance(&stored, key);
+            int grid = (stored.nodes == key->nodes && same_value(stored.rmax, key->rmax));
+            oz_point_number(pd, "converged", &converged);
+
+            if (distance >= 0.0 && distance <= max_distance && \
+                (best_distance < 0.0 || \
+                 cache_better(distance, grid, converged != 0.0, best_distance, best_grid, best_converged))) {
+                best_distance = distance;
+                best_grid = grid;
+                best_converged = (converged != 0.0);
+                snprintf(best_path, sizeof(best_path), "%s", path);
+            }
+        }
+        free_oz_point(pd);
+    }
+    closedir(d);
+
+    if (best_distance < 0.0) return NULL;
+
+    OZPointData *pd = read_oz_point(best_path, 0, 1);
+    if (!pd) return NULL;
+
+    OZCacheKey stored;
+    int nr_r, nc_r, nc, nr;
+    const double *r = oz_point_dataset(pd, "r", &nc_r, &nr_r);
+    const double *data = oz_point_dataset(pd, "data", &nc, &nr);
+    OZCacheEntry *entry = NULL;
+
+    if (read_cache_key(pd, &stored) == 0 && r && data && nr_r == nr && nr >= 3) {
+        entry = create_oz_cache_entry(&stored, nc, nr);
+    }
+    if (entry) {
+        double value = 0.0;
+        memcpy(entry->r, r, (size_t) nr * sizeof(double));
+        memcpy(entry->data, data, (size_t) nc * nr * sizeof(double));
+        if (oz_point_number(pd, "converged", &value) == 0) entry->converged = (int) value;
+        if (oz_point_number(pd, "iterations", &value) == 0) entry->iterations = (int) value;
+        oz_point_number(pd, "residual", &entry->residual);
+        oz_point_number(pd, "rho", &entry->rho);
+        oz_point_number(pd, "alpha", &entry->alpha);
+        entry->distance = best_distance;
+    }
+    free_oz_point(pd);
+
+    return entry;
+}
+
+int oz_fit_columns(const double *r_in, const double *data, int n_in, int n_columns, \
+                   const double *r, int n_rows, double *out) {
+    // Same grid: exact copy, so a checkpoint resumes where it stopped
+    int same = (n_rows == n_in);
+    for (int i = 0; same && i < n_rows; i++) same = (r[i] == r_in[i]);
+    if (same) {
+        memcpy(out, data, (size_t) n_columns * n_rows * sizeof(double));
+        return 0;
+    }
+
+    // Output points inside [r_in[0], r_in[n_in-1]]: i0 .. i1-1
+    int i0 = 0, i1 = n_rows;
+    while (i0 < n_rows && r[i0] < r_in[0]) i0++;
+    while (i1 > i0 && r[i1-1] > r_in[n_in-1]) i1--;
+
+    for (int c = 0; c < n_columns; c++) {
+        const double *y_in = data + (size_t) c * n_in;
+        double *y = out + (size_t) c * n_rows;
+
+        for (int i = 0; i < i0; i++) y[i] = y_in[0];
+        if (i1 > i0) interpolationFunc((double *) r_in, (double *) y_in, (double *) r + i0, y + i0, n_in, i1 - i0);
+        for (int i = i1; i < n_rows; i++) y[i] = 0.0;
+    }
+    return 0;
+}
+
+int oz_cache_fit(const OZCacheEntry *entry, const double *r, int n_rows, double *out) {
+    return oz_fit_columns(entry->r, entry->data, entry->n_rows, entry->n_columns, r, n_rows, out);
+}
@@ -0,0 +1,315 @@
+#include "structures.h"
+#include "oz_context.h"
+#include "newton.h"
+#include <pthread.h>
+#include <stdarg.h>
+
+// Buffer alignment in doubles (64 bytes)
+#define OZ_ALIGN 8
+
+// Scratch needed by the deepest call chain, in nrows*ncols matrices and
+// nrows columns: adaptive OZ2 (6) + RY search (3) + Newton-GMRES (8 and
+// the Krylov basis; Ng needs 9) + ONg (2) matrices on the iteration path,
+// and OZ2 + Escribe (4) + the padded FT_fast buffers on the output path
+#define OZ_WS_MATRICES (20 + NK_KRYLOV_DIM)
+#define OZ_WS_COLUMNS  16
+#define OZ_WS_SMALL    64       // Per-buffer alignment slack and ncols vectors
+
+static size_t heap_alloc_count = 0;
+static pthread_mutex_t heap_alloc_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static OZWorkspace* create_oz_workspace(int nrows, int ncols) {
+    OZWorkspace *ws = malloc(sizeof(OZWorkspace));
+    if (!ws) return NULL;
+
+    ws->capacity = (size_t) nrows * (OZ_WS_MATRICES*ncols + OZ_WS_COLUMNS) + OZ_WS_SMALL*OZ_ALIGN;
+    ws->used = 0;
+    ws->high_water = 0;
+    ws->arena_allocs = 0;
+    ws->heap_allocs = 0;
+
+    if (posix_memalign((void **) &ws->base, OZ_ALIGN * sizeof(double), ws->capacity * sizeof(double)) != 0) {
+        free(ws);
+        return NULL;
+    }
+
+    return ws;
+}
+
+static void free_oz_workspace(OZWorkspace *ws) {
+    if (!ws) return;
+    free(ws->base);
+    free(ws);
+}
+
+double* oz_alloc(const OZContext *ctx, size_t n) {
+    OZWorkspace *ws = ctx->ws;
+    size_t padded = (n + OZ_ALIGN - 1) / OZ_ALIGN * OZ_ALIGN;
+
+    if (ws != NULL && ws->used + padded <= ws->capacity) {
+        double *p = ws->base + ws->used;
+        ws->used += padded;
+        if (ws->used > ws->high_water) ws->high_water = ws->used;
+        ws->arena_allocs++;
+        return p;
+    }
+
+    if (ws != NULL) ws->heap_allocs++;
+    pthread_mutex_lock(&heap_alloc_lock);
+    heap_alloc_count++;
+    pthread_mutex_unlock(&heap_alloc_lock);
+
+    return malloc(n * sizeof(double));
+}
+
+void oz_free(const OZContext *ctx, double *p) {
+    OZWorkspace *ws = ctx->ws;
+
+    if (ws != NULL && p >= ws->base && p < ws->base + ws->capacity) return;
+    free(p);
+}
+
+size_t oz_mark(const OZContext *ctx) {
+    return ctx->ws ? ctx->ws->used : 0;
+}
+
+void oz_release(const OZContext *ctx, size_t mark) {
+    if (ctx->ws && mark <= ctx->ws->used) ctx->ws->used = mark;
+}
+
+size_t oz_heap_alloc_count(void) {
+    size_t count;
+
+    pthread_mutex_lock(&heap_alloc_lock);
+    count = heap_alloc_count;
+    pthread_mutex_unlock(&heap_alloc_lock);
+
+    return count;
+}
+
+void oz_columns_from_rows(const OZContext *ctx, const double *rows, double *cols) {
+    for (int k = 0; k < ctx->ncols; k++) {
+        for (int i = 0; i < ctx->nrows; i++) {
+            cols[i + k*ctx->nrows] = rows[i*ctx->ncols + k];
+        }
+    }
+}
+
+void oz_columns_to_rows(const OZContext *ctx, const double *cols, double *rows) {
+    for (int i = 0; i < ctx->nrows; i++) {
+        for (int k = 0; k < ctx->ncols; k++) {
+            rows[i*ctx->ncols + k] = cols[i + k*ctx->nrows];
+        }
+    }
+}
+
+// nrows*ncols matrix with 64-byte aligned columns (see OZContext)
+static double* create_oz_matrix(int nrows, int ncols) {
+    double *p;
+    if (posix_memalign((void **) &p, OZ_ALIGN * sizeof(double), (size_t) nrows * ncols * sizeof(double)) != 0) return NULL;
+    return p;
+}
+
+static OZRYMixing* create_oz_ry_mixing(int nrows) {
+    OZRYMixing *mix = malloc(sizeof(OZRYMixing));
+    if (!mix) return NULL;
+
+    mix->alpha = -1.0;
+    mix->f = malloc(nrows * sizeof(double));
+    if (!mix->f) {
+        free(mix);
+        return NULL;
+    }
+
+    return mix;
+}
+
+static void free_oz_ry_mixing(OZRYMixing *mix) {
+    if (!mix) return;
+    free(mix->f);
+    free(mix);
+}
+
+static OZClosureTables* create_oz_closure_tables(int nrows, int ncols) {
+    OZClosureTables *tab = malloc(sizeof(OZClosureTables));
+    if (!tab) return NULL;
+
+    tab->potential = -1;
+    tab->closure = 0;
+    tab->T = 0.0;
+    tab->w = create_oz_matrix(nrows, ncols);
+    if (!tab->w) {
+        free(tab);
+        return NULL;
+    }
+
+    return tab;
+}
+
+static void free_oz_closure_tables(OZClosureTables *tab) {
+    if (!tab) return;
+    free(tab->w);
+    free(tab);
+}
+
+// Rogers-Young search state of the legacy entry points (persists across calls)
+static double legacy_ry_dif[2] = {0.0};
+static int legacy_ry_ix = 1;
+
+OZContext* create_oz_context(int nodes, double rmax) {
+    OZContext *ctx = malloc(sizeof(OZContext));
+    if (!ctx) return NULL;
+
+    ctx->nrows = nodes;
+    ctx->ncols = 3;
+    ctx->rmax = rmax;
+    ctx->rho = 0.0;
+    ctx->dr = rmax / ((double) nodes);
+    ctx->x[0] = 1.0;
+    ctx->x[1] = 0.0;
+    ctx->owns_arrays = 1;
+    ctx->ry_dif[0] = 0.0;
+    ctx->ry_dif[1] = 0.0;
+    ctx->ry_ix = 1;
+    ctx->pv = 0.0;
+    ctx->chic = 0.0;
+    ctx->ener = 0.0;
+    ctx->chiv = NAN;
+    ctx->ry_alpha = 0.0;
+    ctx->ry_alpha_seed = 0.0;
+    ctx->ry_evals = 0;
+    ctx->ramp_mode = OZ_RAMP_FIXED;
+    ctx->predictor_order = 2;
+    ctx->ng_max_iter = 0;
+    ctx->multigrid_levels = 0;
+    ctx->solver = OZ_SOLVER_NG;
+    ctx->thermo_mode = OZ_THERMO_FD;
+    ctx->fft_double = 0;
+    ctx->ramp_steps = 0;
+    ctx->ramp_rejected = 0;
+    ctx->ng_iter = 0;
+    ctx->ng_residual = 0.0;
+    ctx->verbose = 1;
+    ctx->k_out = NULL;
+    ctx->n_out = 0;
+    ctx->ck_out = NULL;
+    ctx->sk_out = NULL;
+    ctx->potential_table = NULL;
+
+    ctx->r        = malloc(nodes * sizeof(double));
+    ctx->q        = malloc(nodes * sizeof(double));
+    ctx->U        = create_oz_matrix(nodes, ctx->ncols);
+    ctx->Up       = create_oz_matrix(nodes, ctx->ncols);
+    ctx->sigmaVec = malloc(ctx->ncols * sizeof(double));
+    ctx->gamma    = create_oz_matrix(nodes, ctx->ncols);
+    ctx->ck       = malloc(nodes * sizeof(double));
+    ctx->cr       = malloc(nodes * sizeof(double));
+    ctx->ws       = create_oz_workspace(nodes, ctx->ncols);
+    ctx->fft      = oz_fft_plan_create(nodes, ctx->ncols);
+    ctx->fft_pad  = oz_fft_plan_create(FT_PAD * nodes, 1);
+    ctx->ry_mix   = create_oz_ry_mixing(nodes);
+    ctx->closure_tab = create_oz_closure_tables(nodes, ctx->ncols);
+
+    if (!ctx->r || !ctx->q || !ctx->U || !ctx->Up || !ctx->sigmaVec || !ctx->gamma || !ctx->ck || !ctx->cr || !ctx->ws || \
+        !ctx->fft || !ctx->fft_pad || !ctx->ry_mix || !ctx->closure_tab) {
+        free_oz_context(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+void free_oz_context(OZContext *ctx) {
+    if (!ctx) return;
+
+    if (ctx->owns_arrays) {
+        free(ctx->r);
+        free(ctx->q);
+        free(ctx->U);
+        free(ctx->Up);
+        free(ctx->sigmaVec);
+        free(ctx->gamma);
+        free(ctx->ck);
+        free(ctx->cr);
+        free_oz_workspace(ctx->ws);
+        oz_fft_plan_free(ctx->fft);
+        oz_fft_plan_free(ctx->fft_pad);
+        free_oz_ry_mixing(ctx->ry_mix);
+        free_oz_closure_tables(ctx->closure_tab);
+    }
+    free(ctx);
+}
+
+OZContext oz_legacy_context(void) {
+    OZContext ctx;
+
+    ctx.nrows = nrows;
+    ctx.ncols = ncols;
+    ctx.rmax = (nrows > 0) ? dr * nrows : 0.0;
+    ctx.rho = rho;
+    ctx.dr = dr;
+    ctx.x[0] = x[0];
+    ctx.x[1] = x[1];
+    ctx.r = r;
+    ctx.q = q;
+    ctx.U = U;
+    ctx.Up = Up;
+    ctx.sigmaVec = sigmaVec;
+    ctx.gamma = NULL;
+    ctx.ck = NULL;
+    ctx.cr = NULL;
+    ctx.k_out = NULL;
+    ctx.n_out = 0;
+    ctx.ck_out = NULL;
+    ctx.sk_out = NULL;
+    ctx.pv = 0.0;
+    ctx.chic = 0.0;
+    ctx.ener = 0.0;
+    ctx.chiv = NAN;
+    ctx.ry_alpha = 0.0;
+    ctx.ry_alpha_seed = 0.0;
+    ctx.ry_evals = 0;
+    ctx.ws = NULL;
+    ctx.ramp_mode = OZ_RAMP_FIXED;
+    ctx.predictor_order = 2;
+    ctx.ng_max_iter = 0;
+    ctx.multigrid_levels = 0;
+    ctx.solver = OZ_SOLVER_NG;
+    ctx.thermo_mode = OZ_THERMO_FD;
+    ctx.fft_double = 0;
+    ctx.fft = NULL;
+    ctx.fft_pad = NULL;
+    ctx.ry_mix = NULL;
+    ctx.closure_tab = NULL;
+    ctx.potential_table = NULL;
+    ctx.ramp_steps = 0;
+    ctx.ramp_rejected = 0;
+    ctx.ng_iter = 0;
+    ctx.ng_residual = 0.0;
+    ctx.verbose = 1;
+    ctx.owns_arrays = 0;
+    ctx.ry_dif[0] = legacy_ry_dif[0];
+    ctx.ry_dif[1] = legacy_ry_dif[1];
+    ctx.ry_ix = legacy_ry_ix;
+
+    return ctx;
+}
+
+void oz_legacy_sync(const OZContext *ctx) {
+    rho = ctx->rho;
+    dr = ctx->dr;
+    x[0] = ctx->x[0];
+    x[1] = ctx->x[1];
+    legacy_ry_dif[0] = ctx->ry_dif[0];
+    legacy_ry_dif[1] = ctx->ry_dif[1];
+    legacy_ry_ix = ctx->ry_ix;
+}
+
+void oz_log(const OZContext *ctx, const char *fmt, ...) {
+    if (!ctx->verbose) return;
+
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
@@ -0,0 +1,140 @@
+/**
+ * @file oz_fft.c
+ * @brief Sine-transform backends behind FFTM_ctx and FT_fast_ctx.
+ *
+ * Default: the Numerical Recipes sinft of math_aux.c, one column at a time
+ * (n a power of 2). With -DOZ_USE_FFTW: one FFTW RODFT00 plan per grid
+ * size over all columns, built once when the context is created.
+ */
+
+#include "oz_fft.h"
+#include "math_aux.h"
+#include <stdlib.h>
+
+#ifdef OZ_USE_FFTW
+#include <fftw3.h>
+#include <pthread.h>
+
+// The FFTW planner is not thread-safe; sweep workers create contexts concurrently
+static pthread_mutex_t planner_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct OZFFTPlan {
+    int n;
+    int howmany;
+    fftw_plan plan;         // RODFT00 of size n-1 on elements 1..n-1 of each column
+};
+
+OZFFTPlan* oz_fft_plan_create(int n, int howmany) {
+    if (n < 2 || howmany < 1) return NULL;
+
+    OZFFTPlan *plan = malloc(sizeof(OZFFTPlan));
+    if (!plan) return NULL;
+
+    int size = n - 1;
+    // FFTW_MEASURE overwrites the array it plans on, so plan on scratch;
+    // FFTW_UNALIGNED lets the plan run on any solver matrix afterwards
+    double *scratch = fftw_malloc((size_t) n * howmany * sizeof(double));
+    if (!scratch) {
+        free(plan);
+        return NULL;
+    }
+
+    fftw_r2r_kind kind = FFTW_RODFT00;
+
+    pthread_mutex_lock(&planner_lock);
+    plan->plan = fftw_plan_many_r2r(1, &size, howmany, scratch + 1, NULL, 1, n, \
+                                    scratch + 1, NULL, 1, n, &kind, FFTW_MEASURE | FFTW_UNALIGNED);
+    pthread_mutex_unlock(&planner_lock);
+
+    fftw_free(scratch);
+
+    if (!plan->plan) {
+        free(plan);
+        return NULL;
+    }
+
+    plan->n = n;
+    plan->howmany = howmany;
+
+    return plan;
+}
+
+void oz_fft_plan_free(OZFFTPlan *plan) {
+    if (!plan) return;
+
+    pthread_mutex_lock(&planner_lock);
+    fftw_destroy_plan(plan->plan);
+    pthread_mutex_unlock(&planner_lock);
+
+    free(plan);
+}
+
+void oz_fft_sine(const OZFFTPlan *plan, double *data, int fullPrecision) {
+    int i, k;
+    double *col;
+
+    (void) fullPrecision;
+
+    fftw_execute_r2r(plan->plan, data + 1, data + 1);
+
+    // RODFT00 is 2 * sum_j y[j] sin(pi j k / n)
+    for (k = 0; k < plan->howmany; k++) {
+        col = data + (size_t) k*plan->n;
+        col[0] = 0.0;
+        for (i = 1; i < plan->n; i++) col[i] *= 0.5;
+    }
+}
+
+int oz_fft_size_supported(int n) {
+    return n >= 2;
+}
+
+const char* oz_fft_backend(void) {
+    return "fftw";
+}
+
+#else
+
+struct OZFFTPlan {
+    int n;
+    int howmany;
+};
+
+OZFFTPlan* oz_fft_plan_create(int n, int howmany) {
+    if (!oz_fft_size_supported(n) || howmany < 1) return NULL;
+
+    OZFFTPlan *plan = malloc(sizeof(OZFFTPlan));
+    if (!plan) return NULL;
+
+    plan->n = n;
+    plan->howmany = howmany;
+
+    return plan;
+}
+
+void oz_fft_plan_free(OZFFTPlan *plan) {
+    free(plan);
+}
+
+void oz_fft_sine(const OZFFTPlan *plan, double *data, int fullPrecision) {
+    int k;
+
+    // Columns are contiguous, so sinft runs on them in place
+    for (k = 0; k < plan->howmany; k++) {
+        if (fullPrecision) {
+            sinft_double(data + (size_t) k*plan->n, plan->n);
+        } else {
+            sinft(data + (size_t) k*plan->n, plan->n);
+        }
+    }
+}
+
+int oz_fft_size_supported(int n) {
+    return n >= 2 && (n & (n - 1)) == 0;
+}
+
+const char* oz_fft_backend(void) {
+    return "nr";
+}
+
+#endif
@@ -0,0 +1,643 @@
+/**
+ * @file oz_output.c
+ * @brief Binary and HDF5 writers behind --output-format.
+ *
+ * bin: after the header, every item is a tagged record
+ *   char tag[4], uint64 payload size, payload
+ * with tags ATTR (key, type, value), PBEG (point index), DSET (name,
+ * column labels, n_columns, n_rows, doubles column by column) and PEND.
+ * Readers skip unknown tags by their size. With -DOZ_USE_HDF5 the same
+ * calls build extendable HDF5 datasets instead. read_oz_point reads a bin
+ * point back (the solution cache uses it).
+ */
+
+#include "oz_output.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef OZ_USE_HDF5
+#include <hdf5.h>
+#endif
+
+#define OZ_BIN_MAGIC      "OZBIN\0\0\0"
+#define OZ_BIN_VERSION    1
+#define OZ_BIN_BYTE_ORDER 0x01020304u   // Written natively; read_oz_point swaps files of the other endianness
+#define OZ_BIN_BUFFER     (1 << 20)     // stdio buffer, so a dataset is one large write
+
+// ATTR value types
+#define OZ_ATTR_INT    1        // int64
+#define OZ_ATTR_DOUBLE 2        // double
+#define OZ_ATTR_STRING 3        // uint32 length + bytes
+
+#define OZ_H5_SCALAR_CHUNK 256  // Points per chunk of the /points arrays
+
+struct OZOutput {
+    OZOutputFormat format;
+    int n_points;           // Points completed
+    int in_point;           // 1 between begin_point and end_point
+    FILE *file;             // bin
+    char *buffer;           // bin stdio buffer
+#ifdef OZ_USE_HDF5
+    hid_t h5;               // hdf5 file
+    hid_t points;           // /points group (created with the first point)
+#endif
+};
+
+int oz_output_parse_format(const char *name, OZOutputFormat *format) {
+    if (strcmp(name, "text") == 0) *format = OZ_OUTPUT_TEXT;
+    else if (strcmp(name, "bin") == 0) *format = OZ_OUTPUT_BIN;
+    else if (strcmp(name, "hdf5") == 0) *format = OZ_OUTPUT_HDF5;
+    else return 1;
+    return 0;
+}
+
+int oz_output_format_available(OZOutputFormat format) {
+#ifdef OZ_USE_HDF5
+    return format == OZ_OUTPUT_TEXT || format == OZ_OUTPUT_BIN || format == OZ_OUTPUT_HDF5;
+#else
+    return format == OZ_OUTPUT_TEXT || format == OZ_OUTPUT_BIN;
+#endif
+}
+
+const char* oz_output_extension(OZOutputFormat format) {
+    switch (format) {
+        case OZ_OUTPUT_BIN:  return ".bin";
+        case OZ_OUTPUT_HDF5: return ".h5";
+        default:             return ".dat";
+    }
+}
+
+int oz_output_point_count(const OZOutput *out) {
+    return out->n_points;
+}
+
+// ---------------------------------------------------------------
+// bin
+// ---------------------------------------------------------------
+
+static int bin_write(OZOutput *out, const void *p, size_t size) {
+    return fwrite(p, 1, size, out->file) != size;
+}
+
+static int bin_record(OZOutput *out, const char tag[4], uint64_t size) {
+    return bin_write(out, tag, 4) | bin_write(out, &size, sizeof(size));
+}
+
+static int bin_string(OZOutput *out, const char *s, int wide) {
+    size_t len = strlen(s);
+    int status;
+
+    if (wide) {
+        uint32_t n = (uint32_t) len;
+        status = bin_write(out, &n, sizeof(n));
+    } else {
+        uint16_t n = (uint16_t) len;
+        status = bin_write(out, &n, sizeof(n));
+    }
+    return status | bin_write(out, s, len);
+}
+
+static int bin_attr(OZOutput *out, const char *key, uint8_t type, const void *value, size_t value_size) {
+    uint64_t size = sizeof(uint16_t) + strlen(key) + 1 + value_size;
+    int status = bin_record(out, "ATTR", size) | bin_string(out, key, 0) | bin_write(out, &type, 1);
+
+    if (type == OZ_ATTR_STRING) return status | bin_string(out, value, 1);
+    return status | bin_write(out, value, value_size);
+}
+
+static int bin_open(OZOutput *out, const char *path) {
+    uint32_t order = OZ_BIN_BYTE_ORDER;
+    uint32_t version = OZ_BIN_VERSION;
+
+    out->file = fopen(path, "wb");
+    if (!out->file) return 1;
+
+    out->buffer = malloc(OZ_BIN_BUFFER);
+    if (out->buffer) setvbuf(out->file, out->buffer, _IOFBF, OZ_BIN_BUFFER);
+
+    return bin_write(out, OZ_BIN_MAGIC, 8) | bin_write(out, &order, sizeof(order)) | \
+           bin_write(out, &version, sizeof(version));
+}
+
+// ---------------------------------------------------------------
+// hdf5
+// ---------------------------------------------------------------
+
+#ifdef OZ_USE_HDF5
+
+static int h5_string_attr(hid_t obj, const char *key, const char *value) {
+    hid_t type = H5Tcopy(H5T_C_S1);
+    hid_t space = H5Screate(H5S_SCALAR);
+    int status = 1;
+
+    H5Tset_size(type, strlen(value) + 1);
+    hid_t attr = H5Acreate2(obj, key, type, space, H5P_DEFAULT, H5P_DEFAULT);
+    if (attr >= 0) {
+        status = H5Awrite(attr, type, value) < 0;
+        H5Aclose(attr);
+    }
+    H5Sclose(space);
+    H5Tclose(type);
+    return status;
+}
+
+static int h5_scalar_attr(hid_t obj, const char *key, hid_t file_type, hid_t mem_type, const void *value) {
+    hid_t space = H5Screate(H5S_SCALAR);
+    int status = 1;
+
+    hid_t attr = H5Acreate2(obj, key, file_type, space, H5P_DEFAULT, H5P_DEFAULT);
+    if (attr >= 0) {
+        status = H5Awrite(attr, mem_type, value) < 0;
+        H5Aclose(attr);
+    }
+    H5Sclose(space);
+    return status;
+}
+
+// Opens /points/<key>, or creates it as an extendable [n_points] array
+static hid_t h5_point_array(OZOutput *out, const char *key, hid_t file_type) {
+    if (H5Lexists(out->points, key, H5P_DEFAULT) > 0) {
+        return H5Dopen2(out->points, key, H5P_DEFAULT);
+    }
+
+    hsize_t dims = 0, maxdims = H5S_UNLIMITED, chunk = OZ_H5_SCALAR_CHUNK;
+    hid_t space = H5Screate_simple(1, &dims, &maxdims);
+    hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(plist, 1, &chunk);
+    hid_t dset = H5Dcreate2(out->points, key, file_type, space, H5P_DEFAULT, plist, H5P_DEFAULT);
+    H5Pclose(plist);
+    H5Sclose(space);
+    return dset;
+}
+
+// Entry n_points of /points/<key>; points that lacked the key keep the fill value 0
+static int h5_point_value(OZOutput *out, const char *key, hid_t file_type, hid_t mem_type, const void *value) {
+    hid_t dset = h5_point_array(out, key, file_type);
+    if (dset < 0) return 1;
+
+    hsize_t start = (hsize_t) out->n_points, count = 1, size = start + 1;
+    int status = H5Dset_extent(dset, &size) < 0;
+
+    hid_t fspace = H5Dget_space(dset);
+    hid_t mspace = H5Screate_simple(1, &count, NULL);
+    status |= H5Sselect_hyperslab(fspace, H5S_SELECT_SET, &start, NULL, &count, NULL) < 0;
+    if (!status) status = H5Dwrite(dset, mem_type, mspace, fspace, H5P_DEFAULT, value) < 0;
+
+    H5Sclose(mspace);
+    H5Sclose(fspace);
+    H5Dclose(dset);
+    return status;
+}
+
+static int h5_dataset(OZOutput *out, const char *name, const char *columns, const double *const *data, \
+                      int n_columns, int n_rows) {
+    hid_t dset;
+
+    if (H5Lexists(out->h5, name, H5P_DEFAULT) > 0) {
+        dset = H5Dopen2(out->h5, name, H5P_DEFAULT);
+        if (dset < 0) return 1;
+
+        hsize_t dims[3];
+        hid_t space = H5Dget_space(dset);
+        int rank = H5Sget_simple_extent_dims(space, dims, NULL);
+        H5Sclose(space);
+        if (rank != 3 || dims[1] != (hsize_t) n_columns || dims[2] != (hsize_t) n_rows) {
+            fprintf(stderr, "Error: El dataset '%s' cambia de forma entre puntos.\n", name);
+            H5Dclose(dset);
+            return 1;
+        }
+    } else {
+        hsize_t dims[3] = {0, (hsize_t) n_columns, (hsize_t) n_rows};
+        hsize_t maxdims[3] = {H5S_UNLIMITED, (hsize_t) n_columns, (hsize_t) n_rows};
+        hsize_t chunk[3] = {1, 1, (hsize_t) n_rows};
+        hid_t space = H5Screate_simple(3, dims, maxdims);
+        hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
+        H5Pset_chunk(plist, 3, chunk);
+        dset = H5Dcreate2(out->h5, name, H5T_IEEE_F64LE, space, H5P_DEFAULT, plist, H5P_DEFAULT);
+        H5Pclose(plist);
+        H5Sclose(space);
+        if (dset < 0) return 1;
+        if (h5_string_attr(dset, "columns", columns)) {
+            H5Dclose(dset);
+            return 1;
+        }
+    }
+
+    hsize_t size[3] = {(hsize_t) out->n_points + 1, (hsize_t) n_columns, (hsize_t) n_rows};
+    int status = H5Dset_extent(dset, size) < 0;
+
+    hid_t fspace = H5Dget_space(dset);
+    hsize_t count[3] = {1, 1, (hsize_t) n_rows};
+    hsize_t row = (hsize_t) n_rows;
+    hid_t mspace = H5Screate_simple(1, &row, NULL);
+
+    // One chunk per column
+    for (int c = 0; c < n_columns && !status; c++) {
+        hsize_t start[3] = {(hsize_t) out->n_points, (hsize_t) c, 0};
+        status = H5Sselect_hyperslab(fspace, H5S_SELECT_SET, start, NULL, count, NULL) < 0;
+        if (!status) status = H5Dwrite(dset, H5T_NATIVE_DOUBLE, mspace, fspace, H5P_DEFAULT, data[c]) < 0;
+    }
+
+    H5Sclose(mspace);
+    H5Sclose(fspace);
+    H5Dclose(dset);
+    return status;
+}
+
+#endif
+
+// ---------------------------------------------------------------
+// Public interface
+// ---------------------------------------------------------------
+
+OZOutput* create_oz_output(const char *path, OZOutputFormat format) {
+    if (format == OZ_OUTPUT_TEXT || !oz_output_format_available(format)) return NULL;
+
+    OZOutput *out = calloc(1, sizeof(OZOutput));
+    if (!out) return NULL;
+
+    out->format = format;
+
+    if (format == OZ_OUTPUT_BIN) {
+        if (bin_open(out, path)) {
+            free_oz_output(out);
+            return NULL;
+        }
+    }
+#ifdef OZ_USE_HDF5
+    else {
+        out->points = -1;
+        out->h5 = H5Fcreate(path, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+        if (out->h5 < 0 || h5_string_attr(out->h5, "format", "oz-output")) {
+            free_oz_output(out);
+            return NULL;
+        }
+    }
+#endif
+
+    return out;
+}
+
+void free_oz_output(OZOutput *out) {
+    if (!out) return;
+
+    if (out->in_point) oz_output_end_point(out);
+
+    if (out->file) fclose(out->file);
+    free(out->buffer);
+#ifdef OZ_USE_HDF5
+    if (out->format == OZ_OUTPUT_HDF5) {
+        if (out->points >= 0) H5Gclose(out->points);
+        if (out->h5 >= 0) {
+            long n = out->n_points;
+            h5_scalar_attr(out->h5, "n_points", H5T_STD_I64LE, H5T_NATIVE_LONG, &n);
+            H5Fclose(out->h5);
+        }
+    }
+#endif
+    free(out);
+}
+
+int oz_output_attr_string(OZOutput *out, const char *key, const char *value) {
+    if (out->in_point) return 1;
+
+    if (out->format == OZ_OUTPUT_BIN) return bin_attr(out, key, OZ_ATTR_STRING, value, sizeof(uint32_t) + strlen(value));
+#ifdef OZ_USE_HDF5
+    return h5_string_attr(out->h5, key, value);
+#else
+    return 1;
+#endif
+}
+
+int oz_output_attr_int(OZOutput *out, const char *key, long value) {
+    int64_t v = value;
+
+    if (out->format == OZ_OUTPUT_BIN) return bin_attr(out, key, OZ_ATTR_INT, &v, sizeof(v));
+#ifdef OZ_USE_HDF5
+    if (out->in_point) return h5_point_value(out, key, H5T_STD_I64LE, H5T_NATIVE_INT64, &v);
+    return h5_scalar_attr(out->h5, key, H5T_STD_I64LE, H5T_NATIVE_INT64, &v);
+#else
+    return 1;
+#endif
+}
+
+int oz_output_attr_double(OZOutput *out, const char *key, double value) {
+    if (out->format == OZ_OUTPUT_BIN) return bin_attr(out, key, OZ_ATTR_DOUBLE, &value, sizeof(value));
+#ifdef OZ_USE_HDF5
+    if (out->in_point) return h5_point_value(out, key, H5T_IEEE_F64LE, H5T_NATIVE_DOUBLE, &value);
+    return h5_scalar_attr(out->h5, key, H5T_IEEE_F64LE, H5T_NATIVE_DOUBLE, &value);
+#else
+    return 1;
+#endif
+}
+
+int oz_output_begin_point(OZOutput *out) {
+    if (out->in_point) return 1;
+    out->in_point = 1;
+
+    if (out->format == OZ_OUTPUT_BIN) {
+        uint32_t index = (uint32_t) out->n_points;
+        return bin_record(out, "PBEG", sizeof(index)) | bin_write(out, &index, sizeof(index));
+    }
+#ifdef OZ_USE_HDF5
+    if (out->points < 0) {
+        out->points = H5Gcreate2(out->h5, "points", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        if (out->points < 0) return 1;
+    }
+    return 0;
+#else
+    return 1;
+#endif
+}
+
+int oz_output_dataset(OZOutput *out, const char *name, const char *columns, const double *const *data, \
+                      int n_columns, int n_rows) {
+    if (!out->in_point || n_columns < 1 || n_rows < 1) return 1;
+
+    if (out->format == OZ_OUTPUT_BIN) {
+        uint32_t nc = (uint32_t) n_columns, nr = (uint32_t) n_rows;
+        uint64_t size = sizeof(uint16_t) + strlen(name) + sizeof(uint32_t) + strlen(columns) + \
+                        2*sizeof(uint32_t) + (uint64_t) n_columns * n_rows * sizeof(double);
+        int status = bin_record(out, "DSET", size) | bin_string(out, name, 0) | bin_string(out, columns, 1) | \
+                     bin_write(out, &nc, sizeof(nc)) | bin_write(out, &nr, sizeof(nr));
+        for (int c = 0; c < n_columns && !status; c++) {
+            status = bin_write(out, data[c], (size_t) n_rows * sizeof(double));
+        }
+        return status;
+    }
+#ifdef OZ_USE_HDF5
+    return h5_dataset(out, name, columns, data, n_columns, n_rows);
+#else
+    return 1;
+#endif
+}
+
+int oz_output_end_point(OZOutput *out) {
+    if (!out->in_point) return 1;
+    out->in_point = 0;
+    out->n_points++;
+
+    if (out->format == OZ_OUTPUT_BIN) return bin_record(out, "PEND", 0);
+    return 0;
+}
+
+// ---------------------------------------------------------------
+// bin reader
+// ---------------------------------------------------------------
+
+// Reverses the bytes of each of count items of size bytes
+static void bin_swap(void *p, size_t size, size_t count) {
+    unsigned char *b = p;
+
+    for (size_t i = 0; i < count; i++, b += size) {
+        for (size_t lo = 0, hi = size - 1; lo < hi; lo++, hi--) {
+            unsigned char t = b[lo];
+            b[lo] = b[hi];
+            b[hi] = t;
+        }
+    }
+}
+
+// fread of count items; swap: the file has the other endianness
+static int bin_read(FILE *file, void *p, size_t size, size_t count, int swap) {
+    if (fread(p, size, count, file) != count) return 1;
+    if (swap && size > 1) bin_swap(p, size, count);
+    return 0;
+}
+
+static char* bin_read_string(FILE *file, int wide, int swap) {
+    uint32_t len = 0;
+
+    if (wide) {
+        if (bin_read(file, &len, sizeof(len), 1, swap)) return NULL;
+    } else {
+        uint16_t n;
+        if (bin_read(file, &n, sizeof(n), 1, swap)) return NULL;
+        len = n;
+    }
+
+    char *s = malloc((size_t) len + 1);
+    if (!s) return NULL;
+    if (len > 0 && fread(s, 1, len, file) != len) {
+        free(s);
+        return NULL;
+    }
+    s[len] = '\0';
+    return s;
+}
+
+static int point_add_attr(OZPointData *pd, char *key, double value, char *string) {
+    int n = pd->n_attrs + 1;
+    char **keys = realloc(pd->keys, n * sizeof(char*));
+    if (keys) pd->keys = keys;
+    double *values = realloc(pd->values, n * sizeof(double));
+    if (values) pd->values = values;
+    char **strings = realloc(pd->strings, n * sizeof(char*));
+    if (strings) pd->strings = strings;
+    if (!keys || !values || !strings) return 1;
+
+    pd->keys[pd->n_attrs] = key;
+    pd->values[pd->n_attrs] = value;
+    pd->strings[pd->n_attrs] = string;
+    pd->n_attrs = n;
+    return 0;
+}
+
+static int point_add_dataset(OZPointData *pd, char *name, int n_columns, int n_rows, double *data) {
+    int n = pd->n_datasets + 1;
+    char **names = realloc(pd->names, n * sizeof(char*));
+    if (names) pd->names = names;
+    int *nc = realloc(pd->n_columns, n * sizeof(int));
+    if (nc) pd->n_columns = nc;
+    int *nr = realloc(pd->n_rows, n * sizeof(int));
+    if (nr) pd->n_rows = nr;
+    double **d = realloc(pd->data, n * sizeof(double*));
+    if (d) pd->data = d;
+    if (!names || !nc || !nr || !d) return 1;
+
+    pd->names[pd->n_datasets] = name;
+    pd->n_columns[pd->n_datasets] = n_columns;
+    pd->n_rows[pd->n_datasets] = n_rows;
+    pd->data[pd->n_datasets] = data;
+    pd->n_datasets = n;
+    return 0;
+}
+
+// Reads one ATTR payload into pd
+static int bin_read_attr(FILE *file, OZPointData *pd, int swap) {
+    char *key = bin_read_string(file, 0, swap);
+    uint8_t type;
+    double value = 0.0;
+    char *string = NULL;
+
+    if (!key || fread(&type, 1, 1, file) != 1) {
+        free(key);
+        return 1;
+    }
+
+    int status = 0;
+    if (type == OZ_ATTR_INT) {
+        int64_t v;
+        status = bin_read(file, &v, sizeof(v), 1, swap);
+        value = (double) v;
+    } else if (type == OZ_ATTR_DOUBLE) {
+        status = bin_read(file, &value, sizeof(value), 1, swap);
+    } else if (type == OZ_ATTR_STRING) {
+        string = bin_read_string(file, 1, swap);
+        status = (string == NULL);
+    } else {
+        status = 1;
+    }
+
+    if (status || point_add_attr(pd, key, value, string)) {
+        free(key);
+        free(string);
+    }
+    return status;
+}
+
+static int bin_read_dataset(FILE *file, OZPointData *pd, int load_data, int swap) {
+    char *name = bin_read_string(file, 0, swap);
+    char *columns = bin_read_string(file, 1, swap);
+    uint32_t nc, nr;
+    double *data = NULL;
+
+    free(columns);
+    if (!name || bin_read(file, &nc, sizeof(nc), 1, swap) || bin_read(file, &nr, sizeof(nr), 1, swap)) {
+        free(name);
+        return 1;
+    }
+
+    size_t count = (size_t) nc * nr;
+    if (load_data) {
+        data = malloc(count * sizeof(double));
+        if (!data || bin_read(file, data, sizeof(double), count, swap)) {
+            free(name);
+            free(data);
+            return 1;
+        }
+    } else if (fseek(file, (long) (count * sizeof(double)), SEEK_CUR) != 0) {
+        free(name);
+        return 1;
+    }
+
+    if (point_add_dataset(pd, name, (int) nc, (int) nr, data)) {
+        free(name);
+        free(data);
+        return 1;
+    }
+    return 0;
+}
+
+OZPointData* read_oz_point(const char *path, int index, int load_data) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    char magic[8];
+    uint32_t order, version;
+    if (fread(magic, 1, 8, file) != 8 || memcmp(magic, OZ_BIN_MAGIC, 8) != 0 || \
+        fread(&order, sizeof(order), 1, file) != 1) {
+        fclose(file);
+        return NULL;
+    }
+
+    // The marker reads back reversed when the file was written on the other endianness
+    int swap = (order != OZ_BIN_BYTE_ORDER);
+    if (swap) bin_swap(&order, sizeof(order), 1);
+    if (order != OZ_BIN_BYTE_ORDER || bin_read(file, &version, sizeof(version), 1, swap) || version != OZ_BIN_VERSION) {
+        fclose(file);
+        return NULL;
+    }
+
+    OZPointData *pd = calloc(1, sizeof(OZPointData));
+    if (!pd) {
+        fclose(file);
+        return NULL;
+    }
+
+    int point = -1;         // Index of the point being read (-1: file level)
+    int found = 0, status = 0;
+    char tag[4];
+    uint64_t size;
+
+    while (!status && fread(tag, 1, 4, file) == 4 && !bin_read(file, &size, sizeof(size), 1, swap)) {
+        long next = ftell(file) + (long) size;
+        // Only the file level and the requested point are kept
+        int keep = (point < 0 && !found) || point == index;
+
+        if (memcmp(tag, "ATTR", 4) == 0 && keep) {
+            status = bin_read_attr(file, pd, swap);
+        } else if (memcmp(tag, "DSET", 4) == 0 && point == index) {
+            status = bin_read_dataset(file, pd, load_data, swap);
+        } else if (memcmp(tag, "PBEG", 4) == 0) {
+            uint32_t i;
+            status = bin_read(file, &i, sizeof(i), 1, swap);
+            point = (int) i;
+        } else if (memcmp(tag, "PEND", 4) == 0) {
+            if (point == index) found = 1;
+            point = -1;
+        }
+
+        if (found) break;
+        if (!status) status = fseek(file, next, SEEK_SET) != 0;
+    }
+
+    fclose(file);
+
+    if (status || !found) {
+        free_oz_point(pd);
+        return NULL;
+    }
+    return pd;
+}
+
+void free_oz_point(OZPointData *pd) {
+    if (!pd) return;
+
+    for (int i = 0; i < pd->n_attrs; i++) {
+        free(pd->keys[i]);
+        free(pd->strings[i]);
+    }
+    for (int i = 0; i < pd->n_datasets; i++) {
+        free(pd->names[i]);
+        free(pd->data[i]);
+    }
+    free(pd->keys);
+    free(pd->values);
+    free(pd->strings);
+    free(pd->names);
+    free(pd->n_columns);
+    free(pd->n_rows);
+    free(pd->data);
+    free(pd);
+}
+
+int oz_point_number(const OZPointData *pd, const char *key, double *value) {
+    for (int i = pd->n_attrs - 1; i >= 0; i--) {
+        if (strcmp(pd->keys[i], key) == 0 && pd->strings[i] == NULL) {
+            *value = pd->values[i];
+            return 0;
+        }
+    }
+    return 1;
+}
+
+const char* oz_point_string(const OZPointData *pd, const char *key) {
+    for (int i = pd->n_attrs - 1; i >= 0; i--) {
+        if (strcmp(pd->keys[i], key) == 0 && pd->strings[i] != NULL) return pd->strings[i];
+    }
+    return NULL;
+}
+
+const double* oz_point_dataset(const OZPointData *pd, const char *name, int *n_columns, int *n_rows) {
+    for (int i = 0; i < pd->n_datasets; i++) {
+        if (strcmp(pd->names[i], name) == 0 && pd->data[i] != NULL) {
+            if (n_columns) *n_columns = pd->n_columns[i];
+            if (n_rows) *n_rows = pd->n_rows[i];
+            return pd->data[i];
+        }
+    }
+    return NULL;
+}
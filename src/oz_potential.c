@@ -0,0 +1,262 @@
+/**
+ * @file oz_potential.c
+ * @brief Shared U/Up tables of the spherical potentials and tabulated u(r) files.
+ *
+ * The shared tables are a short list behind one mutex, like the
+ * hard-sphere references: entries are never modified after the store and
+ * a lookup copies them out, so dropping the oldest one is always safe.
+ */
+
+#include "oz_potential.h"
+#include <gsl/gsl_spline.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define OZ_UTAB_MAGIC      "OZUTAB\0\0"
+#define OZ_UTAB_BYTE_ORDER 0x01020304u
+#define OZ_UTAB_HEADER     24
+
+// FNV-1a over the bytes of the data block
+static unsigned int fnv1a(const unsigned char *p, size_t n) {
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+OZPotentialTable* oz_potential_table_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: No se pudo abrir la tabla de potencial %s.\n", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < OZ_UTAB_HEADER) {
+        fprintf(stderr, "Error: %s no es una tabla de potencial válida.\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t) st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: No se pudo proyectar en memoria la tabla de potencial %s.\n", path);
+        return NULL;
+    }
+
+    const unsigned char *bytes = map;
+    uint32_t order, n_columns;
+    int64_t n_points;
+    memcpy(&order, bytes + 8, sizeof(order));
+    memcpy(&n_columns, bytes + 12, sizeof(n_columns));
+    memcpy(&n_points, bytes + 16, sizeof(n_points));
+
+    const char *problem = NULL;
+    if (memcmp(bytes, OZ_UTAB_MAGIC, 8) != 0) {
+        problem = "no es una tabla de potencial";
+    } else if (order != OZ_UTAB_BYTE_ORDER) {
+        problem = "fue escrita con el otro orden de bytes";
+    } else if ((n_columns != 2 && n_columns != 3) || n_points < 4 || n_points > INT32_MAX || \
+               size < OZ_UTAB_HEADER + (size_t) n_columns * (size_t) n_points * sizeof(double)) {
+        problem = "tiene una cabecera o un tamaño no válidos";
+    }
+
+    OZPotentialTable *table = problem ? NULL : calloc(1, sizeof(OZPotentialTable));
+    if (table) {
+        const double *data = (const double *) (bytes + OZ_UTAB_HEADER);
+        table->n_points = (int) n_points;
+        table->r = data;
+        table->u = data + n_points;
+        table->du = (n_columns == 3) ? data + 2*n_points : NULL;
+        table->checksum = fnv1a((const unsigned char *) data, (size_t) n_columns * (size_t) n_points * sizeof(double));
+        table->map = map;
+        table->map_size = size;
+
+        for (int i = 1; i < table->n_points; i++) {
+            if (!(table->r[i] > table->r[i-1])) {
+                problem = "no tiene r estrictamente creciente";
+                break;
+            }
+        }
+    } else if (!problem) {
+        problem = "no se pudo cargar (memoria)";
+    }
+
+    if (problem) {
+        fprintf(stderr, "Error: La tabla de potencial %s %s.\n", path, problem);
+        free(table);
+        munmap(map, size);
+        return NULL;
+    }
+    return table;
+}
+
+void oz_potential_table_close(OZPotentialTable *table) {
+    if (!table) return;
+
+    munmap(table->map, table->map_size);
+    free(table);
+}
+
+int oz_potential_table_sample(const OZPotentialTable *table, const double *r, int n, double scale, \
+                              double *U, double *Up) {
+    int m = table->n_points;
+    double r_first = table->r[0];
+    double r_last = table->r[m - 1];
+
+    gsl_interp_accel *acc = gsl_interp_accel_alloc();
+    gsl_interp_accel *acc_du = gsl_interp_accel_alloc();
+    gsl_spline *spline = gsl_spline_alloc(gsl_interp_steffen, m);
+    gsl_spline *spline_du = table->du ? gsl_spline_alloc(gsl_interp_steffen, m) : NULL;
+
+    if (!acc || !acc_du || !spline || (table->du && !spline_du)) {
+        printf("Memory allocation failed in oz_potential_table_sample.\n");
+        gsl_interp_accel_free(acc);
+        gsl_interp_accel_free(acc_du);
+        gsl_spline_free(spline);
+        gsl_spline_free(spline_du);
+        return 1;
+    }
+
+    gsl_spline_init(spline, table->r, table->u, m);
+    if (spline_du) gsl_spline_init(spline_du, table->r, table->du, m);
+
+    for (int i = 0; i < n; i++) {
+        if (r[i] < r_first || r[i] > r_last) {
+            U[i] = 0.0;
+            Up[i] = 0.0;
+        } else {
+            double du = spline_du ? gsl_spline_eval(spline_du, r[i], acc_du) : gsl_spline_eval_deriv(spline, r[i], acc);
+            U[i] = scale * gsl_spline_eval(spline, r[i], acc);
+            Up[i] = -r[i] * scale * du;
+        }
+    }
+
+    gsl_interp_accel_free(acc);
+    gsl_interp_accel_free(acc_du);
+    gsl_spline_free(spline);
+    gsl_spline_free(spline_du);
+    return 0;
+}
+
+typedef struct OZPotentialEntry {
+    OZPotentialKey key;
+    double scale[3];
+    double *U;                  // [nrows*ncols]
+    double *Up;
+    struct OZPotentialEntry *next;
+} OZPotentialEntry;
+
+static OZPotentialEntry *entries = NULL;     // Newest first
+static pthread_mutex_t entries_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int same_key(const OZPotentialKey *a, const OZPotentialKey *b) {
+    return a->potential == b->potential && a->nrows == b->nrows && a->ncols == b->ncols && a->dr == b->dr && \
+           a->sigma[0] == b->sigma[0] && a->sigma[1] == b->sigma[1] && a->sigma[2] == b->sigma[2] && \
+           a->lambda[0] == b->lambda[0] && a->lambda[1] == b->lambda[1] && \
+           a->lambda2[0] == b->lambda2[0] && a->lambda2[1] == b->lambda2[1] && \
+           a->temperature2[0] == b->temperature2[0] && a->temperature2[1] == b->temperature2[1] && \
+           a->xnu == b->xnu && a->table == b->table;
+}
+
+static void free_entry(OZPotentialEntry *entry) {
+    free(entry->U);
+    free(entry->Up);
+    free(entry);
+}
+
+int oz_potential_lookup(const OZPotentialKey *key, const double *scale, double *U, double *Up) {
+    int found = 0;
+
+    pthread_mutex_lock(&entries_lock);
+
+    for (OZPotentialEntry *entry = entries; entry; entry = entry->next) {
+        if (!same_key(&entry->key, key)) continue;
+
+        for (int k = 0; k < key->ncols; k++) {
+            // A ratio of 1 (same temperature) copies the tables bit for bit
+            double ratio = scale[k] / entry->scale[k];
+            size_t off = (size_t) k * key->nrows;
+            for (int i = 0; i < key->nrows; i++) {
+                U[off + i] = entry->U[off + i] * ratio;
+                Up[off + i] = entry->Up[off + i] * ratio;
+            }
+        }
+        found = 1;
+        break;
+    }
+
+    pthread_mutex_unlock(&entries_lock);
+    return found;
+}
+
+void oz_potential_store(const OZPotentialKey *key, const double *scale, const double *U, const double *Up) {
+    size_t n = (size_t) key->nrows * key->ncols;
+
+    // The scale of every column has to be usable as a divisor
+    for (int k = 0; k < key->ncols; k++) {
+        if (!(scale[k] != 0.0)) return;
+    }
+
+    OZPotentialEntry *entry = calloc(1, sizeof(OZPotentialEntry));
+    if (entry) {
+        entry->U = malloc(n * sizeof(double));
+        entry->Up = malloc(n * sizeof(double));
+    }
+    if (!entry || !entry->U || !entry->Up) {
+        if (entry) free_entry(entry);
+        return;
+    }
+
+    entry->key = *key;
+    memcpy(entry->scale, scale, key->ncols * sizeof(double));
+    memcpy(entry->U, U, n * sizeof(double));
+    memcpy(entry->Up, Up, n * sizeof(double));
+
+    pthread_mutex_lock(&entries_lock);
+
+    int count = 0;
+    OZPotentialEntry **link = &entries;
+    for (OZPotentialEntry *e = entries; e; e = e->next) {
+        // Another thread stored this key first
+        if (same_key(&e->key, key)) {
+            pthread_mutex_unlock(&entries_lock);
+            free_entry(entry);
+            return;
+        }
+        if (++count < OZ_POTENTIAL_MAX_ENTRIES) link = &e->next;
+    }
+
+    // Drop the oldest entries beyond the limit
+    while (*link) {
+        OZPotentialEntry *old = *link;
+        *link = old->next;
+        free_entry(old);
+    }
+
+    entry->next = entries;
+    entries = entry;
+
+    pthread_mutex_unlock(&entries_lock);
+}
+
+void oz_potential_clear(void) {
+    pthread_mutex_lock(&entries_lock);
+    while (entries) {
+        OZPotentialEntry *entry = entries;
+        entries = entry->next;
+        free_entry(entry);
+    }
+    pthread_mutex_unlock(&entries_lock);
+}
@@ -0,0 +1,134 @@
+/**
+ * @file oz_solver.c
+ * @brief In-memory solver handle of liboz.
+ *
+ * oz_solver_solve is facdes2YAll without its per-call setup: the context,
+ * the S(k)/g(r) buffers and the previous gamma live in the handle, the
+ * progress output is off and there is no cache or output file.
+ */
+
+#include "oz_solver.h"
+
+struct OZSolver {
+    OZContext *ctx;
+    double *StructFactor;       // [nodes*2] k, S(k) pairs of facdes2YSolve
+    double *Gr_data;            // [nodes*2] r, g(r) pairs
+    double *seed;               // [nrows*ncols] converged gamma of the last solve
+    double seed_rho;
+    double seed_alpha;
+    int seed_potential;         // Potential and closure of seed (seed_potential < 0: no seed)
+    int seed_closure;
+};
+
+void oz_solve_params_default(OZSolveParams *params) {
+    params->potential = 0;
+    params->closure = 2;
+    params->volume_factor = 0.0;
+    params->temperature = 1.0;
+    params->temperature2 = 1.0;
+    params->lambda_a = 0.0;
+    params->lambda_r = 0.0;
+    params->sigma = 1.0;
+    params->alpha = 1.0;
+    params->tolerance = 1.0E-4;
+    params->nrho = 100;
+    params->ramp_mode = OZ_RAMP_ADAPTIVE;
+    params->predictor_order = 2;
+    params->solver = OZ_SOLVER_NG;
+    params->thermo_mode = OZ_THERMO_FD;
+    params->multigrid_levels = 0;
+    params->warm_start = 1;
+    params->potential_table = NULL;
+    params->verbose = 0;
+}
+
+OZSolver* create_oz_solver(int nodes, double rmax) {
+    OZSolver *solver = calloc(1, sizeof(OZSolver));
+    if (!solver) return NULL;
+
+    solver->ctx          = create_oz_context(nodes, rmax);
+    solver->StructFactor = malloc(nodes*2 * sizeof(double));
+    solver->Gr_data      = malloc(nodes*2 * sizeof(double));
+    solver->seed         = malloc((size_t) nodes * 3 * sizeof(double));
+    solver->seed_potential = -1;
+
+    if (!solver->ctx || !solver->StructFactor || !solver->Gr_data || !solver->seed) {
+        free_oz_solver(solver);
+        return NULL;
+    }
+    return solver;
+}
+
+void free_oz_solver(OZSolver *solver) {
+    if (!solver) return;
+
+    free_oz_context(solver->ctx);
+    free(solver->StructFactor);
+    free(solver->Gr_data);
+    free(solver->seed);
+    free(solver);
+}
+
+int oz_solver_solve(OZSolver *solver, const OZSolveParams *params, OZResult *result) {
+    OZContext *ctx = solver->ctx;
+    // facdes2YSolve takes the folder name of the CLI; nothing is written to it
+    char folderName[20] = "";
+    // 1 suppresses the ramp counter of Ng_ctx and the adaptive ramp
+    int printFlag = params->verbose ? 0 : 1;
+
+    if (result->nodes != ctx->nrows) {
+        fprintf(stderr, "Error: oz_solver_solve: result has %d nodes, solver %d.\n", result->nodes, ctx->nrows);
+        return 1;
+    }
+    if (params->potential == 17 && params->potential_table == NULL) {
+        fprintf(stderr, "Error: oz_solver_solve: potential 17 needs params->potential_table.\n");
+        return 1;
+    }
+
+    ctx->verbose = params->verbose;
+    ctx->ramp_mode = params->ramp_mode;
+    ctx->predictor_order = params->predictor_order;
+    ctx->solver = params->solver;
+    ctx->thermo_mode = params->thermo_mode;
+    ctx->multigrid_levels = params->multigrid_levels;
+    ctx->potential_table = params->potential_table;
+    ctx->k_out = result->k_out;
+    ctx->n_out = result->n_out;
+    ctx->ck_out = result->Ck_out;
+    ctx->sk_out = result->Sk_out;
+
+    int warm = params->warm_start && solver->seed_potential == params->potential && \
+               solver->seed_closure == params->closure;
+    ctx->ry_alpha_seed = warm ? solver->seed_alpha : 0.0;
+
+    facdes2YSolve(ctx, params->potential, params->closure, params->sigma, params->sigma, params->temperature, \
+                  params->temperature2, params->lambda_a, params->lambda_r, params->volume_factor, params->alpha, \
+                  params->tolerance, params->nrho, warm ? solver->seed : NULL, solver->seed_rho, \
+                  solver->StructFactor, solver->Gr_data, folderName, &printFlag);
+
+    // A continuation that diverged is redone with the full ramp
+    if (warm && !spherical_cache_usable(ctx)) {
+        oz_log(ctx, "\nLa continuación desde la solución anterior no convergió; rampa completa\n");
+        ctx->ry_alpha_seed = 0.0;
+        facdes2YSolve(ctx, params->potential, params->closure, params->sigma, params->sigma, params->temperature, \
+                      params->temperature2, params->lambda_a, params->lambda_r, params->volume_factor, params->alpha, \
+                      params->tolerance, params->nrho, NULL, 0.0, solver->StructFactor, solver->Gr_data, \
+                      folderName, &printFlag);
+    }
+
+    oz_result_from_context(result, ctx, solver->StructFactor, solver->Gr_data);
+
+    if (!spherical_cache_usable(ctx)) {
+        solver->seed_potential = -1;
+        return 1;
+    }
+
+    // Only a converged gamma seeds the next solve
+    memcpy(solver->seed, ctx->gamma, (size_t) ctx->nrows * ctx->ncols * sizeof(double));
+    solver->seed_rho = ctx->rho;
+    solver->seed_alpha = ctx->ry_alpha;
+    solver->seed_potential = params->potential;
+    solver->seed_closure = params->closure;
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file oz_telemetry.c
+ * @brief Per-iteration solver records behind --telemetry.
+ *
+ * CSV: one header line, then
+ *   point,solver,step,rho,iteration,residual,accepted,precision,transform,oz,closure,mixing,output,arena_allocs,heap_allocs
+ * JSON Lines: one object per record with the same keys.
+ */
+
+#include "oz_telemetry.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+int oz_telemetry_active = 0;
+
+static OZTelemetryCallback callback = NULL;
+static void *callback_user = NULL;
+static pthread_mutex_t sink_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static FILE *file = NULL;
+static int file_csv = 0;
+
+static _Thread_local int thread_point = -1;
+static _Thread_local int thread_step = 0;
+static _Thread_local int thread_precision = 64;
+
+static void write_record(const OZTelemetryRecord *rec, void *user) {
+    (void) user;
+
+    if (file_csv) {
+        fprintf(file, "%d,%s,%d,%.10g,%d,%.6e,%d,%d", rec->point, rec->solver, rec->step, rec->rho, \
+                rec->iteration, rec->residual, rec->accepted, rec->precision);
+        for (int p = 0; p < OZ_N_PHASES; p++) fprintf(file, ",%.6f", rec->seconds[p]);
+        fprintf(file, ",%zu,%zu\n", rec->arena_allocs, rec->heap_allocs);
+    } else {
+        fprintf(file, "{\"point\": %d, \"solver\": \"%s\", \"step\": %d, \"rho\": %.10g, \"iteration\": %d, " \
+                "\"residual\": %.6e, \"accepted\": %d, \"precision\": %d", rec->point, rec->solver, rec->step, \
+                rec->rho, rec->iteration, rec->residual, rec->accepted, rec->precision);
+        for (int p = 0; p < OZ_N_PHASES; p++) fprintf(file, ", \"%s\": %.6f", oz_phase_name((OZPhase) p), rec->seconds[p]);
+        fprintf(file, ", \"arena_allocs\": %zu, \"heap_allocs\": %zu}\n", rec->arena_allocs, rec->heap_allocs);
+    }
+}
+
+void oz_telemetry_set_callback(OZTelemetryCallback cb, void *user) {
+    if (cb != write_record) oz_telemetry_close();
+
+    pthread_mutex_lock(&sink_lock);
+    callback = cb;
+    callback_user = user;
+    oz_telemetry_active = (cb != NULL);
+    pthread_mutex_unlock(&sink_lock);
+}
+
+int oz_telemetry_open(const char *path) {
+    oz_telemetry_close();
+
+    FILE *f = fopen(path, "w");
+    if (!f) return 1;
+
+    size_t len = strlen(path);
+    file = f;
+    file_csv = (len >= 4 && strcmp(path + len - 4, ".csv") == 0);
+
+    if (file_csv) {
+        fprintf(file, "point,solver,step,rho,iteration,residual,accepted,precision");
+        for (int p = 0; p < OZ_N_PHASES; p++) fprintf(file, ",%s", oz_phase_name((OZPhase) p));
+        fprintf(file, ",arena_allocs,heap_allocs\n");
+    }
+
+    oz_telemetry_set_callback(write_record, NULL);
+    return 0;
+}
+
+int oz_telemetry_close(void) {
+    pthread_mutex_lock(&sink_lock);
+    if (callback == write_record) {
+        callback = NULL;
+        callback_user = NULL;
+        oz_telemetry_active = 0;
+    }
+    FILE *f = file;
+    file = NULL;
+    pthread_mutex_unlock(&sink_lock);
+
+    return (f != NULL) ? fclose(f) != 0 : 0;
+}
+
+void oz_telemetry_set_point(int point) {
+    thread_point = point;
+    thread_step = 0;
+}
+
+void oz_telemetry_set_precision(int bits) {
+    thread_precision = bits;
+}
+
+int oz_telemetry_next_step(void) {
+    return ++thread_step;
+}
+
+void oz_telemetry_emit(const char *solver, int step, double rho, int iteration, double residual, int accepted, \
+                       size_t arena_allocs, size_t heap_allocs) {
+    OZTelemetryRecord rec;
+    const OZTimings *t = oz_timings();
+
+    rec.solver = solver;
+    rec.point = thread_point;
+    rec.step = step;
+    rec.rho = rho;
+    rec.iteration = iteration;
+    rec.residual = residual;
+    rec.accepted = accepted;
+    rec.precision = thread_precision;
+    memcpy(rec.seconds, t->seconds, sizeof(rec.seconds));
+    rec.arena_allocs = arena_allocs;
+    rec.heap_allocs = heap_allocs;
+
+    pthread_mutex_lock(&sink_lock);
+    if (callback != NULL) callback(&rec, callback_user);
+    pthread_mutex_unlock(&sink_lock);
+}
@@ -0,0 +1,71 @@
+/**
+ * @file oz_timing.c
+ * @brief Thread-local phase counters behind --timing.
+ */
+
+#include "oz_timing.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static _Thread_local OZTimings timings;
+
+static const char *phase_names[OZ_N_PHASES] = {"transform", "oz", "closure", "mixing", "output"};
+
+double oz_time_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + 1e-9 * (double) ts.tv_nsec;
+}
+
+void oz_timing_stop(OZPhase phase, double t0) {
+    timings.seconds[phase] += oz_time_now() - t0;
+}
+
+void oz_timing_add(OZPhase phase, double seconds) {
+    timings.seconds[phase] += seconds;
+}
+
+void oz_timing_count(long n) {
+    timings.iterations += n;
+}
+
+const OZTimings* oz_timings(void) {
+    return &timings;
+}
+
+void oz_timing_merge(const OZTimings *t) {
+    for (int p = 0; p < OZ_N_PHASES; p++) timings.seconds[p] += t->seconds[p];
+    timings.iterations += t->iterations;
+}
+
+double oz_timing_total(void) {
+    double total = 0.0;
+    for (int p = 0; p < OZ_N_PHASES; p++) total += timings.seconds[p];
+    return total;
+}
+
+void oz_timing_reset(void) {
+    memset(&timings, 0, sizeof(timings));
+}
+
+const char* oz_phase_name(OZPhase phase) {
+    return (phase >= 0 && phase < OZ_N_PHASES) ? phase_names[phase] : "?";
+}
+
+int oz_timing_write_json(const char *path, double wall) {
+    FILE *file = fopen(path, "w");
+    if (!file) return 1;
+
+    double other = wall - oz_timing_total();
+    if (other < 0.0) other = 0.0;
+
+    fprintf(file, "{\"wall\": %.6f, \"iterations\": %ld, \"time_per_iteration\": %.9f,\n \"phases\": {", \
+            wall, timings.iterations, (timings.iterations > 0) ? wall / (double) timings.iterations : 0.0);
+    for (int p = 0; p < OZ_N_PHASES; p++) {
+        fprintf(file, "\"%s\": %.6f, ", phase_names[p], timings.seconds[p]);
+    }
+    fprintf(file, "\"other\": %.6f}}\n", other);
+
+    return fclose(file) != 0;
+}
@@ -1,117 +1,37 @@
 #include "structures_nonspherical.h"
+#include "mixing.h"
 #include "facdes2Y.h"
 #include "math_aux.h"
+#include "hankel_transforms.h"
+#include "chi_modes.h"
+#include "hs_reference.h"
+#include "oz_timing.h"
+#include "oz_telemetry.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
-// Forward declarations of closure functions
-void closure_MSA_dipolar(double **c, double **eta, double *r, int n_points, double beta_mu2, double sigma);
-void closure_LHNC_dipolar(double **c, double **h, double **eta, double *r, int n_points, double beta_mu2, double sigma);
-void closure_QHNC_dipolar(double **c, double **h, double **eta, double *r, int n_points, double beta_mu2, double sigma);
-void closure_RHNC_dipolar(double **c, double **h, double **eta, double *r, int n_points, double beta_mu2, double sigma, double *c_HS, double *h_HS);
-
-/**
- * @brief Solves the OZ equation in k-space for Dipolar Hard Spheres.
- *
- * Uses the chi-basis decoupling (Blum/Wertheim) which reduces the coupled
- * 2x2 system {110, 112} to two independent scalar equations.
- *
- * From the Patey OZ equations:
- *   eta^000 = rho * C000 * H000    (000 decouples)
- *   eta^0   = (rho/3) * C^0 * H^0  (chi=0 mode, C^0 = C110 + 2*C112)
- *   eta^1   = (rho/3) * C^1 * H^1  (chi=1 mode, C^1 = C110 - C112)
- *
- * Recovery: H110 = (H^0 + 2*H^1)/3,  H112 = (H^0 - H^1)/3
- */
-void solve_oz_k_space(double **C_k, double **H_k, int nodes, double rho) {
-    for (int i = 0; i < nodes; i++) {
-        double C000 = C_k[0][i];
-        double C110 = C_k[1][i];
-        double C112 = C_k[2][i];
-
-        // --- 000 mode (decoupled) ---
-        double denom000 = 1.0 - rho * C000;
-        H_k[0][i] = (fabs(denom000) > 1e-12) ? C000 / denom000 : 0.0;
-
-        // --- Chi modes ---
-        double C0 = C110 + 2.0 * C112;  // chi=0: f^0 = f^{110} + 2*f^{112}
-        double C1 = C110 - C112;         // chi=1: f^1 = f^{110} - f^{112}
-
-        double denom0 = 1.0 - (rho / 3.0) * C0;
-        double denom1 = 1.0 - (rho / 3.0) * C1;
-
-        double H0 = (fabs(denom0) > 1e-12) ? C0 / denom0 : 0.0;
-        double H1 = (fabs(denom1) > 1e-12) ? C1 / denom1 : 0.0;
-
-        // --- Recover Patey projections ---
-        H_k[1][i] = (H0 + 2.0 * H1) / 3.0;  // H110
-        H_k[2][i] = (H0 - H1) / 3.0;         // H112
-    }
-}
-
-/**
- * @brief Computes the exact Percus-Yevick Hard Sphere reference functions.
- * Evaluates the exact PY polynomial for c(r), transforms to C(k), solves OZ for H(k),
- * and transforms back to h(r).
- */
-void compute_HS_reference(double *c_HS, double *h_HS, double *r, double *k, 
-                          int nodes, double dr, double rho, double sigma) {
-    double eta_vol = rho * M_PI * pow(sigma, 3) / 6.0;
-    double lambda1 = pow(1.0 + 2.0*eta_vol, 2) / pow(1.0 - eta_vol, 4);
-    double lambda2 = -pow(1.0 + 0.5*eta_vol, 2) / pow(1.0 - eta_vol, 4);
-
-    // 1. Exact PY c(r)
-    for (int i = 0; i < nodes; i++) {
-        if (r[i] < sigma) {
-            c_HS[i] = -lambda1 - 6.0*eta_vol*lambda2*r[i] - 0.5*eta_vol*lambda1*pow(r[i], 3);
-        } else {
-            c_HS[i] = 0.0;
-        }
-    }
+// k_min rmax = k_max r_min of the log grid: k_max = 1/r_min truncates the
+// 1/r^3 kernel of the contact region and leaves modes of small r nearly
+// free, which stalls the iteration
+#define DIPOLAR_LOG_KR 20.0
 
-    // 2. Transform to C(k) (Sine transform)
-    double *C_k = malloc(nodes * sizeof(double));
-    for (int i = 0; i < nodes; i++) {
-        double k_val = k[i];
-        double sum = 0.0;
-        for (int j = 0; j < nodes; j++) {
-            double r_val = r[j];
-            double j0 = (fabs(k_val*r_val) < 1e-6) ? 1.0 : sin(k_val*r_val)/(k_val*r_val);
-            sum += r_val * r_val * c_HS[j] * j0 * dr;
-        }
-        C_k[i] = 4.0 * M_PI * sum;
-    }
-
-    // 3. Solve OZ for H(k)
-    double *H_k = malloc(nodes * sizeof(double));
-    for (int i = 0; i < nodes; i++) {
-        double denom = 1.0 - rho * C_k[i];
-        H_k[i] = (fabs(denom) > 1e-12) ? C_k[i] / denom : 0.0;
-    }
-
-    // 4. Transform back to h(r) (Inverse Sine transform)
-    double dk = k[1] - k[0];
-    for (int i = 0; i < nodes; i++) {
-        double r_val = r[i];
-        double sum = 0.0;
-        for (int j = 0; j < nodes; j++) {
-            double k_val = k[j];
-            double j0 = (fabs(k_val*r_val) < 1e-6) ? 1.0 : sin(k_val*r_val)/(k_val*r_val);
-            sum += k_val * k_val * H_k[j] * j0 * dk;
-        }
-        h_HS[i] = (1.0 / (2.0 * M_PI * M_PI)) * sum;
-    }
-
-    free(C_k);
-    free(H_k);
-}
+// Forward declarations of closure functions
+void closure_MSA_dipolar(double **c, double **eta, const DipolarClosureGrid *grid);
+void closure_LHNC_dipolar(double **c, double **h, double **eta, const DipolarClosureGrid *grid);
+void closure_QHNC_dipolar(double **c, double **h, double **eta, const DipolarClosureGrid *grid);
+void closure_RHNC_dipolar(double **c, double **h, double **eta, double *r, const DipolarClosureGrid *grid, const HSReference *ref);
 
 /**
  * @brief Main solver function for Dipolar Hard Spheres.
+ *
+ * @return 0 if the iteration converged, 1 if it stopped at max_iter or failed
+ *         (the results of the last iteration are still written).
  */
-void solver_dipolar(int closureID, double temp, double rho, double dipole_moment, 
-                   int nodes, double rmax, const char *output_dir) {
+int solver_dipolar(int closureID, double temp, double rho, double dipole_moment, 
+                   int nodes, double rmax, const char *output_dir,
+                   const NonSphericalOptions *opts) {
     
     printf("Initializing Dipolar Solver...\n");
     printf("Closure: %d (0=MSA, 1=LHNC, 2=QHNC)\n", closureID);
@@ -127,193 +47,208 @@ void solver_dipolar(int closureID, double temp, double rho, double dipole_moment
     // Arrays for k-space
     ProjectionMatrix *C_k = create_projection_matrix(n_projections, nodes);
     ProjectionMatrix *H_k = create_projection_matrix(n_projections, nodes);
+    // Closure output, reused across iterations
+    ProjectionMatrix *c_new_mat = create_projection_matrix(n_projections, nodes);
 
-    // Grid generation
+    // Grid generation: r_j = (j+1)*dr, k_i = (i+1)*PI/(N*dr), or the log grid
+    // of --grid log, which reaches k ~ 20/rmax and resolves the 1/r^3 tails
+    int log_grid = (opts->grid == RADIAL_GRID_LOG);
     double dr = rmax / nodes;
     double *r = malloc(nodes * sizeof(double));
     double *k = malloc(nodes * sizeof(double));
-    double dk = M_PI / (nodes * dr); // Approximate Nyquist (actually PI/dr?) 
-    // Usually dk = pi / (N*dr) or similar. 
-    // Standard FFT grid: dk = 2*pi / (N*dr). 
-    // Let's stick to what main solver likely uses or standard discrete definition.
-    // If r[i] = (i+1)*dr, then k[i] = (i+1)*dk.
-    dk = M_PI / (nodes * dr);
-
-    for(int i=0; i<nodes; i++) {
-        r[i] = (i+1) * dr;
-        k[i] = (i+1) * dk;
-    }
 
     double beta = 1.0 / temp;
     double beta_mu2 = beta * dipole_moment * dipole_moment;
     double sigma = 1.0;
 
-    // Hard Sphere Reference for RHNC
-    double *c_HS = NULL;
-    double *h_HS = NULL;
+    if (log_grid && closureID == 3) {
+        printf("RHNC needs the uniform grid (--grid uniform).\n");
+        return 1;
+    }
+
+    // O(N log N) transforms for power-of-2 grids (O(N^2) otherwise); one plan
+    // (and its scratch) per projection so the three run in parallel
+    static const int order[3] = {0, 0, 2};     // 000/110: order 0 (exact DST), 112: order 2
+    HankelPlan *hankel[3];
+    int plans_ok = (r && k);
+    double r_min = opts->r_min, r_max = rmax;
+    if (log_grid) {
+        // Same spacing, shifted by less than one node to put a node at sigma,
+        // where the closures switch between core and tail
+        double dlnr = log(rmax / r_min) / (nodes - 1);
+        r_min = sigma * exp(-round(log(sigma / r_min) / dlnr) * dlnr);
+        r_max = r_min * exp((nodes - 1) * dlnr);
+    }
+    for (int p = 0; p < n_projections; p++) {
+        hankel[p] = log_grid ? create_hankel_plan_log(nodes, r_min, r_max, DIPOLAR_LOG_KR) : create_hankel_plan(nodes, dr);
+        if (!hankel[p]) plans_ok = 0;
+    }
+    if (plans_ok) {
+        memcpy(r, hankel[0]->r, nodes * sizeof(double));
+        memcpy(k, hankel[0]->k, nodes * sizeof(double));
+    }
+    // Core split and 1/r^3 tail of the closures
+    DipolarClosureGrid *cgrid = create_dipolar_closure_grid(r, nodes, beta_mu2, sigma);
+    // k-space OZ in the chi basis (Blum/Wertheim): 000 decouples and {110, 112}
+    // split into the scalar modes C^0 = C110 + 2*C112 (rho/3) and
+    // C^1 = C110 - C112 (-rho/3); 011 and 101 vanish for point dipoles.
+    static const int proj_m[3] = {0, 1, 1}, proj_n[3] = {0, 1, 1}, proj_l[3] = {0, 0, 2};
+    ChiModeSolver *chi = create_chi_mode_solver(n_projections, proj_m, proj_n, proj_l, CHI_NORM_Y_LFACT, nodes);
+    // --dipole-split: the 1/r^3 tails of c112 and h112 go through T(k); chi0
+    // solves OZ at k -> 0 for the amplitude of h112
+    DipoleTail *tail = (opts->dipole_split && plans_ok) ? create_dipole_tail(r, k, nodes, dr, sigma, -1.0) : NULL;
+    ChiModeSolver *chi0 = opts->dipole_split ? create_chi_mode_solver(n_projections, proj_m, proj_n, proj_l, CHI_NORM_Y_LFACT, 1) : NULL;
+    if ((opts->dipole_split && (!tail || !chi0)) || !plans_ok || !cgrid || !chi || !h || !c || !eta || !C_k || !H_k || !c_new_mat) {
+        printf("Memory allocation failed in solver_dipolar.\n");
+        return 1;
+    }
+
+    // Hard Sphere Reference for RHNC, shared by every solve at this rho and grid
+    const HSReference *hs_ref = NULL;
     if (closureID == 3) {
-        c_HS = malloc(nodes * sizeof(double));
-        h_HS = malloc(nodes * sizeof(double));
-        compute_HS_reference(c_HS, h_HS, r, k, nodes, dr, rho, sigma);
+        hs_ref = hs_reference_get(opts->hs_reference, nodes, dr, rho, sigma, opts->cache_dir);
+        if (!hs_ref) {
+            printf("Could not build the hard-sphere reference.\n");
+            return 1;
+        }
     }
 
-    // 2. Initialization 
-    closure_MSA_dipolar(c->data, eta->data, r, nodes, beta_mu2, sigma);
+    // 2. Initialization (MSA, or the nearest cached solution)
+    static const char *closure_names[4] = {"MSA", "LHNC", "QHNC", "RHNC"};
+    const char *closure_name = (closureID == 3 && opts->hs_reference == HS_REFERENCE_VW) ? "RHNC-VW" : closure_names[closureID];
+    closure_MSA_dipolar(c->data, eta->data, cgrid);
+
+    OZCacheKey cache_key;
+    if (opts->cache_dir) {
+        nonspherical_cache_key(&cache_key, "dipolar", closure_name, 14, 1, nodes, rmax, rho, temp, dipole_moment);
+        nonspherical_cache_load(opts->cache_dir, &cache_key, r, c);
+    }
 
     // 3. Iteration Loop
-    int max_iter = 2000;
-    double tolerance = 1e-6;
+    int max_iter = opts->max_iter;
+    double tolerance = opts->tolerance;
     double error = 1.0;
     int iter = 0;
 
+    // Picard is Anderson with an empty history
+    int depth = (opts->mixing == MIXING_ANDERSON) ? opts->anderson_depth : 0;
+    AndersonMixer *mixer = create_anderson_mixer(n_projections, nodes, depth);
+    if (!mixer) {
+        printf("Memory allocation failed for the mixer.\n");
+        return 1;
+    }
+    // On the log grid the nodes crowd at small r: weight the residual by the
+    // volume r^3 each node stands for, or the core dominates the mixer
+    double *weight = NULL;
+    if (log_grid) {
+        weight = malloc(nodes * sizeof(double));
+        if (!weight) {
+            printf("Memory allocation failed for the mixer.\n");
+            return 1;
+        }
+        for (int i = 0; i < nodes; i++) weight[i] = pow(r[i] / sigma, 3);
+        anderson_set_weights(mixer, weight);
+    }
+    DampingControl damping;
+    damping_init(&damping, opts->alpha, opts->adaptive_damping);
+
+    if (opts->mixing == MIXING_ANDERSON)
+        printf("Mixing: Anderson (m=%d), alpha=%.3f%s\n", depth, opts->alpha, opts->adaptive_damping ? ", adaptive" : "");
+    else
+        printf("Mixing: Picard, alpha=%.3f%s\n", opts->alpha, opts->adaptive_damping ? ", adaptive" : "");
+
     printf("Starting Iteration...\n");
     while (iter < max_iter && error > tolerance) {
         
         // A. Transforms c(r) -> C(k)
-        // 000: Sine Transform (j0)
-        // We use FFT wrapper from math_aux which does sine transform
-        // Note: FFT in math_aux acts IN PLACE? Uses 'sinft'. 
-        // Copies to C_k first.
-        for(int i=0; i<nodes; i++) C_k->data[0][i] = c->data[0][i] * r[i]; // r*c(r) for sine transform?
-        // Check FFT implementation. math_aux FFT assumes input is f(r). 
-        // Actually math_aux FFT: "inputData[i] = (i * inputData[i]);" inside? No, it does sinft directly.
-        // Let's use generic sinft calls if possible, or copy FFT logic. 
-        // math_aux's FFT function: "inputData[i] = (i * inputData[i])" ?? That looks suspicious for internal rescaling.
-        // Let's use our new HT2 logic for 112, and maybe just call sine transform for 000/110.
-        // For 000/110 (l=0) -> 4*pi/k * Integral(r * c(r) * sin(kr))
-        // So we transform f(r) = r*c(r) using sine transform.
-        
-        // Manual Sine Transform for 000 and 110 using simple direct sum for consistency with HT2 approx for now
-        // or re-use HT2 with j0? j0(x) = sin(x)/x.
-        // Integral r^2 c(r) j0(kr) dr = Integral r^2 c(r) sin(kr)/(kr) dr = 1/k Integral r c(r) sin(kr) dr.
-        // This is Sine Transform of r*c(r) divided by k.
-        
-        // Using HT2_Direct logic but with j0 for 000 and 110
-        // NOTE: Efficient FFT not used here yet, keeping O(N^2) for correctness first.
-        // We need a HT0_Direct equivalent.
-        // Let's just use HT2_Direct but swap j2 for j0... 
-        // Hardcoding loop here for now for 000/110
-         for (int i = 0; i < nodes; i++) {
-            double k_val = k[i];
-            double sum0 = 0.0;
-            double sum1 = 0.0;
-            for (int j = 0; j < nodes; j++) {
-                double r_val = r[j];
-                double j0 = (fabs(k_val*r_val) < 1e-6) ? 1.0 : sin(k_val*r_val)/(k_val*r_val);
-                double term0 = r_val * r_val * c->data[0][j] * j0;
-                double term1 = r_val * r_val * c->data[1][j] * j0;
-                
-                double w = dr; // simple weight
-                sum0 += term0 * w;
-                sum1 += term1 * w;
+        // 000/110: order 0 (exact DST), 112: order 2 (sine/cosine sums)
+        double t0 = oz_time_now();
+        // (with --dipole-split, 112 only transforms c112 - beta*mu^2 t(r))
+        #pragma omp parallel for schedule(static)
+        for (int p = 0; p < n_projections; p++) {
+            if (tail && p == 2) {
+                dipole_tail_remove(tail, c->data[p], tail->t_r, beta_mu2);
+                hankel_forward(hankel[p], order[p], tail->work, C_k->data[p]);
+                dipole_tail_restore(tail, C_k->data[p], tail->t_k, beta_mu2);
+            } else {
+                hankel_forward(hankel[p], order[p], c->data[p], C_k->data[p]);
             }
-            C_k->data[0][i] = 4.0 * M_PI * sum0;
-            C_k->data[1][i] = 4.0 * M_PI * sum1;
         }
-
-        // 112: Hankel Transform order 2
-        HT2_Direct(c->data[2], C_k->data[2], r, k, nodes);
+        oz_timing_stop(OZ_PHASE_TRANSFORM, t0);
 
         // B. Solve OZ in k-space
-        solve_oz_k_space(C_k->data, H_k->data, nodes, rho);
+        t0 = oz_time_now();
+        chi_mode_solve(chi, C_k->data, H_k->data, rho);
+        double h112_tail = tail ? dipole_tail_amplitude(tail, chi0, c->data, 2, beta_mu2, rho) : 0.0;
+        oz_timing_stop(OZ_PHASE_OZ, t0);
 
         // C. Transforms H(k) -> h(r)
-        // 000/110: Inverse Sine / j0
-        // h(r) = 1/(2pi^2) Integral k^2 H(k) j0(kr) dk
-        for (int i = 0; i < nodes; i++) {
-            double r_val = r[i];
-            double sum0 = 0.0;
-            double sum1 = 0.0;
-            for (int j = 0; j < nodes; j++) {
-                double k_val = k[j];
-                double j0 = (fabs(k_val*r_val) < 1e-6) ? 1.0 : sin(k_val*r_val)/(k_val*r_val);
-                double term0 = k_val * k_val * H_k->data[0][j] * j0;
-                double term1 = k_val * k_val * H_k->data[1][j] * j0;
-                
-                double w = dk;
-                sum0 += term0 * w;
-                sum1 += term1 * w;
+        t0 = oz_time_now();
+        // (and H112 - A T(k), A = h112_tail)
+        #pragma omp parallel for schedule(static)
+        for (int p = 0; p < n_projections; p++) {
+            if (tail && p == 2) {
+                dipole_tail_remove(tail, H_k->data[p], tail->t_k, h112_tail);
+                hankel_inverse(hankel[p], order[p], tail->work, h->data[p]);
+                dipole_tail_restore(tail, h->data[p], tail->t_r, h112_tail);
+            } else {
+                hankel_inverse(hankel[p], order[p], H_k->data[p], h->data[p]);
             }
-            h->data[0][i] = sum0 / (2.0 * M_PI * M_PI);
-            h->data[1][i] = sum1 / (2.0 * M_PI * M_PI);
         }
-
-        // 112: Inverse HT2
-        IHT2_Direct(H_k->data[2], h->data[2], r, k, nodes);
+        oz_timing_stop(OZ_PHASE_TRANSFORM, t0);
 
         // D. Calculate Eta = h - c
+        t0 = oz_time_now();
+        #pragma omp parallel for collapse(2) schedule(static)
         for(int p=0; p<n_projections; p++)
             for(int i=0; i<nodes; i++)
                 eta->data[p][i] = h->data[p][i] - c->data[p][i];
 
-        // E. Closure: compute c_new from h and eta
-        // Allocate a temporary ProjectionMatrix to hold the closure output
-        ProjectionMatrix *c_new_mat = create_projection_matrix(n_projections, nodes);
-        for(int p=0; p<n_projections; p++)
-            for(int i=0; i<nodes; i++)
-                c_new_mat->data[p][i] = c->data[p][i];
+        // E. Closure: compute c_new from h and eta into the persistent buffer
+        projection_matrix_copy(c_new_mat, c);
 
         // E. Apply Closure Extension c(r)
         if (closureID == 0) {
-            closure_MSA_dipolar(c_new_mat->data, eta->data, r, nodes, beta_mu2, sigma);
+            closure_MSA_dipolar(c_new_mat->data, eta->data, cgrid);
         } else if (closureID == 1) {
-            closure_LHNC_dipolar(c_new_mat->data, h->data, eta->data, r, nodes, beta_mu2, sigma);
+            closure_LHNC_dipolar(c_new_mat->data, h->data, eta->data, cgrid);
         } else if (closureID == 2) {
-            closure_QHNC_dipolar(c_new_mat->data, h->data, eta->data, r, nodes, beta_mu2, sigma);
+            closure_QHNC_dipolar(c_new_mat->data, h->data, eta->data, cgrid);
         } else if (closureID == 3) {
-            closure_RHNC_dipolar(c_new_mat->data, h->data, eta->data, r, nodes, beta_mu2, sigma, c_HS, h_HS);
+            closure_RHNC_dipolar(c_new_mat->data, h->data, eta->data, r, cgrid, hs_ref);
         } 
+        oz_timing_stop(OZ_PHASE_CLOSURE, t0);
 
-        // F. Compute L2 error and apply Picard mixing
-        // c_mixed = (1 - alpha) * c_old + alpha * c_new
-        double alpha = 0.3;   // Damping factor (0 < alpha <= 1)
-        error = 0.0;
-        for(int p=0; p<n_projections; p++) {
-            for(int i=0; i<nodes; i++) {
-                double diff = c_new_mat->data[p][i] - c->data[p][i];
-                error += diff * diff;
-                c->data[p][i] += alpha * diff;  // Picard update
-            }
-        }
-        error = sqrt(error / (n_projections * nodes));
-        free_projection_matrix(c_new_mat);
+        // F. Compute the L2 residual and mix (Picard or Anderson)
+        t0 = oz_time_now();
+        error = anderson_residual(mixer, c->data, c_new_mat->data);
+        if (damping_update(&damping, error)) anderson_reset(mixer);
+        anderson_step(mixer, c->data, damping.beta);
+        oz_timing_stop(OZ_PHASE_MIXING, t0);
 
         if (iter % 50 == 0)
             printf("Iter %4d: Error = %.5e\n", iter, error);
         iter++;
-    }
-    printf("Iter %4d: Error = %.5e  [DONE]\n", iter-1, error);
-
-    // 4. Output Results
-    FILE *fp = fopen("output/output_dipolar.dat", "w");
-    if(fp) {
-        fprintf(fp, "# r h000 h110 h112 c000 c110 c112\n");
-        for(int i=0; i<nodes; i++) {
-            fprintf(fp, "%.5e %.5e %.5e %.5e %.5e %.5e %.5e\n", 
-                r[i], 
-                h->data[0][i], h->data[1][i], h->data[2][i],
-                c->data[0][i], c->data[1][i], c->data[2][i]);
-        }
-        fclose(fp);
-        printf("Written output/output_dipolar.dat\n");
-    }
+        if (oz_telemetry_active) oz_telemetry_emit("dipolar", 1, rho, iter, error, -1, 0, oz_heap_alloc_count());
 
-    // Output k-space Results
-    FILE *fp_k = fopen("output/output_dipolar_k.dat", "w");
-    if(fp_k) {
-        fprintf(fp_k, "# k H000 H110 H112 C000 C110 C112\n");
-        for(int i=0; i<nodes; i++) {
-            fprintf(fp_k, "%.5e %.5e %.5e %.5e %.5e %.5e %.5e\n", 
-                k[i], 
-                H_k->data[0][i], H_k->data[1][i], H_k->data[2][i],
-                C_k->data[0][i], C_k->data[1][i], C_k->data[2][i]);
-        }
-        fclose(fp_k);
-        printf("Written output/output_dipolar_k.dat\n");
+        // Checkpoint, so a killed run resumes from here
+        if (opts->cache_dir && opts->checkpoint_interval > 0 && iter % opts->checkpoint_interval == 0 && error > tolerance)
+            nonspherical_cache_save(opts->cache_dir, &cache_key, r, c, 0, iter, error, rho);
     }
-
-    // ---------------------------------------------------------------
-    // Output: Structure Factor S(k) in Patey and chi representations
+    int converged = (error <= tolerance);
+    if (converged)
+        printf("Iter %4d: Error = %.5e  [DONE]\n", iter-1, error);
+    else if (!isfinite(error))
+        printf("Iter %4d: Error = %.5e  [DIVERGED]\n", iter-1, error);
+    else
+        printf("Iter %4d: Error = %.5e  [NOT CONVERGED after max_iter = %d]\n", iter-1, error, max_iter);
+    oz_timing_count(iter);
+    double t_output = oz_time_now();
+
+    if (opts->cache_dir)
+        nonspherical_cache_save(opts->cache_dir, &cache_key, r, c, converged, iter, error, rho);
+
+    // S(k) in the Patey and chi representations (columns S000 S110 S112 S0 S1)
     // ---------------------------------------------------------------
     // Patey:
     //   S000 = 1 + rho * H000   (equivalently: 1 / (1 - rho*C000))
@@ -328,35 +263,109 @@ void solver_dipolar(int closureID, double temp, double rho, double dipole_moment
     //   S110 = (S0 + 2*S1)/3 - 1
     //   S112 = (S0 - S1)/3
     // ---------------------------------------------------------------
-    FILE *fp_sk = fopen("output/output_dipolar_sk.dat", "w");
-    if(fp_sk) {
-        fprintf(fp_sk, "# k  S000  S110_Patey  S112_Patey  S0_chi  S1_chi\n");
-        for(int i = 0; i < nodes; i++) {
-            double C000 = C_k->data[0][i];
-            double C110 = C_k->data[1][i];
-            double C112 = C_k->data[2][i];
-
-            // --- Patey (direct from H_k) ---
-            double S000 = 1.0 + rho * H_k->data[0][i];
-            double S110 = rho * H_k->data[1][i];
-            double S112 = rho * H_k->data[2][i];
-
-            // --- Chi representation (from C_k) ---
-            double C0 = C110 + 2.0 * C112;  // chi=0 mode
-            double C1 = C110 - C112;         // chi=1 mode
-
-            double denom0 = 1.0 - (rho / 3.0) * C0;
-            double denom1 = 1.0 + (rho / 3.0) * C1;
-
-            double S0 = (fabs(denom0) > 1e-12) ? 1.0 / denom0 : 1e12;
-            double S1 = (fabs(denom1) > 1e-12) ? 1.0 / denom1 : 1e12;
-
-            fprintf(fp_sk, "%.5e  %.5e  %.5e  %.5e  %.5e  %.5e\n",
-                k[i], S000, S110, S112, S0, S1);
+    ProjectionMatrix *S_k = create_projection_matrix(5, nodes);
+    if (!S_k) {
+        printf("Memory allocation failed in solver_dipolar.\n");
+        return 1;
+    }
+    for(int i = 0; i < nodes; i++) {
+        double C110 = C_k->data[1][i];
+        double C112 = C_k->data[2][i];
+
+        // --- Patey (direct from H_k) ---
+        S_k->data[0][i] = 1.0 + rho * H_k->data[0][i];
+        S_k->data[1][i] = rho * H_k->data[1][i];
+        S_k->data[2][i] = rho * H_k->data[2][i];
+
+        // --- Chi representation (from C_k) ---
+        double C0 = C110 + 2.0 * C112;  // chi=0 mode
+        double C1 = C110 - C112;         // chi=1 mode
+
+        double denom0 = 1.0 - (rho / 3.0) * C0;
+        double denom1 = 1.0 + (rho / 3.0) * C1;
+
+        S_k->data[3][i] = (fabs(denom0) > 1e-12) ? 1.0 / denom0 : 1e12;
+        S_k->data[4][i] = (fabs(denom1) > 1e-12) ? 1.0 / denom1 : 1e12;
+    }
+
+    // 4. Output Results (none without an output directory)
+    char filepath[256];
+    if (output_dir == NULL) {
+        // Caller keeps the results in memory
+    } else if (opts->output_format != OZ_OUTPUT_TEXT) {
+        snprintf(filepath, sizeof(filepath), "%s/output_dipolar%s", output_dir, oz_output_extension(opts->output_format));
+
+        OZOutput *out = create_oz_output(filepath, opts->output_format);
+        int status = (out == NULL);
+        if (!status) {
+            const double *col[1];
+            status = oz_output_attr_string(out, "solver", "dipolar") | \
+                     oz_output_attr_string(out, "closure", closure_name) | \
+                     oz_output_attr_int(out, "potential", 14) | \
+                     oz_output_attr_int(out, "nodes", nodes) | \
+                     oz_output_attr_double(out, "rmax", rmax) | \
+                     oz_output_attr_string(out, "grid", log_grid ? "log" : "uniform") | \
+                     oz_output_begin_point(out) | \
+                     oz_output_attr_double(out, "temp", temp) | \
+                     oz_output_attr_double(out, "rho", rho) | \
+                     oz_output_attr_double(out, "dipole", dipole_moment) | \
+                     oz_output_attr_int(out, "iterations", iter) | \
+                     oz_output_attr_double(out, "residual", error);
+            col[0] = r; status |= oz_output_dataset(out, "r", "r", col, 1, nodes);
+            status |= write_projection_matrix(out, "h", h, proj_m, proj_n, proj_l);
+            status |= write_projection_matrix(out, "c", c, proj_m, proj_n, proj_l);
+            col[0] = k; status |= oz_output_dataset(out, "k", "k", col, 1, nodes);
+            status |= write_projection_matrix(out, "H", H_k, proj_m, proj_n, proj_l);
+            status |= write_projection_matrix(out, "C", C_k, proj_m, proj_n, proj_l);
+            status |= oz_output_dataset(out, "S", "S000 S110 S112 S0 S1", (const double *const *) S_k->data, 5, nodes);
+            status |= oz_output_end_point(out);
+        }
+        free_oz_output(out);
+        if (status) fprintf(stderr, "Error: Could not write file %s.\n", filepath);
+        else printf("Written %s\n", filepath);
+    } else {
+        snprintf(filepath, sizeof(filepath), "%s/output_dipolar.dat", output_dir);
+        FILE *fp = fopen(filepath, "w");
+        if(fp) {
+            fprintf(fp, "# r h000 h110 h112 c000 c110 c112\n");
+            for(int i=0; i<nodes; i++) {
+                fprintf(fp, "%.5e %.5e %.5e %.5e %.5e %.5e %.5e\n", 
+                    r[i], 
+                    h->data[0][i], h->data[1][i], h->data[2][i],
+                    c->data[0][i], c->data[1][i], c->data[2][i]);
+            }
+            fclose(fp);
+            printf("Written %s\n", filepath);
+        }
+
+        // Output k-space Results
+        snprintf(filepath, sizeof(filepath), "%s/output_dipolar_k.dat", output_dir);
+        FILE *fp_k = fopen(filepath, "w");
+        if(fp_k) {
+            fprintf(fp_k, "# k H000 H110 H112 C000 C110 C112\n");
+            for(int i=0; i<nodes; i++) {
+                fprintf(fp_k, "%.5e %.5e %.5e %.5e %.5e %.5e %.5e\n", 
+                    k[i], 
+                    H_k->data[0][i], H_k->data[1][i], H_k->data[2][i],
+                    C_k->data[0][i], C_k->data[1][i], C_k->data[2][i]);
+            }
+            fclose(fp_k);
+            printf("Written %s\n", filepath);
+        }
+
+        snprintf(filepath, sizeof(filepath), "%s/output_dipolar_sk.dat", output_dir);
+        FILE *fp_sk = fopen(filepath, "w");
+        if(fp_sk) {
+            fprintf(fp_sk, "# k  S000  S110_Patey  S112_Patey  S0_chi  S1_chi\n");
+            for(int i = 0; i < nodes; i++) {
+                fprintf(fp_sk, "%.5e  %.5e  %.5e  %.5e  %.5e  %.5e\n",
+                    k[i], S_k->data[0][i], S_k->data[1][i], S_k->data[2][i], S_k->data[3][i], S_k->data[4][i]);
+            }
+            fclose(fp_sk);
+            printf("Written %s\n", filepath);
         }
-        fclose(fp_sk);
-        printf("Written output/output_dipolar_sk.dat\n");
     }
+    oz_timing_stop(OZ_PHASE_OUTPUT, t_output);
 
     // Cleanup
     free_projection_matrix(h);
@@ -364,9 +373,17 @@ void solver_dipolar(int closureID, double temp, double rho, double dipole_moment
     free_projection_matrix(eta);
     free_projection_matrix(C_k);
     free_projection_matrix(H_k);
+    free_projection_matrix(c_new_mat);
+    free_projection_matrix(S_k);
     free(r);
     free(k);
-    if (c_HS) free(c_HS);
-    if (h_HS) free(h_HS);
+    for (int p = 0; p < n_projections; p++) free_hankel_plan(hankel[p]);
+    free_chi_mode_solver(chi);
+    free_dipolar_closure_grid(cgrid);
+    free_dipole_tail(tail);
+    free_chi_mode_solver(chi0);
+    free_anderson_mixer(mixer);
+    free(weight);
+    return converged ? 0 : 1;
 }
 
@@ -1,7 +1,36 @@
 #include "structures_nonspherical.h"
+#include "mixing.h"
+#include "chi_modes.h"
+#include "oz_timing.h"
+#include "oz_telemetry.h"
+#include "oz_context.h"
+#include "mode2_gpu.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <gsl/gsl_cblas.h>
+
+/**
+ * @brief Upper bound (in MB) for the cached j_l(k_i r_j) tables.
+ *
+ * Each distinct l needs N*N doubles. The tables are built for l = 0, 1, ...
+ * until the budget is exhausted; orders that do not fit are evaluated on the
+ * fly. Override at compile time with -DMODE2_KERNEL_CACHE_MB=<MB>.
+ */
+#ifndef MODE2_KERNEL_CACHE_MB
+#define MODE2_KERNEL_CACHE_MB 1024
+#endif
+
+/**
+ * @brief Output points per dgemm call in the threaded transforms.
+ *
+ * The chunks are fixed, so the result does not depend on the number of
+ * threads.
+ */
+#ifndef MODE2_TRANSFORM_CHUNK
+#define MODE2_TRANSFORM_CHUNK 64
+#endif
 
 
 // ----------------------------------------------------
@@ -27,33 +56,227 @@ static double get_jl_kr(int l, double kr) {
         case 2: return ((3.0 / kr3) - (1.0 / kr)) * sk - (3.0 / kr2) * ck;
         case 3: return ((15.0 / kr4) - (6.0 / kr2)) * sk + ((1.0 / kr) - (15.0 / kr3)) * ck;
         case 4: return ((105.0 / kr5) - (45.0 / kr3) + (1.0 / kr)) * sk + ((10.0 / kr2) - (105.0 / kr4)) * ck;
-        default: return 0.0;
+        default: break;
+    }
+
+    // l > 4 (mmax > 2): upward recurrence where it is stable (kr > l), power series below
+    if (kr > l) {
+        double jm = get_jl_kr(3, kr), j = get_jl_kr(4, kr);
+        for (int q = 4; q < l; q++) {
+            double jp = (2.0 * q + 1.0) / kr * j - jm;
+            jm = j;
+            j = jp;
+        }
+        return j;
+    }
+
+    double lead = 1.0;
+    for (int q = 1; q <= l; q++) lead *= kr / (2.0 * q + 1.0);
+    double term = 1.0, sum = 1.0;
+    for (int q = 1; q < 60 && fabs(term) > 1e-17 * fabs(sum); q++) {
+        term *= -0.5 * kr2 / (q * (2.0 * l + 2.0 * q + 1.0));
+        sum += term;
+    }
+    return lead * sum;
+}
+
+/**
+ * @brief Cached spherical-Bessel kernels K_l[i][j] = j_l(k_i r_j).
+ *
+ * On the grid r_j = (j+1)dr, k_i = (i+1)dk with dk = PI/(N dr) the argument
+ * k_i r_j is symmetric in (i, j), so the same table serves the forward and
+ * the inverse transform. A single-precision cache (--mixed-precision) holds
+ * float tables, half the memory and the bandwidth of sgemm instead of dgemm.
+ */
+typedef struct {
+    int nodes;
+    int lmax;
+    int single;             // 1: tables in table_f, 0: in table
+    double **table;         // [lmax+1], NULL if l is evaluated on the fly
+    float **table_f;        // [lmax+1], same for the single-precision cache
+} BesselKernelCache;
+
+static double bessel_kernel(int l, double arg) {
+    return (arg < 1e-6 && l > 0) ? 0.0 : ((arg < 1e-6 && l == 0) ? 1.0 : get_jl_kr(l, arg));
+}
+
+static BesselKernelCache* create_bessel_cache(const double *r, const double *k, int nodes, int lmax, double budget_mb, \
+                                              int single) {
+    BesselKernelCache *kc = malloc(sizeof(BesselKernelCache));
+    if (!kc) return NULL;
+
+    kc->table = calloc(lmax + 1, sizeof(double*));
+    kc->table_f = calloc(lmax + 1, sizeof(float*));
+    if (!kc->table || !kc->table_f) {
+        free(kc->table);
+        free(kc->table_f);
+        free(kc);
+        return NULL;
+    }
+
+    kc->nodes = nodes;
+    kc->lmax = lmax;
+    kc->single = single;
+    size_t entry = single ? sizeof(float) : sizeof(double);
+    double table_mb = (double) nodes * nodes * entry / (1024.0 * 1024.0);
+    double used_mb = 0.0;
+
+    for (int l = 0; l <= lmax; l++) {
+        if (used_mb + table_mb > budget_mb) continue;
+
+        void *K = malloc((size_t) nodes * nodes * entry);
+        if (!K) continue;
+
+        if (single) {
+            // Evaluated in double and rounded once
+            float *Kf = K;
+            #pragma omp parallel for schedule(static)
+            for (int i = 0; i < nodes; i++) {
+                for (int j = 0; j < nodes; j++) {
+                    Kf[(size_t) i*nodes + j] = (float) bessel_kernel(l, k[i] * r[j]);
+                }
+            }
+            kc->table_f[l] = Kf;
+        } else {
+            double *Kd = K;
+            #pragma omp parallel for schedule(static)
+            for (int i = 0; i < nodes; i++) {
+                for (int j = 0; j < nodes; j++) {
+                    Kd[(size_t) i*nodes + j] = bessel_kernel(l, k[i] * r[j]);
+                }
+            }
+            kc->table[l] = Kd;
+        }
+        used_mb += table_mb;
     }
+
+    printf("Bessel kernel cache: %.1f MB %s(", used_mb, single ? "float " : "");
+    for (int l = 0; l <= lmax; l++) printf(" l=%d:%s", l, (kc->table[l] || kc->table_f[l]) ? "table" : "on-the-fly");
+    printf(" )\n");
+
+    return kc;
 }
 
-// Modes derived from m,n <= 2 and m+n+l even
-// Total 14 modes for symmetric non-spherical potentials like dipoles
-static int mode_l[14] = {
-    0, 1, 2, 1, 0, 2, 1, 3, 2, 1, 3, 0, 2, 4
-};
-// Correct list ordered identically to Python generator:
-// 0: 000(l=0), 1: 011(1), 2: 022(2), 3: 101(1), 4: 110(0), 5: 112(2),
-// 6: 121(1), 7: 123(3), 8: 202(2), 9: 211(1), 10: 213(3),
-// 11: 220(0), 12: 222(2), 13: 224(4)
-
-static int get_mode_l(int index) {
-    return mode_l[index];
+static void free_bessel_cache(BesselKernelCache *kc) {
+    if (!kc) return;
+    for (int l = 0; l <= kc->lmax; l++) {
+        free(kc->table[l]);
+        free(kc->table_f[l]);
+    }
+    free(kc->table);
+    free(kc->table_f);
+    free(kc);
 }
 
-void solve_oz_k_space_mode2(ProjectionMatrix *C_mat, ProjectionMatrix *H_mat, int nodes, double rho);
+/**
+ * @brief Applies the order-l Hankel kernel to every projection with that l.
+ *
+ *   out[p][i] = prefactor * sum_j x_j^2 in[p][j] j_l(y_i x_j)
+ *
+ * With a cached table all projections sharing l are packed as the rows of
+ * one matrix and transformed with dgemm, each thread producing its own slice
+ * of output points. Otherwise the Bessel function is evaluated once per
+ * (i, j) and shared across those projections, with the i loop in parallel.
+ * With a single-precision cache the packed rows are floats (in the same
+ * buffers) and the product is sgemm; the on-the-fly orders stay in double.
+ * proj_l[p] is the order l of projection p.
+ * pack_in/pack_out must hold n_projections*nodes doubles.
+ */
+static void transform_mode2(const BesselKernelCache *kc, double **in, double **out, const double *x,
+                            const double *y, double prefactor, int n_projections, const int *proj_l,
+                            double *pack_in, double *pack_out) {
+    int nodes = kc->nodes;
+    int group[n_projections];
+
+    for (int l = 0; l <= kc->lmax; l++) {
+        int m = 0;
+        for (int p = 0; p < n_projections; p++) {
+            if (proj_l[p] == l) group[m++] = p;
+        }
+        if (m == 0) continue;
+
+        if (kc->table_f[l]) {
+            float *pack_in_f = (float*) pack_in;
+            float *pack_out_f = (float*) pack_out;
+            #pragma omp parallel
+            {
+                #pragma omp for collapse(2) schedule(static)
+                for (int g = 0; g < m; g++) {
+                    for (int j = 0; j < nodes; j++) {
+                        pack_in_f[(size_t) g*nodes + j] = (float) (x[j] * x[j] * in[group[g]][j]);
+                    }
+                }
+
+                int n_chunks = (nodes + MODE2_TRANSFORM_CHUNK - 1) / MODE2_TRANSFORM_CHUNK;
+                #pragma omp for schedule(static)
+                for (int q = 0; q < n_chunks; q++) {
+                    int i0 = q * MODE2_TRANSFORM_CHUNK;
+                    int ni = (nodes - i0 < MODE2_TRANSFORM_CHUNK) ? nodes - i0 : MODE2_TRANSFORM_CHUNK;
+                    cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, m, ni, nodes,
+                                (float) prefactor, pack_in_f, nodes, kc->table_f[l] + (size_t) i0*nodes, nodes,
+                                0.0f, pack_out_f + i0, nodes);
+                }
+
+                #pragma omp for collapse(2) schedule(static)
+                for (int g = 0; g < m; g++) {
+                    for (int i = 0; i < nodes; i++) {
+                        out[group[g]][i] = pack_out_f[(size_t) g*nodes + i];
+                    }
+                }
+            }
+        } else if (kc->table[l]) {
+            #pragma omp parallel
+            {
+                #pragma omp for collapse(2) schedule(static)
+                for (int g = 0; g < m; g++) {
+                    for (int j = 0; j < nodes; j++) {
+                        pack_in[(size_t) g*nodes + j] = x[j] * x[j] * in[group[g]][j];
+                    }
+                }
+
+                // Y (m x N) = prefactor * X (m x N) * K^T; K is symmetric on this grid.
+                // Output points [i0, i1) only need rows i0..i1-1 of K.
+                int n_chunks = (nodes + MODE2_TRANSFORM_CHUNK - 1) / MODE2_TRANSFORM_CHUNK;
+                #pragma omp for schedule(static)
+                for (int q = 0; q < n_chunks; q++) {
+                    int i0 = q * MODE2_TRANSFORM_CHUNK;
+                    int ni = (nodes - i0 < MODE2_TRANSFORM_CHUNK) ? nodes - i0 : MODE2_TRANSFORM_CHUNK;
+                    cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasTrans, m, ni, nodes,
+                                prefactor, pack_in, nodes, kc->table[l] + (size_t) i0*nodes, nodes,
+                                0.0, pack_out + i0, nodes);
+                }
+
+                #pragma omp for collapse(2) schedule(static)
+                for (int g = 0; g < m; g++) {
+                    for (int i = 0; i < nodes; i++) {
+                        out[group[g]][i] = pack_out[(size_t) g*nodes + i];
+                    }
+                }
+            }
+        } else {
+            #pragma omp parallel for schedule(static)
+            for (int i = 0; i < nodes; i++) {
+                double sum[n_projections];
+                for (int g = 0; g < m; g++) sum[g] = 0.0;
+                for (int j = 0; j < nodes; j++) {
+                    double w = x[j] * x[j] * bessel_kernel(l, y[i] * x[j]);
+                    for (int g = 0; g < m; g++) sum[g] += w * in[group[g]][j];
+                }
+                for (int g = 0; g < m; g++) out[group[g]][i] = prefactor * sum[g];
+            }
+        }
+    }
+}
 
-void closure_MSA_mode2(double **c, double **eta, double *r, int n_points, double beta_mu2, double sigma, int n_projections) {
+// i112 is the index of the 112 projection, which carries the dipole-dipole tail
+void closure_MSA_mode2(double **c, double **eta, double *r, int n_points, double beta_mu2, double sigma, int n_projections, int i112) {
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < n_points; i++) {
         if (r[i] > sigma) {
             for(int p=0; p<n_projections; p++) {
                 c[p][i] = 0.0;
             }
-            c[5][i] = beta_mu2 / pow(r[i], 3.0); // Index 5 is 112
+            c[i112][i] = beta_mu2 / pow(r[i], 3.0);
         } else {
             c[0][i] = -1.0 - eta[0][i];
             for(int p=1; p<n_projections; p++) {
@@ -63,7 +286,8 @@ void closure_MSA_mode2(double **c, double **eta, double *r, int n_points, double
     }
 }
 
-void closure_LHNC_mode2(double **c, double **h, double **eta, double *r, int n_points, double beta_mu2, double sigma, int n_projections) {
+void closure_LHNC_mode2(double **c, double **h, double **eta, double *r, int n_points, double beta_mu2, double sigma, int n_projections, int i112) {
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < n_points; i++) {
         if (r[i] > sigma) {
             double h000 = h[0][i];
@@ -74,7 +298,7 @@ void closure_LHNC_mode2(double **c, double **h, double **eta, double *r, int n_p
             for(int p=1; p<n_projections; p++) {
                 c[p][i] = h000 * eta[p][i];
             }
-            c[5][i] += beta_mu2 / pow(r[i], 3.0) + h000 * (beta_mu2 / pow(r[i], 3.0));
+            c[i112][i] += beta_mu2 / pow(r[i], 3.0) + h000 * (beta_mu2 / pow(r[i], 3.0));
         } else {
             c[0][i] = -1.0 - eta[0][i];
             for(int p=1; p<n_projections; p++) {
@@ -86,20 +310,57 @@ void closure_LHNC_mode2(double **c, double **h, double **eta, double *r, int n_p
 
 // Quick integration using generic spherical bessel
 void solver_mode2_core(int closureID, double temp, double rho, double dipole_moment, 
-                   int nodes, double rmax, const char *output_dir) {
+                   int nodes, double rmax, const char *output_dir,
+                   const NonSphericalOptions *opts) {
     
-    printf("Initializing Extended Mode 2 Solver (Potential 15, m,n<=2, parity even)...\n");
-    int n_projections = 14; 
-    ProjectionMatrix *h = create_projection_matrix(n_projections, nodes);
-    ProjectionMatrix *c = create_projection_matrix(n_projections, nodes);
-    ProjectionMatrix *eta = create_projection_matrix(n_projections, nodes); 
-    ProjectionMatrix *C_k = create_projection_matrix(n_projections, nodes);
-    ProjectionMatrix *H_k = create_projection_matrix(n_projections, nodes);
+    int mmax = opts->mmax;
+    printf("Initializing Extended Mode 2 Solver (Potential 15, m,n<=%d, parity even)...\n", mmax);
+
+    // Everything the cleanup label frees (all NULL-safe)
+    int *pm = NULL, *pn = NULL, *pl = NULL;
+    ChiModeSolver *chi = NULL;
+    ProjectionMatrix *h = NULL, *c = NULL, *eta = NULL, *C_k = NULL, *H_k = NULL, *c_new = NULL;
+    double *r = NULL, *k = NULL, *pack_in = NULL, *pack_out = NULL;
+    BesselKernelCache *kernels = NULL;
+    DipoleTail *tail = NULL;
+    ChiModeSolver *chi0 = NULL;
+    double **rows = NULL;
+    Mode2Device *dev = NULL;
+    AndersonMixer *mixer = NULL;
+
+    // Projection set and chi blocks (14 projections for mmax = 2)
+    int n_projections = chi_projection_set(mmax, NULL, NULL, NULL);
+    pm = malloc(n_projections * sizeof(int));
+    pn = malloc(n_projections * sizeof(int));
+    pl = malloc(n_projections * sizeof(int));
+    if (!pm || !pn || !pl) {
+        printf("Memory allocation failed in solver_mode2_core.\n");
+        goto cleanup;
+    }
+    chi_projection_set(mmax, pm, pn, pl);
+    chi = create_chi_mode_solver(n_projections, pm, pn, pl, CHI_NORM_Y, nodes);
+    if (!chi) {
+        printf("Memory allocation failed in solver_mode2_core.\n");
+        goto cleanup;
+    }
+    int i112 = chi_projection_index(chi, 1, 1, 2);
+    printf("Projections: %d, chi blocks: %d\n", n_projections, chi->n_blocks);
+
+    h = create_projection_matrix(n_projections, nodes);
+    c = create_projection_matrix(n_projections, nodes);
+    eta = create_projection_matrix(n_projections, nodes);
+    C_k = create_projection_matrix(n_projections, nodes);
+    H_k = create_projection_matrix(n_projections, nodes);
+    c_new = create_projection_matrix(n_projections, nodes); // Closure output
 
     double dr = rmax / nodes;
-    double *r = malloc(nodes * sizeof(double));
-    double *k = malloc(nodes * sizeof(double));
-    double dk = M_PI / (nodes * dr); 
+    double dk = M_PI / (nodes * dr);
+    r = malloc(nodes * sizeof(double));
+    k = malloc(nodes * sizeof(double));
+    if (!r || !k) {
+        printf("Memory allocation failed in solver_mode2_core.\n");
+        goto cleanup;
+    }
 
     for(int i=0; i<nodes; i++) {
         r[i] = (i+1) * dr;
@@ -110,229 +371,242 @@ void solver_mode2_core(int closureID, double temp, double rho, double dipole_mom
     double beta_mu2 = beta * dipole_moment * dipole_moment;
     double sigma = 1.0;
 
-    closure_MSA_mode2(c->data, eta->data, r, nodes, beta_mu2, sigma, n_projections);
+    // --gpu: the whole loop runs on the device (which builds its own tables);
+    // without a usable device it runs here
+    int depth = (opts->mixing == MIXING_ANDERSON) ? opts->anderson_depth : 0;
+    dev = opts->gpu ? create_mode2_device(chi, r, k, nodes, depth) : NULL;
+    if (opts->gpu) printf(dev ? "Iterating on the GPU.\n" : "GPU not available, iterating on the CPU.\n");
+
+    // --mixed-precision: float tables until the residual drops below opts->mixed_precision, then
+    // double tables for the final iterations (the device path is always double)
+    int single = (opts->mixed_precision > 0.0 && !dev);
+    kernels = dev ? NULL : create_bessel_cache(r, k, nodes, 2 * mmax, MODE2_KERNEL_CACHE_MB, single);
+    pack_in = malloc((size_t) n_projections * nodes * sizeof(double));
+    pack_out = malloc((size_t) n_projections * nodes * sizeof(double));
+    // --dipole-split (CPU only): the 1/r^3 tails of c112 and h112 go through T(k)
+    // (no sign: these kernels are plain j_l); chi0 solves OZ at k -> 0 for the amplitude of h112
+    if (opts->dipole_split && !dev) {
+        tail = create_dipole_tail(r, k, nodes, dr, sigma, 1.0);
+        chi0 = create_chi_mode_solver(n_projections, pm, pn, pl, CHI_NORM_Y, 1);
+        rows = malloc(n_projections * sizeof(double *));
+    }
+    if ((!dev && !kernels) || (opts->dipole_split && !dev && (!tail || !chi0 || !rows)) || !pack_in || !pack_out || !h || !c || !eta || !C_k || !H_k || !c_new) {
+        printf("Memory allocation failed in solver_mode2_core.\n");
+        goto cleanup;
+    }
+
+    closure_MSA_mode2(c->data, eta->data, r, nodes, beta_mu2, sigma, n_projections, i112);
+
+    // Start from the nearest cached solution instead, if any
+    OZCacheKey cache_key;
+    if (opts->cache_dir) {
+        nonspherical_cache_key(&cache_key, "mode2", (closureID == 0) ? "MSA" : "LHNC", 15, mmax, nodes, rmax, \
+                               rho, temp, dipole_moment);
+        nonspherical_cache_load(opts->cache_dir, &cache_key, r, c);
+    }
 
-    int max_iter = 2000;
-    double tolerance = 1e-6;
+    int max_iter = opts->max_iter;
+    double tolerance = opts->tolerance;
     double error = 1.0;
     int iter = 0;
 
-    while (iter < max_iter && error > tolerance) {
-        // Forward Hankel Transform O(N^2)
-        for (int p = 0; p < n_projections; p++) {
-            int l = get_mode_l(p);
-            for (int i = 0; i < nodes; i++) {
-                double k_val = k[i];
-                double sum = 0.0;
-                for (int j = 0; j < nodes; j++) {
-                    double r_val = r[j];
-                    double arg = k_val * r_val;
-                    double bessel = (arg < 1e-6 && l > 0) ? 0.0 : ((arg < 1e-6 && l == 0) ? 1.0 : get_jl_kr(l, arg));
-                    sum += r_val * r_val * c->data[p][j] * bessel * dr;
-                }
-                C_k->data[p][i] = 4.0 * M_PI * sum;
-            }
-        }
+    if (dev) mode2_device_upload(dev, c);
 
-        solve_oz_k_space_mode2(C_k, H_k, nodes, rho);
+    // Picard is Anderson with an empty history (with --gpu the history lives on the device)
+    mixer = dev ? NULL : create_anderson_mixer(n_projections, nodes, depth);
+    if (!dev && !mixer) {
+        printf("Memory allocation failed for the mixer.\n");
+        goto cleanup;
+    }
+    DampingControl damping;
+    damping_init(&damping, opts->alpha, opts->adaptive_damping);
 
-        // Inverse Hankel Transform O(N^2)
-        for (int p = 0; p < n_projections; p++) {
-            int l = get_mode_l(p);
-            for (int i = 0; i < nodes; i++) {
-                double r_val = r[i];
-                double sum = 0.0;
-                for (int j = 0; j < nodes; j++) {
-                    double k_val = k[j];
-                    double arg = k_val * r_val;
-                    double bessel = (arg < 1e-6 && l > 0) ? 0.0 : ((arg < 1e-6 && l == 0) ? 1.0 : get_jl_kr(l, arg));
-                    sum += k_val * k_val * H_k->data[p][j] * bessel * dk;
-                }
-                h->data[p][i] = (1.0 / (2.0 * M_PI * M_PI)) * sum;
-                eta->data[p][i] = h->data[p][i] - c->data[p][i];
+    if (opts->mixing == MIXING_ANDERSON)
+        printf("Mixing: Anderson (m=%d), alpha=%.3f%s\n", depth, opts->alpha, opts->adaptive_damping ? ", adaptive" : "");
+    else
+        printf("Mixing: Picard, alpha=%.3f%s\n", opts->alpha, opts->adaptive_damping ? ", adaptive" : "");
+
+    if (single) oz_telemetry_set_precision(32);
+    while (iter < max_iter && (error > tolerance || single)) {
+        // Promote before converging (the loop runs on while single), so the result is the double fixed point
+        if (single && (error < opts->mixed_precision || error <= tolerance)) {
+            printf("Iter %4d: Error = %.5e, switching the transforms to double precision\n", iter, error);
+            free_bessel_cache(kernels);
+            kernels = create_bessel_cache(r, k, nodes, 2 * mmax, MODE2_KERNEL_CACHE_MB, 0);
+            single = 0;
+            oz_telemetry_set_precision(64);
+            if (!kernels) {
+                printf("Memory allocation failed in solver_mode2_core.\n");
+                break;
             }
         }
 
-        ProjectionMatrix *c_new = create_projection_matrix(n_projections, nodes);
-        for(int p=0; p<n_projections; p++) {
-            for(int i=0; i<nodes; i++) {
-                c_new->data[p][i] = c->data[p][i];
-            }
+        // Forward Hankel Transform: C(k) = 4 PI sum_j r_j^2 c(r_j) j_l(k r_j) dr
+        // (with --dipole-split, 112 only transforms c112 - beta*mu^2 t(r))
+        double t0 = oz_time_now();
+        if (dev) {
+            mode2_device_forward(dev, 4.0 * M_PI * dr);
+        } else if (tail) {
+            memcpy(rows, c->data, n_projections * sizeof(double *));
+            dipole_tail_remove(tail, c->data[i112], tail->t_r, beta_mu2);
+            rows[i112] = tail->work;
+            transform_mode2(kernels, rows, C_k->data, r, k, 4.0 * M_PI * dr,
+                            n_projections, chi->l, pack_in, pack_out);
+            dipole_tail_restore(tail, C_k->data[i112], tail->t_k, beta_mu2);
+        } else {
+            transform_mode2(kernels, c->data, C_k->data, r, k, 4.0 * M_PI * dr,
+                            n_projections, chi->l, pack_in, pack_out);
         }
+        oz_timing_stop(OZ_PHASE_TRANSFORM, t0);
+
+        t0 = oz_time_now();
+        if (dev) mode2_device_oz(dev, rho);
+        else chi_mode_solve(chi, C_k->data, H_k->data, rho);
+        double h112_tail = tail ? dipole_tail_amplitude(tail, chi0, c->data, i112, beta_mu2, rho) : 0.0;
+        oz_timing_stop(OZ_PHASE_OZ, t0);
 
-        if (closureID == 0) closure_MSA_mode2(c_new->data, eta->data, r, nodes, beta_mu2, sigma, n_projections);
-        else if (closureID == 1) closure_LHNC_mode2(c_new->data, h->data, eta->data, r, nodes, beta_mu2, sigma, n_projections);
-        else closure_LHNC_mode2(c_new->data, h->data, eta->data, r, nodes, beta_mu2, sigma, n_projections); // Fallback
-
-        double alpha = 0.3;
-        error = 0.0;
-        for(int p=0; p<n_projections; p++) {
-            for(int i=0; i<nodes; i++) {
-                double diff = c_new->data[p][i] - c->data[p][i];
-                error += diff * diff;
-                c->data[p][i] += alpha * diff;
+        // Inverse Hankel Transform: h(r) = 1/(2 PI^2) sum_j k_j^2 H(k_j) j_l(k_j r) dk
+        // (and H112 - A T(k), A = h112_tail)
+        t0 = oz_time_now();
+        if (dev) {
+            mode2_device_inverse(dev, dk / (2.0 * M_PI * M_PI));
+        } else if (tail) {
+            memcpy(rows, H_k->data, n_projections * sizeof(double *));
+            dipole_tail_remove(tail, H_k->data[i112], tail->t_k, h112_tail);
+            rows[i112] = tail->work;
+            transform_mode2(kernels, rows, h->data, k, r, dk / (2.0 * M_PI * M_PI),
+                            n_projections, chi->l, pack_in, pack_out);
+            dipole_tail_restore(tail, h->data[i112], tail->t_r, h112_tail);
+        } else {
+            transform_mode2(kernels, H_k->data, h->data, k, r, dk / (2.0 * M_PI * M_PI),
+                            n_projections, chi->l, pack_in, pack_out);
+        }
+        oz_timing_stop(OZ_PHASE_TRANSFORM, t0);
+
+        if (dev) {
+            t0 = oz_time_now();
+            mode2_device_closure(dev, closureID, beta_mu2, sigma, i112);
+            oz_timing_stop(OZ_PHASE_CLOSURE, t0);
+
+            t0 = oz_time_now();
+            error = mode2_device_residual(dev);
+            mode2_device_step(dev, damping.beta, damping_update(&damping, error));
+            oz_timing_stop(OZ_PHASE_MIXING, t0);
+        } else {
+            t0 = oz_time_now();
+            #pragma omp parallel for collapse(2) schedule(static)
+            for (int p = 0; p < n_projections; p++) {
+                for (int i = 0; i < nodes; i++) {
+                    eta->data[p][i] = h->data[p][i] - c->data[p][i];
+                }
             }
+
+            projection_matrix_copy(c_new, c);
+
+            if (closureID == 0) closure_MSA_mode2(c_new->data, eta->data, r, nodes, beta_mu2, sigma, n_projections, i112);
+            else if (closureID == 1) closure_LHNC_mode2(c_new->data, h->data, eta->data, r, nodes, beta_mu2, sigma, n_projections, i112);
+            else closure_LHNC_mode2(c_new->data, h->data, eta->data, r, nodes, beta_mu2, sigma, n_projections, i112); // Fallback
+            oz_timing_stop(OZ_PHASE_CLOSURE, t0);
+
+            // F. Compute the L2 residual and mix (Picard or Anderson)
+            t0 = oz_time_now();
+            error = anderson_residual(mixer, c->data, c_new->data);
+            if (damping_update(&damping, error)) anderson_reset(mixer);
+            anderson_step(mixer, c->data, damping.beta);
+            oz_timing_stop(OZ_PHASE_MIXING, t0);
         }
-        error = sqrt(error / (n_projections * nodes));
-        free_projection_matrix(c_new);
 
         if (iter % 50 == 0) printf("Iter %4d: Error = %.5e\n", iter, error);
         iter++;
+        if (oz_telemetry_active) oz_telemetry_emit("mode2", 1, rho, iter, error, -1, 0, oz_heap_alloc_count());
+
+        // Checkpoint, so a killed run resumes from here
+        if (opts->cache_dir && opts->checkpoint_interval > 0 && iter % opts->checkpoint_interval == 0 && error > tolerance) {
+            if (dev) mode2_device_download(dev, c, NULL, NULL, NULL);
+            nonspherical_cache_save(opts->cache_dir, &cache_key, r, c, 0, iter, error, rho);
+        }
     }
     printf("Finished Mode 2 Solver in %d iter. Error = %.5e\n", iter-1, error);
+    oz_timing_count(iter);
+    oz_telemetry_set_precision(64);
+    if (dev) mode2_device_download(dev, c, h, C_k, H_k);
+
+    if (opts->cache_dir)
+        nonspherical_cache_save(opts->cache_dir, &cache_key, r, c, error <= tolerance, iter, error, rho);
     
     // Save output...
-    char filename[256];
-    snprintf(filename, sizeof(filename), "output/output_mode15.dat");
-    FILE *fp = fopen(filename, "w");
-    fprintf(fp, "# r h000 h110 h112 h220 h222 c000 ... \n");
-    for (int i=0; i<nodes; i++) {
-        fprintf(fp, "%.5e", r[i]);
-        for(int p=0; p<n_projections; p++) fprintf(fp, " %.5e", h->data[p][i]);
-        fprintf(fp, "\n");
+    double t_output = oz_time_now();
+    char filepath[256];
+    if (output_dir == NULL) {
+        // Caller keeps the results in memory
+    } else if (opts->output_format != OZ_OUTPUT_TEXT) {
+        snprintf(filepath, sizeof(filepath), "%s/output_mode15%s", output_dir, oz_output_extension(opts->output_format));
+
+        // S^{mnl}(k) = delta_{mnl,000} + rho H^{mnl}(k), into the no longer needed eta
+        for (int p = 0; p < n_projections; p++) {
+            for (int i = 0; i < nodes; i++) {
+                eta->data[p][i] = ((p == 0) ? 1.0 : 0.0) + rho * H_k->data[p][i];
+            }
+        }
+
+        OZOutput *out = create_oz_output(filepath, opts->output_format);
+        int status = (out == NULL);
+        if (!status) {
+            const double *col[1];
+            status = oz_output_attr_string(out, "solver", "mode2") | \
+                     oz_output_attr_string(out, "closure", (closureID == 0) ? "MSA" : "LHNC") | \
+                     oz_output_attr_int(out, "potential", 15) | \
+                     oz_output_attr_int(out, "nodes", nodes) | \
+                     oz_output_attr_double(out, "rmax", rmax) | \
+                     oz_output_attr_int(out, "mmax", mmax) | \
+                     oz_output_begin_point(out) | \
+                     oz_output_attr_double(out, "temp", temp) | \
+                     oz_output_attr_double(out, "rho", rho) | \
+                     oz_output_attr_double(out, "dipole", dipole_moment) | \
+                     oz_output_attr_int(out, "iterations", iter) | \
+                     oz_output_attr_double(out, "residual", error);
+            col[0] = r; status |= oz_output_dataset(out, "r", "r", col, 1, nodes);
+            status |= write_projection_matrix(out, "h", h, chi->m, chi->n, chi->l);
+            status |= write_projection_matrix(out, "c", c, chi->m, chi->n, chi->l);
+            col[0] = k; status |= oz_output_dataset(out, "k", "k", col, 1, nodes);
+            status |= write_projection_matrix(out, "H", H_k, chi->m, chi->n, chi->l);
+            status |= write_projection_matrix(out, "C", C_k, chi->m, chi->n, chi->l);
+            status |= write_projection_matrix(out, "S", eta, chi->m, chi->n, chi->l);
+            status |= oz_output_end_point(out);
+        }
+        free_oz_output(out);
+        if (status) fprintf(stderr, "Error: Could not write file %s.\n", filepath);
+        else printf("Written %s\n", filepath);
+    } else {
+        snprintf(filepath, sizeof(filepath), "%s/output_mode15.dat", output_dir);
+        FILE *fp = fopen(filepath, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "Error: Could not open file %s for writing.\n", filepath);
+        } else {
+            fprintf(fp, "# r");
+            for (int p = 0; p < n_projections; p++) fprintf(fp, " h%d%d%d", chi->m[p], chi->n[p], chi->l[p]);
+            fprintf(fp, "\n");
+            for (int i=0; i<nodes; i++) {
+                fprintf(fp, "%.5e", r[i]);
+                for(int p=0; p<n_projections; p++) fprintf(fp, " %.5e", h->data[p][i]);
+                fprintf(fp, "\n");
+            }
+            fclose(fp);
+        }
     }
-    fclose(fp);
+    oz_timing_stop(OZ_PHASE_OUTPUT, t_output);
 
+cleanup:
+    free(pm); free(pn); free(pl);
     free_projection_matrix(h); free_projection_matrix(c); free_projection_matrix(eta);
-    free_projection_matrix(C_k); free_projection_matrix(H_k);
+    free_projection_matrix(C_k); free_projection_matrix(H_k); free_projection_matrix(c_new);
     free(r); free(k);
-}
-
-void solve_oz_k_space_mode2(ProjectionMatrix *C_mat, ProjectionMatrix *H_mat, int nodes, double rho) {
-    double **C_k = C_mat->data;
-    double **H_k = H_mat->data;
-    for (int i = 0; i < nodes; i++) {
-        double C_0_Blum = C_k[0][i] / (1.0);
-        double C_1_Blum = C_k[1][i] / (-0.9999999999999999);
-        double C_2_Blum = C_k[2][i] / (1.0);
-        double C_3_Blum = C_k[3][i] / (-0.9999999999999999);
-        double C_4_Blum = C_k[4][i] / (-1.732050807568877);
-        double C_5_Blum = C_k[5][i] / (1.095445115010332);
-        double C_6_Blum = C_k[6][i] / (1.414213562373095);
-        double C_7_Blum = C_k[7][i] / (-1.1338934190276817);
-        double C_8_Blum = C_k[8][i] / (1.0);
-        double C_9_Blum = C_k[9][i] / (1.414213562373095);
-        double C_10_Blum = C_k[10][i] / (-1.1338934190276817);
-        double C_11_Blum = C_k[11][i] / (2.2360679774997902);
-        double C_12_Blum = C_k[12][i] / (-1.1952286093343938);
-        double C_13_Blum = C_k[13][i] / (1.1952286093343938);
-        double C_p0_00 = (1.0) * C_0_Blum;
-        double C_p0_01 = (-0.5773502691896257) * C_1_Blum;
-        double C_p0_02 = (0.4472135954999579) * C_2_Blum;
-        double C_p0_10 = (-0.5773502691896257) * C_3_Blum;
-        double C_m1_11 = (0.5773502691896257) * C_4_Blum + (0.18257418583505536) * C_5_Blum;
-        double C_p0_11 = (-0.5773502691896257) * C_4_Blum + (0.3651483716701107) * C_5_Blum;
-        double C_p1_11 = (0.5773502691896257) * C_4_Blum + (0.18257418583505536) * C_5_Blum;
-        double C_m1_12 = (-0.31622776601683794) * C_6_Blum + (-0.1690308509457033) * C_7_Blum;
-        double C_p0_12 = (0.3651483716701107) * C_6_Blum + (-0.29277002188455997) * C_7_Blum;
-        double C_p1_12 = (-0.31622776601683794) * C_6_Blum + (-0.1690308509457033) * C_7_Blum;
-        double C_p0_20 = (0.4472135954999579) * C_8_Blum;
-        double C_m1_21 = (-0.31622776601683794) * C_9_Blum + (-0.1690308509457033) * C_10_Blum;
-        double C_p0_21 = (0.3651483716701107) * C_9_Blum + (-0.29277002188455997) * C_10_Blum;
-        double C_p1_21 = (-0.31622776601683794) * C_9_Blum + (-0.1690308509457033) * C_10_Blum;
-        double C_m2_22 = (0.4472135954999579) * C_11_Blum + (0.23904572186687872) * C_12_Blum + (0.03984095364447979) * C_13_Blum;
-        double C_m1_22 = (-0.4472135954999579) * C_11_Blum + (0.11952286093343936) * C_12_Blum + (0.15936381457791915) * C_13_Blum;
-        double C_p0_22 = (0.4472135954999579) * C_11_Blum + (-0.23904572186687872) * C_12_Blum + (0.23904572186687872) * C_13_Blum;
-        double C_p1_22 = (-0.4472135954999579) * C_11_Blum + (0.11952286093343936) * C_12_Blum + (0.15936381457791915) * C_13_Blum;
-        double C_p2_22 = (0.4472135954999579) * C_11_Blum + (0.23904572186687872) * C_12_Blum + (0.03984095364447979) * C_13_Blum;
-
-        // --- Solvers for each Chi mode ---
-        double I_m_C_p0_00 = 1.0 - (1.0 * rho) * C_p0_00;
-        double I_m_C_p0_01 = 0.0 - (1.0 * rho) * C_p0_01;
-        double I_m_C_p0_02 = 0.0 - (1.0 * rho) * C_p0_02;
-        double I_m_C_p0_10 = 0.0 - (1.0 * rho) * C_p0_10;
-        double I_m_C_p0_11 = 1.0 - (1.0 * rho) * C_p0_11;
-        double I_m_C_p0_12 = 0.0 - (1.0 * rho) * C_p0_12;
-        double I_m_C_p0_20 = 0.0 - (1.0 * rho) * C_p0_20;
-        double I_m_C_p0_21 = 0.0 - (1.0 * rho) * C_p0_21;
-        double I_m_C_p0_22 = 1.0 - (1.0 * rho) * C_p0_22;
-
-        double det_p0 = I_m_C_p0_00 * (I_m_C_p0_11 * I_m_C_p0_22 - I_m_C_p0_12 * I_m_C_p0_21)
-                              - I_m_C_p0_01 * (I_m_C_p0_10 * I_m_C_p0_22 - I_m_C_p0_12 * I_m_C_p0_20)
-                              + I_m_C_p0_02 * (I_m_C_p0_10 * I_m_C_p0_21 - I_m_C_p0_11 * I_m_C_p0_20);
-        double inv_det_p0 = (fabs(det_p0) > 1e-12) ? 1.0 / det_p0 : 0.0;
-
-        double M_p0_00 = (I_m_C_p0_11 * I_m_C_p0_22 - I_m_C_p0_12 * I_m_C_p0_21) * inv_det_p0;
-        double M_p0_01 = (I_m_C_p0_02 * I_m_C_p0_21 - I_m_C_p0_01 * I_m_C_p0_22) * inv_det_p0;
-        double M_p0_02 = (I_m_C_p0_01 * I_m_C_p0_12 - I_m_C_p0_02 * I_m_C_p0_11) * inv_det_p0;
-        double M_p0_10 = (I_m_C_p0_12 * I_m_C_p0_20 - I_m_C_p0_10 * I_m_C_p0_22) * inv_det_p0;
-        double M_p0_11 = (I_m_C_p0_00 * I_m_C_p0_22 - I_m_C_p0_02 * I_m_C_p0_20) * inv_det_p0;
-        double M_p0_12 = (I_m_C_p0_02 * I_m_C_p0_10 - I_m_C_p0_00 * I_m_C_p0_12) * inv_det_p0;
-        double M_p0_20 = (I_m_C_p0_10 * I_m_C_p0_21 - I_m_C_p0_11 * I_m_C_p0_20) * inv_det_p0;
-        double M_p0_21 = (I_m_C_p0_01 * I_m_C_p0_20 - I_m_C_p0_00 * I_m_C_p0_21) * inv_det_p0;
-        double M_p0_22 = (I_m_C_p0_00 * I_m_C_p0_11 - I_m_C_p0_01 * I_m_C_p0_10) * inv_det_p0;
-        double H_p0_00 = M_p0_00 * C_p0_00 + M_p0_01 * C_p0_10 + M_p0_02 * C_p0_20;
-        double H_p0_01 = M_p0_00 * C_p0_01 + M_p0_01 * C_p0_11 + M_p0_02 * C_p0_21;
-        double H_p0_02 = M_p0_00 * C_p0_02 + M_p0_01 * C_p0_12 + M_p0_02 * C_p0_22;
-        double H_p0_10 = M_p0_10 * C_p0_00 + M_p0_11 * C_p0_10 + M_p0_12 * C_p0_20;
-        double H_p0_11 = M_p0_10 * C_p0_01 + M_p0_11 * C_p0_11 + M_p0_12 * C_p0_21;
-        double H_p0_12 = M_p0_10 * C_p0_02 + M_p0_11 * C_p0_12 + M_p0_12 * C_p0_22;
-        double H_p0_20 = M_p0_20 * C_p0_00 + M_p0_21 * C_p0_10 + M_p0_22 * C_p0_20;
-        double H_p0_21 = M_p0_20 * C_p0_01 + M_p0_21 * C_p0_11 + M_p0_22 * C_p0_21;
-        double H_p0_22 = M_p0_20 * C_p0_02 + M_p0_21 * C_p0_12 + M_p0_22 * C_p0_22;
-        double I_m_C_p1_11 = 1.0 - (-1.0 * rho) * C_p1_11;
-        double I_m_C_p1_12 = 0.0 - (-1.0 * rho) * C_p1_12;
-        double I_m_C_p1_21 = 0.0 - (-1.0 * rho) * C_p1_21;
-        double I_m_C_p1_22 = 1.0 - (-1.0 * rho) * C_p1_22;
-
-        double det_p1 = I_m_C_p1_11 * I_m_C_p1_22 - I_m_C_p1_12 * I_m_C_p1_21;
-        double inv_det_p1 = (fabs(det_p1) > 1e-12) ? 1.0 / det_p1 : 0.0;
-        double M_p1_11 = I_m_C_p1_22 * inv_det_p1;
-        double M_p1_12 = -I_m_C_p1_12 * inv_det_p1;
-        double M_p1_21 = -I_m_C_p1_21 * inv_det_p1;
-        double M_p1_22 = I_m_C_p1_11 * inv_det_p1;
-        double H_p1_11 = M_p1_11 * C_p1_11 + M_p1_12 * C_p1_21;
-        double H_p1_12 = M_p1_11 * C_p1_12 + M_p1_12 * C_p1_22;
-        double H_p1_21 = M_p1_21 * C_p1_11 + M_p1_22 * C_p1_21;
-        double H_p1_22 = M_p1_21 * C_p1_12 + M_p1_22 * C_p1_22;
-        double I_m_C_m1_11 = 1.0 - (-1.0 * rho) * C_m1_11;
-        double I_m_C_m1_12 = 0.0 - (-1.0 * rho) * C_m1_12;
-        double I_m_C_m1_21 = 0.0 - (-1.0 * rho) * C_m1_21;
-        double I_m_C_m1_22 = 1.0 - (-1.0 * rho) * C_m1_22;
-
-        double det_m1 = I_m_C_m1_11 * I_m_C_m1_22 - I_m_C_m1_12 * I_m_C_m1_21;
-        double inv_det_m1 = (fabs(det_m1) > 1e-12) ? 1.0 / det_m1 : 0.0;
-        double M_m1_11 = I_m_C_m1_22 * inv_det_m1;
-        double M_m1_12 = -I_m_C_m1_12 * inv_det_m1;
-        double M_m1_21 = -I_m_C_m1_21 * inv_det_m1;
-        double M_m1_22 = I_m_C_m1_11 * inv_det_m1;
-        double H_m1_11 = M_m1_11 * C_m1_11 + M_m1_12 * C_m1_21;
-        double H_m1_12 = M_m1_11 * C_m1_12 + M_m1_12 * C_m1_22;
-        double H_m1_21 = M_m1_21 * C_m1_11 + M_m1_22 * C_m1_21;
-        double H_m1_22 = M_m1_21 * C_m1_12 + M_m1_22 * C_m1_22;
-        double denom_p2 = 1.0 - (1.0 * rho) * C_p2_22;
-        double H_p2_22 = (fabs(denom_p2) > 1e-12) ? C_p2_22 / denom_p2 : 0.0;
-        double denom_m2 = 1.0 - (1.0 * rho) * C_m2_22;
-        double H_m2_22 = (fabs(denom_m2) > 1e-12) ? C_m2_22 / denom_m2 : 0.0;
-
-        // --- Inverse Chi Transforms ---
-        double H_0_Blum = (1.0) * H_p0_00;
-        double H_1_Blum = (-1.7320508075688772) * H_p0_01;
-        double H_2_Blum = (2.23606797749979) * H_p0_02;
-        double H_3_Blum = (-1.7320508075688772) * H_p0_10;
-        double H_4_Blum = (0.5773502691896257) * H_m1_11 + (-0.5773502691896257) * H_p0_11 + (0.5773502691896257) * H_p1_11;
-        double H_5_Blum = (0.9128709291752768) * H_m1_11 + (1.8257418583505536) * H_p0_11 + (0.9128709291752768) * H_p1_11;
-        double H_6_Blum = (-0.9486832980505138) * H_m1_12 + (1.0954451150103321) * H_p0_12 + (-0.9486832980505138) * H_p1_12;
-        double H_7_Blum = (-1.1832159566199232) * H_m1_12 + (-2.04939015319192) * H_p0_12 + (-1.1832159566199232) * H_p1_12;
-        double H_8_Blum = (2.23606797749979) * H_p0_20;
-        double H_9_Blum = (-0.9486832980505138) * H_m1_21 + (1.0954451150103321) * H_p0_21 + (-0.9486832980505138) * H_p1_21;
-        double H_10_Blum = (-1.1832159566199232) * H_m1_21 + (-2.04939015319192) * H_p0_21 + (-1.1832159566199232) * H_p1_21;
-        double H_11_Blum = (0.4472135954999579) * H_m2_22 + (-0.4472135954999579) * H_m1_22 + (0.4472135954999579) * H_p0_22 + (-0.4472135954999579) * H_p1_22 + (0.4472135954999579) * H_p2_22;
-        double H_12_Blum = (1.1952286093343936) * H_m2_22 + (0.5976143046671968) * H_m1_22 + (-1.1952286093343936) * H_p0_22 + (0.5976143046671968) * H_p1_22 + (1.1952286093343936) * H_p2_22;
-        double H_13_Blum = (0.3585685828003181) * H_m2_22 + (1.4342743312012725) * H_m1_22 + (2.1514114968019085) * H_p0_22 + (1.4342743312012725) * H_p1_22 + (0.3585685828003181) * H_p2_22;
-        H_k[0][i] = H_0_Blum * (1.0);
-        H_k[1][i] = H_1_Blum * (-0.9999999999999999);
-        H_k[2][i] = H_2_Blum * (1.0);
-        H_k[3][i] = H_3_Blum * (-0.9999999999999999);
-        H_k[4][i] = H_4_Blum * (-1.732050807568877);
-        H_k[5][i] = H_5_Blum * (1.095445115010332);
-        H_k[6][i] = H_6_Blum * (1.414213562373095);
-        H_k[7][i] = H_7_Blum * (-1.1338934190276817);
-        H_k[8][i] = H_8_Blum * (1.0);
-        H_k[9][i] = H_9_Blum * (1.414213562373095);
-        H_k[10][i] = H_10_Blum * (-1.1338934190276817);
-        H_k[11][i] = H_11_Blum * (2.2360679774997902);
-        H_k[12][i] = H_12_Blum * (-1.1952286093343938);
-        H_k[13][i] = H_13_Blum * (1.1952286093343938);
-    }
+    free_bessel_cache(kernels);
+    free(pack_in); free(pack_out);
+    free_dipole_tail(tail);
+    free_chi_mode_solver(chi0);
+    free(rows);
+    free_mode2_device(dev);
+    free_anderson_mixer(mixer);
+    free_chi_mode_solver(chi);
 }
@@ -9,77 +9,162 @@
 
 #include "structures.h"
 #include "math_aux.h"
+#include "newton.h"
+#include "closure_kernels.h"
+#include "oz_timing.h"
+#include "oz_telemetry.h"
+#include "oz_potential.h"
+#include <float.h>
 
 /**
  * @brief Initializes the system parameters and interaction potentials.
  *
+ * @param ctx Solver context (grids, potential tables, density).
  * @param fv Volume fraction.
  * @param xnu Potential parameter (e.g., for LJT).
  * @param especie1 Properties of species 1.
  * @param especie2 Properties of species 2.
- * @param rmax Maximum radial distance.
  * @param potentialID ID of the interaction potential to use.
+ * @return 0 on success, 1 if POT_ctx could not build U and Up.
  */
-void input(double fv, double xnu, species especie1, species especie2, double rmax, int potentialID) {
+int input_ctx(OZContext *ctx, double fv, double xnu, species especie1, species especie2, int potentialID) {
 
     int i;
     double dq;
 
-    rho = (6.0 / M_PI) * fv;
+    ctx->rho = (6.0 / M_PI) * fv;
 
-    printf("\n------------------------------\n");
-    printf("VOLUME FRACTION = %lf\n\n", fv);
+    oz_log(ctx, "\n------------------------------\n");
+    oz_log(ctx, "VOLUME FRACTION = %lf\n\n", fv);
 
     double sigma1 = especie1.diameter;
     double sigma2 = especie2.diameter;
 
-    sigmaVec[0] = sigma1;
-    sigmaVec[1] = (sigma1 + sigma2) / 2.0;
-    sigmaVec[2] = sigma2;
+    ctx->sigmaVec[0] = sigma1;
+    ctx->sigmaVec[1] = (sigma1 + sigma2) / 2.0;
+    ctx->sigmaVec[2] = sigma2;
 
-    dq = M_PI / rmax;
-    dr = rmax / ((double) nrows);
+    dq = M_PI / ctx->rmax;
+    ctx->dr = ctx->rmax / ((double) ctx->nrows);
 
-    for (i = 0; i < nrows; i++) {
-        r[i] = i * dr;
-        q[i] = i * dq;
+    for (i = 0; i < ctx->nrows; i++) {
+        ctx->r[i] = i * ctx->dr;
+        ctx->q[i] = i * dq;
     }
 
-    POT(especie1, especie2, potentialID, xnu);
+    // The grid and U are rewritten: rebuild the RY mixing function and the closure tables on first use
+    if (ctx->ry_mix) ctx->ry_mix->alpha = -1.0;
+    if (ctx->closure_tab) ctx->closure_tab->potential = -1;
+
+    return POT_ctx(ctx, especie1, especie2, potentialID, xnu);
+}
+
+/**
+ * @brief Legacy entry point: runs input_ctx on the global state.
+ */
+void input(double fv, double xnu, species especie1, species especie2, double rmax, int potentialID) {
+    OZContext ctx = oz_legacy_context();
+    ctx.rmax = rmax;
+    input_ctx(&ctx, fv, xnu, especie1, especie2, potentialID);
+    oz_legacy_sync(&ctx);
+}
+
+/*
+ * Key and energy factors of the shared U/Up tables (oz_potential.h): every
+ * potential below is linear in 1/T of the pair (E, and E2 of the double
+ * Yukawa at fixed temperature2). Returns 0 for IDs POT_ctx does not build.
+ */
+static int pot_shared_key(const OZContext *ctx, species especie1, species especie2, int potentialID, double xnu, \
+                          OZPotentialKey *key, double *scale) {
+    if (ctx->ncols != 3 || potentialID < 1 || potentialID == 14 || potentialID == 15 || potentialID > 17) return 0;
+    if (potentialID == 17 && ctx->potential_table == NULL) return 0;
+
+    memset(key, 0, sizeof(OZPotentialKey));
+    key->potential = potentialID;
+    key->nrows = ctx->nrows;
+    key->ncols = ctx->ncols;
+    key->dr = ctx->dr;
+    for (int k = 0; k < 3; k++) key->sigma[k] = ctx->sigmaVec[k];
+    key->lambda[0] = especie1.lambda;
+    key->lambda[1] = especie2.lambda;
+    key->lambda2[0] = especie1.lambda2;
+    key->lambda2[1] = especie2.lambda2;
+    key->temperature2[0] = especie1.temperature2;
+    key->temperature2[1] = especie2.temperature2;
+    key->xnu = xnu;
+    key->table = (potentialID == 17) ? ctx->potential_table->checksum : 0;
+
+    if (potentialID == 7) {
+        // Hard spheres: U = 0 at every temperature
+        scale[0] = scale[1] = scale[2] = 1.0;
+    } else {
+        scale[0] = 1.0 / especie1.temperature;
+        scale[2] = 1.0 / especie2.temperature;
+        scale[1] = sqrt(scale[0] * scale[2]);
+    }
+    return 1;
 }
 
 /**
  * @brief Calculates the interaction potential U(r) and its derivative Up(r).
  *
  * Initializes the potential arrays `U` and `Up` based on the selected `potentialID`.
+ * A potential already built on this grid with the same parameters (by any
+ * context of the process) is copied from the shared tables of
+ * oz_potential.h, rescaled to the temperatures of especie1 and especie2.
  *
+ * @param ctx Solver context (grids, potential tables, density).
  * @param especie1 Properties of species 1.
  * @param especie2 Properties of species 2.
  * @param potentialID ID of the potential.
  * @param xnu Potential parameter.
+ * @return 0 on success, 1 if U and Up could not be built (no memory, or
+ *         potential 17 without ctx->potential_table); they are then zero.
  */
-void POT(species especie1, species especie2, int potentialID, double xnu) {
+int POT_ctx(OZContext *ctx, species especie1, species especie2, int potentialID, double xnu) {
 
     int i, k;
     double dmed, rlamb;
     double arg1, arg2, arg3, arg4;
     double *Ua, *Ur, *E, *E2, *z, *z2;
+    int status = 0;
+
+    // Same potential on the same grid: only the energy scale changes
+    OZPotentialKey key;
+    double scale[3];
+    int shared = pot_shared_key(ctx, especie1, especie2, potentialID, xnu, &key, scale);
+    if (shared && oz_potential_lookup(&key, scale, ctx->U, ctx->Up)) {
+        oz_log(ctx, "POTENTIAL %d: SHARED TABLE\n\n", potentialID);
+        oz_log(ctx, "ENERGY SCALE: %.3lf\n", scale[0]);
+        oz_log(ctx, "------------------------------\n");
+        return 0;
+    }
 
+    size_t mark = oz_mark(ctx);
     // Allocate memory for potential calculation arrays
-    Ua = malloc(nrows*ncols * sizeof(double));
-    Ur = malloc(nrows*ncols * sizeof(double));
-    E = malloc(ncols * sizeof(double));
-    E2 = malloc(ncols * sizeof(double));
-    z = malloc(ncols * sizeof(double));
-    z2 = malloc(ncols * sizeof(double));
+    Ua = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    Ur = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    E = oz_alloc(ctx, ctx->ncols);
+    E2 = oz_alloc(ctx, ctx->ncols);
+    z = oz_alloc(ctx, ctx->ncols);
+    z2 = oz_alloc(ctx, ctx->ncols);
 
     if (Ua == NULL || Ur == NULL || E == NULL || E2 == NULL || z == NULL || z2 == NULL ) {
         printf("Memory allocation failed in POT.\n");
-        return;
+        oz_free(ctx, Ua);
+        oz_free(ctx, Ur);
+        oz_free(ctx, E);
+        oz_free(ctx, E2);
+        oz_free(ctx, z);
+        oz_free(ctx, z2);
+        oz_release(ctx, mark);
+        memset(ctx->U, 0, (size_t) ctx->nrows * ctx->ncols * sizeof(double));
+        memset(ctx->Up, 0, (size_t) ctx->nrows * ctx->ncols * sizeof(double));
+        return 1;
     }
 
     // Mean distance between particles
-    dmed = pow(rho, -1.0/3.0);
+    dmed = pow(ctx->rho, -1.0/3.0);
 
     switch(potentialID){
         
@@ -93,23 +178,23 @@ void POT(species especie1, species especie2, int potentialID, double xnu) {
             z[2] = especie2.lambda;
             z[1] = sqrt(z[0] * z[2]);
 
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    if (r[i] < (sigmaVec[k] / 2.0)) {
-                        U[i*ncols + k] = 0.0;
-                        Up[i*ncols + k] = 0.0;
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
+                    if (ctx->r[i] < (ctx->sigmaVec[k] / 2.0)) {
+                        ctx->U[i + k*ctx->nrows] = 0.0;
+                        ctx->Up[i + k*ctx->nrows] = 0.0;
                     } else {
-                        U[i*ncols + k] = E[k] * pow(sigmaVec[k]/r[i], z[k]);
-                        Up[i*ncols + k] = U[i*ncols + k] * (z[k]); // -f(r)*r
+                        ctx->U[i + k*ctx->nrows] = E[k] * pow(ctx->sigmaVec[k]/ctx->r[i], z[k]);
+                        ctx->Up[i + k*ctx->nrows] = ctx->U[i + k*ctx->nrows] * (z[k]); // -f(r)*r
                     }
                 }
             }
 
-            printf("POTENTIAL:   INVERSE POWER LAW\n\n");
-            printf("TEMPERATURE:  %.3lf\n", E[0]);
-            printf("POWER:        %.3lf\n", z[0]);
-            printf("DIAMETER:     %.3lf\n", sigmaVec[0]);
-            printf("------------------------------\n");
+            oz_log(ctx, "POTENTIAL:   INVERSE POWER LAW\n\n");
+            oz_log(ctx, "TEMPERATURE:  %.3lf\n", E[0]);
+            oz_log(ctx, "POWER:        %.3lf\n", z[0]);
+            oz_log(ctx, "DIAMETER:     %.3lf\n", ctx->sigmaVec[0]);
+            oz_log(ctx, "------------------------------\n");
             break;
         
         case 2: 
@@ -120,26 +205,26 @@ void POT(species especie1, species especie2, int potentialID, double xnu) {
             E[2] = 1.0 / especie2.temperature;
             E[1] = sqrt(E[0] * E[2]);
 
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    arg4 = sigmaVec[k] * pow(2.0, 1.0/rlamb);
-                    if ((r[i] < (sigmaVec[k] / 2.0)) || (r[i] > arg4)) {
-                        U[i*ncols + k] = 0.0;
-                        Up[i*ncols + k] = 0.0;
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
+                    arg4 = ctx->sigmaVec[k] * pow(2.0, 1.0/rlamb);
+                    if ((ctx->r[i] < (ctx->sigmaVec[k] / 2.0)) || (ctx->r[i] > arg4)) {
+                        ctx->U[i + k*ctx->nrows] = 0.0;
+                        ctx->Up[i + k*ctx->nrows] = 0.0;
                     } else {
-                        arg1 = pow(sigmaVec[k] / r[i], rlamb);
+                        arg1 = pow(ctx->sigmaVec[k] / ctx->r[i], rlamb);
                         arg2 = arg1 * arg1;
                         arg3 = 1.0/4.0;
-                        U[i*ncols + k] = 4.0 * E[k] * (arg2 - arg1 + arg3);
-                        Up[i*ncols + k] = 4.0 * E[k] * rlamb * (2.0*arg2 - arg1);
+                        ctx->U[i + k*ctx->nrows] = 4.0 * E[k] * (arg2 - arg1 + arg3);
+                        ctx->Up[i + k*ctx->nrows] = 4.0 * E[k] * rlamb * (2.0*arg2 - arg1);
                     }
                 }
             }
 
-            printf("POTENTIAL: TRUNCATED LENNARD-JONES 6-12\n\n");
-            printf("TEMPERATURE:  %.3lf\n", E[0]);
-            printf("DIAMETER:     %.3lf\n", sigmaVec[0]);
-            printf("------------------------------\n");
+            oz_log(ctx, "POTENTIAL: TRUNCATED LENNARD-JONES 6-12\n\n");
+            oz_log(ctx, "TEMPERATURE:  %.3lf\n", E[0]);
+            oz_log(ctx, "DIAMETER:     %.3lf\n", ctx->sigmaVec[0]);
+            oz_log(ctx, "------------------------------\n");
             break;
 
         case 3: 
@@ -148,25 +233,25 @@ void POT(species especie1, species especie2, int potentialID, double xnu) {
             E[2] = 1.0 / especie2.temperature;
             E[1] = sqrt(E[0] * E[2]);
             
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    if ((r[i] < (sigmaVec[k] / 2.0)) || (r[i] > sigmaVec[k])) {
-                        U[i*ncols + k] = 0.0;
-                        Up[i*ncols + k] = 0.0;
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
+                    if ((ctx->r[i] < (ctx->sigmaVec[k] / 2.0)) || (ctx->r[i] > ctx->sigmaVec[k])) {
+                        ctx->U[i + k*ctx->nrows] = 0.0;
+                        ctx->Up[i + k*ctx->nrows] = 0.0;
                     } else {
-                        arg1 = pow(sigmaVec[k] / r[i], xnu);
+                        arg1 = pow(ctx->sigmaVec[k] / ctx->r[i], xnu);
                         arg2 = arg1 * arg1;
                         arg3 = 1.0;
-                        U[i*ncols + k] = E[k] * (arg2 - 2.0*arg1 + arg3);
-                        Up[i*ncols + k] = E[k] * 2.0*xnu * (arg2 - arg1);
+                        ctx->U[i + k*ctx->nrows] = E[k] * (arg2 - 2.0*arg1 + arg3);
+                        ctx->Up[i + k*ctx->nrows] = E[k] * 2.0*xnu * (arg2 - arg1);
                     }
                 }
             }
 
-            printf("POTENTIAL: TRUNCATED LENNARD-JONES %.1lf-%.1lf\n\n", xnu, 2.0*xnu);
-            printf("TEMPERATURE:  %.3lf\n", E[0]);
-            printf("DIAMETER:     %.3lf\n", sigmaVec[0]);
-            printf("------------------------------\n");
+            oz_log(ctx, "POTENTIAL: TRUNCATED LENNARD-JONES %.1lf-%.1lf\n\n", xnu, 2.0*xnu);
+            oz_log(ctx, "TEMPERATURE:  %.3lf\n", E[0]);
+            oz_log(ctx, "DIAMETER:     %.3lf\n", ctx->sigmaVec[0]);
+            oz_log(ctx, "------------------------------\n");
             break;
 
         case 4: 
@@ -187,29 +272,29 @@ void POT(species especie1, species especie2, int potentialID, double xnu) {
             z2[2] = especie2.lambda2;
             z2[1] = sqrt(z2[0] * z2[2]);
 
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    if (r[i] < sigmaVec[k]) {
-                        Ua[i*ncols + k] = 0.0;
-                        Ur[i*ncols + k] = 0.0;
-                        U[i*ncols + k] = 0.0;
-                        Up[i*ncols + k] = 0.0;
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
+                    if (ctx->r[i] < ctx->sigmaVec[k]) {
+                        Ua[i + k*ctx->nrows] = 0.0;
+                        Ur[i + k*ctx->nrows] = 0.0;
+                        ctx->U[i + k*ctx->nrows] = 0.0;
+                        ctx->Up[i + k*ctx->nrows] = 0.0;
                     } else {
-                        Ua[i*ncols + k] = - E[k] * exp(- z[k] * (r[i] - 1.0)) / r[i];
-                        Ur[i*ncols + k] = E2[k] * exp(- z2[k] * (r[i] - 1.0)) / r[i];
-                        U[i*ncols + k] = Ua[i*ncols + k] + Ur[i*ncols + k];
-                        Up[i*ncols + k] = (1.0 + z[k]*r[i]) * Ua[i*ncols + k] + \
-                                          (1.0 + z2[k]*r[i]) * Ur[i*ncols + k];
+                        Ua[i + k*ctx->nrows] = - E[k] * exp(- z[k] * (ctx->r[i] - 1.0)) / ctx->r[i];
+                        Ur[i + k*ctx->nrows] = E2[k] * exp(- z2[k] * (ctx->r[i] - 1.0)) / ctx->r[i];
+                        ctx->U[i + k*ctx->nrows] = Ua[i + k*ctx->nrows] + Ur[i + k*ctx->nrows];
+                        ctx->Up[i + k*ctx->nrows] = (1.0 + z[k]*ctx->r[i]) * Ua[i + k*ctx->nrows] + \
+                                          (1.0 + z2[k]*ctx->r[i]) * Ur[i + k*ctx->nrows];
                     }
                 }
             }
 
-            printf("POTENTIAL: DOUBLE YUKAWA (ATRACTIVE + REPULSIVE)\n\n");
-            printf("TEMPERATURE  (atr, rep):  %1.9e   %1.9e\n", 1/E[0], 1/E2[0]);
-            printf("RATIO  (atr perturbation):  %.3lf\n", E[0]/E2[0]);
-            printf("z  (atr, rep):       %.3lf   %.3lf\n", z[0], z2[0]);
-            printf("DIAMETER:                 %.3lf\n", sigmaVec[0]);
-            printf("------------------------------\n");
+            oz_log(ctx, "POTENTIAL: DOUBLE YUKAWA (ATRACTIVE + REPULSIVE)\n\n");
+            oz_log(ctx, "TEMPERATURE  (atr, rep):  %1.9e   %1.9e\n", 1/E[0], 1/E2[0]);
+            oz_log(ctx, "RATIO  (atr perturbation):  %.3lf\n", E[0]/E2[0]);
+            oz_log(ctx, "z  (atr, rep):       %.3lf   %.3lf\n", z[0], z2[0]);
+            oz_log(ctx, "DIAMETER:                 %.3lf\n", ctx->sigmaVec[0]);
+            oz_log(ctx, "------------------------------\n");
             break;
 
         case 5: 
@@ -222,23 +307,23 @@ void POT(species especie1, species especie2, int potentialID, double xnu) {
             z[2] = especie2.lambda;
             z[1] = sqrt(z[0] * z[2]);
 
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    if (r[i] < sigmaVec[k]) {
-                        U[i*ncols + k] = 0.0;
-                        Up[i*ncols + k] = 0.0;
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
+                    if (ctx->r[i] < ctx->sigmaVec[k]) {
+                        ctx->U[i + k*ctx->nrows] = 0.0;
+                        ctx->Up[i + k*ctx->nrows] = 0.0;
                     } else {
-                        U[i*ncols + k] = - E[k] * exp(- z[k] * (r[i] - 1.0)) / r[i];
-                        Up[i*ncols + k] = (1.0 + z[k]*r[i]) * U[i*ncols + k];
+                        ctx->U[i + k*ctx->nrows] = - E[k] * exp(- z[k] * (ctx->r[i] - 1.0)) / ctx->r[i];
+                        ctx->Up[i + k*ctx->nrows] = (1.0 + z[k]*ctx->r[i]) * ctx->U[i + k*ctx->nrows];
                     }
                 }
             }
 
-            printf("POTENTIAL: ATRACTIVE YUKAWA\n\n");
-            printf("TEMPERATURE:  %.3lf\n", E[0]);
-            printf("LAMBDA:       %.3lf\n", z[0]);
-            printf("DIAMETER:     %.3lf\n", sigmaVec[0]);
-            printf("------------------------------\n");
+            oz_log(ctx, "POTENTIAL: ATRACTIVE YUKAWA\n\n");
+            oz_log(ctx, "TEMPERATURE:  %.3lf\n", E[0]);
+            oz_log(ctx, "LAMBDA:       %.3lf\n", z[0]);
+            oz_log(ctx, "DIAMETER:     %.3lf\n", ctx->sigmaVec[0]);
+            oz_log(ctx, "------------------------------\n");
             break;
 
         case 6: 
@@ -251,36 +336,36 @@ void POT(species especie1, species especie2, int potentialID, double xnu) {
             z[2] = especie2.lambda;
             z[1] = sqrt(z[0] * z[2]);
 
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    if (r[i] < sigmaVec[k]) {
-                        U[i*ncols + k] = 0.0;
-                        Up[i*ncols + k] = 0.0;
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
+                    if (ctx->r[i] < ctx->sigmaVec[k]) {
+                        ctx->U[i + k*ctx->nrows] = 0.0;
+                        ctx->Up[i + k*ctx->nrows] = 0.0;
                     } else {
-                        U[i*ncols + k] =  E[k] * exp( -z[k] * (r[i] - 1.0)) / r[i];
-                        Up[i*ncols + k] = (1.0 + z[k]*r[i]) * U[i*ncols + k];
+                        ctx->U[i + k*ctx->nrows] =  E[k] * exp( -z[k] * (ctx->r[i] - 1.0)) / ctx->r[i];
+                        ctx->Up[i + k*ctx->nrows] = (1.0 + z[k]*ctx->r[i]) * ctx->U[i + k*ctx->nrows];
                     }
                 }
             }
           
-            printf("POTENTIAL: REPULSIVE YUKAWA\n\n");
-            printf("TEMPERATURE:  %1.9e\n", 1/E[0]);
-            printf("LAMBDA:       %1.9e\n", z[0]);
-            printf("DIAMETER:     %1.9e\n", sigmaVec[0]);
-            printf("------------------------------\n");
+            oz_log(ctx, "POTENTIAL: REPULSIVE YUKAWA\n\n");
+            oz_log(ctx, "TEMPERATURE:  %1.9e\n", 1/E[0]);
+            oz_log(ctx, "LAMBDA:       %1.9e\n", z[0]);
+            oz_log(ctx, "DIAMETER:     %1.9e\n", ctx->sigmaVec[0]);
+            oz_log(ctx, "------------------------------\n");
             break;
 
         case 7: 
             // HARD SPHERE
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    U[i*ncols + k] = 0.0;
-                    Up[i*ncols + k] = 0.0;
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
+                    ctx->U[i + k*ctx->nrows] = 0.0;
+                    ctx->Up[i + k*ctx->nrows] = 0.0;
                 }
             }
 
-            printf("POTENTIAL: HARD SPHERE\n\n");
-            printf("------------------------------\n");
+            oz_log(ctx, "POTENTIAL: HARD SPHERE\n\n");
+            oz_log(ctx, "------------------------------\n");
             break;
 
         case 8: 
@@ -297,24 +382,24 @@ void POT(species especie1, species especie2, int potentialID, double xnu) {
             E2[2] = especie2.temperature2;
             E2[1] = sqrt(E2[0] * E2[2]);
 
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    if (r[i] < sigmaVec[k] || (r[i] > E2[k])) {
-                        U[i*ncols + k] = 0.0;
-                        Up[i*ncols + k] = 0.0;
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
+                    if (ctx->r[i] < ctx->sigmaVec[k] || (ctx->r[i] > E2[k])) {
+                        ctx->U[i + k*ctx->nrows] = 0.0;
+                        ctx->Up[i + k*ctx->nrows] = 0.0;
                     } else {
-                        U[i*ncols + k] =  E[k] * z[k];
-                        Up[i*ncols + k] = 0.0;
+                        ctx->U[i + k*ctx->nrows] =  E[k] * z[k];
+                        ctx->Up[i + k*ctx->nrows] = 0.0;
                     }
                 }
             }
 
-            printf("POTENTIAL: SHOULDER FUNCTION\n\n");
-            printf("TEMPERATURE:  %.3lf\n", E[0]);
-            printf("HEIGHT:       %.3lf\n", z[0]);
-            printf("WIDTH:        %.3lf\n", E2[0]);
-            printf("DIAMETER:     %.3lf\n", sigmaVec[0]);
-            printf("------------------------------\n");
+            oz_log(ctx, "POTENTIAL: SHOULDER FUNCTION\n\n");
+            oz_log(ctx, "TEMPERATURE:  %.3lf\n", E[0]);
+            oz_log(ctx, "HEIGHT:       %.3lf\n", z[0]);
+            oz_log(ctx, "WIDTH:        %.3lf\n", E2[0]);
+            oz_log(ctx, "DIAMETER:     %.3lf\n", ctx->sigmaVec[0]);
+            oz_log(ctx, "------------------------------\n");
             break;
 
         case 9: 
@@ -327,28 +412,28 @@ void POT(species especie1, species especie2, int potentialID, double xnu) {
             E2[2] = especie2.temperature2;
             E2[1] = sqrt(E2[0] * E2[2]);
 
-            z[0] = especie1.lambda / (E2[0] - sigmaVec[0]);
-            z[2] = especie2.lambda / (E2[2] - sigmaVec[2]);
+            z[0] = especie1.lambda / (E2[0] - ctx->sigmaVec[0]);
+            z[2] = especie2.lambda / (E2[2] - ctx->sigmaVec[2]);
             z[1] = sqrt(z[0] * z[2]);
             
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    if (r[i] < sigmaVec[k] || (r[i] > E2[k])) {
-                        U[i*ncols + k] = 0.0;
-                        Up[i*ncols + k] = 0.0;
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
+                    if (ctx->r[i] < ctx->sigmaVec[k] || (ctx->r[i] > E2[k])) {
+                        ctx->U[i + k*ctx->nrows] = 0.0;
+                        ctx->Up[i + k*ctx->nrows] = 0.0;
                     } else {
-                        U[i*ncols + k] =  E[k] * (-z[k] * (r[i] - E2[k]));
-                        Up[i*ncols + k] = E[k] * z[k] * r[i];
+                        ctx->U[i + k*ctx->nrows] =  E[k] * (-z[k] * (ctx->r[i] - E2[k]));
+                        ctx->Up[i + k*ctx->nrows] = E[k] * z[k] * ctx->r[i];
                     }
                 }
             }
 
-            printf("POTENTIAL: DOWN-HILL FUNCTION\n\n");
-            printf("TEMPERATURE:  %.3lf\n", E[0]);
-            printf("HEIGHT:       %.3lf\n", especie1.lambda);
-            printf("WIDTH:        %.3lf\n", E2[0]);
-            printf("DIAMETER:     %.3lf\n", sigmaVec[0]);
-            printf("------------------------------\n");
+            oz_log(ctx, "POTENTIAL: DOWN-HILL FUNCTION\n\n");
+            oz_log(ctx, "TEMPERATURE:  %.3lf\n", E[0]);
+            oz_log(ctx, "HEIGHT:       %.3lf\n", especie1.lambda);
+            oz_log(ctx, "WIDTH:        %.3lf\n", E2[0]);
+            oz_log(ctx, "DIAMETER:     %.3lf\n", ctx->sigmaVec[0]);
+            oz_log(ctx, "------------------------------\n");
             break;
 
         case 10: 
@@ -357,17 +442,17 @@ void POT(species especie1, species especie2, int potentialID, double xnu) {
             E[2] = 1.0 / especie2.temperature;
             E[1] = sqrt(E[0] * E[2]);
 
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    U[i*ncols + k] = E[k] * exp(- pow(r[i] / sigmaVec[k], 2.0));
-                    Up[i*ncols + k] = 2.0 * pow(r[i] / sigmaVec[k], 2.0) * U[i*ncols + k];
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
+                    ctx->U[i + k*ctx->nrows] = E[k] * exp(- pow(ctx->r[i] / ctx->sigmaVec[k], 2.0));
+                    ctx->Up[i + k*ctx->nrows] = 2.0 * pow(ctx->r[i] / ctx->sigmaVec[k], 2.0) * ctx->U[i + k*ctx->nrows];
                 }
             }
 
-            printf("POTENTIAL: GAUSSIAN CORE MODEL\n\n");
-            printf("TEMPERATURE:  %.3lf\n", E[0]);
-            printf("DIAMETER:     %.3lf\n", sigmaVec[0]);
-            printf("------------------------------\n");
+            oz_log(ctx, "POTENTIAL: GAUSSIAN CORE MODEL\n\n");
+            oz_log(ctx, "TEMPERATURE:  %.3lf\n", E[0]);
+            oz_log(ctx, "DIAMETER:     %.3lf\n", ctx->sigmaVec[0]);
+            oz_log(ctx, "------------------------------\n");
             break;
 
         case 11: 
@@ -376,22 +461,22 @@ void POT(species especie1, species especie2, int potentialID, double xnu) {
             E[2] = 1.0 / especie2.temperature;
             E[1] = sqrt(E[0] * E[2]);
             double lamb = 1.56;
-            for (int k = 0; k < ncols; k++) {
-                for (int i = 0; i < nrows; i++) {
-                    if (r[i] < sigmaVec[k] || r[i] > lamb * sigmaVec[k]) {
-                        U[i*ncols + k]  = 0.0;
-                        Up[i*ncols + k] = 0.0;
+            for (int k = 0; k < ctx->ncols; k++) {
+                for (int i = 0; i < ctx->nrows; i++) {
+                    if (ctx->r[i] < ctx->sigmaVec[k] || ctx->r[i] > lamb * ctx->sigmaVec[k]) {
+                        ctx->U[i + k*ctx->nrows]  = 0.0;
+                        ctx->Up[i + k*ctx->nrows] = 0.0;
                     } else {
-                        U[i*ncols + k]  = E[k] * (lamb - r[i]) / (lamb - 1.0);
-                        Up[i*ncols + k] = E[k] * r[i] / (lamb - 1.0);
+                        ctx->U[i + k*ctx->nrows]  = E[k] * (lamb - ctx->r[i]) / (lamb - 1.0);
+                        ctx->Up[i + k*ctx->nrows] = E[k] * ctx->r[i] / (lamb - 1.0);
                     }
                 }
             }
 
-            printf("POTENTIAL: STEP FUNCTION\n\n");
-            printf("TEMPERATURE:  %1.9e\n", 1/E[0]);
-            printf("DIAMETER:     %1.9e\n", sigmaVec[0]);
-            printf("------------------------------\n");
+            oz_log(ctx, "POTENTIAL: STEP FUNCTION\n\n");
+            oz_log(ctx, "TEMPERATURE:  %1.9e\n", 1/E[0]);
+            oz_log(ctx, "DIAMETER:     %1.9e\n", ctx->sigmaVec[0]);
+            oz_log(ctx, "------------------------------\n");
             break;
 
         case 12: 
@@ -407,16 +492,16 @@ void POT(species especie1, species especie2, int potentialID, double xnu) {
             E2[0] = especie1.temperature2;
             E2[2] = especie2.temperature2;
             E2[1] = sqrt(E2[0] * E2[2]);
-            printf("%1.9e\t%1.9e\t%1.9e\n",z[0],E[0],sigmaVec[0]);
+            oz_log(ctx, "%1.9e\t%1.9e\t%1.9e\n",z[0],E[0],ctx->sigmaVec[0]);
             
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    if (r[i] > sigmaVec[k]) {
-                        U[i*ncols + k] = 0.0;
-                        Up[i*ncols + k] = 0.0;
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
+                    if (ctx->r[i] > ctx->sigmaVec[k]) {
+                        ctx->U[i + k*ctx->nrows] = 0.0;
+                        ctx->Up[i + k*ctx->nrows] = 0.0;
                     } else {
-                        U[i*ncols + k] =  E[k] * pow(1-r[i]/sigmaVec[0],z[k]); 
-                        Up[i*ncols + k] = 0.0;
+                        ctx->U[i + k*ctx->nrows] =  E[k] * pow(1-ctx->r[i]/ctx->sigmaVec[0],z[k]); 
+                        ctx->Up[i + k*ctx->nrows] = 0.0;
                     }
                 }
             }
@@ -434,24 +519,24 @@ void POT(species especie1, species especie2, int potentialID, double xnu) {
             E[2] = 1.0 / especie2.temperature;
             E[1] = sqrt(E[0] * E[2]);
             
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
                     
-                    if (r[i] < sigmaVec[k]) {
-                        double factor = 1.0 - (r[i] / sigmaVec[k]);
-                        U[i*ncols + k] = E[k] * pow(factor, n_exponent);
-                        Up[i*ncols + k] = (n_exponent * E[k] / sigmaVec[k]) * r[i] * pow(factor, n_exponent - 1.0);
+                    if (ctx->r[i] < ctx->sigmaVec[k]) {
+                        double factor = 1.0 - (ctx->r[i] / ctx->sigmaVec[k]);
+                        ctx->U[i + k*ctx->nrows] = E[k] * pow(factor, n_exponent);
+                        ctx->Up[i + k*ctx->nrows] = (n_exponent * E[k] / ctx->sigmaVec[k]) * ctx->r[i] * pow(factor, n_exponent - 1.0);
                     } else {
-                        U[i*ncols + k] = 0.0;
-                        Up[i*ncols + k] = 0.0;
+                        ctx->U[i + k*ctx->nrows] = 0.0;
+                        ctx->Up[i + k*ctx->nrows] = 0.0;
                     }
                 }
             }
 
-            printf("POTENTIAL: HERTZIAN POTENTIAL (n=2.5)\n\n");
-            printf("ENERGY SCALE (epsilon/kT):  %.3lf\n", E[0]);
-            printf("DIAMETER:                   %.3lf\n", sigmaVec[0]);
-            printf("------------------------------\n");
+            oz_log(ctx, "POTENTIAL: HERTZIAN POTENTIAL (n=2.5)\n\n");
+            oz_log(ctx, "ENERGY SCALE (epsilon/kT):  %.3lf\n", E[0]);
+            oz_log(ctx, "DIAMETER:                   %.3lf\n", ctx->sigmaVec[0]);
+            oz_log(ctx, "------------------------------\n");
             break;
 
         case 16:
@@ -469,35 +554,365 @@ void POT(species especie1, species especie2, int potentialID, double xnu) {
             z2[2] = especie2.lambda2;
             z2[1] = sqrt(z2[0] * z2[2]);
 
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    if (r[i] < sigmaVec[k]) {
-                        U[i*ncols + k]  = 0.0;
-                        Up[i*ncols + k] = 0.0;
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
+                    if (ctx->r[i] < ctx->sigmaVec[k]) {
+                        ctx->U[i + k*ctx->nrows]  = 0.0;
+                        ctx->Up[i + k*ctx->nrows] = 0.0;
                     } else {
-                        double arg = z2[k] * (r[i] - z[k]);
+                        double arg = z2[k] * (ctx->r[i] - z[k]);
                         double t_arg = tanh(arg);
-                        U[i*ncols + k]  = 0.5 * E[k] * (1.0 - t_arg);
-                        Up[i*ncols + k] = 0.5 * E[k] * z2[k] * r[i] * (1.0 - t_arg * t_arg);
+                        ctx->U[i + k*ctx->nrows]  = 0.5 * E[k] * (1.0 - t_arg);
+                        ctx->Up[i + k*ctx->nrows] = 0.5 * E[k] * z2[k] * ctx->r[i] * (1.0 - t_arg * t_arg);
                     }
                 }
             }
 
-            printf("POTENTIAL: SOFT SHOULDER POTENTIAL\n\n");
-            printf("TEMPERATURE:  %.3lf\n", E[0]);
-            printf("LAMBDA (REACH): %.3lf\n", z[0]);
-            printf("ALPHA (SMOOTHNESS): %.3lf\n", z2[0]);
-            printf("DIAMETER:     %.3lf\n", sigmaVec[0]);
-            printf("------------------------------\n");
+            oz_log(ctx, "POTENTIAL: SOFT SHOULDER POTENTIAL\n\n");
+            oz_log(ctx, "TEMPERATURE:  %.3lf\n", E[0]);
+            oz_log(ctx, "LAMBDA (REACH): %.3lf\n", z[0]);
+            oz_log(ctx, "ALPHA (SMOOTHNESS): %.3lf\n", z2[0]);
+            oz_log(ctx, "DIAMETER:     %.3lf\n", ctx->sigmaVec[0]);
+            oz_log(ctx, "------------------------------\n");
+            break;
+
+        case 17:
+            // TABULATED u(r) (--potential-file): U = u/T, the same u for every pair
+            if (ctx->potential_table == NULL) {
+                fprintf(stderr, "Error: El potencial 17 requiere una tabla de u(r) (--potential-file).\n");
+                memset(ctx->U, 0, (size_t) ctx->nrows * ctx->ncols * sizeof(double));
+                memset(ctx->Up, 0, (size_t) ctx->nrows * ctx->ncols * sizeof(double));
+                status = 1;
+                break;
+            }
+
+            E[0] = 1.0 / especie1.temperature;
+            E[2] = 1.0 / especie2.temperature;
+            E[1] = sqrt(E[0] * E[2]);
+
+            for (k = 0; k < ctx->ncols; k++) {
+                if (oz_potential_table_sample(ctx->potential_table, ctx->r, ctx->nrows, E[k], \
+                                              ctx->U + k*ctx->nrows, ctx->Up + k*ctx->nrows) != 0) {
+                    memset(ctx->U + k*ctx->nrows, 0, (size_t) ctx->nrows * sizeof(double));
+                    memset(ctx->Up + k*ctx->nrows, 0, (size_t) ctx->nrows * sizeof(double));
+                    status = 1;
+                }
+            }
+
+            oz_log(ctx, "POTENTIAL: TABULATED u(r)\n\n");
+            oz_log(ctx, "TEMPERATURE:  %.3lf\n", E[0]);
+            oz_log(ctx, "POINTS:       %d\n", ctx->potential_table->n_points);
+            oz_log(ctx, "RANGE:        %.3lf - %.3lf\n", ctx->potential_table->r[0], \
+                   ctx->potential_table->r[ctx->potential_table->n_points - 1]);
+            oz_log(ctx, "------------------------------\n");
+            break;
+    }
+
+    if (shared && status == 0) oz_potential_store(&key, scale, ctx->U, ctx->Up);
+
+    oz_free(ctx, Ua);
+    oz_free(ctx, Ur);
+    oz_free(ctx, E);
+    oz_free(ctx, E2);
+    oz_free(ctx, z);
+    oz_free(ctx, z2);
+    oz_release(ctx, mark);
+    return status;
+}
+
+/**
+ * @brief Legacy entry point: runs POT_ctx on the global state.
+ */
+void POT(species especie1, species especie2, int potentialID, double xnu) {
+    OZContext ctx = oz_legacy_context();
+    POT_ctx(&ctx, especie1, especie2, potentialID, xnu);
+}
+
+/*
+ * Rogers-Young consistency residual chic - chiv at one alpha. g[0..2] hold
+ * the last gammas at rho, rho - ddrho and rho + ddrho: each solve starts
+ * from them and overwrites them with its result. With OZ_THERMO_LINEAR
+ * chiv comes from the tangent at rho and the other two solves are only
+ * run if the linear solve fails. Returns 1 if a solve failed.
+ */
+static int ry_residual(OZContext *ctx, int kj, double rhoa, double ddrho, double alpha, int potentialID, int closureID, \
+                       double EZ, int nrho, double *cFuncMatrix, double **g, double *gammaOutput, double *res) {
+
+    int i, j;
+    int quiet = 1;
+    int nsolves = 3;
+    int size = ctx->nrows*ctx->ncols;
+    const double shift[3] = {0.0, -1.0, 1.0};
+    double pv[3], chic[3], ener[3], chiv;
+
+    ctx->ry_evals++;
+
+    for (j = 0; j < nsolves; j++) {
+        ctx->rho = rhoa + shift[j]*ddrho;
+        if (Ng_ctx(ctx, kj, g[j], gammaOutput, potentialID, closureID, cFuncMatrix, 1.0, 0.0, alpha, EZ, nrho, &quiet) < 0) {
+            ctx->rho = rhoa;
+            oz_log(ctx, "   ALPHA = %.17g  (Ng no converge)\n\n", alpha);
+            return 1;
+        }
+        Termo_ctx(ctx, gammaOutput, cFuncMatrix, &pv[j], &chic[j], &ener[j]);
+        for (i = 0; i < size; i++) g[j][i] = gammaOutput[i];
+
+        if (j == 0 && ctx->thermo_mode == OZ_THERMO_LINEAR) {
+            if (TangentPressure_ctx(ctx, gammaOutput, potentialID, closureID, alpha, &chiv) == 0) {
+                nsolves = 1;
+            } else {
+                oz_log(ctx, "   Respuesta lineal no converge; diferencias en rho -+ ddrho\n");
+            }
+        }
+    }
+    ctx->rho = rhoa;
+
+    if (nsolves == 3) chiv = (pv[2] - pv[1]) / (2.0 * ddrho);
+    *res = chic[0] - chiv;
+    ctx->chic = chic[0];
+
+    if (!isfinite(*res)) {
+        oz_log(ctx, "   ALPHA = %.17g  (residuo no finito)\n\n", alpha);
+        return 1;
+    }
+
+    oz_log(ctx, "   CHIC = %.17g   CHIV = %.17g\n", chic[0], chiv);
+    oz_log(ctx, "   DIFF = %.17g   \n", *res);
+    oz_log(ctx, "   ALPHA = %.17g  <------------------ \n\n", alpha);
+
+    return 0;
+}
+
+/*
+ * Finds the alpha where chic = chiv. Secant steps from alpha0, aimed
+ * RY_OVERSHOOT past the secant root and growing at most RY_BRACKET_GROWTH
+ * per step, until the residual changes sign; then Brent's method inside
+ * the bracket. Returns the best alpha found.
+ */
+static double ry_alpha_search(OZContext *ctx, int kj, double rhoa, double ddrho, double alpha0, int potentialID, int closureID, \
+                              double EZ, int nrho, double *cFuncMatrix, double **g, double *gammaOutput) {
+
+    double a, b, c, d, e, fa, fb, fc, step, best, fbest;
+    double p, q, rr, sgn, tol1, xm, min1, min2;
+    int bracketed;
+
+    ctx->ry_evals = 0;
+    a = alpha0;
+    if (ry_residual(ctx, kj, rhoa, ddrho, a, potentialID, closureID, EZ, nrho, cFuncMatrix, g, gammaOutput, &fa)) return alpha0;
+    best = a; fbest = fa;
+    if (fabs(fa) <= RY_RESIDUAL_TOL * fabs(ctx->chic)) return a;
+
+    // First step as in the original walk
+    b = a - a / 50.0;
+    while (ry_residual(ctx, kj, rhoa, ddrho, b, potentialID, closureID, EZ, nrho, cFuncMatrix, g, gammaOutput, &fb)) {
+        b = 0.5 * (a + b);
+        if (!(fabs(b - a) >= RY_ALPHA_TOL) || ctx->ry_evals >= RY_MAX_EVAL) return best;
+    }
+    if (fabs(fb) < fabs(fbest)) { best = b; fbest = fb; }
+
+    // Bracketing: secant extrapolation with limited growth
+    bracketed = (fa * fb <= 0.0);
+    while (!bracketed) {
+        if (fabs(b - a) < RY_ALPHA_TOL || ctx->ry_evals >= RY_MAX_EVAL) return best;
+
+        if (fabs(fb) <= RY_RESIDUAL_TOL * fabs(ctx->chic)) return b;
+
+        step = (fb != fa) ? -RY_OVERSHOOT * fb * (b - a) / (fb - fa) : 2.0 * (b - a);
+        if (fabs(step) > RY_BRACKET_GROWTH * fabs(b - a)) step = copysign(RY_BRACKET_GROWTH * fabs(b - a), step);
+
+        c = b + step;
+        if (c < RY_ALPHA_MIN) c = RY_ALPHA_MIN;
+        if (c > RY_ALPHA_MAX) c = RY_ALPHA_MAX;
+        if (c == b) {
+            oz_log(ctx, "   Busqueda de alpha: no hay cambio de signo en [%g, %g].\n", RY_ALPHA_MIN, RY_ALPHA_MAX);
+            return best;
+        }
+
+        while (ry_residual(ctx, kj, rhoa, ddrho, c, potentialID, closureID, EZ, nrho, cFuncMatrix, g, gammaOutput, &fc)) {
+            c = 0.5 * (b + c);
+            if (!(fabs(c - b) >= RY_ALPHA_TOL) || ctx->ry_evals >= RY_MAX_EVAL) return best;
+        }
+
+        a = b; fa = fb;
+        b = c; fb = fc;
+        if (fabs(fb) < fabs(fbest)) { best = b; fbest = fb; }
+        bracketed = (fa * fb <= 0.0);
+    }
+
+    // Brent's method on [a, b]
+    c = b; fc = fb;
+    d = e = b - a;
+    while (ctx->ry_evals < RY_MAX_EVAL) {
+        if ((fb > 0.0 && fc > 0.0) || (fb < 0.0 && fc < 0.0)) {
+            c = a; fc = fa;
+            d = e = b - a;
+        }
+        if (fabs(fc) < fabs(fb)) {
+            a = b; b = c; c = a;
+            fa = fb; fb = fc; fc = fa;
+        }
+
+        tol1 = 2.0 * DBL_EPSILON * fabs(b) + 0.5 * RY_ALPHA_TOL;
+        xm = 0.5 * (c - b);
+        if (fabs(xm) <= tol1 || fabs(fb) <= RY_RESIDUAL_TOL * fabs(ctx->chic)) return b;
+
+        if (fabs(e) >= tol1 && fabs(fa) > fabs(fb)) {
+            sgn = fb / fa;
+            if (a == c) {
+                p = 2.0 * xm * sgn;
+                q = 1.0 - sgn;
+            } else {
+                q = fa / fc;
+                rr = fb / fc;
+                p = sgn * (2.0 * xm * q * (q - rr) - (b - a) * (rr - 1.0));
+                q = (q - 1.0) * (rr - 1.0) * (sgn - 1.0);
+            }
+            if (p > 0.0) q = -q;
+            p = fabs(p);
+            min1 = 3.0 * xm * q - fabs(tol1 * q);
+            min2 = fabs(e * q);
+            if (2.0 * p < (min1 < min2 ? min1 : min2)) {
+                e = d;
+                d = p / q;
+            } else {
+                d = xm;
+                e = d;
+            }
+        } else {
+            d = xm;
+            e = d;
+        }
+
+        a = b; fa = fb;
+        b += (fabs(d) > tol1) ? d : copysign(tol1, xm);
+
+        // A failed solve falls back to bisection of the bracket
+        if (ry_residual(ctx, kj, rhoa, ddrho, b, potentialID, closureID, EZ, nrho, cFuncMatrix, g, gammaOutput, &fb)) {
+            b = a + xm;
+            e = d = xm;
+            if (ry_residual(ctx, kj, rhoa, ddrho, b, potentialID, closureID, EZ, nrho, cFuncMatrix, g, gammaOutput, &fb)) return a;
+        }
+    }
+
+    oz_log(ctx, "   Busqueda de alpha: %d evaluaciones sin converger.\n", RY_MAX_EVAL);
+    return (fabs(fb) < fabs(fbest)) ? b : best;
+}
+
+/**
+ * @brief Final stage shared by OZ2_ctx and OZ2_warm_ctx.
+ *
+ * Solves at the target density, runs the Rogers-Young alpha search when
+ * closureID = 3, writes S(k) and g(r) and keeps the converged gamma in
+ * ctx->gamma (when the context has one) for later warm starts. The
+ * thermodynamics of the final solution are kept in ctx->pv, chic and ener
+ * (and chiv with OZ_THERMO_LINEAR).
+ */
+static void OZ2_finish_ctx(OZContext *ctx, double *Sk, double *Gr, int potentialID, int closureID, double alpha, double EZ, \
+                           int nrho, char folderName[20], int *printFlag, int kj, double rhoa, \
+                           double *cFuncMatrix, double *gammaInput1, double *gammaOutput) {
+
+    int i;
+    double T, TFlag, pv, chic, ener;
+    double ddrho, PexV;
+
+    TFlag = 0.0;
+
+    // Final solution step
+    T = 1.0;
+    ctx->rho = rhoa;
+
+    Ng_ctx(ctx, kj, gammaInput1, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, nrho, printFlag);
+    
+    switch (closureID){
+        case 1:
+            oz_log(ctx, "\n==============\n");
+            oz_log(ctx, "  Salida PY:\n");
+            oz_log(ctx, "==============\n\n");
+            break;
+        case 2:
+            oz_log(ctx, "\n==============\n");
+            oz_log(ctx, " Salida HNC:\n");
+            oz_log(ctx, "==============\n\n");
+            break;
+        case 3:
+            // Rogers-Young specific logic to determine alpha
+            oz_log(ctx, "\n===========================\n");
+            oz_log(ctx, "  CALCULANDO VALOR ALPHA:\n");
+            oz_log(ctx, "===========================\n\n");
+
+            ddrho = rhoa / 100.0;
+            {
+                size_t ry_mark = oz_mark(ctx);
+                double *g[3];
+                int size = ctx->nrows*ctx->ncols;
+                double alpha0 = (ctx->ry_alpha_seed > 0.0) ? ctx->ry_alpha_seed : alpha;
+
+                g[0] = oz_alloc(ctx, size);
+                g[1] = oz_alloc(ctx, size);
+                g[2] = oz_alloc(ctx, size);
+                if (g[0] == NULL || g[1] == NULL || g[2] == NULL) {
+                    printf("Memory allocation failed in OZ2.\n");
+                    oz_free(ctx, g[0]);
+                    oz_free(ctx, g[1]);
+                    oz_free(ctx, g[2]);
+                    oz_release(ctx, ry_mark);
+                    return;
+                }
+
+                // All three densities start from the solution at rho
+                for (i = 0; i < size; i++) {
+                    g[0][i] = g[1][i] = g[2][i] = gammaOutput[i];
+                }
+
+                ctx->ng_max_iter = RY_NG_MAX_ITER;
+                alpha = ry_alpha_search(ctx, kj, rhoa, ddrho, alpha0, potentialID, closureID, EZ, nrho, cFuncMatrix, g, gammaOutput);
+                ctx->ng_max_iter = 0;
+
+                for (i = 0; i < size; i++) gammaInput1[i] = g[0][i];
+
+                oz_log(ctx, "   ALPHA RY = %.17g  (%d evaluaciones)\n", alpha, ctx->ry_evals);
+
+                oz_free(ctx, g[0]);
+                oz_free(ctx, g[1]);
+                oz_free(ctx, g[2]);
+                oz_release(ctx, ry_mark);
+            }
+            
+            oz_log(ctx, "\n==============\n");
+            oz_log(ctx, "  Salida RY:\n");
+            oz_log(ctx, "==============\n\n");
             break;
     }
 
-    free(Ua);
-    free(Ur);
-    free(E);
-    free(E2);
-    free(z);
-    free(z2);
+    // Final calculation and output
+    T = 1.0;
+    TFlag = 1.0;
+    ctx->rho = rhoa;
+
+    Ng_ctx(ctx, kj, gammaInput1, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, nrho, printFlag);
+
+    Escribe_ctx(ctx, gammaOutput, cFuncMatrix, Sk, Gr, potentialID, closureID, folderName);
+
+    Termo_ctx(ctx, gammaOutput, cFuncMatrix, &pv, &chic, &ener);
+    PexV = pv/ctx->rho - 1.0;
+
+    ctx->pv = pv;
+    ctx->chic = chic;
+    ctx->ener = ener;
+    ctx->ry_alpha = alpha;
+
+    // Exact d(beta*P)/drho for equation-of-state fits
+    ctx->chiv = NAN;
+    if (ctx->thermo_mode == OZ_THERMO_LINEAR && \
+        TangentPressure_ctx(ctx, gammaOutput, potentialID, closureID, alpha, &ctx->chiv) != 0) {
+        ctx->chiv = NAN;
+    }
+
+    if (ctx->gamma != NULL) {
+        for (i = 0; i < ctx->nrows*ctx->ncols; i++) {
+            ctx->gamma[i] = gammaOutput[i];
+        }
+    }
 }
 
 /**
@@ -506,251 +921,607 @@ void POT(species especie1, species especie2, int potentialID, double xnu) {
  * This function orchestrates the iterative solution process, handling the
  * charging parameter (kj) for gradual solution and switching between closures.
  *
+ * @param ctx Solver context (grids, potential tables, density).
  * @param Sk Output Structure Factor array.
  * @param Gr Output Radial Distribution Function array.
  * @param potentialID ID of the potential.
  * @param closureID ID of the closure relation (1=PY, 2=HNC, 3=RY).
  * @param alpha Parameter for RY closure.
  * @param EZ Convergence criterion.
- * @param rmax Maximum radial distance.
  * @param nrho Number of density steps.
  * @param folderName Output folder name.
  * @param printFlag Flag to control printing.
  */
-void OZ2(double *Sk, double *Gr, int potentialID, int closureID, double alpha, double EZ, \
-         double rmax, int nrho, char folderName[20], int *printFlag) {
+void OZ2_ctx(OZContext *ctx, double *Sk, double *Gr, int potentialID, int closureID, double alpha, double EZ, \
+             int nrho, char folderName[20], int *printFlag) {
 
     int i, k;
-    int kj, IRY;
-    double T, TFlag, pv, pv0, pv1, pv2;
-    double chic, chic0, chic1, chic2;
-    double ener, ener0, ener1, ener2;
-    double rhoa, dT, drho, ddrho, dalpha, PexV;
+    int kj;
+    double T, TFlag;
+    double rhoa, dT, drho;
     double *cFuncMatrix, *gammaInput1, *gammaInput2, *gammaOutput;
     
+    size_t mark = oz_mark(ctx);
     // Allocate memory for solver matrices
-    cFuncMatrix = malloc(nrows*ncols * sizeof(double));
-    gammaInput1 = malloc(nrows*ncols * sizeof(double));
-    gammaInput2 = malloc(nrows*ncols * sizeof(double));
-    gammaOutput = malloc(nrows*ncols * sizeof(double));
+    cFuncMatrix = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    gammaInput1 = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    gammaInput2 = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    gammaOutput = oz_alloc(ctx, ctx->nrows*ctx->ncols);
 
     if (cFuncMatrix == NULL || gammaInput1 == NULL || gammaInput2 == NULL || gammaOutput == NULL) {
         printf("Memory allocation failed in OZ2.\n");
+        oz_free(ctx, cFuncMatrix);
+        oz_free(ctx, gammaInput1);
+        oz_free(ctx, gammaInput2);
+        oz_free(ctx, gammaOutput);
+        oz_release(ctx, mark);
         return;
     }
 
     TFlag = 0.0;
 
-    for (k = 0; k < ncols; k++) {
-        for (i = 0; i < nrows; i++) {
-            gammaInput1[i*ncols + k] = 0.0;
+    for (k = 0; k < ctx->ncols; k++) {
+        for (i = 0; i < ctx->nrows; i++) {
+            gammaInput1[i + k*ctx->nrows] = 0.0;
         }
     }
 
     // Initialize density ramp
-    rhoa = rho;
+    rhoa = ctx->rho;
     dT = 1.0 / ((double) nrho);
-    drho = rho / ((double) nrho);
+    drho = ctx->rho / ((double) nrho);
 
     kj = 1;
-    rho = kj * drho;
+    ctx->rho = kj * drho;
     T = dT * kj;
 
     // Initial guess
-    Ng(kj, gammaInput1, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, rmax, nrho, printFlag);
+    Ng_ctx(ctx, kj, gammaInput1, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, nrho, printFlag);
 
     // Ramp up density
     while (kj <= 1) {
-        for (k = 0; k < ncols; k++) {
-            for (i = 0; i < nrows; i++) {
-                gammaInput1[i*ncols + k] = gammaOutput[i*ncols + k];
+        for (k = 0; k < ctx->ncols; k++) {
+            for (i = 0; i < ctx->nrows; i++) {
+                gammaInput1[i + k*ctx->nrows] = gammaOutput[i + k*ctx->nrows];
             }
         }
         kj++;
-        rho = kj * drho;
+        ctx->rho = kj * drho;
         T = dT * kj;
-        Ng(kj, gammaInput1, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, rmax, nrho, printFlag);
+        Ng_ctx(ctx, kj, gammaInput1, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, nrho, printFlag);
     }
 
-    Extrap(gammaInput1, gammaOutput, rho, drho);
+    Extrap_ctx(ctx, gammaInput1, gammaOutput, ctx->rho, drho);
 
     while(true) {
-        for (k = 0; k < ncols; k++) {
-            for (i = 0; i < nrows; i++) {
-                gammaInput2[i*ncols + k] = gammaOutput[i*ncols + k];
+        for (k = 0; k < ctx->ncols; k++) {
+            for (i = 0; i < ctx->nrows; i++) {
+                gammaInput2[i + k*ctx->nrows] = gammaOutput[i + k*ctx->nrows];
             }
         }
 
         kj++;
-        rho = kj * drho;
+        ctx->rho = kj * drho;
         T = dT * kj;
 
-        Ng(kj, gammaInput1, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, rmax, nrho, printFlag);
+        Ng_ctx(ctx, kj, gammaInput1, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, nrho, printFlag);
 
         if (kj == nrho) {
             break;
         } else {
-            Extrap(gammaInput2, gammaOutput, rho, drho);
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    gammaInput1[i*ncols + k] = gammaInput2[i*ncols + k];
+            Extrap_ctx(ctx, gammaInput2, gammaOutput, ctx->rho, drho);
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
+                    gammaInput1[i + k*ctx->nrows] = gammaInput2[i + k*ctx->nrows];
                 }
             }
         }
     }
 
-    // Final solution step
-    T = 1.0;
-    rho = rhoa;
+    OZ2_finish_ctx(ctx, Sk, Gr, potentialID, closureID, alpha, EZ, nrho, folderName, printFlag, \
+                   kj, rhoa, cFuncMatrix, gammaInput1, gammaOutput);
+    ctx->ramp_steps = nrho;
+    ctx->ramp_rejected = 0;
 
-    Ng(kj, gammaInput1, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, rmax, nrho, printFlag);
-    
-    switch (closureID){
-        case 1:
-            printf("\n==============\n");
-            printf("  Salida PY:\n");
-            printf("==============\n\n");
-            break;
-        case 2:
-            printf("\n==============\n");
-            printf(" Salida HNC:\n");
-            printf("==============\n\n");
-            break;
-        case 3:
-            // Rogers-Young specific logic to determine alpha
-            printf("\n===========================\n");
-            printf("  CALCULANDO VALOR ALPHA:\n");
-            printf("===========================\n\n");
+    oz_free(ctx, cFuncMatrix);
+    oz_free(ctx, gammaInput1);
+    oz_free(ctx, gammaInput2);
+    oz_free(ctx, gammaOutput);
+    oz_release(ctx, mark);
+}
 
-            ddrho = rhoa / 100.0;
-            dalpha = -alpha / 50.0;
+/*
+ * Predicts gamma at lambda from the converged history (lam[j], g[j]),
+ * newest first: constant with one point, linear with two, quadratic
+ * (Lagrange) with three when order >= 2.
+ */
+static void ramp_predict(const OZContext *ctx, double *guess, double lambda, const double *lam, double **g, int nhist, int order) {
 
-            do{
-                T = 1.0;
-                rho = rhoa;
+    int i;
+    int size = ctx->nrows*ctx->ncols;
 
-                Ng(kj, gammaInput1, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, rmax, nrho, printFlag);
-                
-                for (k = 0; k < ncols; k++) {
-                    for (i = 0; i < nrows; i++) {
-                        gammaInput1[i*ncols + k] = gammaOutput[i*ncols + k];
-                    }
-                }
+    if (nhist == 1) {
+        for (i = 0; i < size; i++) guess[i] = g[0][i];
+    } else if (nhist == 2 || order < 2) {
+        double w = (lambda - lam[0]) / (lam[0] - lam[1]);
+        for (i = 0; i < size; i++) guess[i] = g[0][i] + w * (g[0][i] - g[1][i]);
+    } else {
+        double l0 = (lambda - lam[1]) * (lambda - lam[2]) / ((lam[0] - lam[1]) * (lam[0] - lam[2]));
+        double l1 = (lambda - lam[0]) * (lambda - lam[2]) / ((lam[1] - lam[0]) * (lam[1] - lam[2]));
+        double l2 = (lambda - lam[0]) * (lambda - lam[1]) / ((lam[2] - lam[0]) * (lam[2] - lam[1]));
+        for (i = 0; i < size; i++) guess[i] = l0*g[0][i] + l1*g[1][i] + l2*g[2][i];
+    }
+}
+
+/**
+ * @brief Solves the OZ equation with an adaptive density continuation.
+ *
+ * Charges along lambda = rho/rho_final = T from 0 to 1 like OZ2_ctx, but
+ * the step is chosen from the Ng iteration count: it doubles when Ng
+ * converges in at most OZ_ADAPT_FAST iterations and halves above
+ * OZ_ADAPT_SLOW. A step whose Ng diverges or exceeds OZ_ADAPT_MAX_ITER
+ * is retried at half the size. The initial guess of each step comes from
+ * a linear or quadratic (ctx->predictor_order) fit to the last converged
+ * states. If the step falls below 1/(4*nrho) it falls back to OZ2_ctx.
+ *
+ * @param ctx Solver context (grids, potential tables, density).
+ * @param Sk Output Structure Factor array.
+ * @param Gr Output Radial Distribution Function array.
+ * @param potentialID ID of the potential.
+ * @param closureID ID of the closure relation (1=PY, 2=HNC, 3=RY).
+ * @param alpha Parameter for RY closure.
+ * @param EZ Convergence criterion.
+ * @param nrho Steps of the fixed ramp (sets the smallest step and the fallback).
+ * @param folderName Output folder name.
+ * @param printFlag Flag to control printing.
+ * @return Number of accepted density steps.
+ */
+int OZ2_adaptive_ctx(OZContext *ctx, double *Sk, double *Gr, int potentialID, int closureID, double alpha, double EZ, \
+                     int nrho, char folderName[20], int *printFlag) {
+
+    int i, it, nhist, steps, rejected;
+    int quiet = 1;
+    int size = ctx->nrows*ctx->ncols;
+    double rhoa, lambda, h, hmin;
+    double lam[3];
+    double *cFuncMatrix, *guess, *gammaOutput, *g[3];
+
+    size_t mark = oz_mark(ctx);
+    cFuncMatrix = oz_alloc(ctx, size);
+    guess       = oz_alloc(ctx, size);
+    gammaOutput = oz_alloc(ctx, size);
+    g[0]        = oz_alloc(ctx, size);
+    g[1]        = oz_alloc(ctx, size);
+    g[2]        = oz_alloc(ctx, size);
+
+    if (cFuncMatrix == NULL || guess == NULL || gammaOutput == NULL || g[0] == NULL || g[1] == NULL || g[2] == NULL) {
+        printf("Memory allocation failed in OZ2_adaptive.\n");
+        oz_free(ctx, cFuncMatrix);
+        oz_free(ctx, guess);
+        oz_free(ctx, gammaOutput);
+        oz_free(ctx, g[0]);
+        oz_free(ctx, g[1]);
+        oz_free(ctx, g[2]);
+        oz_release(ctx, mark);
+        return 0;
+    }
 
-                Termo(gammaOutput, cFuncMatrix, &pv0, &chic0, &ener0);
-                chic = chic0;
+    rhoa = ctx->rho;
+    hmin = 1.0 / (4.0 * nrho);
+    h = OZ_ADAPT_H0;
 
-                rho -= ddrho;
-                Ng(kj, gammaInput1, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, rmax, nrho, printFlag);
-                Termo(gammaOutput, cFuncMatrix, &pv1, &chic1, &ener1);
+    // gamma = 0 is exact at rho = 0
+    for (i = 0; i < size; i++) g[0][i] = 0.0;
+    lam[0] = 0.0;
+    nhist = 1;
+    lambda = 0.0;
+    steps = 0;
+    rejected = 0;
 
-                rho += 2.0*ddrho;
-                Ng(kj, gammaInput1, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, rmax, nrho, printFlag);
-                Termo(gammaOutput, cFuncMatrix, &pv2, &chic2, &ener2);
+    ctx->ng_max_iter = OZ_ADAPT_MAX_ITER;
 
-                RY(pv1, pv2, chic, ddrho, &alpha, dalpha, &IRY);
+    while (lambda < 1.0) {
+        double lambdaNew = lambda + h;
 
-            } while(IRY == 1);
-            
-            printf("\n==============\n");
-            printf("  Salida RY:\n");
-            printf("==============\n\n");
-            break;
+        // Do not leave a sliver for the last step
+        if (lambdaNew > 1.0 - 0.25*h) lambdaNew = 1.0;
+
+        ramp_predict(ctx, guess, lambdaNew, lam, g, nhist, ctx->predictor_order);
+
+        ctx->rho = lambdaNew * rhoa;
+        it = Ng_ctx(ctx, nrho, guess, gammaOutput, potentialID, closureID, cFuncMatrix, lambdaNew, 0.0, alpha, EZ, nrho, &quiet);
+
+        if (it < 0) {
+            rejected++;
+            h *= 0.5;
+            if (h < hmin) break;
+            continue;
+        }
+
+        // Accept: rotate the history, newest first
+        double *oldest = g[2];
+        g[2] = g[1]; lam[2] = lam[1];
+        g[1] = g[0]; lam[1] = lam[0];
+        g[0] = gammaOutput; lam[0] = lambdaNew;
+        gammaOutput = oldest;
+        if (nhist < 3) nhist++;
+
+        lambda = lambdaNew;
+        steps++;
+
+        if (it <= OZ_ADAPT_FAST) h *= 2.0;
+        else if (it > OZ_ADAPT_SLOW) h *= 0.5;
+        if (h > OZ_ADAPT_HMAX) h = OZ_ADAPT_HMAX;
+        if (h < hmin) h = hmin;
+
+        if ((*printFlag) == 0) {
+            printf("paso %03d  rho/rho_f = %.4f  (%d iteraciones)\r", steps, lambda, it);
+            fflush(stdout);
+        }
     }
 
-    // Final calculation and output
+    ctx->ng_max_iter = 0;
+
+    if (lambda < 1.0) {
+        oz_log(ctx, "\nRampa adaptativa: paso menor que 1/(4*nrho) en rho/rho_f = %.4f; se usa la rampa fija.\n", lambda);
+        ctx->rho = rhoa;
+        oz_free(ctx, cFuncMatrix);
+        oz_free(ctx, guess);
+        oz_free(ctx, gammaOutput);
+        oz_free(ctx, g[0]);
+        oz_free(ctx, g[1]);
+        oz_free(ctx, g[2]);
+        oz_release(ctx, mark);
+        OZ2_ctx(ctx, Sk, Gr, potentialID, closureID, alpha, EZ, nrho, folderName, printFlag);
+        ctx->ramp_rejected = rejected;
+        return ctx->ramp_steps;
+    }
+
+    if ((*printFlag) == 0) printf("\nRampa adaptativa: %d pasos (%d rechazados)\n", steps, rejected);
+
+    OZ2_finish_ctx(ctx, Sk, Gr, potentialID, closureID, alpha, EZ, nrho, folderName, printFlag, \
+                   nrho, rhoa, cFuncMatrix, g[0], gammaOutput);
+    ctx->ramp_steps = steps;
+    ctx->ramp_rejected = rejected;
+
+    oz_free(ctx, cFuncMatrix);
+    oz_free(ctx, guess);
+    oz_free(ctx, gammaOutput);
+    oz_free(ctx, g[0]);
+    oz_free(ctx, g[1]);
+    oz_free(ctx, g[2]);
+    oz_release(ctx, mark);
+
+    return steps;
+}
+
+/*
+ * Continuation of OZ2_warm_ctx under OZ_RAMP_ADAPTIVE: the step control of
+ * OZ2_adaptive_ctx along the fraction s of the way from rhoSeed to rhoa,
+ * at T = 1. The first step tries the whole gap, capped like the cold ramp
+ * at OZ_ADAPT_HMAX*rhoa; a step below rhoa/(4*nrho) counts as a divergence.
+ */
+static int warm_adaptive_ctx(OZContext *ctx, const double *gammaSeed, double rhoSeed, double *Sk, double *Gr, \
+                             int potentialID, int closureID, double alpha, double EZ, int nrho, \
+                             char folderName[20], int *printFlag) {
+
+    int i, it, nhist, steps, rejected;
+    int quiet = 1;
+    int size = ctx->nrows*ctx->ncols;
+    double rhoa, gap, s, h, hmax, hmin;
+    double lam[3];
+    double *cFuncMatrix, *guess, *gammaOutput, *g[3];
+
+    size_t mark = oz_mark(ctx);
+    cFuncMatrix = oz_alloc(ctx, size);
+    guess       = oz_alloc(ctx, size);
+    gammaOutput = oz_alloc(ctx, size);
+    g[0]        = oz_alloc(ctx, size);
+    g[1]        = oz_alloc(ctx, size);
+    g[2]        = oz_alloc(ctx, size);
+
+    if (cFuncMatrix == NULL || guess == NULL || gammaOutput == NULL || g[0] == NULL || g[1] == NULL || g[2] == NULL) {
+        printf("Memory allocation failed in OZ2_warm.\n");
+        oz_free(ctx, cFuncMatrix);
+        oz_free(ctx, guess);
+        oz_free(ctx, gammaOutput);
+        oz_free(ctx, g[0]);
+        oz_free(ctx, g[1]);
+        oz_free(ctx, g[2]);
+        oz_release(ctx, mark);
+        return 0;
+    }
+
+    rhoa = ctx->rho;
+    gap = fabs(rhoa - rhoSeed);
+    hmax = (gap > 0.0) ? OZ_ADAPT_HMAX * rhoa / gap : 1.0;
+    hmin = (gap > 0.0) ? rhoa / (4.0 * nrho * gap) : 1.0;
+    h = (hmax < 1.0) ? hmax : 1.0;
+
+    for (i = 0; i < size; i++) g[0][i] = gammaSeed[i];
+    lam[0] = 0.0;
+    nhist = 1;
+    s = (gap > 0.0) ? 0.0 : 1.0;
+    steps = 0;
+    rejected = 0;
+
+    ctx->ng_max_iter = OZ_ADAPT_MAX_ITER;
+
+    while (s < 1.0) {
+        double sNew = s + h;
+
+        // Do not leave a sliver for the last step
+        if (sNew > 1.0 - 0.25*h) sNew = 1.0;
+
+        ramp_predict(ctx, guess, sNew, lam, g, nhist, ctx->predictor_order);
+
+        ctx->rho = rhoSeed + sNew * (rhoa - rhoSeed);
+        it = Ng_ctx(ctx, nrho, guess, gammaOutput, potentialID, closureID, cFuncMatrix, 1.0, 0.0, alpha, EZ, nrho, &quiet);
+
+        if (it < 0) {
+            rejected++;
+            h *= 0.5;
+            if (h < hmin) break;
+            continue;
+        }
+
+        // Accept: rotate the history, newest first
+        double *oldest = g[2];
+        g[2] = g[1]; lam[2] = lam[1];
+        g[1] = g[0]; lam[1] = lam[0];
+        g[0] = gammaOutput; lam[0] = sNew;
+        gammaOutput = oldest;
+        if (nhist < 3) nhist++;
+
+        s = sNew;
+        steps++;
+
+        if (it <= OZ_ADAPT_FAST) h *= 2.0;
+        else if (it > OZ_ADAPT_SLOW) h *= 0.5;
+        if (h > hmax) h = hmax;
+        if (h < hmin) h = hmin;
+    }
+
+    ctx->ng_max_iter = 0;
+
+    if (s < 1.0) {
+        // Leave ctx marked as failed (ng_iter = -1, no thermodynamics) so the caller can fall back
+        oz_log(ctx, "\nContinuación: paso menor que rho/(4*nrho) en rho = %.6f.\n", ctx->rho);
+        ctx->rho = rhoa;
+        ctx->ng_iter = -1;
+        ctx->pv = ctx->chic = ctx->ener = ctx->chiv = NAN;
+    } else {
+        OZ2_finish_ctx(ctx, Sk, Gr, potentialID, closureID, alpha, EZ, nrho, folderName, printFlag, \
+                       nrho, rhoa, cFuncMatrix, g[0], gammaOutput);
+    }
+    ctx->ramp_steps = steps;
+    ctx->ramp_rejected = rejected;
+
+    oz_free(ctx, cFuncMatrix);
+    oz_free(ctx, guess);
+    oz_free(ctx, gammaOutput);
+    oz_free(ctx, g[0]);
+    oz_free(ctx, g[1]);
+    oz_free(ctx, g[2]);
+    oz_release(ctx, mark);
+
+    return steps;
+}
+
+/**
+ * @brief Solves the OZ equation starting from a converged neighbouring state.
+ *
+ * Instead of charging from gamma = 0 over nrho steps, the density is moved
+ * from rhoSeed to the target ctx->rho in steps no larger than those of the
+ * OZ2_ctx ramp (rho/nrho), starting from gammaSeed and extrapolating
+ * linearly between steps. With ctx->ramp_mode = OZ_RAMP_ADAPTIVE the steps
+ * come from the step control of OZ2_adaptive_ctx instead, so a seed far
+ * from the target costs a few steps rather than up to nrho. The potential
+ * is already the target one, so a neighbour at a nearby temperature is
+ * also a valid seed.
+ *
+ * @param ctx Solver context (grids, potential tables, density).
+ * @param gammaSeed Converged gamma [nrows*ncols] of the neighbouring state.
+ * @param rhoSeed Density of the neighbouring state.
+ * @param Sk Output Structure Factor array.
+ * @param Gr Output Radial Distribution Function array.
+ * @param potentialID ID of the potential.
+ * @param closureID ID of the closure relation (1=PY, 2=HNC, 3=RY).
+ * @param alpha Parameter for RY closure.
+ * @param EZ Convergence criterion.
+ * @param nrho Number of density steps of the cold ramp (sets the step size).
+ * @param folderName Output folder name.
+ * @param printFlag Flag to control printing.
+ * @return Number of continuation steps used. If Ng diverges on the way,
+ *         ctx->ng_iter is -1, the thermodynamics are NAN and Sk, Gr and
+ *         ctx->gamma are left untouched (the caller redoes the full ramp).
+ */
+int OZ2_warm_ctx(OZContext *ctx, const double *gammaSeed, double rhoSeed, double *Sk, double *Gr, \
+                 int potentialID, int closureID, double alpha, double EZ, int nrho, \
+                 char folderName[20], int *printFlag) {
+
+    int i, step, nsteps;
+    int size = ctx->nrows*ctx->ncols;
+    double T, TFlag, rhoa, drho;
+    double *cFuncMatrix, *gammaInput1, *gammaInput2, *gammaOutput;
+
+    if (ctx->ramp_mode == OZ_RAMP_ADAPTIVE) {
+        return warm_adaptive_ctx(ctx, gammaSeed, rhoSeed, Sk, Gr, potentialID, closureID, alpha, EZ, nrho, \
+                                 folderName, printFlag);
+    }
+
+    size_t mark = oz_mark(ctx);
+    cFuncMatrix = oz_alloc(ctx, size);
+    gammaInput1 = oz_alloc(ctx, size);
+    gammaInput2 = oz_alloc(ctx, size);
+    gammaOutput = oz_alloc(ctx, size);
+
+    if (cFuncMatrix == NULL || gammaInput1 == NULL || gammaInput2 == NULL || gammaOutput == NULL) {
+        printf("Memory allocation failed in OZ2_warm.\n");
+        oz_free(ctx, cFuncMatrix);
+        oz_free(ctx, gammaInput1);
+        oz_free(ctx, gammaInput2);
+        oz_free(ctx, gammaOutput);
+        oz_release(ctx, mark);
+        return 0;
+    }
+
+    rhoa = ctx->rho;
+    nsteps = (int) ceil(fabs(rhoa - rhoSeed) / (rhoa / ((double) nrho)));
+    if (nsteps < 1) nsteps = 1;
+    if (nsteps > nrho) nsteps = nrho;
+    drho = (rhoa - rhoSeed) / ((double) nsteps);
+
     T = 1.0;
-    TFlag = 1.0;
-    rho = rhoa;
+    TFlag = 0.0;
 
-    Ng(kj, gammaInput1, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, rmax, nrho, printFlag);
+    for (i = 0; i < size; i++) {
+        gammaInput1[i] = gammaSeed[i];
+    }
 
-    Escribe(gammaOutput, cFuncMatrix, Sk, Gr, potentialID, closureID, folderName);
+    // The last step is taken at rhoa by OZ2_finish_ctx
+    for (step = 1; step < nsteps; step++) {
+        for (i = 0; i < size; i++) {
+            gammaInput2[i] = gammaInput1[i];
+        }
 
-    Termo(gammaOutput, cFuncMatrix, &pv, &chic, &ener);
-    PexV = pv/rho - 1.0;
+        ctx->rho = rhoSeed + step * drho;
+        if (Ng_ctx(ctx, nrho, gammaInput1, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, \
+                   nrho, printFlag) < 0) {
+            // Leave ctx marked as failed (ng_iter = -1, no thermodynamics) so the caller can fall back
+            oz_log(ctx, "\nContinuación: Ng divergió en rho = %.6f (paso %d de %d).\n", ctx->rho, step, nsteps);
+            ctx->rho = rhoa;
+            ctx->pv = ctx->chic = ctx->ener = ctx->chiv = NAN;
+            ctx->ramp_steps = step;
+            ctx->ramp_rejected = 0;
+            oz_free(ctx, cFuncMatrix);
+            oz_free(ctx, gammaInput1);
+            oz_free(ctx, gammaInput2);
+            oz_free(ctx, gammaOutput);
+            oz_release(ctx, mark);
+            return step;
+        }
 
-    free(cFuncMatrix);
-    free(gammaInput1);
-    free(gammaInput2);
-    free(gammaOutput);
+        Extrap_ctx(ctx, gammaInput2, gammaOutput, ctx->rho, drho);
+        for (i = 0; i < size; i++) {
+            gammaInput1[i] = gammaInput2[i];
+        }
+    }
+
+    OZ2_finish_ctx(ctx, Sk, Gr, potentialID, closureID, alpha, EZ, nrho, folderName, printFlag, \
+                   nrho, rhoa, cFuncMatrix, gammaInput1, gammaOutput);
+    ctx->ramp_steps = nsteps;
+    ctx->ramp_rejected = 0;
+
+    oz_free(ctx, cFuncMatrix);
+    oz_free(ctx, gammaInput1);
+    oz_free(ctx, gammaInput2);
+    oz_free(ctx, gammaOutput);
+    oz_release(ctx, mark);
+
+    return nsteps;
+}
+
+/**
+ * @brief Legacy entry point: runs OZ2_ctx on the global state.
+ */
+void OZ2(double *Sk, double *Gr, int potentialID, int closureID, double alpha, double EZ, \
+         double rmax, int nrho, char folderName[20], int *printFlag) {
+    OZContext ctx = oz_legacy_context();
+    ctx.rmax = rmax;
+    OZ2_ctx(&ctx, Sk, Gr, potentialID, closureID, alpha, EZ, nrho, folderName, printFlag);
+    oz_legacy_sync(&ctx);
 }
 
 /**
  * @brief Calculates thermodynamic properties (Pressure, Compressibility, Energy).
  *
+ * @param ctx Solver context (grids, potential tables, density).
  * @param gamma Indirect correlation function.
  * @param cFuncMatrix Direct correlation function.
  * @param pv1 Pointer to store pressure (virial).
  * @param chic Pointer to store compressibility.
  * @param ener Pointer to store energy.
  */
-void Termo(double *gamma, double *cFuncMatrix, double *pv1, double *chic, double *ener) {
+void Termo_ctx(const OZContext *ctx, double *gamma, double *cFuncMatrix, double *pv1, double *chic, double *ener) {
     
     int i, k;
     double ru1, ru2, ru3;
     double *r1;
     double *gMatrix;
 
-    r1 = malloc(nrows * sizeof(double));
-    gMatrix = malloc(nrows*ncols * sizeof(double));
+    size_t mark = oz_mark(ctx);
+    r1 = oz_alloc(ctx, ctx->nrows);
+    gMatrix = oz_alloc(ctx, ctx->nrows*ctx->ncols);
 
     if (r1 == NULL || gMatrix == NULL) {
         printf("Memory allocation failed in Termo.\n");
+        oz_free(ctx, r1);
+        oz_free(ctx, gMatrix);
+        oz_release(ctx, mark);
         return;
     }
 
-    for (i = 0; i < nrows; i++) {
-        r1[i] = x[0]*x[0]*cFuncMatrix[i*ncols + 0] + 2.0*x[0]*x[1]*cFuncMatrix[i*ncols + 1] + x[1]*x[1]*cFuncMatrix[i*ncols + 2];
-        r1[i] = r1[i] * r[i]*r[i];
+    for (i = 0; i < ctx->nrows; i++) {
+        r1[i] = ctx->x[0]*ctx->x[0]*cFuncMatrix[i + 0*ctx->nrows] + 2.0*ctx->x[0]*ctx->x[1]*cFuncMatrix[i + 1*ctx->nrows] + ctx->x[1]*ctx->x[1]*cFuncMatrix[i + 2*ctx->nrows];
+        r1[i] = r1[i] * ctx->r[i]*ctx->r[i];
     }
 
     *chic = 0.0;
     
-    for (i = 1; i < nrows - 1; i++) {
+    for (i = 1; i < ctx->nrows - 1; i++) {
         *chic += r1[i];
     }
-    *chic = dr * (*chic + (r1[0] + r1[nrows-1]) / 2.0);
-    *chic = 1.0 - 4.0 * M_PI * rho * (*chic);
+    *chic = ctx->dr * (*chic + (r1[0] + r1[ctx->nrows-1]) / 2.0);
+    *chic = 1.0 - 4.0 * M_PI * ctx->rho * (*chic);
 
-    for (k = 0; k < ncols; k++) {
-        for (i = 0; i < nrows; i++) {
-            gMatrix[i + k*nrows] = gamma[i*ncols + k] + cFuncMatrix[i*ncols + k] + 1.0;
+    for (k = 0; k < ctx->ncols; k++) {
+        for (i = 0; i < ctx->nrows; i++) {
+            gMatrix[i + k*ctx->nrows] = gamma[i + k*ctx->nrows] + cFuncMatrix[i + k*ctx->nrows] + 1.0;
         }
     }
 
-    for (i = 0; i < nrows; i++) {
-        ru1 = x[0]*x[0] * gMatrix[i + 0*nrows] * Up[i*ncols + 0];
-        ru2 = 2.0 * x[0]*x[1] * gMatrix[i + 1*nrows] * Up[i*ncols + 1];
-        ru3 = x[1]*x[1] * gMatrix[i + 2*nrows] * Up[i*ncols + 2];
-        r1[i] = (ru1 + ru2 + ru3) * r[i]*r[i];
+    for (i = 0; i < ctx->nrows; i++) {
+        ru1 = ctx->x[0]*ctx->x[0] * gMatrix[i + 0*ctx->nrows] * ctx->Up[i + 0*ctx->nrows];
+        ru2 = 2.0 * ctx->x[0]*ctx->x[1] * gMatrix[i + 1*ctx->nrows] * ctx->Up[i + 1*ctx->nrows];
+        ru3 = ctx->x[1]*ctx->x[1] * gMatrix[i + 2*ctx->nrows] * ctx->Up[i + 2*ctx->nrows];
+        r1[i] = (ru1 + ru2 + ru3) * ctx->r[i]*ctx->r[i];
     }
 
     *pv1 = 0.0;
 
-    for (i = 1; i < (nrows-1); i++) {
+    for (i = 1; i < (ctx->nrows-1); i++) {
         *pv1 += r1[i];
     }
     
-    *pv1 = dr * ((*pv1) + (r1[0] + r1[nrows-1])/2.0);
-    *pv1 = rho * (1.0 + 2.0*M_PI * rho*(*pv1)/3.0);
+    *pv1 = ctx->dr * ((*pv1) + (r1[0] + r1[ctx->nrows-1])/2.0);
+    *pv1 = ctx->rho * (1.0 + 2.0*M_PI * ctx->rho*(*pv1)/3.0);
 
-    for (i = 0; i < nrows; i++) {
-        r1[i] = x[0]*x[0] * gMatrix[i + 0*nrows] * U[i*ncols + 0] + 2.0*x[0]*x[1] * gMatrix[i + 1*nrows]*U[i*ncols + 1];
-        r1[i] = (r1[i] + x[1]*x[1] * gMatrix[i + 2*nrows] * U[i*ncols + 2]) * r[i]*r[i];
+    for (i = 0; i < ctx->nrows; i++) {
+        r1[i] = ctx->x[0]*ctx->x[0] * gMatrix[i + 0*ctx->nrows] * ctx->U[i + 0*ctx->nrows] + 2.0*ctx->x[0]*ctx->x[1] * gMatrix[i + 1*ctx->nrows]*ctx->U[i + 1*ctx->nrows];
+        r1[i] = (r1[i] + ctx->x[1]*ctx->x[1] * gMatrix[i + 2*ctx->nrows] * ctx->U[i + 2*ctx->nrows]) * ctx->r[i]*ctx->r[i];
     }
 
     *ener = 0.0;
 
-    for (i = 1; i < (nrows-1); i++) {
+    for (i = 1; i < (ctx->nrows-1); i++) {
         *ener += r1[i];
     }
 
-    *ener = dr * ((*ener) + (r1[0] + r1[nrows-1]) / 2.0);
-    *ener *= 2.0 * M_PI * rho;
+    *ener = ctx->dr * ((*ener) + (r1[0] + r1[ctx->nrows-1]) / 2.0);
+    *ener *= 2.0 * M_PI * ctx->rho;
 
-    free(r1);
-    free(gMatrix);
+    oz_free(ctx, r1);
+    oz_free(ctx, gMatrix);
+    oz_release(ctx, mark);
+}
+
+/**
+ * @brief Legacy entry point: runs Termo_ctx on the global state.
+ */
+void Termo(double *gamma, double *cFuncMatrix, double *pv1, double *chic, double *ener) {
+    OZContext ctx = oz_legacy_context();
+    Termo_ctx(&ctx, gamma, cFuncMatrix, pv1, chic, ener);
 }
 
 /**
@@ -758,6 +1529,7 @@ void Termo(double *gamma, double *cFuncMatrix, double *pv1, double *chic, double
  *
  * Checks for thermodynamic consistency between virial and compressibility equations of state.
  *
+ * @param ctx Solver context (grids, potential tables, density).
  * @param pv1 Pressure at rho - drho.
  * @param pv2 Pressure at rho + 2*drho.
  * @param chic Compressibility.
@@ -766,25 +1538,24 @@ void Termo(double *gamma, double *cFuncMatrix, double *pv1, double *chic, double
  * @param dalpha Alpha step.
  * @param IRY Pointer to flag (1 if iteration needed, 0 if converged).
  */
-void RY(double pv1, double pv2, double chic, double ddrho, double *alpha, double dalpha, int *IRY) {
+void RY_ctx(OZContext *ctx, double pv1, double pv2, double chic, double ddrho, double *alpha, double dalpha, int *IRY) {
 
-    static double dif[2] = {0.0};
-    static int ix = 1;
+    double *dif = ctx->ry_dif;
     double chiv, prod, A, B;
 
     *IRY = 0;
     chiv = (pv2 - pv1) / (2.0 * ddrho);
-    dif[ix-1] = chic - chiv;
+    dif[ctx->ry_ix-1] = chic - chiv;
 
     prod = 0.0;
 
-    if (ix < 2) {
-        ix++;
+    if (ctx->ry_ix < 2) {
+        ctx->ry_ix++;
         *alpha += dalpha;
         *IRY = 1;
-        printf("   CHIC = %.17g   CHIV = %.17g\n", chic, chiv);
-        printf("   DIFF = %.17g   \n", dif[ix - 1]);
-        printf("   ALPHA = %.17g  <------------------ \n\n", *alpha);
+        oz_log(ctx, "   CHIC = %.17g   CHIV = %.17g\n", chic, chiv);
+        oz_log(ctx, "   DIFF = %.17g   \n", dif[ctx->ry_ix - 1]);
+        oz_log(ctx, "   ALPHA = %.17g  <------------------ \n\n", *alpha);
         return;
     }
 
@@ -796,24 +1567,34 @@ void RY(double pv1, double pv2, double chic, double ddrho, double *alpha, double
         B = dif[0] - A * (*alpha);
         *alpha = -B / A;
         *IRY = 0;
-        printf("   CHIC = %.17g   CHIV = %.17g\n", chic, chiv);
-        printf("   DIFF = %.17g   \n", dif[ix - 1]);
-        printf("   ALPHA = %.17g  <------------------ \n\n", *alpha);
+        oz_log(ctx, "   CHIC = %.17g   CHIV = %.17g\n", chic, chiv);
+        oz_log(ctx, "   DIFF = %.17g   \n", dif[ctx->ry_ix - 1]);
+        oz_log(ctx, "   ALPHA = %.17g  <------------------ \n\n", *alpha);
         return;
     } else {
         dif[0] = dif[1];
         *alpha += dalpha;
         *IRY = 1;
-        printf("   CHIC = %.17g   CHIV = %.17g\n", chic, chiv);
-        printf("   DIFF = %.17g   \n", dif[ix - 1]);
-        printf("   ALPHA = %.17g  <------------------ \n\n", *alpha);
+        oz_log(ctx, "   CHIC = %.17g   CHIV = %.17g\n", chic, chiv);
+        oz_log(ctx, "   DIFF = %.17g   \n", dif[ctx->ry_ix - 1]);
+        oz_log(ctx, "   ALPHA = %.17g  <------------------ \n\n", *alpha);
         return;
     }
 }
 
+/**
+ * @brief Legacy entry point: runs RY_ctx on the global state.
+ */
+void RY(double pv1, double pv2, double chic, double ddrho, double *alpha, double dalpha, int *IRY) {
+    OZContext ctx = oz_legacy_context();
+    RY_ctx(&ctx, pv1, pv2, chic, ddrho, alpha, dalpha, IRY);
+    oz_legacy_sync(&ctx);
+}
+
 /**
  * @brief Writes the results (Structure Factor and Radial Distribution Function) to files.
  *
+ * @param ctx Solver context (grids, potential tables, density).
  * @param gamma Indirect correlation function.
  * @param cFuncMatrix Direct correlation function.
  * @param Sk Output array for Structure Factor.
@@ -822,84 +1603,161 @@ void RY(double pv1, double pv2, double chic, double ddrho, double *alpha, double
  * @param closureID Closure ID.
  * @param folderName Output folder name.
  */
-void Escribe(double *gamma, double *cFuncMatrix, double *Sk, double *Gr, int potentialID, int closureID, char folderName[20]) {
+// S_11(k)/x_1 from c_11(k), c_12(k) and c_22(k); same operations as the S[0] column of Escribe_ctx
+static double escribe_s11(const OZContext *ctx, double c11, double c12, double c22) {
+    double delta, s;
 
-    int i, k;
+    delta = (1.0 - ctx->rho*ctx->x[0] * c11) * (1.0 - ctx->rho*ctx->x[1] * c22);
+    delta -= pow(ctx->rho, 2.0) * ctx->x[0]*ctx->x[1] * pow(c12, 2.0);
+
+    s = (1.0 - ctx->rho*ctx->x[1] * c22) * c11;
+    s = (s + ctx->rho*ctx->x[1] * pow(c12, 2.0)) / delta;
+    s = ctx->x[0] + ctx->rho*pow(ctx->x[0], 2.0) * s;
+
+    return s/ctx->x[0];
+}
+
+void Escribe_ctx(const OZContext *ctx, double *gamma, double *cFuncMatrix, double *Sk, double *Gr, int potentialID, int closureID, char folderName[20]) {
+
+    int i;
     double dk, qmax, rk_max, sqmax, delta;
-    double *rk, *c1, *gh, *gh2, *Ck, *S;
+    double *rk, *c1, *gh, *Ck, *S;
+    double t0 = oz_time_now();
 
-    rk  = malloc(nrows * sizeof(double));
-    c1  = malloc(nrows*ncols * sizeof(double));
-    gh  = malloc(nrows*ncols * sizeof(double));
-    gh2 = malloc(nrows*ncols * sizeof(double));
-    Ck  = malloc(nrows*ncols * sizeof(double));
-    S   = malloc(nrows*ncols * sizeof(double));
+    size_t mark = oz_mark(ctx);
+    rk  = oz_alloc(ctx, ctx->nrows);
+    c1  = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    gh  = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    Ck  = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    S   = oz_alloc(ctx, ctx->nrows*ctx->ncols);
 
-    if (rk == NULL || c1 == NULL || gh == NULL || gh2 == NULL || Ck == NULL || S == NULL) {
+    if (rk == NULL || c1 == NULL || gh == NULL || Ck == NULL || S == NULL) {
         printf("Memory allocation failed in Escribe.\n");
+        oz_free(ctx, rk);
+        oz_free(ctx, c1);
+        oz_free(ctx, gh);
+        oz_free(ctx, Ck);
+        oz_free(ctx, S);
+        oz_release(ctx, mark);
+        oz_timing_stop(OZ_PHASE_OUTPUT, t0);
         return;
     }
 
-    for (i = 0; i < nrows; i++) {
-        for (k = 0; k < ncols; k++) {
-            gh[i*ncols + k] = gamma[i*ncols + k] + cFuncMatrix[i*ncols + k];
+    for (i = 0; i < ctx->nrows*ctx->ncols; i++) {
+        gh[i] = gamma[i] + cFuncMatrix[i];
+    }
+
+    for (i = 0; i < ctx->nrows; i++) {
+        Gr[i*2 + 0] = ctx->r[i];
+        Gr[i*2 + 1] = gh[i + 0*ctx->nrows] + 1.0;
+    }
+
+    if (ctx->cr != NULL) {
+        for (i = 0; i < ctx->nrows; i++) {
+            ctx->cr[i] = cFuncMatrix[i + 0*ctx->nrows];
         }
-        Gr[i*2 + 0] = r[i];
-        Gr[i*2 + 1] = gh[i*ncols + 0] + 1.0;
     }
 
-    qmax = q[nrows - 1];
+    qmax = ctx->q[ctx->nrows - 1];
     rk_max = qmax / 2.0;
-    dk = rk_max / (1.0 * nrows);
+    dk = rk_max / (1.0 * ctx->nrows);
 
-    for (i = 0; i < nrows; i++) {
+    for (i = 0; i < ctx->nrows; i++) {
         rk[i] = 1.0E-5 + (i+0) * dk;
     }
 
-    FT(gh, gh2, rk, dr);
-    FT(cFuncMatrix, c1, rk, dr);
+    // S(k) only needs c(k); the O(N^2) FT_ctx is replaced by one padded sinft per column
+    FT_fast_ctx(ctx, cFuncMatrix, c1, rk, ctx->nrows);
 
-    for (i = 0; i < nrows; i++) {
-        for (k = 0; k < ncols; k++) {
-            Ck[i*ncols + k] = c1[i*ncols + k];
+    memcpy(Ck, c1, (size_t) ctx->nrows*ctx->ncols * sizeof(double));
+
+    if (ctx->ck != NULL) {
+        for (i = 0; i < ctx->nrows; i++) {
+            ctx->ck[i] = Ck[i + 0*ctx->nrows];
         }
     }
 
-    for (i = 0; i < nrows; i++) {
-        delta = (1.0 - rho*x[0] * Ck[i*ncols + 0]) * (1.0 - rho*x[1] * Ck[i*ncols + 2]);
-        delta -= pow(rho, 2.0) * x[0]*x[1] * pow(Ck[i*ncols + 1], 2.0);
+    for (i = 0; i < ctx->nrows; i++) {
+        delta = (1.0 - ctx->rho*ctx->x[0] * Ck[i + 0*ctx->nrows]) * (1.0 - ctx->rho*ctx->x[1] * Ck[i + 2*ctx->nrows]);
+        delta -= pow(ctx->rho, 2.0) * ctx->x[0]*ctx->x[1] * pow(Ck[i + 1*ctx->nrows], 2.0);
         
-        S[i*ncols + 0] = (1.0 - rho*x[1] * Ck[i*ncols + 2]) * Ck[i*ncols + 0];
-        S[i*ncols + 0] = (S[i*ncols + 0] + rho*x[1] * pow(Ck[i*ncols + 1], 2.0)) / delta;
-        S[i*ncols + 1] = Ck[i*ncols + 1] / delta;
-        S[i*ncols + 2] = (1.0 - rho*x[0] * Ck[i*ncols + 0]) * Ck[i*ncols + 2];
-        S[i*ncols + 2] = (S[i*ncols + 2] + rho*x[0] * pow(Ck[i*ncols + 1], 2.0)) / delta;
-        S[i*ncols + 0] = x[0] + rho*pow(x[0], 2.0) * S[i*ncols + 0];
-        S[i*ncols + 1] = rho * x[0]*x[1] * S[i*ncols + 1];
-        S[i*ncols + 2] = x[1] + rho*pow(x[1], 2.0) * S[i*ncols + 2];
+        S[i + 0*ctx->nrows] = (1.0 - ctx->rho*ctx->x[1] * Ck[i + 2*ctx->nrows]) * Ck[i + 0*ctx->nrows];
+        S[i + 0*ctx->nrows] = (S[i + 0*ctx->nrows] + ctx->rho*ctx->x[1] * pow(Ck[i + 1*ctx->nrows], 2.0)) / delta;
+        S[i + 1*ctx->nrows] = Ck[i + 1*ctx->nrows] / delta;
+        S[i + 2*ctx->nrows] = (1.0 - ctx->rho*ctx->x[0] * Ck[i + 0*ctx->nrows]) * Ck[i + 2*ctx->nrows];
+        S[i + 2*ctx->nrows] = (S[i + 2*ctx->nrows] + ctx->rho*ctx->x[0] * pow(Ck[i + 1*ctx->nrows], 2.0)) / delta;
+        S[i + 0*ctx->nrows] = ctx->x[0] + ctx->rho*pow(ctx->x[0], 2.0) * S[i + 0*ctx->nrows];
+        S[i + 1*ctx->nrows] = ctx->rho * ctx->x[0]*ctx->x[1] * S[i + 1*ctx->nrows];
+        S[i + 2*ctx->nrows] = ctx->x[1] + ctx->rho*pow(ctx->x[1], 2.0) * S[i + 2*ctx->nrows];
     }
 
     sqmax = 0.0;
 
-    for (i = 0; i < nrows; i++) {
+    for (i = 0; i < ctx->nrows; i++) {
         Sk[i*2 + 0] = rk[i];
-        Sk[i*2 + 1] = S[i*ncols + 0]/x[0];
-        if (S[i*ncols + 0] > sqmax) {
-            sqmax = S[i*ncols + 0];
+        Sk[i*2 + 1] = S[i + 0*ctx->nrows]/ctx->x[0];
+        if (S[i + 0*ctx->nrows] > sqmax) {
+            sqmax = S[i + 0*ctx->nrows];
+        }
+    }
+
+    // Caller-given (possibly non-uniform) k: c(k) directly by Filon quadrature, no interpolation
+    if (ctx->k_out != NULL && ctx->n_out > 0) {
+        size_t filon_mark = oz_mark(ctx);
+        double *c_out = oz_alloc(ctx, (size_t) ctx->n_out*ctx->ncols);
+
+        if (c_out == NULL) {
+            printf("Memory allocation failed in Escribe.\n");
+        } else {
+            FT_filon_ctx(ctx, cFuncMatrix, c_out, (double *) ctx->k_out, ctx->n_out);
+            for (i = 0; i < ctx->n_out; i++) {
+                if (ctx->ck_out != NULL) {
+                    ctx->ck_out[i] = c_out[i + 0*ctx->n_out];
+                }
+                if (ctx->sk_out != NULL) {
+                    ctx->sk_out[i] = escribe_s11(ctx, c_out[i + 0*ctx->n_out], c_out[i + 1*ctx->n_out], c_out[i + 2*ctx->n_out]);
+                }
+            }
         }
+        oz_free(ctx, c_out);
+        oz_release(ctx, filon_mark);
     }
 
-    free(rk);
-    free(c1);
-    free(gh);
-    free(gh2);
-    free(Ck);
-    free(S);
+    oz_free(ctx, rk);
+    oz_free(ctx, c1);
+    oz_free(ctx, gh);
+    oz_free(ctx, Ck);
+    oz_free(ctx, S);
+    oz_release(ctx, mark);
+    oz_timing_stop(OZ_PHASE_OUTPUT, t0);
+}
+
+/**
+ * @brief Legacy entry point: runs Escribe_ctx on the global state.
+ */
+void Escribe(double *gamma, double *cFuncMatrix, double *Sk, double *Gr, int potentialID, int closureID, char folderName[20]) {
+    OZContext ctx = oz_legacy_context();
+    Escribe_ctx(&ctx, gamma, cFuncMatrix, Sk, Gr, potentialID, closureID, folderName);
+}
+
+// Ramp progress counter; printing stops once the ramp reaches nrho
+static void ng_progress(int kj, int nrho, int *printFlag) {
+
+    if ((*printFlag) == 0){
+        printf("%03d/%03d", kj, nrho);
+        fflush(stdout);
+        printf("\b\b\b\b\b\b\b");
+    }
+
+    if (kj >= nrho){
+        *printFlag = 1;
+    }
 }
 
 /**
  * @brief Ng's method for accelerating convergence of the iterative solution.
  *
+ * @param ctx Solver context (grids, potential tables, density).
  * @param kj Current iteration step (related to density ramp).
  * @param gammaInput Input gamma function.
  * @param gammaOutput Output gamma function.
@@ -910,85 +1768,134 @@ void Escribe(double *gamma, double *cFuncMatrix, double *Sk, double *Gr, int pot
  * @param TFlag Temperature flag.
  * @param alpha Alpha parameter.
  * @param EZ Convergence criterion.
- * @param rmax Maximum radial distance.
  * @param nrho Number of density steps.
  * @param printFlag Print flag.
+ * With ctx->solver = OZ_SOLVER_NEWTON (and kj >= 2) the point is solved by
+ * NewtonKrylov_ctx instead; if Newton fails, the Ng iteration restarts from
+ * its best iterate.
+ *
+ * @return Ng iterations (or Newton steps) to convergence (0 when kj < 2), or
+ *         -1 if the residual stopped being finite or, with
+ *         ctx->ng_max_iter > 0, did not converge. The return value and the
+ *         last residual norm are also left in ctx->ng_iter and ctx->ng_residual.
  */
-void Ng(int kj, double *gammaInput, double *gammaOutput, int potentialID, int closureID, double *cFuncMatrix, \
-        double T, double TFlag, double alpha, double EZ, double rmax, int nrho, int *printFlag) {
+// Time of Ng_ctx since t0 not spent in the phases timed below it (ONg_ctx) counts as mixing
+static void ng_timing_stop(double t0, double phases0, int iter) {
+    oz_timing_add(OZ_PHASE_MIXING, (oz_time_now() - t0) - (oz_timing_total() - phases0));
+    if (iter > 0) oz_timing_count(iter);
+}
+
+int Ng_ctx(OZContext *ctx, int kj, double *gammaInput, double *gammaOutput, int potentialID, int closureID, \
+           double *cFuncMatrix, double T, double TFlag, double alpha, double EZ, int nrho, int *printFlag) {
 
     int i, k, flag;
-    double ETA, V, condition1;
+    int iter = 0;
+    double ETA = 0.0, ETA0 = 0.0, V, condition1;
+    double *start = gammaInput;
     double *f, *g1, *g2, *g3;
     double *d1, *d2, *d3, *d01, *d02;
     double *d01d01, *d01d02, *d02d02, *d3d01, *d3d02;
     double *const1, *const2;
+    double t_ng = oz_time_now(), phases0 = oz_timing_total();
+    int step = oz_telemetry_active ? oz_telemetry_next_step() : 0;
+
+    if (ctx->solver == OZ_SOLVER_NEWTON && kj >= 2) {
+        iter = NewtonKrylov_ctx(ctx, step, gammaInput, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ);
+        if (iter >= 0) {
+            ng_progress(kj, nrho, printFlag);
+            ctx->ng_iter = iter;
+            ng_timing_stop(t_ng, phases0, iter);
+            return iter;
+        }
+        // Newton left its best iterate in gammaOutput
+        start = gammaOutput;
+        iter = 0;
+    }
 
-    f   = malloc(nrows*ncols * sizeof(double));
-    g1  = malloc(nrows*ncols * sizeof(double));
-    g2  = malloc(nrows*ncols * sizeof(double));
-    g3  = malloc(nrows*ncols * sizeof(double));
-    d1  = malloc(nrows*ncols * sizeof(double));
-    d2  = malloc(nrows*ncols * sizeof(double));
-    d3  = malloc(nrows*ncols * sizeof(double));
-    d01 = malloc(nrows*ncols * sizeof(double));
-    d02 = malloc(nrows*ncols * sizeof(double));
-    d01d01  = malloc(ncols * sizeof(double));
-    d01d02  = malloc(ncols * sizeof(double));
-    d02d02  = malloc(ncols * sizeof(double));
-    d3d01   = malloc(ncols * sizeof(double));
-    d3d02   = malloc(ncols * sizeof(double));
-    const1  = malloc(ncols * sizeof(double));
-    const2  = malloc(ncols * sizeof(double));
+    size_t mark = oz_mark(ctx);
+    f   = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    g1  = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    g2  = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    g3  = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    d1  = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    d2  = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    d3  = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    d01 = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    d02 = oz_alloc(ctx, ctx->nrows*ctx->ncols);
+    d01d01  = oz_alloc(ctx, ctx->ncols);
+    d01d02  = oz_alloc(ctx, ctx->ncols);
+    d02d02  = oz_alloc(ctx, ctx->ncols);
+    d3d01   = oz_alloc(ctx, ctx->ncols);
+    d3d02   = oz_alloc(ctx, ctx->ncols);
+    const1  = oz_alloc(ctx, ctx->ncols);
+    const2  = oz_alloc(ctx, ctx->ncols);
 
     if (f == NULL || g1 == NULL || g2 == NULL || g3 == NULL || d1 == NULL || d2 == NULL || d3 == NULL ||
         d01 == NULL || d02 == NULL || d01d01 == NULL || d01d02 == NULL || d02d02 == NULL ||
         d3d01 == NULL || d3d02 == NULL || const1 == NULL || const2 == NULL ) {
         printf("Memory allocation failed in Ng.\n");
-        return;
+        oz_free(ctx, f);
+        oz_free(ctx, g1);
+        oz_free(ctx, g2);
+        oz_free(ctx, g3);
+        oz_free(ctx, d1);
+        oz_free(ctx, d2);
+        oz_free(ctx, d3);
+        oz_free(ctx, d01);
+        oz_free(ctx, d02);
+        oz_free(ctx, d01d01);
+        oz_free(ctx, d01d02);
+        oz_free(ctx, d02d02);
+        oz_free(ctx, d3d01);
+        oz_free(ctx, d3d02);
+        oz_free(ctx, const1);
+        oz_free(ctx, const2);
+        oz_release(ctx, mark);
+        ng_timing_stop(t_ng, phases0, 0);
+        return -1;
     }
 
-    for (k = 0; k < ncols; k++) {
-        for (i = 0; i < nrows; i++) {
-            f[i*ncols + k] = gammaInput[i*ncols + k];
+    for (k = 0; k < ctx->ncols; k++) {
+        for (i = 0; i < ctx->nrows; i++) {
+            f[i + k*ctx->nrows] = start[i + k*ctx->nrows];
         }
     }
 
-    ONg(f, g1, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, rmax);
-    ONg(g1, g2, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, rmax);
-    ONg(g2, g3, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, rmax);
+    ONg_ctx(ctx, f, g1, potentialID, closureID, cFuncMatrix, T, TFlag, alpha);
+    ONg_ctx(ctx, g1, g2, potentialID, closureID, cFuncMatrix, T, TFlag, alpha);
+    ONg_ctx(ctx, g2, g3, potentialID, closureID, cFuncMatrix, T, TFlag, alpha);
 
-    for (k = 0; k < ncols; k++) {
-        for (i = 0; i < nrows; i++) {
-            d1[i*ncols + k] = (g1[i*ncols + k] - f[i*ncols + k]);
-            d2[i*ncols + k] = (g2[i*ncols + k] - g1[i*ncols + k]);
+    for (k = 0; k < ctx->ncols; k++) {
+        for (i = 0; i < ctx->nrows; i++) {
+            d1[i + k*ctx->nrows] = (g1[i + k*ctx->nrows] - f[i + k*ctx->nrows]);
+            d2[i + k*ctx->nrows] = (g2[i + k*ctx->nrows] - g1[i + k*ctx->nrows]);
         }
     }
 
     while (kj >= 2) {
         
-        for (k = 0; k < ncols; k++) {
-            for (i = 0; i < nrows; i++) {
-                d3[i*ncols + k] = (g3[i*ncols + k] - g2[i*ncols + k]);
+        for (k = 0; k < ctx->ncols; k++) {
+            for (i = 0; i < ctx->nrows; i++) {
+                d3[i + k*ctx->nrows] = (g3[i + k*ctx->nrows] - g2[i + k*ctx->nrows]);
             }
         }
 
-        for (k = 0; k < ncols; k++) {
-            for (i = 0; i < nrows; i++) {
-                d01[i*ncols + k] = (d3[i*ncols + k] - d2[i*ncols + k]);
-                d02[i*ncols + k] = (d3[i*ncols + k] - d1[i*ncols + k]);
+        for (k = 0; k < ctx->ncols; k++) {
+            for (i = 0; i < ctx->nrows; i++) {
+                d01[i + k*ctx->nrows] = (d3[i + k*ctx->nrows] - d2[i + k*ctx->nrows]);
+                d02[i + k*ctx->nrows] = (d3[i + k*ctx->nrows] - d1[i + k*ctx->nrows]);
             }
         }
 
-        pp(dr, d01, d01, d01d01);
-        pp(dr, d01, d02, d01d02);
-        pp(dr, d3, d01, d3d01);
-        pp(dr, d02, d02, d02d02);
-        pp(dr, d3, d02, d3d02);
+        pp_ctx(ctx, ctx->dr, d01, d01, d01d01);
+        pp_ctx(ctx, ctx->dr, d01, d02, d01d02);
+        pp_ctx(ctx, ctx->dr, d3, d01, d3d01);
+        pp_ctx(ctx, ctx->dr, d02, d02, d02d02);
+        pp_ctx(ctx, ctx->dr, d3, d02, d3d02);
 
         V = (double) 1.0E-50;
 
-        for (k = 0; k < ncols; k++) {
+        for (k = 0; k < ctx->ncols; k++) {
 
             condition1 = d02d02[k] - (d01d02[k]*d01d02[k]) / d01d01[k];
 
@@ -998,9 +1905,9 @@ void Ng(int kj, double *gammaInput, double *gammaOutput, int potentialID, int cl
                 const2[k] = const2[k] / (d02d02[k] - d01d02[k]*d01d02[k] / d01d01[k]);
                 const1[k] = (d3d02[k] - d02d02[k] * const2[k]) / d01d02[k];
                 
-                for (i = 0; i < nrows; i++) {
-                    f[i*ncols + k] = (1.0 - const1[k] - const2[k]) * g3[i*ncols + k];
-                    f[i*ncols + k] = f[i*ncols + k] + const1[k]*g2[i*ncols + k] + const2[k]*g1[i*ncols + k];
+                for (i = 0; i < ctx->nrows; i++) {
+                    f[i + k*ctx->nrows] = (1.0 - const1[k] - const2[k]) * g3[i + k*ctx->nrows];
+                    f[i + k*ctx->nrows] = f[i + k*ctx->nrows] + const1[k]*g2[i + k*ctx->nrows] + const2[k]*g1[i + k*ctx->nrows];
                 }
 
                 flag = 0;
@@ -1012,69 +1919,106 @@ void Ng(int kj, double *gammaInput, double *gammaOutput, int potentialID, int cl
         }
 
         if (flag == 0){
-            ONg(f, g3, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, rmax);
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    d3[i*ncols + k] = g3[i*ncols + k] - f[i*ncols + k];
+            ONg_ctx(ctx, f, g3, potentialID, closureID, cFuncMatrix, T, TFlag, alpha);
+            for (k = 0; k < ctx->ncols; k++) {
+                for (i = 0; i < ctx->nrows; i++) {
+                    d3[i + k*ctx->nrows] = g3[i + k*ctx->nrows] - f[i + k*ctx->nrows];
                 }
             }
         }
 
-        Pres(d3, dr, &ETA);
+        Pres_ctx(ctx, d3, ctx->dr, &ETA);
+        iter++;
+
+        if (oz_telemetry_active) {
+            oz_telemetry_emit("ng", step, ctx->rho, iter, ETA, flag == 0, ctx->ws ? ctx->ws->arena_allocs : 0, \
+                              ctx->ws ? ctx->ws->heap_allocs : oz_heap_alloc_count());
+        }
+
+        if (!isfinite(ETA)) {
+            iter = -1;
+            break;
+        }
 
         if (ETA <= EZ) {
             break;
         }
 
-        for (k = 0; k < ncols; k++) {
-            for (i = 0; i < nrows; i++) {
-                g1[i*ncols + k] = g2[i*ncols + k];
-                d1[i*ncols + k] = d2[i*ncols + k];
-                g2[i*ncols + k] = g3[i*ncols + k];
-                d2[i*ncols + k] = d3[i*ncols + k];
+        // Only the adaptive ramp sets a cap; it retries with a smaller step
+        if (ctx->ng_max_iter > 0) {
+            if (iter == 1) ETA0 = ETA;
+            if (iter >= ctx->ng_max_iter || ETA > NG_DIVERGENCE_FACTOR * ETA0) {
+                iter = -1;
+                break;
             }
         }
 
-        ONg(g2, g3, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, rmax);
-    }
-
-    for (k = 0; k < ncols; k++) {
-        for (i = 0; i < nrows; i++) {
-            gammaOutput[i*ncols + k] = g3[i*ncols + k];
+        for (k = 0; k < ctx->ncols; k++) {
+            for (i = 0; i < ctx->nrows; i++) {
+                g1[i + k*ctx->nrows] = g2[i + k*ctx->nrows];
+                d1[i + k*ctx->nrows] = d2[i + k*ctx->nrows];
+                g2[i + k*ctx->nrows] = g3[i + k*ctx->nrows];
+                d2[i + k*ctx->nrows] = d3[i + k*ctx->nrows];
+            }
         }
-    }
 
-    if ((*printFlag) == 0){
-        printf("%03d/%03d", kj, nrho);
-        fflush(stdout);
-        printf("\b\b\b\b\b\b\b");
+        ONg_ctx(ctx, g2, g3, potentialID, closureID, cFuncMatrix, T, TFlag, alpha);
     }
 
-    if (kj >= nrho){
-        *printFlag = 1;
+    for (k = 0; k < ctx->ncols; k++) {
+        for (i = 0; i < ctx->nrows; i++) {
+            gammaOutput[i + k*ctx->nrows] = g3[i + k*ctx->nrows];
+        }
     }
+
+    ng_progress(kj, nrho, printFlag);
     
-    free(f);
-    free(g1);
-    free(g2);
-    free(g3);
-    free(d1);
-    free(d2);
-    free(d3);
-    free(d01);
-    free(d02);
-    free(d01d01);
-    free(d01d02);
-    free(d02d02);
-    free(d3d01);
-    free(d3d02);
-    free(const1);
-    free(const2);
+    oz_free(ctx, f);
+    oz_free(ctx, g1);
+    oz_free(ctx, g2);
+    oz_free(ctx, g3);
+    oz_free(ctx, d1);
+    oz_free(ctx, d2);
+    oz_free(ctx, d3);
+    oz_free(ctx, d01);
+    oz_free(ctx, d02);
+    oz_free(ctx, d01d01);
+    oz_free(ctx, d01d02);
+    oz_free(ctx, d02d02);
+    oz_free(ctx, d3d01);
+    oz_free(ctx, d3d02);
+    oz_free(ctx, const1);
+    oz_free(ctx, const2);
+    oz_release(ctx, mark);
+
+    ctx->ng_iter = iter;
+    ctx->ng_residual = ETA;
+    ng_timing_stop(t_ng, phases0, iter);
+
+    return iter;
+}
+
+/**
+ * @brief Legacy entry point: runs Ng_ctx on the global state.
+ */
+void Ng(int kj, double *gammaInput, double *gammaOutput, int potentialID, int closureID, double *cFuncMatrix, \
+        double T, double TFlag, double alpha, double EZ, double rmax, int nrho, int *printFlag) {
+    OZContext ctx = oz_legacy_context();
+    ctx.rmax = rmax;
+    Ng_ctx(&ctx, kj, gammaInput, gammaOutput, potentialID, closureID, cFuncMatrix, T, TFlag, alpha, EZ, nrho, printFlag);
 }
 
 /**
  * @brief Applies the closure relation (PY, HNC, RY) to calculate the direct correlation function.
  *
+ * Each column is split once at the core radius and the two parts go
+ * through the branch-free kernels of closure_kernels.c. The RY mixing
+ * function is taken from ctx->ry_mix and rebuilt only when alpha changes;
+ * the core index and the PY/RY factors of U from ctx->closure_tab, rebuilt
+ * when the potential, the closure or T change.
+ * gamma and cFuncMatrix must not overlap.
+ *
+ * @param ctx Solver context (grids, potential tables, density).
  * @param gamma Indirect correlation function.
  * @param potentialID Potential ID.
  * @param closureID Closure ID.
@@ -1082,78 +2026,124 @@ void Ng(int kj, double *gammaInput, double *gammaOutput, int potentialID, int cl
  * @param T Temperature parameter.
  * @param alpha Alpha parameter (for RY).
  */
-void closrel(double *gamma, int potentialID, int closureID, double *cFuncMatrix, double T, double alpha) {
+void closrel_ctx(const OZContext *ctx, double *gamma, int potentialID, int closureID, double *cFuncMatrix, double T, double alpha) {
     
-    int i, k;
-    double sigmaAux[ncols];
-    double arg, F;
+    int k, hi, mid;
+    int lo_local[3];
+    double sigmaAux;
+    double *mix = NULL;
+    double *w = NULL;
+
+    size_t mark = oz_mark(ctx);
+
+    // The RY mixing function depends only on r and alpha
+    if (closureID == 3) {
+        if (ctx->ry_mix) {
+            mix = ctx->ry_mix->f;
+            if (ctx->ry_mix->alpha != alpha) {
+                closure_RY_mixing(mix, ctx->r, alpha, ctx->nrows);
+                ctx->ry_mix->alpha = alpha;
+            }
+        } else {
+            mix = oz_alloc(ctx, ctx->nrows);
+            if (mix == NULL) {
+                printf("Memory allocation failed in closrel.\n");
+                return;
+            }
+            closure_RY_mixing(mix, ctx->r, alpha, ctx->nrows);
+        }
+    }
+
+    // The core index and the PY/RY factors depend only on U, the closure and T
+    OZClosureTables *tab = ctx->closure_tab;
+    int *lo = tab ? tab->lo : lo_local;
+    int build = 1;
+    if (tab) {
+        w = tab->w;
+        build = !(tab->potential == potentialID && tab->closure == closureID && tab->T == T);
+    } else if (closureID == 1 || closureID == 3) {
+        w = oz_alloc(ctx, (size_t) ctx->nrows*ctx->ncols);
+        if (w == NULL) {
+            printf("Memory allocation failed in closrel.\n");
+            if (mix != NULL && ctx->ry_mix == NULL) oz_free(ctx, mix);
+            oz_release(ctx, mark);
+            return;
+        }
+    }
+
+    for (k = 0; build && k < ctx->ncols; k++) {
+        const double *u = ctx->U + (size_t) k*ctx->nrows;
+        double *wk = w ? w + (size_t) k*ctx->nrows : NULL;
 
-    for (k = 0; k < ncols; k++) {
         if (potentialID == 1 || potentialID == 2 || potentialID == 3) {
-            sigmaAux[k] = (sigmaVec[k] / 2.0);
+            sigmaAux = (ctx->sigmaVec[k] / 2.0);
         } else if (potentialID == 10) {
-            sigmaAux[k] = 0.0;
+            sigmaAux = 0.0;
+        } else if (potentialID == 17) {
+            // A table starting at r_first > 0 has a core below it
+            sigmaAux = ctx->potential_table ? ctx->potential_table->r[0] : 0.0;
         } else {
-            sigmaAux[k] = sigmaVec[k];
+            sigmaAux = ctx->sigmaVec[k];
+        }
+
+        // r is increasing: points [0, lo) are inside the core (r < sigma)
+        lo[k] = 0;
+        hi = ctx->nrows;
+        while (lo[k] < hi) {
+            mid = (lo[k] + hi) / 2;
+            if (ctx->r[mid] < sigmaAux) lo[k] = mid + 1;
+            else hi = mid;
         }
-    }
 
-    for (k = 0; k < ncols; k++) {
-        for (i = 0; i < nrows; i++) {
-            cFuncMatrix[i*ncols + k] = gamma[i*ncols + k] + 1.0;
+        if (closureID == 1) {
+            closure_PY_weights(wk + lo[k], u + lo[k], T, ctx->nrows - lo[k]);
+        } else if (closureID == 3) {
+            closure_boltzmann(wk + lo[k], u + lo[k], T, ctx->nrows - lo[k]);
         }
     }
+    if (tab && build) {
+        tab->potential = potentialID;
+        tab->closure = closureID;
+        tab->T = T;
+    }
 
-    switch(closureID){
-        
-        case 1: // PY
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    if (r[i] < sigmaAux[k]) {
-                        cFuncMatrix[i*ncols + k] = -cFuncMatrix[i*ncols + k];
-                    } else {
-                        arg = U[i*ncols + k] * T;
-                        if (arg > 70.0) {
-                            cFuncMatrix[i*ncols + k] = -cFuncMatrix[i*ncols + k];
-                        } else {
-                            cFuncMatrix[i*ncols + k] = -(exp(-arg) - 1.0) * cFuncMatrix[i*ncols + k];
-                        }
-                    }
-                }
-            }
-            return;
-        
-        case 2: // HNC
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    if (r[i] < sigmaAux[k]) {
-                        cFuncMatrix[i*ncols + k] = -cFuncMatrix[i*ncols + k];
-                    } else {
-                        arg = U[i*ncols + k] * T - gamma[i*ncols + k];
-                        if (arg > 70.0) {
-                            cFuncMatrix[i*ncols + k] = -cFuncMatrix[i*ncols + k];
-                        } else {
-                            cFuncMatrix[i*ncols + k] = exp(-arg) - cFuncMatrix[i*ncols + k];
-                        }
-                    }
-                }
-            }
-            return;
-        
-        case 3: // RY
-            for (k = 0; k < ncols; k++) {
-                for (i = 0; i < nrows; i++) {
-                    if (r[i] < sigmaAux[k]) {
-                        cFuncMatrix[i*ncols + k] = -cFuncMatrix[i*ncols + k];
-                    } else {
-                        F = 1.0 - exp(-alpha * r[i]);
-                        arg = (exp(gamma[i*ncols + k] * F) - 1.0) / F;
-                        cFuncMatrix[i*ncols + k] = exp(-U[i*ncols + k] * T) * (1.0 + arg) - cFuncMatrix[i*ncols + k];
-                    }
-                }
-            }
-            return;
+    for (k = 0; k < ctx->ncols; k++) {
+        double *c = cFuncMatrix + (size_t) k*ctx->nrows;
+        const double *g = gamma + (size_t) k*ctx->nrows;
+        const double *u = ctx->U + (size_t) k*ctx->nrows;
+        const double *wk = w ? w + (size_t) k*ctx->nrows : NULL;
+        int n = ctx->nrows - lo[k];
+
+        switch(closureID){
+            case 1: // PY
+                closure_core_kernel(c, g, lo[k]);
+                closure_PY_table_kernel(c + lo[k], g + lo[k], wk + lo[k], n);
+                break;
+            case 2: // HNC
+                closure_core_kernel(c, g, lo[k]);
+                closure_HNC_kernel(c + lo[k], g + lo[k], u + lo[k], T, n);
+                break;
+            case 3: // RY
+                closure_core_kernel(c, g, lo[k]);
+                closure_RY_table_kernel(c + lo[k], g + lo[k], wk + lo[k], mix + lo[k], n);
+                break;
+            default: // g = gamma + 1
+                for (int i = 0; i < ctx->nrows; i++) c[i] = g[i] + 1.0;
+                break;
+        }
     }
+
+    if (w != NULL && tab == NULL) oz_free(ctx, w);
+    if (mix != NULL && (ctx->ry_mix == NULL || mix != ctx->ry_mix->f)) oz_free(ctx, mix);
+    oz_release(ctx, mark);
+}
+
+/**
+ * @brief Legacy entry point: runs closrel_ctx on the global state.
+ */
+void closrel(double *gamma, int potentialID, int closureID, double *cFuncMatrix, double T, double alpha) {
+    OZContext ctx = oz_legacy_context();
+    closrel_ctx(&ctx, gamma, potentialID, closureID, cFuncMatrix, T, alpha);
 }
 
 /**
@@ -1188,6 +2178,7 @@ void appendPotentialID(char *inputString, int potentialID) {
         case 8: strcat(inputString, "_STEPFUNC"); break;
         case 9: strcat(inputString, "_DOWNHILL"); break;
         case 16: strcat(inputString, "_SOFTSHOULDER"); break;
+        case 17: strcat(inputString, "_TABULATED"); break;
     }
 }
 
@@ -1209,5 +2200,6 @@ void PotentialName(int potentialID, double xnu) {
         case 8: printf("POTENTIAL: SHOULDER FUNCTION"); break;
         case 9: printf("POTENTIAL: DOWN-HILL FUNCTION"); break;
         case 16: printf("POTENTIAL: SOFT SHOULDER POTENTIAL"); break;
+        case 17: printf("POTENTIAL: TABULATED u(r)"); break;
     }
 }
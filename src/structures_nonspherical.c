@@ -3,36 +3,55 @@
 #include <string.h>
 #include <stdio.h>
 
+NonSphericalOptions default_nonspherical_options(void) {
+    NonSphericalOptions opts;
+    opts.mixing = MIXING_PICARD;
+    opts.anderson_depth = 5;
+    opts.alpha = 0.3;
+    opts.adaptive_damping = 0;
+    opts.max_iter = 2000;
+    opts.tolerance = 1e-6;
+    opts.mmax = 2;
+    opts.output_format = OZ_OUTPUT_TEXT;
+    opts.cache_dir = NULL;
+    opts.checkpoint_interval = 100;
+    opts.hs_reference = HS_REFERENCE_PY;
+    opts.grid = RADIAL_GRID_UNIFORM;
+    opts.r_min = 1e-2;
+    opts.dipole_split = 0;
+    opts.gpu = 0;
+    opts.mixed_precision = 0.0;
+    return opts;
+}
+
 ProjectionMatrix* create_projection_matrix(int n_projections, int n_points) {
     ProjectionMatrix *pm = malloc(sizeof(ProjectionMatrix));
     if (!pm) return NULL;
 
     pm->n_projections = n_projections;
     pm->n_points = n_points;
+    pm->stride = (n_points + PROJECTION_ALIGN - 1) / PROJECTION_ALIGN * PROJECTION_ALIGN;
+    pm->block = NULL;
 
-    // Allocate array of pointers
+    size_t size = (size_t) n_projections * pm->stride * sizeof(double);
+    if (posix_memalign((void **) &pm->block, PROJECTION_ALIGN * sizeof(double), size) != 0) pm->block = NULL;
     pm->data = malloc(n_projections * sizeof(double*));
     pm->labels = malloc(n_projections * sizeof(char*));
 
-    if (!pm->data || !pm->labels) {
-        if (pm->data) free(pm->data);
-        if (pm->labels) free(pm->labels);
+    if (!pm->block || !pm->data || !pm->labels) {
+        free(pm->block);
+        free(pm->data);
+        free(pm->labels);
         free(pm);
         return NULL;
     }
 
-    // Allocate rows
+    memset(pm->block, 0, size); // Initialize to 0
+
+    // Row views into the block
     for (int i = 0; i < n_projections; i++) {
-        pm->data[i] = calloc(n_points, sizeof(double)); // Initialize to 0
+        pm->data[i] = pm->block + (size_t) i * pm->stride;
         pm->labels[i] = NULL;
-        if (!pm->data[i]) {
-            // Rollback
-            for (int k = 0; k < i; k++) free(pm->data[k]);
-            free(pm->data);
-            free(pm->labels);
-            free(pm);
-            return NULL;
-        }
     }
 
     return pm;
@@ -41,12 +60,8 @@ ProjectionMatrix* create_projection_matrix(int n_projections, int n_points) {
 void free_projection_matrix(ProjectionMatrix *pm) {
     if (!pm) return;
 
-    if (pm->data) {
-        for (int i = 0; i < pm->n_projections; i++) {
-            if (pm->data[i]) free(pm->data[i]);
-        }
-        free(pm->data);
-    }
+    free(pm->block);
+    free(pm->data);
 
     if (pm->labels) {
         for (int i = 0; i < pm->n_projections; i++) {
@@ -58,6 +73,99 @@ void free_projection_matrix(ProjectionMatrix *pm) {
     free(pm);
 }
 
+void projection_matrix_copy(ProjectionMatrix *dst, const ProjectionMatrix *src) {
+    memcpy(dst->block, src->block, (size_t) src->n_projections * src->stride * sizeof(double));
+}
+
+void projection_matrix_swap(ProjectionMatrix *a, ProjectionMatrix *b) {
+    double *block = a->block;
+    double **data = a->data;
+
+    a->block = b->block;
+    a->data = b->data;
+    b->block = block;
+    b->data = data;
+}
+
+int write_projection_matrix(OZOutput *out, const char *name, const ProjectionMatrix *pm, \
+                            const int *m, const int *n, const int *l) {
+    size_t size = (size_t) pm->n_projections * (strlen(name) + 16) + 1;
+    char *columns = malloc(size);
+    if (!columns) {
+        printf("Memory allocation failed in write_projection_matrix.\n");
+        return 1;
+    }
+
+    size_t used = 0;
+    for (int p = 0; p < pm->n_projections; p++) {
+        used += snprintf(columns + used, size - used, "%s%s%d%d%d", (p > 0) ? " " : "", name, m[p], n[p], l[p]);
+    }
+
+    int status = oz_output_dataset(out, name, columns, (const double *const *) pm->data, pm->n_projections, pm->n_points);
+    free(columns);
+    return status;
+}
+
+void nonspherical_cache_key(OZCacheKey *key, const char *solver, const char *closure, int potential, int mmax, \
+                            int nodes, double rmax, double rho, double temp, double dipole) {
+    memset(key, 0, sizeof(OZCacheKey));
+    snprintf(key->solver, sizeof(key->solver), "%s", solver);
+    snprintf(key->closure, sizeof(key->closure), "%s", closure);
+    key->potential = potential;
+    key->mmax = mmax;
+    key->nodes = nodes;
+    key->rmax = rmax;
+    key->n_state = 3;
+    key->state[0] = rho;
+    key->state[1] = temp;
+    key->state[2] = dipole;
+}
+
+int nonspherical_cache_load(const char *dir, const OZCacheKey *key, const double *r, ProjectionMatrix *c) {
+    OZCacheEntry *entry = oz_cache_nearest(dir, key, OZ_CACHE_MAX_DISTANCE);
+    if (!entry) return 1;
+
+    int status = 1;
+    double *fit = NULL;
+    if (entry->n_columns == c->n_projections) {
+        fit = malloc((size_t) c->n_projections * c->n_points * sizeof(double));
+    }
+    if (fit && oz_cache_fit(entry, r, c->n_points, fit) == 0) {
+        for (int p = 0; p < c->n_projections; p++) {
+            memcpy(c->data[p], fit + (size_t) p * c->n_points, c->n_points * sizeof(double));
+        }
+        printf("Warm start from cache: rho = %.4f, T = %.4f, mu = %.4f (distance %.3g%s)\n", entry->key.state[0], \
+               entry->key.state[1], entry->key.state[2], entry->distance, entry->converged ? "" : ", checkpoint");
+        status = 0;
+    }
+
+    free(fit);
+    free_oz_cache_entry(entry);
+    return status;
+}
+
+int nonspherical_cache_save(const char *dir, const OZCacheKey *key, const double *r, const ProjectionMatrix *c, \
+                            int converged, int iterations, double residual, double rho) {
+    OZCacheEntry *entry = create_oz_cache_entry(key, c->n_projections, c->n_points);
+    if (!entry) {
+        printf("Memory allocation failed in nonspherical_cache_save.\n");
+        return 1;
+    }
+
+    memcpy(entry->r, r, c->n_points * sizeof(double));
+    for (int p = 0; p < c->n_projections; p++) {
+        memcpy(entry->data + (size_t) p * c->n_points, c->data[p], c->n_points * sizeof(double));
+    }
+    entry->converged = converged;
+    entry->iterations = iterations;
+    entry->residual = residual;
+    entry->rho = rho;
+
+    int status = oz_cache_save(dir, entry);
+    free_oz_cache_entry(entry);
+    return status;
+}
+
 void set_projection_label(ProjectionMatrix *pm, int index, const char *label) {
     if (!pm || index < 0 || index >= pm->n_projections) return;
 
@@ -0,0 +1,541 @@
+/**
+ * @file sweep.c
+ * @brief Batch solution of many spherical state points on a thread pool.
+ *
+ * Every worker owns one OZContext. A point is seeded from the converged
+ * gamma of the nearest point solved so far, so only the first points pay
+ * for the full nrho density ramp. With --cache, points without a solved
+ * neighbour (or solved before) start from the solution cache instead, and
+ * every converged point is stored in it. A seeded solve that does not
+ * converge is redone with the full ramp; only converged points seed others.
+ *
+ * The neighbour is picked among the points finished when a point is handed
+ * out, which depends on the thread count and timing: with several threads
+ * the results are reproducible only to within EZ.
+ */
+
+#include "facdes2Y.h"
+#include "sweep.h"
+#include "oz_timing.h"
+#include "oz_telemetry.h"
+#include <pthread.h>
+#include <unistd.h>
+
+// Solver defaults shared with solve_and_process (defined in facdes2Y.c)
+extern double rmax, alpha, EZ, sigma1, sigma2;
+extern int nrho;
+
+typedef struct {
+    StatePoint point;
+    int done;               // 1 once gamma, Sk and Gr hold a converged solution (may seed others)
+    int converged;          // 0 if neither the seeded solve nor the full ramp converged
+    int seed;               // Index of the neighbour used as seed (-1: full ramp or cache)
+    int steps;              // Density steps taken
+    double rho;             // Density of the converged solution
+    double alpha;           // Closure alpha of the solution (fitted for RY)
+    double *gamma;          // [nodes*ncols] converged gamma
+    double *Sk;             // [n_out] S(k) on cfg->k_out
+    double *Gr;             // [n_out] g(r) on cfg->r_out
+    OZResult *result;       // Solver-grid result for bin/hdf5 output (NULL for text)
+} SweepTask;
+
+typedef struct {
+    const SweepConfig *cfg;
+    SweepTask *tasks;
+    int *order;             // Scheduling order (indices into tasks)
+    int n_tasks;
+    int next;               // Next position of order to hand out
+    int completed;
+    int failed;             // Completed points that did not converge
+    double scale_vf;        // Ranges used to normalise neighbour distances
+    double scale_T;
+    OZTimings timings;      // Phase counters of the finished workers
+    pthread_mutex_t lock;
+} SweepShared;
+
+static const StatePoint *sort_points;
+
+/*
+ * Orders by temperature and then by volume fraction, reversing the
+ * direction on every other temperature so consecutive points stay close.
+ */
+static int compare_points(const void *a, const void *b) {
+    const StatePoint *pa = &sort_points[*(const int *) a];
+    const StatePoint *pb = &sort_points[*(const int *) b];
+
+    if (pa->temperature < pb->temperature) return -1;
+    if (pa->temperature > pb->temperature) return 1;
+    if (pa->volumeFactor < pb->volumeFactor) return -1;
+    if (pa->volumeFactor > pb->volumeFactor) return 1;
+    return 0;
+}
+
+static void serpentine_order(int *order, int n) {
+    int start = 0;
+    int row = 0;
+
+    while (start < n) {
+        int end = start;
+        while (end < n && sort_points[order[end]].temperature == sort_points[order[start]].temperature) end++;
+
+        if (row % 2 == 1) {
+            for (int i = start, j = end - 1; i < j; i++, j--) {
+                int t = order[i]; order[i] = order[j]; order[j] = t;
+            }
+        }
+
+        start = end;
+        row++;
+    }
+}
+
+// Caller must hold sh->lock
+static int nearest_solved(const SweepShared *sh, int t) {
+    const StatePoint *p = &sh->tasks[t].point;
+    int best = -1;
+    double best_dist = 0.0;
+
+    for (int j = 0; j < sh->n_tasks; j++) {
+        if (!sh->tasks[j].done) continue;
+
+        double dvf = (sh->tasks[j].point.volumeFactor - p->volumeFactor) / sh->scale_vf;
+        double dT = (sh->tasks[j].point.temperature - p->temperature) / sh->scale_T;
+        double dist = dvf*dvf + dT*dT;
+
+        if (best < 0 || dist < best_dist) {
+            best = j;
+            best_dist = dist;
+        }
+    }
+
+    return best;
+}
+
+static void *sweep_worker(void *arg) {
+    SweepShared *sh = arg;
+    const SweepConfig *cfg = sh->cfg;
+    int nodes = cfg->nodes;
+
+    OZContext *ctx = create_oz_context(nodes, rmax);
+    double *StructFactor = malloc(nodes*2 * sizeof(double));
+    double *Gr_data = malloc(nodes*2 * sizeof(double));
+    double *xIn = malloc(nodes * sizeof(double));
+    double *yIn = malloc(nodes * sizeof(double));
+
+    if (ctx == NULL || StructFactor == NULL || Gr_data == NULL || xIn == NULL || yIn == NULL) {
+        printf("Memory allocation failed in sweep_worker.\n");
+        free_oz_context(ctx);
+        free(StructFactor);
+        free(Gr_data);
+        free(xIn);
+        free(yIn);
+        return NULL;
+    }
+
+    size_t gamma_size = (size_t) ctx->nrows * ctx->ncols;
+
+    // Cold points (no solved neighbour) use the configured ramp
+    ctx->ramp_mode = rampMode;
+    ctx->predictor_order = predictorOrder;
+    ctx->solver = solverMode;
+    ctx->thermo_mode = thermoMode;
+    ctx->multigrid_levels = multigridLevels;
+    ctx->potential_table = potentialTable;
+
+    while (1) {
+        pthread_mutex_lock(&sh->lock);
+        if (sh->next >= sh->n_tasks) {
+            pthread_mutex_unlock(&sh->lock);
+            break;
+        }
+        int t = sh->order[sh->next++];
+        SweepTask *task = &sh->tasks[t];
+        int seed = nearest_solved(sh, t);
+        oz_telemetry_set_point(t);
+        // Solved tasks are never modified again, so the seed can be read unlocked
+        const double *gammaSeed = (seed >= 0) ? sh->tasks[seed].gamma : NULL;
+        double rhoSeed = (seed >= 0) ? sh->tasks[seed].rho : 0.0;
+        // The RY search starts from the neighbour's alpha
+        ctx->ry_alpha_seed = (seed >= 0) ? sh->tasks[seed].alpha : 0.0;
+        pthread_mutex_unlock(&sh->lock);
+
+        OZCacheKey key;
+        double *cachedGamma = NULL;
+        if (cfg->cache_dir != NULL) {
+            spherical_cache_key(&key, ctx, cfg->potentialID, cfg->closureID, cfg->Temperature2, cfg->lambda_a, \
+                                cfg->lambda_r, task->point.volumeFactor, task->point.temperature);
+            // Without a solved neighbour start from the nearest cached point;
+            // with one, only a cached solution of this very point beats it
+            double rhoCached, alphaCached;
+            cachedGamma = spherical_cache_seed(cfg->cache_dir, &key, ctx, (seed < 0) ? OZ_CACHE_MAX_DISTANCE : 0.0, \
+                                               &rhoCached, &alphaCached);
+            if (cachedGamma != NULL) {
+                gammaSeed = cachedGamma;
+                rhoSeed = rhoCached;
+                ctx->ry_alpha_seed = alphaCached;
+                seed = -1;
+            }
+        }
+
+        int printFlag = 1;
+        char *folderName = getFolderID();
+
+        int steps = facdes2YSolve(ctx, cfg->potentialID, cfg->closureID, sigma1, sigma2, \
+                                  task->point.temperature, cfg->Temperature2, cfg->lambda_a, cfg->lambda_r, \
+                                  task->point.volumeFactor, alpha, EZ, nrho, gammaSeed, rhoSeed, \
+                                  StructFactor, Gr_data, folderName, &printFlag);
+        int cached = (cachedGamma != NULL);
+        // A seeded continuation that diverged is redone with the full ramp
+        if (gammaSeed != NULL && !spherical_cache_usable(ctx)) {
+            printf("\n[barrido] phi = %.4f  T = %.4f: la continuación desde la semilla (%s) no convergió; rampa completa\n", \
+                   task->point.volumeFactor, task->point.temperature, cached ? "caché" : "vecino");
+            cached = 0;
+            seed = -1;
+            ctx->ry_alpha_seed = 0.0;
+            steps = facdes2YSolve(ctx, cfg->potentialID, cfg->closureID, sigma1, sigma2, \
+                                  task->point.temperature, cfg->Temperature2, cfg->lambda_a, cfg->lambda_r, \
+                                  task->point.volumeFactor, alpha, EZ, nrho, NULL, 0.0, \
+                                  StructFactor, Gr_data, folderName, &printFlag);
+        }
+        free(folderName);
+        free(cachedGamma);
+        int converged = spherical_cache_usable(ctx);
+        if (cfg->cache_dir != NULL) spherical_cache_store(cfg->cache_dir, &key, ctx);
+
+        for (int i = 0; i < nodes; i++) {
+            xIn[i] = StructFactor[i*2 + 0];
+            yIn[i] = StructFactor[i*2 + 1];
+        }
+        interpolationFunc(xIn, yIn, (double *) cfg->k_out, task->Sk, nodes, cfg->n_out);
+
+        for (int i = 0; i < nodes; i++) {
+            xIn[i] = Gr_data[i*2 + 0];
+            yIn[i] = Gr_data[i*2 + 1];
+        }
+        interpolationFunc(xIn, yIn, (double *) cfg->r_out, task->Gr, nodes, cfg->n_out);
+
+        // Only a converged gamma may seed the neighbours
+        double *gamma = converged ? malloc(gamma_size * sizeof(double)) : NULL;
+        if (gamma != NULL) {
+            memcpy(gamma, ctx->gamma, gamma_size * sizeof(double));
+        }
+
+        OZResult *result = NULL;
+        if (cfg->output_format != OZ_OUTPUT_TEXT) {
+            result = create_oz_result(nodes);
+            if (result != NULL) {
+                oz_result_from_context(result, ctx, StructFactor, Gr_data);
+            } else {
+                printf("Memory allocation failed in sweep_worker.\n");
+            }
+        }
+
+        pthread_mutex_lock(&sh->lock);
+        task->gamma = gamma;
+        task->result = result;
+        task->rho = ctx->rho;
+        task->alpha = ctx->ry_alpha;
+        task->seed = seed;
+        task->steps = steps;
+        // A converged point without a stored gamma still has valid output, it just cannot seed others
+        task->done = (gamma != NULL);
+        task->converged = converged;
+        sh->completed++;
+        if (!converged) {
+            printf("\n[barrido] %d/%d  phi = %.4f  T = %.4f  NO CONVERGIÓ\n", sh->completed, sh->n_tasks, \
+                   task->point.volumeFactor, task->point.temperature);
+            sh->failed++;
+        } else if (seed >= 0) {
+            printf("\n[barrido] %d/%d  phi = %.4f  T = %.4f  semilla: #%d (%d pasos)\n", sh->completed, sh->n_tasks, \
+                   task->point.volumeFactor, task->point.temperature, seed, steps);
+        } else if (cached) {
+            printf("\n[barrido] %d/%d  phi = %.4f  T = %.4f  semilla: caché (%d pasos)\n", sh->completed, sh->n_tasks, \
+                   task->point.volumeFactor, task->point.temperature, steps);
+        } else {
+            printf("\n[barrido] %d/%d  phi = %.4f  T = %.4f  rampa completa (%d pasos)\n", sh->completed, sh->n_tasks, \
+                   task->point.volumeFactor, task->point.temperature, steps);
+        }
+        fflush(stdout);
+        pthread_mutex_unlock(&sh->lock);
+    }
+
+    free_oz_context(ctx);
+    free(StructFactor);
+    free(Gr_data);
+    free(xIn);
+    free(yIn);
+
+    // Hand the phase counters of this thread to run_sweep
+    pthread_mutex_lock(&sh->lock);
+    const OZTimings *own = oz_timings();
+    for (int p = 0; p < OZ_N_PHASES; p++) sh->timings.seconds[p] += own->seconds[p];
+    sh->timings.iterations += own->iterations;
+    pthread_mutex_unlock(&sh->lock);
+    oz_timing_reset();
+
+    return NULL;
+}
+
+int read_sweep_file(const char *path, StatePoint **points, int *n_points) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: No se pudo abrir el archivo de barrido %s.\n", path);
+        return 1;
+    }
+
+    int capacity = 64;
+    int n = 0;
+    StatePoint *list = malloc(capacity * sizeof(StatePoint));
+    if (list == NULL) {
+        printf("Memory allocation failed in read_sweep_file.\n");
+        fclose(file);
+        return 1;
+    }
+
+    char line[512];
+    int line_number = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') continue;
+
+        double vf0, vf1, T0, T1;
+        int nvf, nT;
+        int needed;
+
+        if (strncmp(p, "grid", 4) == 0) {
+            if (sscanf(p + 4, "%lf %lf %d %lf %lf %d", &vf0, &vf1, &nvf, &T0, &T1, &nT) != 6 || nvf < 1 || nT < 1) {
+                fprintf(stderr, "Error: Línea %d de %s: se esperaba 'grid vf_min vf_max n_vf T_min T_max n_T'.\n", line_number, path);
+                free(list);
+                fclose(file);
+                return 1;
+            }
+            needed = nvf * nT;
+        } else {
+            if (sscanf(p, "%lf %lf", &vf0, &T0) != 2) {
+                fprintf(stderr, "Error: Línea %d de %s: se esperaba 'volfactor temp'.\n", line_number, path);
+                free(list);
+                fclose(file);
+                return 1;
+            }
+            vf1 = vf0; T1 = T0;
+            nvf = 1; nT = 1;
+            needed = 1;
+        }
+
+        if (n + needed > capacity) {
+            while (n + needed > capacity) capacity *= 2;
+            StatePoint *grown = realloc(list, capacity * sizeof(StatePoint));
+            if (grown == NULL) {
+                printf("Memory allocation failed in read_sweep_file.\n");
+                free(list);
+                fclose(file);
+                return 1;
+            }
+            list = grown;
+        }
+
+        for (int j = 0; j < nT; j++) {
+            for (int i = 0; i < nvf; i++) {
+                list[n].volumeFactor = (nvf > 1) ? vf0 + i * (vf1 - vf0) / (nvf - 1) : vf0;
+                list[n].temperature = (nT > 1) ? T0 + j * (T1 - T0) / (nT - 1) : T0;
+                n++;
+            }
+        }
+    }
+
+    fclose(file);
+
+    if (n == 0) {
+        fprintf(stderr, "Error: El archivo de barrido %s no contiene puntos.\n", path);
+        free(list);
+        return 1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (list[i].volumeFactor <= 0.0 || list[i].temperature <= 0.0) {
+            fprintf(stderr, "Error: Punto %d de %s: volfactor y temp deben ser > 0.\n", i, path);
+            free(list);
+            return 1;
+        }
+    }
+
+    *points = list;
+    *n_points = n;
+    return 0;
+}
+
+// bin/hdf5: one point per task, in input order, on the solver grid
+static int write_sweep_points(const SweepShared *sh) {
+    const SweepConfig *cfg = sh->cfg;
+
+    OZOutput *out = create_oz_output(cfg->output_path, cfg->output_format);
+    if (out == NULL) {
+        fprintf(stderr, "Error: Could not open file %s for writing.\n", cfg->output_path);
+        return 1;
+    }
+
+    int status = write_oz_result_header(out, cfg->potentialID, cfg->closureID, cfg->nodes, \
+                                        cfg->Temperature2, cfg->lambda_a, cfg->lambda_r);
+    for (int t = 0; t < sh->n_tasks && status == 0; t++) {
+        const SweepTask *task = &sh->tasks[t];
+        if (task->result == NULL) {
+            status = 1;
+            break;
+        }
+        status = oz_output_begin_point(out) | \
+                 write_oz_result(out, task->result, task->point.volumeFactor, task->point.temperature) | \
+                 oz_output_attr_int(out, "seed", task->seed) | \
+                 oz_output_attr_int(out, "converged", task->converged) | \
+                 oz_output_end_point(out);
+    }
+    free_oz_output(out);
+
+    if (status != 0) fprintf(stderr, "Error: Could not write file %s.\n", cfg->output_path);
+    return status;
+}
+
+static int write_sweep_output(const SweepShared *sh) {
+    const SweepConfig *cfg = sh->cfg;
+
+    if (cfg->output_format != OZ_OUTPUT_TEXT) return write_sweep_points(sh);
+
+    FILE *outputFile = fopen(cfg->output_path, "w");
+    if (outputFile == NULL) {
+        fprintf(stderr, "Error: Could not open file %s for writing.\n", cfg->output_path);
+        return 1;
+    }
+
+    fprintf(outputFile, "# Sweep: potential %d, closure %s, %d state points, %d nodes\n", \
+            cfg->potentialID, (cfg->closureID == 3) ? "RY" : "HNC", sh->n_tasks, cfg->nodes);
+    fprintf(outputFile, "# One block per point (gnuplot index = point number)\n");
+
+    for (int t = 0; t < sh->n_tasks; t++) {
+        const SweepTask *task = &sh->tasks[t];
+
+        if (t > 0) fprintf(outputFile, "\n\n");
+        fprintf(outputFile, "# point %d: volfactor = %.17g temp = %.17g seed = %d steps = %d%s\n", \
+                t, task->point.volumeFactor, task->point.temperature, task->seed, task->steps, \
+                task->converged ? "" : " (no convergió)");
+        fprintf(outputFile, "# k\tS(k)\tr\tg(r)\n");
+
+        // A point that did not converge is written as nan, never as a (wrong) solution
+        for (int i = 0; i < cfg->n_out; i++) {
+            fprintf(outputFile, "%.17lf\t%.17lf\t%.17lf\t%.17lf\n", cfg->k_out[i], task->converged ? task->Sk[i] : NAN, \
+                    cfg->r_out[i], task->converged ? task->Gr[i] : NAN);
+        }
+    }
+
+    fclose(outputFile);
+    return 0;
+}
+
+int run_sweep(const StatePoint *points, int n_points, const SweepConfig *cfg) {
+    SweepShared sh;
+    int status = 0;
+
+    sh.cfg = cfg;
+    sh.n_tasks = n_points;
+    sh.next = 0;
+    sh.completed = 0;
+    sh.failed = 0;
+    memset(&sh.timings, 0, sizeof(sh.timings));
+    sh.tasks = calloc(n_points, sizeof(SweepTask));
+    sh.order = malloc(n_points * sizeof(int));
+
+    if (sh.tasks == NULL || sh.order == NULL) {
+        printf("Memory allocation failed in run_sweep.\n");
+        free(sh.tasks);
+        free(sh.order);
+        return 1;
+    }
+
+    double vf_min = points[0].volumeFactor, vf_max = vf_min;
+    double T_min = points[0].temperature, T_max = T_min;
+
+    for (int t = 0; t < n_points; t++) {
+        sh.tasks[t].point = points[t];
+        sh.tasks[t].seed = -1;
+        sh.tasks[t].Sk = malloc(cfg->n_out * sizeof(double));
+        sh.tasks[t].Gr = malloc(cfg->n_out * sizeof(double));
+        if (sh.tasks[t].Sk == NULL || sh.tasks[t].Gr == NULL) {
+            printf("Memory allocation failed in run_sweep.\n");
+            status = 1;
+        }
+        sh.order[t] = t;
+
+        vf_min = fmin(vf_min, points[t].volumeFactor);
+        vf_max = fmax(vf_max, points[t].volumeFactor);
+        T_min = fmin(T_min, points[t].temperature);
+        T_max = fmax(T_max, points[t].temperature);
+    }
+
+    sh.scale_vf = (vf_max > vf_min) ? vf_max - vf_min : 1.0;
+    sh.scale_T = (T_max > T_min) ? T_max - T_min : 1.0;
+
+    sort_points = points;
+    qsort(sh.order, n_points, sizeof(int), compare_points);
+    serpentine_order(sh.order, n_points);
+
+    int n_threads = cfg->n_threads;
+    if (n_threads <= 0) n_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads < 1) n_threads = 1;
+    if (n_threads > n_points) n_threads = n_points;
+
+    if (status == 0) {
+        printf("Barrido: %d puntos de estado, %d hilos.\n", n_points, n_threads);
+
+        pthread_t *threads = malloc(n_threads * sizeof(pthread_t));
+        if (threads == NULL) {
+            printf("Memory allocation failed in run_sweep.\n");
+            status = 1;
+        } else {
+            pthread_mutex_init(&sh.lock, NULL);
+
+            int started = 0;
+            for (int i = 0; i < n_threads; i++) {
+                if (pthread_create(&threads[i], NULL, sweep_worker, &sh) != 0) break;
+                started++;
+            }
+            if (started == 0) {
+                // No thread could be created; solve on the calling thread
+                sweep_worker(&sh);
+            }
+            for (int i = 0; i < started; i++) {
+                pthread_join(threads[i], NULL);
+            }
+
+            pthread_mutex_destroy(&sh.lock);
+            free(threads);
+            oz_timing_merge(&sh.timings);
+
+            if (sh.completed < n_points) {
+                fprintf(stderr, "Error: Solo se resolvieron %d de %d puntos.\n", sh.completed, n_points);
+                status = 1;
+            } else {
+                double t_output = oz_time_now();
+                status = write_sweep_output(&sh);
+                oz_timing_stop(OZ_PHASE_OUTPUT, t_output);
+                if (status == 0) printf("\nResultados del barrido escritos en %s\n", cfg->output_path);
+                if (sh.failed > 0) {
+                    fprintf(stderr, "Error: %d de %d puntos no convergieron (escritos como nan).\n", sh.failed, n_points);
+                    status = 1;
+                }
+            }
+        }
+    }
+
+    for (int t = 0; t < n_points; t++) {
+        free(sh.tasks[t].gamma);
+        free(sh.tasks[t].Sk);
+        free(sh.tasks[t].Gr);
+        free_oz_result(sh.tasks[t].result);
+    }
+    free(sh.tasks);
+    free(sh.order);
+
+    return status;
+}